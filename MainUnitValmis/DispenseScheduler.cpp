@@ -0,0 +1,305 @@
+#include "DispenseScheduler.h"
+#include <Preferences.h>
+
+DispenseScheduler::DispenseScheduler(DispensingController* dispensingController)
+    : dispensing(dispensingController), nextJobId(1), completionHead(0), completionCount(0), totalCompleted(0) {
+    mutex = xSemaphoreCreateRecursiveMutex();
+    for (int i = 0; i < DISPENSING_MAX_PUMPS; i++) {
+        PumpQueue& pump = pumps[i];
+        pump.head = 0;
+        pump.count = 0;
+        pump.state = QUEUE_IDLE;
+        pump.running.jobId = 0;
+        pump.sessionId = 0;
+        pump.dwellStart = 0;
+        pump.options.dwellMs = SCHEDULER_DEFAULT_DWELL_MS;
+        pump.options.requireConfirm = false;
+        memset(&pump.stats, 0, sizeof(pump.stats));
+    }
+}
+
+void DispenseScheduler::begin() {
+    Preferences prefs;
+    if (!prefs.begin(SCHEDULER_PREFS_NAMESPACE, true)) {
+        return;
+    }
+    char key[8];
+    for (int pumpId = 1; pumpId <= DISPENSING_MAX_PUMPS; pumpId++) {
+        snprintf(key, sizeof(key), "pump%d", pumpId);
+        PumpQueueOptions saved;
+        if (prefs.getBytes(key, &saved, sizeof(saved)) == sizeof(saved)) {
+            pumps[pumpId - 1].options = saved;
+        }
+    }
+    prefs.end();
+}
+
+uint32_t DispenseScheduler::enqueue(int pumpId, float volume) {
+    if (!isValidPump(pumpId)) {
+        return 0;
+    }
+
+    Guard guard(mutex);
+    PumpQueue& pump = pumps[pumpId - 1];
+    if (!dispensing->isValidPumpId(pumpId) || volume <= 0 || pump.count >= SCHEDULER_QUEUE_DEPTH) {
+        pump.stats.rejected++;
+        return 0;
+    }
+    DispenseJob& job = pump.jobs[(pump.head + pump.count) % SCHEDULER_QUEUE_DEPTH];
+    job.jobId = nextJobId++;
+    job.volume = volume;
+    job.queuedAt = millis();
+    pump.count++;
+    pump.stats.enqueued++;
+    Serial.printf("Pump %d: job %lu queued, %.3f L, %d waiting\n",
+                 pumpId, (unsigned long)job.jobId, volume, pump.count);
+    return job.jobId;
+}
+
+bool DispenseScheduler::cancel(int pumpId, uint32_t jobId) {
+    if (!isValidPump(pumpId)) {
+        return false;
+    }
+
+    Guard guard(mutex);
+    PumpQueue& pump = pumps[pumpId - 1];
+    for (int i = 0; i < pump.count; i++) {
+        if (pump.jobs[(pump.head + i) % SCHEDULER_QUEUE_DEPTH].jobId != jobId) {
+            continue;
+        }
+        // Close the gap, keeping the order of the rest
+        for (int j = i; j < pump.count - 1; j++) {
+            pump.jobs[(pump.head + j) % SCHEDULER_QUEUE_DEPTH] = pump.jobs[(pump.head + j + 1) % SCHEDULER_QUEUE_DEPTH];
+        }
+        pump.count--;
+        Serial.printf("Pump %d: job %lu cancelled\n", pumpId, (unsigned long)jobId);
+        return true;
+    }
+    return false;
+}
+
+void DispenseScheduler::clear(int pumpId) {
+    if (!isValidPump(pumpId)) return;
+
+    Guard guard(mutex);
+    PumpQueue& pump = pumps[pumpId - 1];
+    pump.head = 0;
+    pump.count = 0;
+    if (pump.state == QUEUE_AWAIT_CONFIRM) {
+        pump.state = QUEUE_IDLE;
+    }
+}
+
+bool DispenseScheduler::confirm(int pumpId) {
+    if (!isValidPump(pumpId)) {
+        return false;
+    }
+
+    Guard guard(mutex);
+    PumpQueue& pump = pumps[pumpId - 1];
+    if (pump.state != QUEUE_AWAIT_CONFIRM && pump.state != QUEUE_DWELL) {
+        return false;
+    }
+    if (pump.count == 0) {
+        pump.state = QUEUE_IDLE;
+        return false;
+    }
+    pump.state = QUEUE_IDLE;
+    return startNext(pumpId, millis());
+}
+
+bool DispenseScheduler::setOptions(int pumpId, uint32_t dwellMs, bool requireConfirm) {
+    if (!isValidPump(pumpId)) {
+        return false;
+    }
+
+    Guard guard(mutex);
+    pumps[pumpId - 1].options.dwellMs = dwellMs;
+    pumps[pumpId - 1].options.requireConfirm = requireConfirm;
+    saveOptions(pumpId);
+    return true;
+}
+
+void DispenseScheduler::saveOptions(int pumpId) {
+    Preferences prefs;
+    if (!prefs.begin(SCHEDULER_PREFS_NAMESPACE, false)) {
+        Serial.println("Queue options: NVS unavailable");
+        return;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "pump%d", pumpId);
+    prefs.putBytes(key, &pumps[pumpId - 1].options, sizeof(PumpQueueOptions));
+    prefs.end();
+}
+
+void DispenseScheduler::service() {
+    Guard guard(mutex);
+    uint32_t now = millis();
+    for (int pumpId = 1; pumpId <= dispensing->getPumpCount(); pumpId++) {
+        servicePump(pumpId, now);
+    }
+}
+
+void DispenseScheduler::servicePump(int pumpId, uint32_t now) {
+    PumpQueue& pump = pumps[pumpId - 1];
+    switch (pump.state) {
+        case QUEUE_RUNNING: {
+            DispensingState state = dispensing->getState(pumpId);
+            if (dispensing->getSessionId(pumpId) != pump.sessionId) {
+                // Someone started another session over ours
+                finishJob(pumpId, READY, now);
+            } else if (state != DISPENSING && state != PAUSED) {
+                finishJob(pumpId, state, now);
+            }
+            break;
+        }
+        case QUEUE_DWELL:
+            if (now - pump.dwellStart >= pump.options.dwellMs) {
+                pump.state = (pump.options.requireConfirm && pump.count > 0) ? QUEUE_AWAIT_CONFIRM : QUEUE_IDLE;
+            }
+            break;
+        case QUEUE_AWAIT_CONFIRM:
+            if (pump.count == 0) {
+                pump.state = QUEUE_IDLE;
+            }
+            break;
+        case QUEUE_HELD:
+            // After an error (or emergency stop) the rest of the queue waits
+            // for a confirm rather than starting on its own
+            if (dispensing->getState(pumpId) != ERROR_STATE) {
+                pump.state = pump.count > 0 ? QUEUE_AWAIT_CONFIRM : QUEUE_IDLE;
+            }
+            break;
+        case QUEUE_IDLE:
+            break;
+    }
+    if (pump.state == QUEUE_IDLE && pump.count > 0) {
+        startNext(pumpId, now);
+    }
+}
+
+bool DispenseScheduler::startNext(int pumpId, uint32_t now) {
+    PumpQueue& pump = pumps[pumpId - 1];
+    DispensingState state = dispensing->getState(pumpId);
+    if (state == DISPENSING || state == PAUSED) {
+        return false;  // Started by hand; the queue waits for it
+    }
+    if (state == ERROR_STATE) {
+        pump.state = QUEUE_HELD;
+        return false;
+    }
+
+    DispenseJob job = pump.jobs[pump.head];
+    pump.head = (pump.head + 1) % SCHEDULER_QUEUE_DEPTH;
+    pump.count--;
+    if (!dispensing->startDispensing(pumpId, job.volume)) {
+        pump.stats.failed++;
+        Serial.printf("Pump %d: job %lu could not start, dropped\n", pumpId, (unsigned long)job.jobId);
+        return false;
+    }
+
+    uint32_t waitMs = now - job.queuedAt;
+    PumpQueueStats& stats = pump.stats;
+    stats.started++;
+    stats.lastWaitMs = waitMs;
+    stats.meanWaitMs += (waitMs - stats.meanWaitMs) / stats.started;
+    if (waitMs > stats.maxWaitMs) {
+        stats.maxWaitMs = waitMs;
+    }
+    pump.running = job;
+    pump.sessionId = dispensing->getSessionId(pumpId);
+    pump.state = QUEUE_RUNNING;
+    Serial.printf("Pump %d: job %lu started after %lu ms in the queue, %d waiting\n",
+                 pumpId, (unsigned long)job.jobId, (unsigned long)waitMs, pump.count);
+    return true;
+}
+
+void DispenseScheduler::finishJob(int pumpId, DispensingState endState, uint32_t now) {
+    PumpQueue& pump = pumps[pumpId - 1];
+    if (endState == COMPLETED) {
+        pump.stats.completed++;
+        totalCompleted++;
+        completions[(completionHead + completionCount) % SCHEDULER_RATE_SAMPLES] = now;
+        if (completionCount < SCHEDULER_RATE_SAMPLES) {
+            completionCount++;
+        } else {
+            completionHead = (completionHead + 1) % SCHEDULER_RATE_SAMPLES;
+        }
+    } else {
+        pump.stats.failed++;
+    }
+    Serial.printf("Pump %d: job %lu %s\n", pumpId, (unsigned long)pump.running.jobId,
+                 endState == COMPLETED ? "done" : "did not complete");
+    pump.running.jobId = 0;
+
+    if (endState == ERROR_STATE) {
+        pump.state = QUEUE_HELD;
+    } else {
+        pump.state = QUEUE_DWELL;
+        pump.dwellStart = now;
+    }
+}
+
+PumpQueueState DispenseScheduler::getState(int pumpId) const {
+    if (!isValidPump(pumpId)) return QUEUE_IDLE;
+    return pumps[pumpId - 1].state;
+}
+
+int DispenseScheduler::getQueueDepth(int pumpId) const {
+    if (!isValidPump(pumpId)) return 0;
+    return pumps[pumpId - 1].count;
+}
+
+const DispenseJob& DispenseScheduler::getJob(int pumpId, int position) const {
+    const PumpQueue& pump = pumps[pumpId - 1];
+    return pump.jobs[(pump.head + position) % SCHEDULER_QUEUE_DEPTH];
+}
+
+uint32_t DispenseScheduler::getRunningJobId(int pumpId) const {
+    if (!isValidPump(pumpId)) return 0;
+    return pumps[pumpId - 1].running.jobId;
+}
+
+uint32_t DispenseScheduler::getOldestWaitMs(int pumpId) const {
+    if (!isValidPump(pumpId) || pumps[pumpId - 1].count == 0) return 0;
+    return millis() - getJob(pumpId, 0).queuedAt;
+}
+
+uint32_t DispenseScheduler::getDwellRemainingMs(int pumpId) const {
+    if (!isValidPump(pumpId)) return 0;
+    const PumpQueue& pump = pumps[pumpId - 1];
+    if (pump.state != QUEUE_DWELL) return 0;
+    uint32_t elapsed = millis() - pump.dwellStart;
+    return elapsed >= pump.options.dwellMs ? 0 : pump.options.dwellMs - elapsed;
+}
+
+float DispenseScheduler::getDrinksPerHour() const {
+    uint32_t now = millis();
+    int recent = 0;
+    for (int i = 0; i < completionCount; i++) {
+        if (now - completions[(completionHead + i) % SCHEDULER_RATE_SAMPLES] <= SCHEDULER_RATE_WINDOW_MS) {
+            recent++;
+        }
+    }
+    if (recent == SCHEDULER_RATE_SAMPLES) {
+        // The whole ring is inside the window: rate over the span it covers
+        uint32_t oldest = completions[completionHead];
+        uint32_t newest = completions[(completionHead + completionCount - 1) % SCHEDULER_RATE_SAMPLES];
+        uint32_t span = newest - oldest;
+        if (span > 0) {
+            return (recent - 1) * 3600000.0f / span;
+        }
+    }
+    return recent * 3600000.0f / SCHEDULER_RATE_WINDOW_MS;
+}
+
+const char* DispenseScheduler::stateName(PumpQueueState state) {
+    switch (state) {
+        case QUEUE_IDLE: return "idle";
+        case QUEUE_RUNNING: return "running";
+        case QUEUE_DWELL: return "dwell";
+        case QUEUE_AWAIT_CONFIRM: return "awaitConfirm";
+        case QUEUE_HELD: return "held";
+    }
+    return "unknown";
+}
@@ -0,0 +1,117 @@
+#ifndef DISPENSE_SCHEDULER_H
+#define DISPENSE_SCHEDULER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "DispensingController.h"
+
+#define SCHEDULER_QUEUE_DEPTH 8                      // Waiting jobs per pump
+#define SCHEDULER_DEFAULT_DWELL_MS OVERSHOOT_SETTLE_MS  // Cup change; also lets the overshoot settle
+#define SCHEDULER_RATE_WINDOW_MS 300000              // Drinks/hour over the last 5 minutes
+#define SCHEDULER_RATE_SAMPLES 128                   // Completion times kept for it
+#define SCHEDULER_PREFS_NAMESPACE "queue"
+
+struct DispenseJob {
+    uint32_t jobId;
+    float volume;                  // Litres
+    uint32_t queuedAt;             // millis()
+};
+
+// How a pump moves from one job to the next: wait dwellMs, then either
+// start the next job or, with requireConfirm, wait for confirm()
+struct PumpQueueOptions {
+    uint32_t dwellMs;
+    bool requireConfirm;
+};
+
+enum PumpQueueState {
+    QUEUE_IDLE,                    // Nothing running; starts the next job when there is one
+    QUEUE_RUNNING,                 // A job's session is dispensing or paused
+    QUEUE_DWELL,                   // Cup change after a job
+    QUEUE_AWAIT_CONFIRM,           // Next job waits for confirm()
+    QUEUE_HELD                     // Last job ended in an error; waits for it to be cleared, then for confirm()
+};
+
+struct PumpQueueStats {
+    uint32_t enqueued;
+    uint32_t rejected;             // Queue full or invalid
+    uint32_t started;
+    uint32_t completed;
+    uint32_t failed;               // Stopped, or ended in an error
+    uint32_t lastWaitMs;           // Queued -> started
+    float meanWaitMs;
+    uint32_t maxWaitMs;
+};
+
+// Per-pump job queues in front of the DispensingController. Each pump runs
+// its jobs back to back with a dwell between cups, and pumps run in
+// parallel. Jobs may be queued from any task; service() starts them and
+// belongs on the control task next to DispensingController::service().
+class DispenseScheduler {
+public:
+    DispenseScheduler(DispensingController* dispensing);
+    // Load per-pump queue options from NVS
+    void begin();
+    void service();
+
+    // Returns the job id, or 0 if the pump is invalid or its queue is full
+    uint32_t enqueue(int pumpId, float volume);
+    bool cancel(int pumpId, uint32_t jobId);
+    void clear(int pumpId);
+    // Cup is in place: start the next job now, skipping what is left of the dwell
+    bool confirm(int pumpId);
+
+    bool setOptions(int pumpId, uint32_t dwellMs, bool requireConfirm);
+    const PumpQueueOptions& getOptions(int pumpId) const { return pumps[pumpId - 1].options; }
+
+    PumpQueueState getState(int pumpId) const;
+    int getQueueDepth(int pumpId) const;
+    const DispenseJob& getJob(int pumpId, int position) const;  // 0 is next
+    uint32_t getRunningJobId(int pumpId) const;
+    uint32_t getOldestWaitMs(int pumpId) const;
+    uint32_t getDwellRemainingMs(int pumpId) const;
+    const PumpQueueStats& getStats(int pumpId) const { return pumps[pumpId - 1].stats; }
+    float getDrinksPerHour() const;
+    uint32_t getTotalCompleted() const { return totalCompleted; }
+
+    static const char* stateName(PumpQueueState state);
+
+private:
+    struct PumpQueue {
+        DispenseJob jobs[SCHEDULER_QUEUE_DEPTH];
+        int head;
+        int count;
+        PumpQueueState state;
+        DispenseJob running;
+        uint32_t sessionId;        // Session the running job started
+        uint32_t dwellStart;
+        PumpQueueOptions options;
+        PumpQueueStats stats;
+    };
+
+    class Guard {
+    public:
+        explicit Guard(SemaphoreHandle_t m) : held(m) { xSemaphoreTakeRecursive(held, portMAX_DELAY); }
+        ~Guard() { xSemaphoreGiveRecursive(held); }
+    private:
+        SemaphoreHandle_t held;
+    };
+
+    DispensingController* dispensing;
+    SemaphoreHandle_t mutex;
+    PumpQueue pumps[DISPENSING_MAX_PUMPS];
+    uint32_t nextJobId;
+    uint32_t completions[SCHEDULER_RATE_SAMPLES];  // millis() of recent completed jobs
+    int completionHead;
+    int completionCount;
+    uint32_t totalCompleted;
+
+    bool isValidPump(int pumpId) const { return pumpId >= 1 && pumpId <= DISPENSING_MAX_PUMPS; }
+    void servicePump(int pumpId, uint32_t now);
+    bool startNext(int pumpId, uint32_t now);
+    void finishJob(int pumpId, DispensingState endState, uint32_t now);
+    void saveOptions(int pumpId);
+};
+
+#endif
@@ -1,11 +1,172 @@
 #include "DispensingController.h"
+#include <Preferences.h>
 
 DispensingController::DispensingController(RelayController* relayController)
-    : relay(relayController), maxFlowRate(5.0), defaultTimeoutMs(300000), volumeThreshold(0.01) {
+    : relay(relayController), pumpCount(DISPENSING_DEFAULT_PUMPS), maxFlowRate(5.0), defaultTimeoutMs(300000),
+      volumeThreshold(0.01), nextSessionId(1), sessionCallback(nullptr) {
+    mutex = xSemaphoreCreateRecursiveMutex();
+    
+    // Initialize every slot in the table, in use or not
+    for (int i = 0; i < DISPENSING_MAX_PUMPS; i++) {
+        pumps[i].sensorId = i + 1;
+        pumps[i].relayIndex = i;
+        settling[i].pending = false;
+        topOff[i].relayOn = false;
+        fillProfileCount[i] = 1;
+        fillProfiles[i][0].minTarget = 0.0f;
+        fillProfiles[i][0].bulkFraction = 1.0f;  // Continuous until configured otherwise
+        fillProfiles[i][0].pulseOnMs = 0;
+        fillProfiles[i][0].pulseOffMs = 0;
+        memset(fillStats[i], 0, sizeof(fillStats[i]));
+        memset(faultCounts[i], 0, sizeof(faultCounts[i]));
+        resetSlot(i);
+    }
+}
+
+void DispensingController::begin() {
+    Preferences prefs;
+    char key[8];
+    if (prefs.begin(PUMP_PREFS_NAMESPACE, true)) {
+        int count = prefs.getUChar("count", 0);
+        PumpConfig saved[DISPENSING_MAX_PUMPS];
+        size_t length = prefs.getBytesLength("map");
+        if (length > 0 && length % sizeof(PumpConfig) == 0 && length <= sizeof(saved)) {
+            prefs.getBytes("map", saved, length);
+            memcpy(pumps, saved, length);
+        }
+        if (count >= 1 && count <= DISPENSING_MAX_PUMPS) {
+            pumpCount = count;
+        }
+        prefs.end();
+    }
+    for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+        const PumpConfig& pump = pumps[getPumpIndex(pumpId)];
+        Serial.printf("Pump %d: flow sensor %d, relay %d\n", pumpId, pump.sensorId, pump.relayIndex);
+    }
     
-    // Initialize both sessions
-    for (int i = 0; i < 2; i++) {
-        resetSession(i + 1);
+    if (prefs.begin(OVERSHOOT_PREFS_NAMESPACE, true)) {
+        for (int pumpId = 1; pumpId <= DISPENSING_MAX_PUMPS; pumpId++) {
+            snprintf(key, sizeof(key), "pump%d", pumpId);
+            OvershootState saved;
+            if (prefs.getBytes(key, &saved, sizeof(saved)) == sizeof(saved) &&
+                models[getPumpIndex(pumpId)].setState(saved)) {
+                const OvershootModel& model = models[getPumpIndex(pumpId)];
+                Serial.printf("Pump %d overshoot model: latency %.0f ms, drip %.3f L from %lu sessions\n",
+                             pumpId, model.getLatencyMs(), model.getDripLiters(), (unsigned long)model.getSessions());
+            }
+        }
+        prefs.end();
+    }
+    if (prefs.begin(FILL_PREFS_NAMESPACE, true)) {
+        for (int pumpId = 1; pumpId <= DISPENSING_MAX_PUMPS; pumpId++) {
+            int index = getPumpIndex(pumpId);
+            snprintf(key, sizeof(key), "pump%d", pumpId);
+            size_t length = prefs.getBytesLength(key);
+            if (length == 0 || length % sizeof(FillProfile) != 0 || length > sizeof(fillProfiles[index])) {
+                continue;
+            }
+            prefs.getBytes(key, fillProfiles[index], length);
+            fillProfileCount[index] = length / sizeof(FillProfile);
+            Serial.printf("Pump %d: %d fill profiles\n", pumpId, fillProfileCount[index]);
+        }
+        prefs.end();
+    }
+    if (prefs.begin(FAULT_PREFS_NAMESPACE, true)) {
+        for (int pumpId = 1; pumpId <= DISPENSING_MAX_PUMPS; pumpId++) {
+            snprintf(key, sizeof(key), "pump%d", pumpId);
+            FaultLimits saved;
+            if (prefs.getBytes(key, &saved, sizeof(saved)) == sizeof(saved) && saved.version == FAULT_LIMITS_VERSION) {
+                faults[getPumpIndex(pumpId)].setLimits(saved);
+                Serial.printf("Pump %d fault limits: dry run %u ms, %.2f-%.2f L/min, stall below %.0f%% of peak\n",
+                             pumpId, saved.dryRunMs, saved.minRateLpm, saved.maxRateLpm, saved.stallFraction * 100.0f);
+            }
+        }
+        prefs.end();
+    }
+}
+
+bool DispensingController::setPumpCount(int count) {
+    if (count < 1 || count > DISPENSING_MAX_PUMPS) {
+        return false;
+    }
+    
+    Guard guard(mutex);
+    // Taps being dropped must be idle, or nothing could stop them
+    for (int pumpId = count + 1; pumpId <= pumpCount; pumpId++) {
+        DispensingState state = sessions[getPumpIndex(pumpId)].state;
+        if (state == DISPENSING || state == PAUSED) {
+            Serial.printf("Pump %d is busy, keeping %d pumps\n", pumpId, pumpCount);
+            return false;
+        }
+    }
+    // Taps being added bring their stored relay with them
+    for (int pumpId = pumpCount + 1; pumpId <= count; pumpId++) {
+        uint8_t relayIndex = pumps[getPumpIndex(pumpId)].relayIndex;
+        if (relayIndex >= relay->getRelayCount() || findRelayOwner(relayIndex, pumpId, count) != 0) {
+            Serial.printf("Pump %d has no relay of its own, keeping %d pumps\n", pumpId, pumpCount);
+            return false;
+        }
+    }
+    pumpCount = count;
+    savePumpTable();
+    Serial.printf("Dispensing with %d pumps\n", pumpCount);
+    return true;
+}
+
+bool DispensingController::configurePump(int pumpId, uint8_t sensorId, uint8_t relayIndex) {
+    if (pumpId < 1 || pumpId > DISPENSING_MAX_PUMPS || sensorId < 1 || relayIndex >= relay->getRelayCount()) {
+        return false;
+    }
+    
+    Guard guard(mutex);
+    int index = getPumpIndex(pumpId);
+    DispensingState state = sessions[index].state;
+    if (state == DISPENSING || state == PAUSED) {
+        return false;
+    }
+    int owner = findRelayOwner(relayIndex, pumpId, pumpCount);
+    if (owner != 0) {
+        // Two taps on one relay would open each other
+        Serial.printf("Relay %d already belongs to pump %d\n", relayIndex, owner);
+        return false;
+    }
+    if (pumps[index].sensorId != sensorId) {
+        // Counts from another sensor share nothing with the old baseline
+        meters[index] = SessionMeter();
+        settling[index].pending = false;
+        FaultLimits limits = faults[index].getLimits();
+        faults[index] = FaultDetector();
+        faults[index].setLimits(limits);
+    }
+    pumps[index].sensorId = sensorId;
+    pumps[index].relayIndex = relayIndex;
+    savePumpTable();
+    Serial.printf("Pump %d: flow sensor %d, relay %d\n", pumpId, sensorId, relayIndex);
+    return true;
+}
+
+void DispensingController::savePumpTable() {
+    Preferences prefs;
+    if (!prefs.begin(PUMP_PREFS_NAMESPACE, false)) {
+        Serial.println("Pump table: NVS unavailable");
+        return;
+    }
+    prefs.putUChar("count", pumpCount);
+    prefs.putBytes("map", pumps, sizeof(pumps));
+    prefs.end();
+}
+
+void DispensingController::service() {
+    Guard guard(mutex);
+    for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+        const DispensingSession& session = sessions[getPumpIndex(pumpId)];
+        if (session.state == DISPENSING && session.toppingOff) {
+            serviceTopOff(pumpId);
+        }
+        if (session.state == DISPENSING) {
+            // The timeout doesn't wait for a report
+            checkForErrors(pumpId);
+        }
     }
 }
 
@@ -14,11 +175,13 @@ bool DispensingController::startDispensing(int pumpId, float targetVolume, bool
         return false;
     }
     
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
     
-    // Don't start if already dispensing
-    if (session.state == DISPENSING) {
+    // Don't start over a running or paused session, nor over a fault
+    // that /dispense/clear hasn't acknowledged yet
+    if (session.state == DISPENSING || session.state == PAUSED || session.state == ERROR_STATE) {
         return false;
     }
     
@@ -26,24 +189,43 @@ bool DispensingController::startDispensing(int pumpId, float targetVolume, bool
     session.pumpId = pumpId;
     session.targetVolume = targetVolume;
     session.currentVolume = 0.0;
-    session.startVolume = 0.0;  // Will be set when we get first flow data
     session.startTime = millis();
     session.pauseTime = 0;
     session.state = DISPENSING;
     session.autoStop = autoStop;
     session.maxFlowRate = maxFlowRate;
     session.timeoutMs = defaultTimeoutMs;
-    
-    // Activate the pump
+    session.sessionId = nextSessionId++;
+    session.fillProfile = selectFillProfile(pumpId, targetVolume);
+    session.toppingOff = false;
+    session.fault = FAULT_NONE;
+    
+    // A stop still settling loses its measurement to the new session
+    settling[index].pending = false;
+    models[index].beginSession();
+    faults[index].setMonitoring(true);
+    
+    // Baseline on the sensor's count at the moment the relay closes
+    SessionMeter& meter = meters[index];
+    meter.latch(millis());
     activatePump(pumpId);
     
-    Serial.printf("Started dispensing on pump %d: target %.3f L\n", pumpId, targetVolume);
+    const FillProfile& profile = fillProfiles[index][session.fillProfile];
+    Serial.printf("Started dispensing on pump %d: target %.3f L, profile %d (bulk to %.0f%%)\n",
+                 pumpId, targetVolume, session.fillProfile, profile.bulkFraction * 100.0f);
+    if (meter.isBaselinePending()) {
+        Serial.printf("Pump %d: no flow count yet, baseline on first report\n", pumpId);
+    } else {
+        Serial.printf("Pump %d: baseline %llu pulses (count %lu ms old)\n", pumpId,
+                     (unsigned long long)meter.getBaseline(), (unsigned long)meter.getBaselineAgeMs());
+    }
     return true;
 }
 
 void DispensingController::stopDispensing(int pumpId) {
     if (!isValidPumpId(pumpId)) return;
     
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
     
@@ -57,6 +239,7 @@ void DispensingController::stopDispensing(int pumpId) {
 void DispensingController::pauseDispensing(int pumpId) {
     if (!isValidPumpId(pumpId)) return;
     
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
     
@@ -71,11 +254,19 @@ void DispensingController::pauseDispensing(int pumpId) {
 void DispensingController::resumeDispensing(int pumpId) {
     if (!isValidPumpId(pumpId)) return;
     
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
     
     if (session.state == PAUSED) {
-        activatePump(pumpId);
+        if (session.toppingOff) {
+            // Back into the pulse cycle, sizing the next pulse right away
+            notifySession(pumpId, true);
+            topOff[index].relayOn = false;
+            topOff[index].phaseStart = millis() - fillProfiles[index][session.fillProfile].pulseOffMs;
+        } else {
+            activatePump(pumpId);
+        }
         session.state = DISPENSING;
         // Adjust start time to account for pause duration
         if (session.pauseTime > 0) {
@@ -87,11 +278,13 @@ void DispensingController::resumeDispensing(int pumpId) {
 }
 
 void DispensingController::emergencyStopAll() {
+    Guard guard(mutex);
     Serial.println("EMERGENCY STOP - All dispensing stopped");
-    for (int pumpId = 1; pumpId <= 2; pumpId++) {
+    for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+        // Every pump latches, but only the ones it actually stopped count it
+        bool wasActive = isDispensing(pumpId) || isPaused(pumpId);
         stopDispensing(pumpId);
-        int index = getPumpIndex(pumpId);
-        sessions[index].state = ERROR_STATE;
+        raiseFault(pumpId, FAULT_EMERGENCY_STOP, wasActive);
     }
 }
 
@@ -167,56 +360,85 @@ float DispensingController::getEstimatedTimeRemaining(int pumpId) const {
     return (remainingVolume / currentRate) * 60.0; // seconds
 }
 
-void DispensingController::updateFlowData(float totalVolume) {
-    // Update only pump 1 session with flow sensor 1 data
-    int pumpId = 1;
+void DispensingController::updateFlowPulses(int pumpId, uint64_t pulses, float pulsesPerLiter, bool fresh) {
+    if (!isValidPumpId(pumpId)) return;
+    
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
+    SessionMeter& meter = meters[index];
+    bool wasPending = meter.isBaselinePending();
+    uint64_t previousCount = meter.getCount();
+    meter.update(pulses, pulsesPerLiter, millis());
+    if (wasPending && meter.isBaselineLate()) {
+        Serial.printf("Pump %d: no flow count at relay-on, baseline taken %lu ms late\n",
+                     pumpId, (unsigned long)(millis() - meter.getBaselineTime()));
+    }
+    
     DispensingSession& session = sessions[index];
+    // Every state: flow with the pump off shows up between sessions
+    FaultCode fault = faults[index].sample(meter.getCount(), meter.getPulsesPerLiter(), millis(),
+                                           isSensorShared(pumpId), fresh);
+    if (fault != FAULT_NONE) {
+        raiseFault(pumpId, fault);
+        return;
+    }
     
     if (session.state == DISPENSING) {
-        // Set start volume on first update
-        if (session.startVolume == 0.0 && totalVolume > 0) {
-            session.startVolume = totalVolume;
-            Serial.printf("Pump %d: Set start volume to %.3f L (Flow Sensor 1)\n", pumpId, totalVolume);
-        }
-        
-        // Calculate current dispensed volume
-        if (session.startVolume > 0) {
-            session.currentVolume = totalVolume - session.startVolume;
-            if (session.currentVolume < 0) session.currentVolume = 0;
+        session.currentVolume = meter.pulsesToLiters(meter.getSessionPulses());
+        if (meter.getCount() != previousCount) {
+            // Repeats from the periodic sync in loop() are not new samples
+            models[index].observeFlow(session.currentVolume, meter.getCountTime());
         }
         
         // Check for completion and errors
         checkForCompletion(pumpId);
-        checkForErrors(pumpId);
+        if (session.state == DISPENSING) {
+            checkForErrors(pumpId);
+        }
+    } else if (session.state == COMPLETED && settling[index].pending) {
+        // Keep counting what arrives after the stop
+        session.currentVolume = meter.pulsesToLiters(meter.getSessionPulses());
+        settleSession(pumpId);
     }
 }
 
-void DispensingController::updateFlow2Data(float totalVolume) {
-    // Update only pump 2 session with flow sensor 2 data
-    int pumpId = 2;
-    int index = getPumpIndex(pumpId);
-    DispensingSession& session = sessions[index];
+void DispensingController::noteCutoffLatency(int pumpId, uint32_t micros) {
+    if (!isValidPumpId(pumpId)) return;
     
-    if (session.state == DISPENSING) {
-        // Set start volume on first update
-        if (session.startVolume == 0.0 && totalVolume > 0) {
-            session.startVolume = totalVolume;
-            Serial.printf("Pump %d: Set start volume to %.3f L (Flow Sensor 2)\n", pumpId, totalVolume);
-        }
-        
-        // Calculate current dispensed volume
-        if (session.startVolume > 0) {
-            session.currentVolume = totalVolume - session.startVolume;
-            if (session.currentVolume < 0) session.currentVolume = 0;
+    Guard guard(mutex);
+    models[getPumpIndex(pumpId)].noteCutoffLatency(micros / 1000.0f);
+}
+
+void DispensingController::resetOvershootModel(int pumpId) {
+    if (!isValidPumpId(pumpId)) return;
+    
+    Guard guard(mutex);
+    int index = getPumpIndex(pumpId);
+    models[index].reset();
+    settling[index].pending = false;
+    saveOvershootModel(pumpId);
+    Serial.printf("Pump %d: overshoot model reset\n", pumpId);
+}
+
+uint64_t DispensingController::getSessionPulses(int pumpId) const {
+    if (!isValidPumpId(pumpId)) return 0;
+    return meters[getPumpIndex(pumpId)].getSessionPulses();
+}
+
+void DispensingController::updateSensorPulses(int sensorId, uint64_t pulses, float pulsesPerLiter, bool fresh) {
+    Guard guard(mutex);
+    for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+        if (pumps[getPumpIndex(pumpId)].sensorId == sensorId) {
+            updateFlowPulses(pumpId, pulses, pulsesPerLiter, fresh);
         }
-        
-        // Check for completion and errors
-        checkForCompletion(pumpId);
-        checkForErrors(pumpId);
     }
 }
 
+void DispensingController::updateSensorVolume(int sensorId, float totalVolume, bool fresh) {
+    // Counted in millilitres
+    updateSensorPulses(sensorId, (uint64_t)(totalVolume * 1000.0f + 0.5f), 1000.0f, fresh);
+}
+
 bool DispensingController::hasError(int pumpId) const {
     if (!isValidPumpId(pumpId)) return true;
     return sessions[getPumpIndex(pumpId)].state == ERROR_STATE;
@@ -227,39 +449,189 @@ String DispensingController::getErrorMessage(int pumpId) const {
     
     const DispensingSession& session = sessions[getPumpIndex(pumpId)];
     if (session.state != ERROR_STATE) return "";
+    return FaultDetector::describe(session.fault);
+}
+
+FaultCode DispensingController::getFaultCode(int pumpId) const {
+    if (!isValidPumpId(pumpId)) return FAULT_NONE;
     
-    // Check different error conditions
-    unsigned long elapsed = getElapsedTime(pumpId);
-    if (elapsed > session.timeoutMs) {
-        return "Timeout - dispensing took too long";
-    }
+    const DispensingSession& session = sessions[getPumpIndex(pumpId)];
+    return session.state == ERROR_STATE ? session.fault : FAULT_NONE;
+}
+
+void DispensingController::reportFault(int pumpId, FaultCode fault) {
+    if (!isValidPumpId(pumpId) || fault == FAULT_NONE || fault >= FAULT_CODE_COUNT) return;
     
-    return "Unknown error";
+    Guard guard(mutex);
+    raiseFault(pumpId, fault);
+}
+
+uint32_t DispensingController::getFaultCount(int pumpId, FaultCode code) const {
+    if (!isValidPumpId(pumpId) || code >= FAULT_CODE_COUNT) return 0;
+    return faultCounts[getPumpIndex(pumpId)][code];
+}
+
+void DispensingController::setMaxFlowRate(float maxRate) {
+    Guard guard(mutex);
+    maxFlowRate = maxRate;
+    for (int i = 0; i < DISPENSING_MAX_PUMPS; i++) {
+        FaultLimits limits = faults[i].getLimits();
+        limits.maxRateLpm = maxRate;
+        faults[i].setLimits(limits);
+    }
+}
+
+bool DispensingController::setFaultLimits(int pumpId, const FaultLimits& limits) {
+    if (!isValidPumpId(pumpId)) return false;
+    if (limits.dryRunMs == 0 || limits.confirmMs == 0 || limits.rateWindowMs == 0 || limits.leakWindowMs == 0) return false;
+    if (limits.minRateLpm < 0.0f || limits.maxRateLpm <= limits.minRateLpm) return false;
+    if (limits.stallFraction < 0.0f || limits.stallFraction >= 1.0f || limits.leakLiters <= 0.0f) return false;
+    if (limits.offGraceMs < OVERSHOOT_SETTLE_MS) return false;  // The drip after a stop is not a leak
+    
+    Guard guard(mutex);
+    FaultLimits saved = limits;
+    saved.version = FAULT_LIMITS_VERSION;
+    faults[getPumpIndex(pumpId)].setLimits(saved);
+    
+    Preferences prefs;
+    if (!prefs.begin(FAULT_PREFS_NAMESPACE, false)) {
+        Serial.println("Fault limits: NVS unavailable");
+        return true;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "pump%d", pumpId);
+    prefs.putBytes(key, &saved, sizeof(saved));
+    prefs.end();
+    Serial.printf("Pump %d fault limits: dry run %u ms, confirm %u ms, %.2f-%.2f L/min\n",
+                 pumpId, saved.dryRunMs, saved.confirmMs, saved.minRateLpm, saved.maxRateLpm);
+    return true;
 }
 
 void DispensingController::clearError(int pumpId) {
     if (!isValidPumpId(pumpId)) return;
     
+    Guard guard(mutex);
     int index = getPumpIndex(pumpId);
     if (sessions[index].state == ERROR_STATE) {
         resetSession(pumpId);
+        faults[index].rearm(millis());  // A leak that persists trips again after the grace
         Serial.printf("Cleared error for pump %d\n", pumpId);
     }
 }
 
-void DispensingController::activatePump(int pumpId) {
-    if (pumpId == 1) {
-        relay->setRelay1(true);
-    } else if (pumpId == 2) {
-        relay->setRelay2(true);
+uint32_t DispensingController::getSessionId(int pumpId) const {
+    if (!isValidPumpId(pumpId)) return 0;
+    return sessions[getPumpIndex(pumpId)].sessionId;
+}
+
+void DispensingController::setSessionCallback(void (*callback)(int, uint32_t, bool, float)) {
+    sessionCallback = callback;
+}
+
+bool DispensingController::setFillProfile(int pumpId, int slot, const FillProfile& profile) {
+    if (!isValidPumpId(pumpId) || slot < 0 || slot >= FILL_MAX_PROFILES) return false;
+    if (profile.minTarget < 0.0f || profile.bulkFraction <= 0.0f || profile.bulkFraction > 1.0f) return false;
+    if (profile.bulkFraction < 1.0f && (profile.pulseOnMs < FILL_MIN_PULSE_MS || profile.pulseOffMs == 0)) return false;
+    
+    Guard guard(mutex);
+    int index = getPumpIndex(pumpId);
+    if (slot > fillProfileCount[index]) return false;
+    fillProfiles[index][slot] = profile;
+    memset(&fillStats[index][slot], 0, sizeof(FillProfileStats));
+    if (slot == fillProfileCount[index]) {
+        fillProfileCount[index]++;
     }
+    saveFillProfiles(pumpId);
+    Serial.printf("Pump %d: fill profile %d from %.3f L, bulk to %.0f%%, pulses %u/%u ms\n",
+                 pumpId, slot, profile.minTarget, profile.bulkFraction * 100.0f,
+                 profile.pulseOnMs, profile.pulseOffMs);
+    return true;
+}
+
+void DispensingController::clearFillProfiles(int pumpId) {
+    if (!isValidPumpId(pumpId)) return;
+    
+    Guard guard(mutex);
+    int index = getPumpIndex(pumpId);
+    fillProfileCount[index] = 1;
+    fillProfiles[index][0].minTarget = 0.0f;
+    fillProfiles[index][0].bulkFraction = 1.0f;
+    fillProfiles[index][0].pulseOnMs = 0;
+    fillProfiles[index][0].pulseOffMs = 0;
+    memset(fillStats[index], 0, sizeof(fillStats[index]));
+    saveFillProfiles(pumpId);
+}
+
+int DispensingController::getFillProfileCount(int pumpId) const {
+    if (!isValidPumpId(pumpId)) return 0;
+    return fillProfileCount[getPumpIndex(pumpId)];
+}
+
+const FillProfile& DispensingController::getFillProfile(int pumpId, int slot) const {
+    return fillProfiles[getPumpIndex(pumpId)][slot];
+}
+
+const FillProfileStats& DispensingController::getFillStats(int pumpId, int slot) const {
+    return fillStats[getPumpIndex(pumpId)][slot];
+}
+
+// The profile with the largest minTarget the target still reaches
+int DispensingController::selectFillProfile(int pumpId, float targetVolume) const {
+    int index = getPumpIndex(pumpId);
+    int best = 0;
+    for (int slot = 1; slot < fillProfileCount[index]; slot++) {
+        const FillProfile& profile = fillProfiles[index][slot];
+        if (profile.minTarget <= targetVolume && profile.minTarget >= fillProfiles[index][best].minTarget) {
+            best = slot;
+        }
+    }
+    if (fillProfiles[index][best].minTarget > targetVolume) {
+        best = 0;  // Nothing small enough; slot 0 is the fallback
+    }
+    return best;
+}
+
+void DispensingController::saveFillProfiles(int pumpId) {
+    Preferences prefs;
+    if (!prefs.begin(FILL_PREFS_NAMESPACE, false)) {
+        Serial.println("Fill profiles: NVS unavailable");
+        return;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "pump%d", pumpId);
+    int index = getPumpIndex(pumpId);
+    prefs.putBytes(key, fillProfiles[index], fillProfileCount[index] * sizeof(FillProfile));
+    prefs.end();
+}
+
+void DispensingController::activatePump(int pumpId) {
+    setPumpRelay(pumpId, true);
+    notifySession(pumpId, true);
 }
 
 void DispensingController::deactivatePump(int pumpId) {
-    if (pumpId == 1) {
-        relay->setRelay1(false);
-    } else if (pumpId == 2) {
-        relay->setRelay2(false);
+    setPumpRelay(pumpId, false);
+    notifySession(pumpId, false);
+}
+
+// Relay only; top-off pulses switch it without ending the session
+void DispensingController::setPumpRelay(int pumpId, bool on) {
+    int index = getPumpIndex(pumpId);
+    relay->setRelay(pumps[index].relayIndex, on);
+    if (topOff[index].relayOn != on) {
+        if (on) {
+            faults[index].relayOn(millis());
+        } else {
+            faults[index].relayOff(millis());
+        }
+    }
+    topOff[index].relayOn = on;
+}
+
+void DispensingController::notifySession(int pumpId, bool pumpOn) {
+    if (sessionCallback) {
+        const DispensingSession& session = sessions[getPumpIndex(pumpId)];
+        sessionCallback(pumpId, session.sessionId, pumpOn, session.targetVolume);
     }
 }
 
@@ -271,43 +643,263 @@ void DispensingController::checkForErrors(int pumpId) {
     unsigned long elapsed = getElapsedTime(pumpId);
     if (elapsed > session.timeoutMs) {
         Serial.printf("Pump %d: Timeout error after %lu ms\n", pumpId, elapsed);
-        deactivatePump(pumpId);
-        session.state = ERROR_STATE;
+        raiseFault(pumpId, FAULT_TIMEOUT);
         return;
     }
     
-    // Could add more error checks here:
-    // - No flow detected for too long
-    // - Flow rate too high/low
-    // - Hardware errors
+    // Rate faults are judged as samples arrive; this catches flow that
+    // never started or stopped coming
+    FaultCode fault = faults[index].check();
+    if (fault != FAULT_NONE) {
+        raiseFault(pumpId, fault);
+    }
 }
 
-void DispensingController::checkForCompletion(int pumpId) {
+// Stop the pump and hold the session in ERROR_STATE until clearError().
+// The first fault sticks until then. Uncounted faults latch without adding
+// to the pump's fault statistics.
+void DispensingController::raiseFault(int pumpId, FaultCode fault, bool counted) {
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
+    if (session.state == ERROR_STATE) {
+        return;
+    }
     
-    if (session.autoStop && session.currentVolume >= (session.targetVolume - volumeThreshold)) {
-        Serial.printf("Pump %d: Target reached! %.3f/%.3f L\n", 
-                     pumpId, session.currentVolume, session.targetVolume);
+    // Relay first; logging can wait on the UART
+    float rate = faults[index].getRateLpm();
+    if (session.state == DISPENSING || session.state == PAUSED) {
         deactivatePump(pumpId);
-        session.state = COMPLETED;
     }
+    session.state = ERROR_STATE;
+    session.fault = fault;
+    settling[index].pending = false;
+    if (counted) {
+        faultCounts[index][fault]++;
+    }
+    Serial.printf("Pump %d fault %s: %s (%.2f L/min, peak %.2f)\n", pumpId, FaultDetector::codeName(fault),
+                 FaultDetector::describe(fault), rate, faults[index].getPeakRateLpm());
 }
 
-void DispensingController::resetSession(int pumpId) {
-    if (!isValidPumpId(pumpId)) return;
+// Another pump on this pump's sensor is running or still dripping, so the
+// sensor's flow can't be pinned on this one
+bool DispensingController::isSensorShared(int pumpId) const {
+    uint8_t sensorId = pumps[getPumpIndex(pumpId)].sensorId;
+    uint32_t now = millis();
+    for (int other = 1; other <= pumpCount; other++) {
+        if (other != pumpId && pumps[getPumpIndex(other)].sensorId == sensorId &&
+            !faults[getPumpIndex(other)].isSettled(now)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The pump in 1..count, other than exceptPumpId, switched by this relay; 0 if none
+int DispensingController::findRelayOwner(uint8_t relayIndex, int exceptPumpId, int count) const {
+    for (int other = 1; other <= count; other++) {
+        if (other != exceptPumpId && pumps[getPumpIndex(other)].relayIndex == relayIndex) {
+            return other;
+        }
+    }
+    return 0;
+}
+
+void DispensingController::checkForCompletion(int pumpId) {
+    int index = getPumpIndex(pumpId);
+    DispensingSession& session = sessions[index];
     
+    const SessionMeter& meter = meters[index];
+    const OvershootModel& model = models[index];
+    uint64_t targetPulses = meter.litersToPulses(session.targetVolume);
+    uint64_t sessionPulses = meter.getSessionPulses();
+    if (!session.autoStop || targetPulses == 0) {
+        return;
+    }
+    
+    if (session.toppingOff) {
+        // Pulses are sized in service(); this only catches one that runs long
+        if (topOff[index].relayOn && sessionPulses >= targetPulses) {
+            finishSession(pumpId, sessionPulses, false);
+        }
+        return;
+    }
+    
+    // Stop early by what is expected to arrive after the stop; until the
+    // model has seen a session, fall back to the fixed threshold
+    const FillProfile& profile = fillProfiles[index][session.fillProfile];
+    float bulkVolume = session.targetVolume * profile.bulkFraction;
+    float early = model.isTrained() ? model.predictOvershoot() : volumeThreshold;
+    if (early > bulkVolume * OVERSHOOT_MAX_FRACTION) {
+        early = bulkVolume * OVERSHOOT_MAX_FRACTION;
+    }
+    uint64_t earlyPulses = meter.litersToPulses(early);
+    uint64_t bulkPulses = profile.bulkFraction < 1.0f ? meter.litersToPulses(bulkVolume) : targetPulses;
+    if (sessionPulses + earlyPulses < bulkPulses) {
+        return;
+    }
+    if (profile.bulkFraction < 1.0f) {
+        startTopOff(pumpId, sessionPulses);
+        return;
+    }
+    
+    finishSession(pumpId, sessionPulses, true);
+    Serial.printf("Pump %d: stopped %.3f L early at %.3f L/s\n", pumpId, early, model.getRate());
+}
+
+// Relay off and session complete; the stop is measured once it settles
+void DispensingController::finishSession(int pumpId, uint64_t sessionPulses, bool learn) {
     int index = getPumpIndex(pumpId);
     DispensingSession& session = sessions[index];
     
-    session.pumpId = pumpId;
+    // Relay first; logging can wait on the UART
+    float rate = topOff[index].relayOn || !session.toppingOff ? models[index].getRate() : 0.0f;
+    deactivatePump(pumpId);
+    session.state = COMPLETED;
+    SettlingStop& stop = settling[index];
+    stop.pending = true;
+    stop.learn = learn;
+    stop.stopTime = millis();
+    stop.stopPulses = sessionPulses;
+    stop.rate = rate;
+    stop.fillSeconds = getElapsedTime(pumpId) / 1000.0f;
+    Serial.printf("Pump %d: Target reached! %.3f/%.3f L\n", 
+                 pumpId, session.currentVolume, session.targetVolume);
+}
+
+// Bulk phase done: relay off and let the flow reports catch up before the
+// first pulse is sized
+void DispensingController::startTopOff(int pumpId, uint64_t sessionPulses) {
+    int index = getPumpIndex(pumpId);
+    DispensingSession& session = sessions[index];
+    
+    setPumpRelay(pumpId, false);
+    session.toppingOff = true;
+    faults[index].setMonitoring(false);  // Short pulses have no steady rate to judge
+    TopOff& pulse = topOff[index];
+    pulse.phaseStart = millis();
+    pulse.onMs = 0;
+    pulse.cycleStartPulses = sessionPulses;
+    pulse.litersPerSecond = models[index].getRate();
+    Serial.printf("Pump %d: bulk done at %.3f/%.3f L, topping off\n",
+                 pumpId, session.currentVolume, session.targetVolume);
+}
+
+// One pulse per cycle: on for onMs, off for pulseOffMs, then size the next
+// pulse from what the last one delivered and what is still missing
+void DispensingController::serviceTopOff(int pumpId) {
+    int index = getPumpIndex(pumpId);
+    const DispensingSession& session = sessions[index];
+    const FillProfile& profile = fillProfiles[index][session.fillProfile];
+    const SessionMeter& meter = meters[index];
+    TopOff& pulse = topOff[index];
+    unsigned long now = millis();
+    
+    if (pulse.relayOn) {
+        if (now - pulse.phaseStart >= pulse.onMs) {
+            setPumpRelay(pumpId, false);
+            pulse.phaseStart = now;
+        }
+        return;
+    }
+    if (now - pulse.phaseStart < profile.pulseOffMs) {
+        return;
+    }
+    
+    uint64_t sessionPulses = meter.getSessionPulses();
+    if (pulse.onMs > 0 && sessionPulses > pulse.cycleStartPulses) {
+        float delivered = meter.pulsesToLiters(sessionPulses - pulse.cycleStartPulses);
+        float measured = delivered * 1000.0f / pulse.onMs;
+        pulse.litersPerSecond += FILL_PULSE_GAIN * (measured - pulse.litersPerSecond);
+    }
+    
+    uint64_t targetPulses = meter.litersToPulses(session.targetVolume);
+    float remaining = sessionPulses < targetPulses ? meter.pulsesToLiters(targetPulses - sessionPulses) : 0.0f;
+    float neededMs = pulse.litersPerSecond > 0.0f ? remaining * 1000.0f / pulse.litersPerSecond : profile.pulseOnMs;
+    if (neededMs < FILL_MIN_PULSE_MS / 2) {
+        // Closer than half the shortest pulse can get
+        finishSession(pumpId, sessionPulses, false);
+        return;
+    }
+    if (neededMs < FILL_MIN_PULSE_MS) neededMs = FILL_MIN_PULSE_MS;
+    if (neededMs > profile.pulseOnMs) neededMs = profile.pulseOnMs;
+    pulse.onMs = (uint16_t)neededMs;
+    pulse.cycleStartPulses = sessionPulses;
+    pulse.phaseStart = now;
+    setPumpRelay(pumpId, true);
+}
+
+// Once the line has settled, the volume counted since the stop is the
+// overshoot for this session and the total its final error
+void DispensingController::settleSession(int pumpId) {
+    int index = getPumpIndex(pumpId);
+    SettlingStop& stop = settling[index];
+    if (millis() - stop.stopTime < OVERSHOOT_SETTLE_MS) {
+        return;
+    }
+    stop.pending = false;
+    
+    const DispensingSession& session = sessions[index];
+    const SessionMeter& meter = meters[index];
+    uint64_t sessionPulses = meter.getSessionPulses();
+    float finalVolume = meter.pulsesToLiters(sessionPulses);
+    float error = finalVolume - session.targetVolume;
+    
+    FillProfileStats& stats = fillStats[index][session.fillProfile];
+    stats.fills++;
+    stats.lastFillSeconds = stop.fillSeconds;
+    stats.lastError = error;
+    stats.meanFillSeconds += (stop.fillSeconds - stats.meanFillSeconds) / stats.fills;
+    stats.meanAbsError += (fabsf(error) - stats.meanAbsError) / stats.fills;
+    Serial.printf("Pump %d: final %.3f/%.3f L (%+.3f) in %.1f s, profile %d\n",
+                 pumpId, finalVolume, session.targetVolume, error, stop.fillSeconds, session.fillProfile);
+    
+    if (!stop.learn) {
+        return;  // Ended between top-off pulses; nothing to learn about a running pump
+    }
+    uint64_t afterStop = sessionPulses > stop.stopPulses ? sessionPulses - stop.stopPulses : 0;
+    float overshoot = meter.pulsesToLiters(afterStop);
+    OvershootModel& model = models[index];
+    float predicted = stop.rate * model.getLatencyMs() / 1000.0f + model.getDripLiters();
+    model.learn(stop.rate, overshoot);
+    saveOvershootModel(pumpId);
+    Serial.printf("Pump %d: %.3f L after stop (predicted %.3f); latency %.0f ms, drip %.3f L\n",
+                 pumpId, overshoot, predicted, model.getLatencyMs(), model.getDripLiters());
+}
+
+void DispensingController::saveOvershootModel(int pumpId) {
+    Preferences prefs;
+    if (!prefs.begin(OVERSHOOT_PREFS_NAMESPACE, false)) {
+        Serial.println("Overshoot model: NVS unavailable");
+        return;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "pump%d", pumpId);
+    const OvershootState& state = models[getPumpIndex(pumpId)].getState();
+    prefs.putBytes(key, &state, sizeof(state));
+    prefs.end();
+}
+
+void DispensingController::resetSession(int pumpId) {
+    if (!isValidPumpId(pumpId)) return;
+    resetSlot(getPumpIndex(pumpId));
+}
+
+// Also for slots past getPumpCount(), which resetSession() refuses
+void DispensingController::resetSlot(int index) {
+    DispensingSession& session = sessions[index];
+    
+    session.pumpId = index + 1;
     session.targetVolume = 0.0;
     session.currentVolume = 0.0;
-    session.startVolume = 0.0;
     session.startTime = 0;
     session.pauseTime = 0;
     session.state = READY;
     session.autoStop = true;
     session.maxFlowRate = maxFlowRate;
     session.timeoutMs = defaultTimeoutMs;
+    session.sessionId = 0;
+    session.fillProfile = 0;
+    session.toppingOff = false;
+    session.fault = FAULT_NONE;
+    meters[index].release();
 } 
\ No newline at end of file
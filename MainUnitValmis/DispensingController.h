@@ -2,7 +2,26 @@
 #define DISPENSING_CONTROLLER_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "RelayController.h"
+#include "SessionMeter.h"
+#include "OvershootModel.h"
+#include "FaultDetector.h"
+
+#ifndef DISPENSING_MAX_PUMPS
+#define DISPENSING_MAX_PUMPS 8         // Pump table capacity, fixed at compile time
+#endif
+#define DISPENSING_DEFAULT_PUMPS 2     // Taps in use until configured otherwise
+#define PUMP_PREFS_NAMESPACE "pumps"
+#define OVERSHOOT_SETTLE_MS 3000       // Wait this long after a stop before measuring the final volume
+#define OVERSHOOT_MAX_FRACTION 0.5f    // Never stop earlier than this share of the target
+#define OVERSHOOT_PREFS_NAMESPACE "overshoot"
+#define FILL_MAX_PROFILES 4            // Per pump, chosen by target size
+#define FILL_MIN_PULSE_MS 30           // Shorter top-off pulses don't get the pump moving
+#define FILL_PULSE_GAIN 0.5f           // Smoothing of the measured volume per pulse
+#define FILL_PREFS_NAMESPACE "fill"
+#define FAULT_PREFS_NAMESPACE "faults"
 
 enum DispensingState {
     READY,
@@ -13,21 +32,63 @@ enum DispensingState {
 };
 
 struct DispensingSession {
-    int pumpId;                    // 1 or 2
+    int pumpId;                    // 1..getPumpCount()
     float targetVolume;            // Target volume in liters
-    float currentVolume;           // Current dispensed volume in liters
-    float startVolume;             // Volume when dispensing started
+    float currentVolume;           // Current dispensed volume in liters (display copy of the pulse count)
     unsigned long startTime;       // When dispensing started
     unsigned long pauseTime;       // When paused (if paused)
     DispensingState state;
     bool autoStop;                 // Whether to auto-stop at target
     float maxFlowRate;            // Maximum expected flow rate (for error detection)
     unsigned long timeoutMs;       // Maximum time allowed for dispensing
+    uint32_t sessionId;            // New for every startDispensing()
+    int fillProfile;               // Index into the pump's fill profiles
+    bool toppingOff;               // Past the bulk phase, pulsing the relay
+    FaultCode fault;               // Why the session is in ERROR_STATE
+};
+
+// How a session fills: continuously up to bulkFraction of the target, then
+// in relay pulses of at most pulseOnMs, pausing pulseOffMs after each so
+// the flow reports catch up before the next one is sized. A bulkFraction
+// of 1 fills continuously to the end.
+struct FillProfile {
+    float minTarget;               // Applies to targets of at least this many litres
+    float bulkFraction;
+    uint16_t pulseOnMs;
+    uint16_t pulseOffMs;
+};
+
+// Which flow sensor meters a pump and which relay output drives it.
+// Pump N defaults to sensor N on relay N-1.
+struct PumpConfig {
+    uint8_t sensorId;              // Flow unit id in its telemetry, 1-based
+    uint8_t relayIndex;            // RelayController output, 0-based
+};
+
+struct FillProfileStats {
+    uint32_t fills;
+    float lastFillSeconds;         // Start to stop, pauses excluded
+    float meanFillSeconds;
+    float lastError;               // Settled volume minus target, litres
+    float meanAbsError;
 };
 
 class DispensingController {
 public:
     DispensingController(RelayController* relayController);
+    // Load the pump table, learned overshoot models, fill profiles and fault
+    // limits from NVS
+    void begin();
+    // Drive top-off pulses and catch faults between flow reports; call often
+    // (the control task does, every few ms)
+    void service();
+    
+    // Pump table
+    int getPumpCount() const { return pumpCount; }
+    bool setPumpCount(int count);
+    bool configurePump(int pumpId, uint8_t sensorId, uint8_t relayIndex);
+    const PumpConfig& getPumpConfig(int pumpId) const { return pumps[getPumpIndex(pumpId)]; }
+    bool isValidPumpId(int pumpId) const { return pumpId >= 1 && pumpId <= pumpCount; }
     
     // Main control methods
     bool startDispensing(int pumpId, float targetVolume, bool autoStop = true);
@@ -47,37 +108,131 @@ public:
     unsigned long getElapsedTime(int pumpId) const;
     float getEstimatedTimeRemaining(int pumpId) const;
     
-    // Update method - call this regularly with flow sensor data
-    void updateFlowData(float totalVolume);
-    void updateFlow2Data(float totalVolume);
+    // Update method - call this regularly with a flow sensor's cumulative
+    // pulse count; every pump it meters is updated, and sessions are
+    // baselined on it at relay-on. fresh is false when the last count is
+    // only being repeated, so fault detection doesn't judge it again.
+    void updateSensorPulses(int sensorId, uint64_t pulses, float pulsesPerLiter, bool fresh = true);
+    // Sensors that only report a volume total; counted in millilitres
+    void updateSensorVolume(int sensorId, float totalVolume, bool fresh = true);
+    uint64_t getSessionPulses(int pumpId) const;
+    const SessionMeter& getMeter(int pumpId) const { return meters[getPumpIndex(pumpId)]; }
     
     // Configuration
-    void setMaxFlowRate(float maxRate) { maxFlowRate = maxRate; }
+    // Upper flow bound of every pump, L/min; setFaultLimits() sets one pump's
+    void setMaxFlowRate(float maxRate);
     void setTimeout(unsigned long timeoutMs) { defaultTimeoutMs = timeoutMs; }
     void setVolumeThreshold(float threshold) { volumeThreshold = threshold; }
     
+    // Overshoot compensation: auto-stop ends early by the volume the pump's
+    // model expects after the stop, and learns from what actually arrived
+    void noteCutoffLatency(int pumpId, uint32_t micros);
+    const OvershootModel& getOvershootModel(int pumpId) const { return models[getPumpIndex(pumpId)]; }
+    void resetOvershootModel(int pumpId);
+    
+    // Fill profiles; slot may replace one or append after the last
+    bool setFillProfile(int pumpId, int slot, const FillProfile& profile);
+    void clearFillProfiles(int pumpId);
+    int getFillProfileCount(int pumpId) const;
+    const FillProfile& getFillProfile(int pumpId, int slot) const;
+    const FillProfileStats& getFillStats(int pumpId, int slot) const;
+    
     // Safety and error handling
+    uint32_t getSessionId(int pumpId) const;
+    
+    // Called whenever a pump is switched on or off for a session, so the
+    // flow unit can be told right away
+    void setSessionCallback(void (*callback)(int pumpId, uint32_t sessionId, bool pumpOn, float targetVolume));
+    
     bool hasError(int pumpId) const;
+    FaultCode getFaultCode(int pumpId) const;
+    // Stop a pump for a fault found elsewhere, e.g. by the safety watchdog
+    void reportFault(int pumpId, FaultCode fault);
     String getErrorMessage(int pumpId) const;
     void clearError(int pumpId);
     
+    // Flow fault detection: limits per pump, and how often each fault fired
+    bool setFaultLimits(int pumpId, const FaultLimits& limits);
+    const FaultLimits& getFaultLimits(int pumpId) const { return faults[getPumpIndex(pumpId)].getLimits(); }
+    const FaultDetector& getFaultDetector(int pumpId) const { return faults[getPumpIndex(pumpId)]; }
+    uint32_t getFaultCount(int pumpId, FaultCode code) const;
+    
 private:
     RelayController* relay;
-    DispensingSession sessions[2];  // For pump 1 and pump 2
+    PumpConfig pumps[DISPENSING_MAX_PUMPS];
+    int pumpCount;
+    DispensingSession sessions[DISPENSING_MAX_PUMPS];  // Indexed by pumpId - 1
+    SessionMeter meters[DISPENSING_MAX_PUMPS];         // Pulse baselines, same indexing
+    OvershootModel models[DISPENSING_MAX_PUMPS];
+    FaultDetector faults[DISPENSING_MAX_PUMPS];
+    uint32_t faultCounts[DISPENSING_MAX_PUMPS][FAULT_CODE_COUNT];
+    
+    // An auto-stop waiting to settle so its overshoot and final error
+    // can be measured
+    struct SettlingStop {
+        bool pending;
+        bool learn;                 // Stopped a running pump; teaches the overshoot model
+        unsigned long stopTime;
+        uint64_t stopPulses;
+        float rate;                 // L/s when the stop was decided
+        float fillSeconds;
+    };
+    SettlingStop settling[DISPENSING_MAX_PUMPS];
+    
+    // Relay pulsing once a session is topping off
+    struct TopOff {
+        bool relayOn;
+        unsigned long phaseStart;
+        uint16_t onMs;
+        uint64_t cycleStartPulses;
+        float litersPerSecond;      // Measured while the relay is on
+    };
+    TopOff topOff[DISPENSING_MAX_PUMPS];
+    
+    FillProfile fillProfiles[DISPENSING_MAX_PUMPS][FILL_MAX_PROFILES];
+    int fillProfileCount[DISPENSING_MAX_PUMPS];
+    FillProfileStats fillStats[DISPENSING_MAX_PUMPS][FILL_MAX_PROFILES];
+    
+    // Sessions are driven from the control task, loop() and web handlers;
+    // every state change holds this (recursive, calls nest)
+    SemaphoreHandle_t mutex;
+    class Guard {
+    public:
+        explicit Guard(SemaphoreHandle_t m) : held(m) { xSemaphoreTakeRecursive(held, portMAX_DELAY); }
+        ~Guard() { xSemaphoreGiveRecursive(held); }
+    private:
+        SemaphoreHandle_t held;
+    };
     
     // Configuration
-    float maxFlowRate;              // L/min - for error detection
+    float maxFlowRate;              // L/min - default upper bound for fault detection
     unsigned long defaultTimeoutMs; // Default timeout in milliseconds
     float volumeThreshold;          // Minimum volume difference to consider "reached target"
+    uint32_t nextSessionId;
+    void (*sessionCallback)(int pumpId, uint32_t sessionId, bool pumpOn, float targetVolume);
     
     // Helper methods
-    int getPumpIndex(int pumpId) const { return pumpId - 1; }  // Convert 1,2 to 0,1
-    bool isValidPumpId(int pumpId) const { return pumpId == 1 || pumpId == 2; }
+    int getPumpIndex(int pumpId) const { return pumpId - 1; }  // Convert 1..N to 0..N-1
+    void updateFlowPulses(int pumpId, uint64_t pulses, float pulsesPerLiter, bool fresh);
+    void savePumpTable();
     void activatePump(int pumpId);
     void deactivatePump(int pumpId);
+    void setPumpRelay(int pumpId, bool on);
+    void notifySession(int pumpId, bool pumpOn);
+    void finishSession(int pumpId, uint64_t sessionPulses, bool learn);
+    void startTopOff(int pumpId, uint64_t sessionPulses);
+    void serviceTopOff(int pumpId);
+    int selectFillProfile(int pumpId, float targetVolume) const;
+    void saveFillProfiles(int pumpId);
     void checkForErrors(int pumpId);
+    void raiseFault(int pumpId, FaultCode fault, bool counted = true);
+    bool isSensorShared(int pumpId) const;
+    int findRelayOwner(uint8_t relayIndex, int exceptPumpId, int count) const;
     void checkForCompletion(int pumpId);
     void resetSession(int pumpId);
+    void resetSlot(int index);
+    void settleSession(int pumpId);
+    void saveOvershootModel(int pumpId);
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "FaultDetector.h"
+
+FaultDetector::FaultDetector()
+    : limits(defaultLimits()), monitoring(true), shared(false), relayIsOn(false), switchTime(0),
+      haveSample(false), lastCount(0), pulsed(false), lastPulseTime(0), lastFreshTime(0), windowCount(0), windowStart(0),
+      rateLpm(0.0f), previousRateLpm(0.0f), peakRateLpm(0.0f), suspect(FAULT_NONE), suspectSince(0),
+      haveLeakBaseline(false), leakBaseline(0), leakBaselineTime(0) {
+}
+
+FaultLimits FaultDetector::defaultLimits() {
+    FaultLimits defaults;
+    defaults.version = FAULT_LIMITS_VERSION;
+    defaults.dryRunMs = FAULT_DEFAULT_DRY_RUN_MS;
+    defaults.confirmMs = FAULT_DEFAULT_CONFIRM_MS;
+    defaults.rateWindowMs = FAULT_DEFAULT_RATE_WINDOW_MS;
+    defaults.minRateLpm = FAULT_DEFAULT_MIN_RATE;
+    defaults.maxRateLpm = FAULT_DEFAULT_MAX_RATE;
+    defaults.stallFraction = FAULT_DEFAULT_STALL_FRACTION;
+    defaults.offGraceMs = FAULT_DEFAULT_OFF_GRACE_MS;
+    defaults.leakWindowMs = FAULT_DEFAULT_LEAK_WINDOW_MS;
+    defaults.leakLiters = FAULT_DEFAULT_LEAK_LITERS;
+    return defaults;
+}
+
+void FaultDetector::relayOn(uint32_t nowMs) {
+    relayIsOn = true;
+    switchTime = nowMs;
+    pulsed = false;
+    lastPulseTime = nowMs;
+    windowCount = lastCount;
+    windowStart = nowMs;
+    rateLpm = 0.0f;
+    previousRateLpm = 0.0f;
+    peakRateLpm = 0.0f;
+    suspect = FAULT_NONE;
+    haveLeakBaseline = false;
+}
+
+void FaultDetector::relayOff(uint32_t nowMs) {
+    relayIsOn = false;
+    switchTime = nowMs;
+    rateLpm = 0.0f;
+    suspect = FAULT_NONE;
+    haveLeakBaseline = false;
+}
+
+void FaultDetector::rearm(uint32_t nowMs) {
+    if (!relayIsOn) {
+        switchTime = nowMs;
+    }
+    haveLeakBaseline = false;
+}
+
+bool FaultDetector::isSettled(uint32_t nowMs) const {
+    return !relayIsOn && nowMs - switchTime >= limits.offGraceMs;
+}
+
+void FaultDetector::rebase(uint64_t count, uint32_t nowMs) {
+    lastCount = count;
+    windowCount = count;
+    windowStart = nowMs;
+    haveLeakBaseline = false;
+}
+
+FaultCode FaultDetector::sample(uint64_t count, float pulsesPerLiter, uint32_t nowMs, bool sensorShared, bool fresh) {
+    shared = sensorShared;
+    if (fresh) {
+        lastFreshTime = nowMs;
+    }
+    if (!haveSample || count < lastCount) {
+        // First count, or a sensor that started over: nothing to compare with
+        rebase(count, nowMs);
+        haveSample = true;
+        return FAULT_NONE;
+    }
+    if (count != lastCount) {
+        lastCount = count;
+        if (relayIsOn) {
+            pulsed = true;
+            lastPulseTime = nowMs;
+        }
+    }
+    if (pulsesPerLiter <= 0.0f) {
+        return FAULT_NONE;
+    }
+    if (!relayIsOn) {
+        return checkLeak(count, pulsesPerLiter, nowMs);
+    }
+
+    uint32_t elapsed = nowMs - windowStart;
+    if (!fresh || elapsed < limits.rateWindowMs) {
+        return FAULT_NONE;  // Windows close on reports, so sparse reports give longer windows
+    }
+    uint32_t start = windowStart;
+    previousRateLpm = rateLpm;
+    rateLpm = (count - windowCount) / pulsesPerLiter * 60000.0f / elapsed;
+    windowCount = count;
+    windowStart = nowMs;
+    // A single window can be inflated by a burst of late reports; the peak
+    // only counts a rate seen twice in a row
+    float held = rateLpm < previousRateLpm ? rateLpm : previousRateLpm;
+    if (monitoring && !shared && held > peakRateLpm) {
+        peakRateLpm = held;
+    }
+    return judgeRate(start, nowMs);
+}
+
+// A bad rate has to persist for confirmMs, counted from the start of the
+// first window that showed it
+FaultCode FaultDetector::judgeRate(uint32_t windowStartMs, uint32_t nowMs) {
+    if (!monitoring || shared) {
+        suspect = FAULT_NONE;
+        return FAULT_NONE;
+    }
+
+    FaultCode verdict = FAULT_NONE;
+    if (rateLpm > limits.maxRateLpm) {
+        verdict = FAULT_RATE_HIGH;
+    } else if (peakRateLpm >= limits.minRateLpm && rateLpm < peakRateLpm * limits.stallFraction) {
+        verdict = FAULT_STALL;
+    } else if (rateLpm < limits.minRateLpm && windowStartMs - switchTime >= limits.dryRunMs) {
+        verdict = FAULT_RATE_LOW;  // Spin-up is the dry run check's business
+    }
+
+    if (verdict != suspect) {
+        suspect = verdict;
+        suspectSince = windowStartMs;
+    }
+    if (verdict == FAULT_NONE || nowMs - suspectSince < limits.confirmMs) {
+        return FAULT_NONE;
+    }
+    return verdict;
+}
+
+// Relay off and the drip over: anything counted now is a leak or a valve
+// that didn't close. Measured in consecutive windows of leakWindowMs.
+FaultCode FaultDetector::checkLeak(uint64_t count, float pulsesPerLiter, uint32_t nowMs) {
+    if (shared || nowMs - switchTime < limits.offGraceMs) {
+        haveLeakBaseline = false;
+        return FAULT_NONE;
+    }
+    if (!haveLeakBaseline) {
+        haveLeakBaseline = true;
+        leakBaseline = count;
+        leakBaselineTime = nowMs;
+        return FAULT_NONE;
+    }
+    if ((count - leakBaseline) / pulsesPerLiter > limits.leakLiters) {
+        return FAULT_FLOW_WHILE_OFF;
+    }
+    if (nowMs - leakBaselineTime >= limits.leakWindowMs) {
+        leakBaseline = count;
+        leakBaselineTime = nowMs;
+    }
+    return FAULT_NONE;
+}
+
+// No pulses for too long, as of a report that came in after the deadline;
+// a pump whose reports are late or sparse is not blamed for them
+FaultCode FaultDetector::check() const {
+    if (!relayIsOn || !monitoring || shared) {
+        return FAULT_NONE;
+    }
+    if (!pulsed) {
+        return (int32_t)(lastFreshTime - switchTime) >= (int32_t)limits.dryRunMs ? FAULT_DRY_RUN : FAULT_NONE;
+    }
+    if ((int32_t)(lastFreshTime - lastPulseTime) >= (int32_t)limits.confirmMs + limits.rateWindowMs) {
+        return peakRateLpm >= limits.minRateLpm ? FAULT_STALL : FAULT_RATE_LOW;
+    }
+    return FAULT_NONE;
+}
+
+const char* FaultDetector::codeName(FaultCode code) {
+    switch (code) {
+        case FAULT_NONE: return "none";
+        case FAULT_TIMEOUT: return "timeout";
+        case FAULT_DRY_RUN: return "dryRun";
+        case FAULT_RATE_LOW: return "rateLow";
+        case FAULT_RATE_HIGH: return "rateHigh";
+        case FAULT_STALL: return "stall";
+        case FAULT_FLOW_WHILE_OFF: return "flowWhileOff";
+        case FAULT_EMERGENCY_STOP: return "emergencyStop";
+        case FAULT_WATCHDOG: return "watchdog";
+        case FAULT_CODE_COUNT: break;
+    }
+    return "unknown";
+}
+
+const char* FaultDetector::describe(FaultCode code) {
+    switch (code) {
+        case FAULT_TIMEOUT: return "Timeout - dispensing took too long";
+        case FAULT_DRY_RUN: return "Dry run - no flow after the pump started";
+        case FAULT_RATE_LOW: return "Flow too low - check the supply and the line";
+        case FAULT_RATE_HIGH: return "Flow too high - check the sensor and the line";
+        case FAULT_STALL: return "Flow stalled - line blocked or supply ran out";
+        case FAULT_FLOW_WHILE_OFF: return "Flow with the pump off - leak or stuck valve";
+        case FAULT_EMERGENCY_STOP: return "Emergency stop";
+        case FAULT_WATCHDOG: return "Safety watchdog - flow reports or the controller stopped";
+        case FAULT_NONE:
+        case FAULT_CODE_COUNT: break;
+    }
+    return "Unknown error";
+}
@@ -0,0 +1,115 @@
+#ifndef FAULT_DETECTOR_H
+#define FAULT_DETECTOR_H
+
+#include <stdint.h>
+
+#define FAULT_LIMITS_VERSION 1
+#define FAULT_DEFAULT_DRY_RUN_MS 1500     // Primed pumps count their first pulse well inside this
+#define FAULT_DEFAULT_CONFIRM_MS 1000
+#define FAULT_DEFAULT_RATE_WINDOW_MS 500
+#define FAULT_DEFAULT_MIN_RATE 0.1f       // L/min
+#define FAULT_DEFAULT_MAX_RATE 5.0f       // L/min
+#define FAULT_DEFAULT_STALL_FRACTION 0.3f
+#define FAULT_DEFAULT_OFF_GRACE_MS 4000   // Longer than the overshoot settle time
+#define FAULT_DEFAULT_LEAK_WINDOW_MS 5000
+#define FAULT_DEFAULT_LEAK_LITERS 0.01f
+
+// Why a pump was stopped, reported by /dispense/status as errorCode.
+// Values are stable; add new ones at the end.
+enum FaultCode {
+    FAULT_NONE = 0,
+    FAULT_TIMEOUT = 1,             // Session ran past its timeout
+    FAULT_DRY_RUN = 2,             // No pulses within dryRunMs of relay-on
+    FAULT_RATE_LOW = 3,            // Never got above minRateLpm
+    FAULT_RATE_HIGH = 4,           // Above maxRateLpm
+    FAULT_STALL = 5,               // Flow collapsed mid-dispense, e.g. a blockage
+    FAULT_FLOW_WHILE_OFF = 6,      // Flow with the relay off: leak or stuck valve
+    FAULT_EMERGENCY_STOP = 7,
+    FAULT_WATCHDOG = 8,            // Safety watchdog cut the relay: stale flow reports or a stuck control task
+    FAULT_CODE_COUNT
+};
+
+// Per-pump thresholds. dryRunMs and confirmMs are also the detection
+// latency: a pump is stopped about that long after the fault starts.
+struct FaultLimits {
+    uint8_t version;
+    uint16_t dryRunMs;             // Relay-on -> first pulse
+    uint16_t confirmMs;            // A bad rate must last this long
+    uint16_t rateWindowMs;         // Rate is measured over windows of this length
+    float minRateLpm;
+    float maxRateLpm;
+    float stallFraction;           // Of the session's peak rate
+    uint16_t offGraceMs;           // Drip allowed after the relay opens
+    uint16_t leakWindowMs;
+    float leakLiters;              // More than this within leakWindowMs with the relay off
+};
+
+// Flow fault detection for one pump, fed every flow sample of the pump's
+// sensor. Only fresh reports are judged: a repeated count says nothing new,
+// and a sensor that stops reporting altogether is the safety watchdog's
+// business. Rate faults are judged only while the pump runs continuously;
+// the owner turns monitoring off for top-off pulses.
+//
+// Rates are litres per minute. No Arduino dependencies, so it builds on a
+// host as well.
+class FaultDetector {
+public:
+    FaultDetector();
+    static FaultLimits defaultLimits();
+
+    void setLimits(const FaultLimits& newLimits) { limits = newLimits; }
+    const FaultLimits& getLimits() const { return limits; }
+
+    void relayOn(uint32_t nowMs);
+    void relayOff(uint32_t nowMs);
+    void setMonitoring(bool on) { monitoring = on; }
+    // Start leak detection over, e.g. once a fault has been cleared
+    void rearm(uint32_t nowMs);
+    // Relay off and past its drip; flow on a shared sensor isn't ours
+    bool isSettled(uint32_t nowMs) const;
+
+    // The sensor's cumulative count. sensorShared: another pump on the same
+    // sensor is running, so the flow says nothing about this one. fresh:
+    // a report that just arrived, rather than the last count again
+    FaultCode sample(uint64_t count, float pulsesPerLiter, uint32_t nowMs, bool sensorShared, bool fresh = true);
+    // Dry run, and flow that stopped altogether, as of the newest report
+    FaultCode check() const;
+
+    float getRateLpm() const { return rateLpm; }
+    float getPeakRateLpm() const { return peakRateLpm; }
+
+    static const char* codeName(FaultCode code);
+    static const char* describe(FaultCode code);
+
+private:
+    FaultLimits limits;
+    bool monitoring;
+    bool shared;
+
+    bool relayIsOn;
+    uint32_t switchTime;           // Last relay-on or relay-off
+
+    bool haveSample;
+    uint64_t lastCount;
+    bool pulsed;                   // Count moved since relay-on
+    uint32_t lastPulseTime;
+    uint32_t lastFreshTime;        // Newest report
+
+    uint64_t windowCount;
+    uint32_t windowStart;
+    float rateLpm;
+    float previousRateLpm;
+    float peakRateLpm;             // Highest rate held for two windows running
+    FaultCode suspect;
+    uint32_t suspectSince;
+
+    bool haveLeakBaseline;
+    uint64_t leakBaseline;
+    uint32_t leakBaselineTime;
+
+    FaultCode judgeRate(uint32_t windowStartMs, uint32_t nowMs);
+    FaultCode checkLeak(uint64_t count, float pulsesPerLiter, uint32_t nowMs);
+    void rebase(uint64_t count, uint32_t nowMs);
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include <Arduino.h>
+#include "FlowTelemetryServer.h"
+#include "WebServerManager.h"
+
+FlowTelemetryServer::FlowTelemetryServer(WebServerManager* owner, uint16_t port)
+    : server(port), owner(owner), requestCount(0), connectionCount(0) {
+    for (int i = 0; i < FLOW_TELEMETRY_MAX_CLIENTS; i++) {
+        connections[i].client = nullptr;
+        connections[i].length = 0;
+    }
+}
+
+void FlowTelemetryServer::begin() {
+    server.onClient([](void* arg, AsyncClient* client) {
+        static_cast<FlowTelemetryServer*>(arg)->handleClient(client);
+    }, this);
+    server.setNoDelay(true);
+    server.begin();
+}
+
+int FlowTelemetryServer::getOpenConnections() const {
+    int open = 0;
+    for (int i = 0; i < FLOW_TELEMETRY_MAX_CLIENTS; i++) {
+        if (connections[i].client) open++;
+    }
+    return open;
+}
+
+void FlowTelemetryServer::handleClient(AsyncClient* client) {
+    Connection* connection = nullptr;
+    for (int i = 0; i < FLOW_TELEMETRY_MAX_CLIENTS; i++) {
+        if (!connections[i].client) {
+            connection = &connections[i];
+            break;
+        }
+    }
+    if (!connection) {
+        Serial.println("Flow telemetry: no free connection slot");
+        client->close(true);
+        delete client;
+        return;
+    }
+
+    connection->client = client;
+    connection->length = 0;
+    connectionCount++;
+
+    client->setRxTimeout(FLOW_TELEMETRY_IDLE_TIMEOUT);
+    client->setNoDelay(true);
+    client->onData([this](void* arg, AsyncClient* c, void* data, size_t len) {
+        handleData(static_cast<Connection*>(arg), static_cast<const char*>(data), len);
+    }, connection);
+    client->onDisconnect([this](void* arg, AsyncClient* c) {
+        handleDisconnect(static_cast<Connection*>(arg));
+    }, connection);
+    client->onTimeout([](void* arg, AsyncClient* c, uint32_t time) {
+        c->close();
+    }, connection);
+}
+
+void FlowTelemetryServer::handleDisconnect(Connection* connection) {
+    AsyncClient* client = connection->client;
+    connection->client = nullptr;
+    connection->length = 0;
+    delete client;
+}
+
+void FlowTelemetryServer::handleData(Connection* connection, const char* data, size_t len) {
+    if (connection->length + len > FLOW_TELEMETRY_BUFFER_SIZE) {
+        sendResponse(connection->client, 413, "Request too large", false);
+        connection->client->close();
+        return;
+    }
+    memcpy(connection->buffer + connection->length, data, len);
+    connection->length += len;
+    connection->buffer[connection->length] = '\0';
+
+    if (!processRequests(connection)) {
+        connection->client->close();
+    }
+}
+
+bool FlowTelemetryServer::processRequests(Connection* connection) {
+    for (;;) {
+        char* request = connection->buffer;
+        char* headerEnd = strstr(request, "\r\n\r\n");
+        if (!headerEnd) {
+            return true;  // Wait for the rest of the headers
+        }
+
+        // Request line: METHOD SP PATH SP VERSION
+        char* lineEnd = strstr(request, "\r\n");
+        char* pathStart = strchr(request, ' ');
+        char* pathEnd = pathStart ? strchr(pathStart + 1, ' ') : nullptr;
+        if (!pathStart || !pathEnd || pathEnd > lineEnd) {
+            sendResponse(connection->client, 400, "Bad request", false);
+            return false;
+        }
+        bool isPost = strncmp(request, "POST ", 5) == 0;
+        bool keepAlive = strncmp(pathEnd + 1, "HTTP/1.1", 8) == 0;
+
+        long contentLength = 0;
+        for (char* header = lineEnd + 2; header < headerEnd; ) {
+            char* next = strstr(header, "\r\n");
+            if (strncasecmp(header, "Content-Length:", 15) == 0) {
+                contentLength = atol(header + 15);
+            } else if (strncasecmp(header, "Connection:", 11) == 0) {
+                char saved = *next;
+                *next = '\0';
+                if (strcasestr(header + 11, "close")) keepAlive = false;
+                if (strcasestr(header + 11, "keep-alive")) keepAlive = true;
+                *next = saved;
+            }
+            header = next + 2;
+        }
+
+        char* body = headerEnd + 4;
+        size_t headerLength = body - request;
+        if (contentLength < 0 || headerLength + contentLength > FLOW_TELEMETRY_BUFFER_SIZE) {
+            sendResponse(connection->client, 413, "Request too large", false);
+            return false;
+        }
+        if (connection->length < headerLength + contentLength) {
+            return true;  // Body still in flight
+        }
+
+        int code = 405;
+        if (isPost) {
+            *pathEnd = '\0';
+            code = owner->handleFlowReport(pathStart + 1, body, contentLength);
+        }
+        requestCount++;
+        sendResponse(connection->client,
+                     code,
+                     code == 200 ? "OK" : code == 404 ? "Not found" : code == 405 ? "Method not allowed" : "Bad request",
+                     keepAlive);
+        if (!keepAlive) {
+            return false;
+        }
+
+        // Keep any pipelined bytes for the next request
+        size_t consumed = headerLength + contentLength;
+        connection->length -= consumed;
+        memmove(connection->buffer, connection->buffer + consumed, connection->length);
+        connection->buffer[connection->length] = '\0';
+    }
+}
+
+void FlowTelemetryServer::sendResponse(AsyncClient* client, int code, const char* text, bool keepAlive) {
+    char response[160];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 %d %s\r\n"
+                          "Content-Type: text/plain\r\n"
+                          "Content-Length: %u\r\n"
+                          "Connection: %s\r\n"
+                          "\r\n"
+                          "%s",
+                          code, text, (unsigned)strlen(text), keepAlive ? "keep-alive" : "close", text);
+    if (length > 0 && client->space() >= (size_t)length) {
+        client->write(response, length);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FLOW_TELEMETRY_SERVER_H
+#define FLOW_TELEMETRY_SERVER_H
+
+#include <AsyncTCP.h>
+
+#define FLOW_TELEMETRY_PORT 8080          // Flow units post /flowN/update here
+#define FLOW_TELEMETRY_MAX_CLIENTS 4
+#define FLOW_TELEMETRY_BUFFER_SIZE 512    // One request incl. headers must fit
+#define FLOW_TELEMETRY_IDLE_TIMEOUT 30    // Seconds before an idle connection is dropped
+
+class WebServerManager;
+
+// Minimal HTTP/1.1 listener for flow unit reports. AsyncWebServer closes the
+// socket after every response, so each 500 ms report used to pay a full TCP
+// handshake. This listener keeps the connection open and answers any number
+// of POSTs on it. Requests are parsed in place in a per-connection buffer.
+class FlowTelemetryServer {
+public:
+    FlowTelemetryServer(WebServerManager* owner, uint16_t port = FLOW_TELEMETRY_PORT);
+    void begin();
+
+    uint32_t getRequestCount() const { return requestCount; }
+    uint32_t getConnectionCount() const { return connectionCount; }
+    int getOpenConnections() const;
+
+private:
+    struct Connection {
+        AsyncClient* client;
+        char buffer[FLOW_TELEMETRY_BUFFER_SIZE + 1];
+        size_t length;
+    };
+
+    AsyncServer server;
+    WebServerManager* owner;
+    Connection connections[FLOW_TELEMETRY_MAX_CLIENTS];
+    uint32_t requestCount;
+    uint32_t connectionCount;
+
+    void handleClient(AsyncClient* client);
+    void handleData(Connection* connection, const char* data, size_t len);
+    void handleDisconnect(Connection* connection);
+    // Returns false when the connection should be closed
+    bool processRequests(Connection* connection);
+    void sendResponse(AsyncClient* client, int code, const char* text, bool keepAlive);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "LatencyStats.h"
+#include <algorithm>
+
+LatencyStats::LatencyStats() {
+    reset();
+}
+
+void LatencyStats::reset() {
+    next = 0;
+    count = 0;
+    maxMicros = 0;
+    lastMicros = 0;
+}
+
+void LatencyStats::record(uint32_t micros) {
+    samples[next] = micros;
+    next = (next + 1) % LATENCY_STATS_WINDOW;
+    count++;
+    lastMicros = micros;
+    if (micros > maxMicros) {
+        maxMicros = micros;
+    }
+}
+
+uint32_t LatencyStats::percentile(uint8_t pct) const {
+    uint32_t n = count < LATENCY_STATS_WINDOW ? count : LATENCY_STATS_WINDOW;
+    if (n == 0) {
+        return 0;
+    }
+    if (pct > 100) pct = 100;
+
+    uint32_t sorted[LATENCY_STATS_WINDOW];
+    std::copy(samples, samples + n, sorted);
+    // Nearest rank: the smallest sample with at least pct% at or below it
+    uint32_t rank = (pct * n + 99) / 100;
+    if (rank == 0) rank = 1;
+    std::nth_element(sorted, sorted + rank - 1, sorted + n);
+    return sorted[rank - 1];
+}
@@ -0,0 +1,34 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+#define LATENCY_STATS_WINDOW 64  // Most recent samples kept for percentiles
+
+// Rolling latency record in microseconds: the last LATENCY_STATS_WINDOW
+// samples for p50/p99, plus lifetime count and maximum.
+//
+// Not synchronised; the owner copies it under its own lock to read it
+// from another task. No Arduino dependencies, so it builds on a host.
+class LatencyStats {
+public:
+    LatencyStats();
+
+    void record(uint32_t micros);
+    void reset();
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMax() const { return maxMicros; }
+    uint32_t getLast() const { return lastMicros; }
+    // Nearest-rank percentile (0..100) over the window; 0 with no samples
+    uint32_t percentile(uint8_t pct) const;
+
+private:
+    uint32_t samples[LATENCY_STATS_WINDOW];
+    uint32_t next;
+    uint32_t count;
+    uint32_t maxMicros;
+    uint32_t lastMicros;
+};
+
+#endif
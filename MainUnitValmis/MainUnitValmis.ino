@@ -13,7 +13,25 @@
 #include "WebServerManager.h"
 #include "TouchController.h"
 #include "DispensingController.h"
+#include "DispenseScheduler.h"
+#include "RecipeEngine.h"
+#include "SafetyWatchdog.h"
 #include "M5_PbHub.h"
+#include "TelemetryReceiver.h"
+#include "TelemetryTracker.h"
+#include "LatencyStats.h"
+
+#define MAIN_LOOP_DELAY 10       // ms; short so telemetry is picked up promptly
+#define PIR_CHECK_INTERVAL 100   // ms between PIR reads over the PbHub
+#define BEACON_INTERVAL 1000     // ms between discovery beacons
+#define TELEMETRY_STATS_INTERVAL 10000  // ms between per-sensor telemetry stats logs
+#define CONTROL_TASK_PRIORITY 5  // Above loop() (1) and the async web server (3)
+#define CONTROL_TASK_CORE 1
+#define CONTROL_TASK_STACK 6144
+#define CONTROL_POLL_MS 2        // UDP has no wakeup; poll it this often
+#define CONTROL_QUEUE_LENGTH 8   // Flow reports posted over HTTP, waiting for the control task
+#define FLOW_TAB_FIRST_ROW 60    // LCD flow tab: y of sensor 1's row
+#define FLOW_TAB_ROW_HEIGHT 20   // Room for TELEMETRY_MAX_UNITS rows on the 240 px screen
 
 // First M5Stack Core 2 (Main unit with PbHub)
 M5UnitPbHub pbhub;
@@ -21,25 +39,197 @@ WiFiMulti wifiMulti;
 // Removed duplicate server - using WebServerManager's server instead
 Preferences preferences;
 WiFiUDP discoveryUDP;
+TelemetryReceiver telemetryReceiver;  // Binary flow reports on port 12347
+TelemetryTracker flowTrackers[TELEMETRY_MAX_UNITS];  // Loss/reorder tracking and pulse-derived volume per sensor
+
+// Flow reports are applied by a control task above loop(), so a pump is
+// cut off as soon as the sample that reaches its target comes in. The
+// task, loop(), touch taps and the web handlers take hubMutex around
+// anything that talks to the PbHub or the trackers; a relay write must not
+// land in the middle of a PIR read.
+struct QueuedFlowReport {
+    TelemetryReport report;
+    uint32_t arrivalMicros;
+};
+TaskHandle_t controlTaskHandle = nullptr;
+SemaphoreHandle_t hubMutex = nullptr;
+QueueHandle_t flowReportQueue = nullptr;
+LatencyStats cutoffLatency;           // Sample arrival -> relay off, microseconds
+portMUX_TYPE latencyLock = portMUX_INITIALIZER_UNLOCKED;
 
 Flashlight flashlight(&pbhub);
 RelayController relay(&pbhub);
 PIRSensor pir(&pbhub);
 DispensingController dispensing(&relay);
-WebServerManager webServer(&pir, &relay, &flashlight, &dispensing);
-TouchController touch(&flashlight, &relay);
+DispenseScheduler scheduler(&dispensing);  // Per-pump order queues
+RecipeEngine recipes(&dispensing);         // Multi-pump drinks poured as one order
+SafetyWatchdog watchdog(&relay);           // Cuts a pump whose flow reports or control task stop
+WebServerManager webServer(&pir, &relay, &flashlight, &dispensing, &scheduler, &recipes);
+TouchController touch(&flashlight, &relay, &scheduler, &dispensing);
 
-// Flow sensor data from both units
+// Flow sensor data from every unit, indexed by sensor - 1
 struct FlowSensorData {
     float flowRate = 0.0f;
     float totalVolume = 0.0f;
     bool error = false;
-} flowData, flow2Data;
+} flowData[TELEMETRY_MAX_UNITS];
 
 static bool pirStateForWeb = false;
 static int currentTab = 0;  // 0: Main, 1: PIR, 2: Flow Sensor, 3: WiFi
 static bool lastPirState = false;
 
+// Apply a flow unit's telemetry report right away, without waiting for the
+// once-a-second sync in loop(). Runs on the control task with hubMutex held.
+void ingestFlowReport(const TelemetryReport& report, uint32_t arrivalMicros) {
+    if (report.unitId < 1 || report.unitId > TELEMETRY_MAX_UNITS) {
+        return;
+    }
+    watchdog.noteSample(report.unitId);  // Even a duplicate shows the link is up
+    TelemetryTracker& tracker = flowTrackers[report.unitId - 1];
+    TelemetryTracker::Verdict verdict = tracker.accept(report, millis());
+    if (verdict == TelemetryTracker::DUPLICATE || verdict == TelemetryTracker::LATE) {
+        return;  // A newer report has already been applied
+    }
+    if (verdict == TelemetryTracker::REBOOTED) {
+        Serial.printf("Flow sensor %d restarted\n", report.unitId);
+    }
+    bool resync = verdict == TelemetryTracker::FIRST || verdict == TelemetryTracker::REBOOTED;
+    bool wasDispensing[DISPENSING_MAX_PUMPS];
+    for (int pumpId = 1; pumpId <= dispensing.getPumpCount(); pumpId++) {
+        wasDispensing[pumpId - 1] = dispensing.isDispensing(pumpId);
+        if (resync && wasDispensing[pumpId - 1] && dispensing.getPumpConfig(pumpId).sensorId == report.unitId) {
+            // The unit missed the start event; put it back in dispensing mode
+            telemetryReceiver.notifySession(report.unitId, dispensing.getSessionId(pumpId),
+                                            TELEMETRY_SESSION_START, dispensing.getTargetVolume(pumpId));
+        }
+    }
+    // Dispensing meters in pulses against the baseline latched at relay-on
+    dispensing.updateSensorPulses(report.unitId, tracker.getPulses(), tracker.getPulsesPerLiter());
+    for (int pumpId = 1; pumpId <= dispensing.getPumpCount(); pumpId++) {
+        if (!wasDispensing[pumpId - 1] || !dispensing.isCompleted(pumpId) ||
+            dispensing.getPumpConfig(pumpId).sensorId != report.unitId) {
+            continue;
+        }
+        uint32_t cutoffMicros = micros() - arrivalMicros;
+        portENTER_CRITICAL(&latencyLock);
+        cutoffLatency.record(cutoffMicros);
+        portEXIT_CRITICAL(&latencyLock);
+        dispensing.noteCutoffLatency(pumpId, cutoffMicros);
+        Serial.printf("Pump %d cut off %lu us after its sample arrived\n",
+                      pumpId, (unsigned long)cutoffMicros);
+    }
+    if (report.flags & TELEMETRY_FLAG_REPLAYED) {
+        // Old sample from an outage: it fills in the metered pulses, but the
+        // display should not jump back in time
+        return;
+    }
+    
+    // The display shows the sensor's own total; resets made on the flow
+    // unit don't disturb the pulse count dispensing works from
+    bool error = (report.flags & TELEMETRY_FLAG_ERROR) != 0;
+    webServer.updateSensorData(report.unitId, report.flowRate, report.totalVolume, error, report.totalPulses);
+}
+
+// UDP reports, dispatched by telemetryReceiver.poll() on the control task
+void handleTelemetryReport(const TelemetryReport& report) {
+    ingestFlowReport(report, telemetryReceiver.getArrivalMicros());
+}
+
+// HTTP reports arrive on the web server's task; hand them to the control task
+void queueFlowReport(const TelemetryReport& report) {
+    QueuedFlowReport queued;
+    queued.report = report;
+    queued.arrivalMicros = micros();
+    if (xQueueSend(flowReportQueue, &queued, 0) != pdTRUE) {
+        Serial.println("Flow report queue full, report dropped");
+    }
+}
+
+void controlTask(void* parameter) {
+    QueuedFlowReport queued;
+    for (;;) {
+        // Wakes at once for an HTTP report, otherwise every CONTROL_POLL_MS
+        bool haveQueued = xQueueReceive(flowReportQueue, &queued, pdMS_TO_TICKS(CONTROL_POLL_MS)) == pdTRUE;
+        xSemaphoreTake(hubMutex, portMAX_DELAY);
+        watchdog.heartbeat();
+        watchdog.serviceTrips(&dispensing);  // Before anything could switch a tripped relay back on
+        while (haveQueued) {
+            ingestFlowReport(queued.report, queued.arrivalMicros);
+            haveQueued = xQueueReceive(flowReportQueue, &queued, 0) == pdTRUE;
+        }
+        telemetryReceiver.poll();
+        dispensing.service();  // Top-off pulse timing
+        scheduler.service();   // Next queued job once a pump is free
+        recipes.service();     // Order completion, or abort on a component fault
+        xSemaphoreGive(hubMutex);
+    }
+}
+
+// Pump switched for a session: tell its flow unit now instead of waiting
+// to be polled. The pump table says which unit meters the pump.
+void handleSessionChange(int pumpId, uint32_t sessionId, bool pumpOn, float targetVolume) {
+    const PumpConfig& pump = dispensing.getPumpConfig(pumpId);
+    if (pumpOn) {
+        watchdog.armPump(pumpId, sessionId, pump.sensorId, pump.relayIndex);
+    } else {
+        watchdog.disarmPump(pumpId);
+    }
+    telemetryReceiver.notifySession(pump.sensorId, sessionId,
+                                    pumpOn ? TELEMETRY_SESSION_START : TELEMETRY_SESSION_STOP, targetVolume);
+}
+
+// Feed the dispensing controller: lifetime pulses when the sensor sends
+// sequenced reports, its reported total otherwise. Sequenced reports were
+// applied as they arrived, so this only repeats them.
+void syncMeteredFlow(int sensor) {
+    const TelemetryTracker& tracker = flowTrackers[sensor - 1];
+    if (tracker.hasData()) {
+        dispensing.updateSensorPulses(sensor, tracker.getPulses(), tracker.getPulsesPerLiter(), false);
+    } else {
+        dispensing.updateSensorVolume(sensor, flowData[sensor - 1].totalVolume);
+    }
+}
+
+void logTelemetryStats() {
+    static unsigned long lastStatsLog = 0;
+    if (millis() - lastStatsLog < TELEMETRY_STATS_INTERVAL) {
+        return;
+    }
+    lastStatsLog = millis();
+    
+    for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+        const TelemetryTracker& tracker = flowTrackers[sensor - 1];
+        if (!tracker.hasData()) {
+            continue;
+        }
+        const TelemetryTracker::Stats& stats = tracker.getStats();
+        Serial.printf("Flow %d telemetry: %lu received, %lu lost (%.1f%%) in %lu gaps, %lu dup, %lu late, "
+                      "%lu reboots, %lu resets, jitter %.1f ms, %.3f L metered\n",
+                      sensor, (unsigned long)stats.received, (unsigned long)stats.lost,
+                      tracker.lossRatio() * 100.0f, (unsigned long)stats.gaps,
+                      (unsigned long)stats.duplicates, (unsigned long)stats.late,
+                      (unsigned long)stats.reboots, (unsigned long)stats.localResets,
+                      stats.jitterMs, tracker.getVolume());
+    }
+    if (telemetryReceiver.getSessionEventsSent() > 0) {
+        Serial.printf("Session events: %lu sent, %lu acked, last ack after %lu ms\n",
+                      (unsigned long)telemetryReceiver.getSessionEventsSent(),
+                      (unsigned long)telemetryReceiver.getSessionEventsAcked(),
+                      telemetryReceiver.getLastSessionAckMs());
+    }
+    portENTER_CRITICAL(&latencyLock);
+    LatencyStats latency = cutoffLatency;
+    portEXIT_CRITICAL(&latencyLock);
+    if (latency.getCount() > 0) {
+        Serial.printf("Cutoff latency: p50 %lu us, p99 %lu us, max %lu us over %lu cutoffs\n",
+                      (unsigned long)latency.percentile(50), (unsigned long)latency.percentile(99),
+                      (unsigned long)latency.getMax(), (unsigned long)latency.getCount());
+    }
+    if (telemetryReceiver.getReplayedCount() > 0) {
+        Serial.printf("Replayed telemetry records: %lu\n", (unsigned long)telemetryReceiver.getReplayedCount());
+    }
+}
+
 void handleUDPDiscovery() {
     int packetSize = discoveryUDP.parsePacket();
     if (packetSize) {
@@ -51,7 +241,8 @@ void handleUDPDiscovery() {
         Serial.println("Received UDP discovery packet: " + message);
         Serial.println("From IP: " + discoveryUDP.remoteIP().toString());
         
-        if (message == "FLOW_SENSOR_DISCOVERY" || message == "FLOW_SENSOR2_DISCOVERY") {
+        // FLOW_SENSOR_DISCOVERY from unit 1, FLOW_SENSORn_DISCOVERY from unit n
+        if (message.startsWith("FLOW_SENSOR") && message.endsWith("_DISCOVERY")) {
             // Send response with our IP (use AP IP if in AP mode, otherwise local IP)
             String ourIP;
             if (WiFi.getMode() == WIFI_AP || WiFi.getMode() == WIFI_AP_STA) {
@@ -71,6 +262,45 @@ void handleUDPDiscovery() {
     }
 }
 
+// Announce ourselves so flow units find us without asking. Sent on every
+// active interface, so AP-only, STA-only and hybrid modes all work.
+void sendDiscoveryBeacon() {
+    static unsigned long lastBeacon = 0;
+    if (millis() - lastBeacon < BEACON_INTERVAL) {
+        return;
+    }
+    lastBeacon = millis();
+    
+    bool apActive = WiFi.getMode() == WIFI_AP || WiFi.getMode() == WIFI_AP_STA;
+    bool staActive = WiFi.status() == WL_CONNECTED;
+    IPAddress apIP = apActive ? WiFi.softAPIP() : IPAddress((uint32_t)0);
+    IPAddress staIP = staActive ? WiFi.localIP() : IPAddress((uint32_t)0);
+    
+    TelemetryBeacon beacon;
+    for (int i = 0; i < 4; i++) {
+        beacon.apAddress[i] = apIP[i];
+        beacon.staAddress[i] = staIP[i];
+    }
+    beacon.telemetryPort = TELEMETRY_UDP_PORT;
+    beacon.keepAlivePort = FLOW_TELEMETRY_PORT;
+    beacon.httpPort = 80;
+    beacon.apiVersion = TELEMETRY_API_VERSION;
+    
+    uint8_t packet[TELEMETRY_BEACON_SIZE];
+    size_t length = encodeTelemetryBeacon(beacon, packet, sizeof(packet));
+    
+    if (apActive) {
+        discoveryUDP.beginPacket(WiFi.softAPBroadcastIP(), TELEMETRY_BEACON_PORT);
+        discoveryUDP.write(packet, length);
+        discoveryUDP.endPacket();
+    }
+    if (staActive) {
+        discoveryUDP.beginPacket(WiFi.broadcastIP(), TELEMETRY_BEACON_PORT);
+        discoveryUDP.write(packet, length);
+        discoveryUDP.endPacket();
+    }
+}
+
 void loadSavedWiFiCredentials() {
     preferences.begin("wifi", true);
     String savedSSID = preferences.getString("ssid", "");
@@ -193,12 +423,7 @@ void connectWiFi() {
             MDNS.addService("http", "tcp", 80);
         }
         
-        // Start UDP discovery listener
-        if (discoveryUDP.begin(12346)) {
-            Serial.println("UDP discovery listener started on port 12346");
-        } else {
-            Serial.println("Failed to start UDP discovery listener");
-        }
+        // The discovery listener from startAccessPoint() serves both interfaces
         
         M5.Lcd.setCursor(10, 90);
         M5.Lcd.setTextColor(GREEN);
@@ -376,8 +601,12 @@ void setup() {
     pir.init();
     Serial.println("PIR sensor initialized");
     
+    // Before anything that can switch a relay from another task
+    hubMutex = xSemaphoreCreateMutex();
+
     // Initialize touch controller
     Serial.println("Initializing touch controller...");
+    touch.setHubLock(hubMutex);
     touch.init();
     Serial.println("Touch controller initialized");
 
@@ -386,22 +615,16 @@ void setup() {
 
     // Initialize web server with WiFi management
     webServer.setWiFiMulti(&wifiMulti);
-    
-    // Set flow data callbacks to sync with global flow data
-    webServer.setFlowDataCallback([](float rate, float volume, bool error) {
-        flowData.flowRate = rate;
-        flowData.totalVolume = volume;
-        flowData.error = error;
-        Serial.printf("Flow 1 data updated: Rate=%.2f L/min, Volume=%.3f L, Error=%s\n", 
-                     rate, volume, error ? "true" : "false");
-    });
-    
-    webServer.setFlow2DataCallback([](float rate, float volume, bool error) {
-        flow2Data.flowRate = rate;
-        flow2Data.totalVolume = volume;
-        flow2Data.error = error;
-        Serial.printf("Flow 2 data updated: Rate=%.2f L/min, Volume=%.3f L, Error=%s\n", 
-                     rate, volume, error ? "true" : "false");
+    webServer.setSafetyWatchdog(&watchdog);
+    webServer.setHubLock(hubMutex);
+    
+    // Set flow data callback to sync with global flow data
+    webServer.setSensorDataCallback([](int sensor, float rate, float volume, bool error) {
+        FlowSensorData& flow = flowData[sensor - 1];
+        flow.flowRate = rate;
+        flow.totalVolume = volume;
+        flow.error = error;
+        watchdog.noteSample(sensor);
     });
     
     // Device control endpoints moved to WebServerManager
@@ -411,6 +634,21 @@ void setup() {
     // Start the web server manager (single server)
     webServer.begin();
     Serial.println("Web server with WiFi management started");
+    
+    // Pump table, learned overshoot, queue options and recipes
+    dispensing.begin();
+    scheduler.begin();
+    recipes.begin();
+    
+    // Binary UDP telemetry from the flow units
+    flowReportQueue = xQueueCreate(CONTROL_QUEUE_LENGTH, sizeof(QueuedFlowReport));
+    telemetryReceiver.setReportCallback(handleTelemetryReport);
+    webServer.setFlowReportCallback(queueFlowReport);
+    dispensing.setSessionCallback(handleSessionChange);
+    telemetryReceiver.begin();
+    watchdog.begin(hubMutex);
+    xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr,
+                            CONTROL_TASK_PRIORITY, &controlTaskHandle, CONTROL_TASK_CORE);
 
     // Draw initial UI
     touch.drawUI(false);
@@ -419,10 +657,13 @@ void setup() {
 void loop() {
     M5.update();
     
-    // Handle UDP discovery requests
-    if (WiFi.status() == WL_CONNECTED) {
-        handleUDPDiscovery();
-    }
+    // Flow telemetry and pump shut-off run on the control task
+    logTelemetryStats();
+    
+    // Answer discovery requests and announce ourselves; in AP-only mode
+    // WiFi.status() is never WL_CONNECTED, so don't gate on it
+    handleUDPDiscovery();
+    sendDiscoveryBeacon();
     
     // Prevent watchdog reset
     yield();
@@ -438,24 +679,32 @@ void loop() {
     }
 
     // Check PIR sensor and handle flashlight
-    pir.check(flashlight.state, [](bool on) {
-        flashlight.set(on);
-    });
+    static unsigned long lastPirCheck = 0;
+    if (millis() - lastPirCheck >= PIR_CHECK_INTERVAL) {
+        xSemaphoreTake(hubMutex, portMAX_DELAY);
+        pir.check(flashlight.state, [](bool on) {
+            flashlight.set(on);
+        });
+        xSemaphoreGive(hubMutex);
+        lastPirCheck = millis();
+    }
 
     pirStateForWeb = pir.isTriggered();
     
     // Update components
-    touch.update();
+    touch.update();  // Takes hubMutex itself, only for relay writes
     webServer.update();
     
-    // Update web server with current flow data (less frequently)
+    // Sync metered flow (less frequently)
     static unsigned long lastFlowUpdate = 0;
     if (millis() - lastFlowUpdate > 1000) { // Only every second
-        webServer.updateFlowData(flowData.flowRate, flowData.totalVolume, flowData.error);
-        webServer.updateFlow2Data(flow2Data.flowRate, flow2Data.totalVolume, flow2Data.error);
-        // Update dispensing controller with flow data from both sensors
-        dispensing.updateFlowData(flowData.totalVolume);    // Pump 1 uses Flow Sensor 1
-        dispensing.updateFlow2Data(flow2Data.totalVolume);  // Pump 2 uses Flow Sensor 2
+        // Update dispensing controller with flow data from every sensor;
+        // the pump table routes each one to the pumps it meters
+        xSemaphoreTake(hubMutex, portMAX_DELAY);
+        for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+            syncMeteredFlow(sensor);
+        }
+        xSemaphoreGive(hubMutex);
         lastFlowUpdate = millis();
     }
     
@@ -491,10 +740,15 @@ void loop() {
                 lastPirState = currentPirState;
                 touch.drawUI(currentPirState);
             }
+            touch.updateQueueStatus();
             break;
             
         case 1:  // PIR tab
-            pir.updateTab();
+            static unsigned long lastPirDisplayUpdate = 0;
+            if (millis() - lastPirDisplayUpdate > PIR_CHECK_INTERVAL) {
+                pir.updateTab();
+                lastPirDisplayUpdate = millis();
+            }
             break;
             
         case 2:  // Flow Sensor tab
@@ -510,7 +764,7 @@ void loop() {
             break;
     }
 
-    delay(100);
+    delay(MAIN_LOOP_DELAY);
 }
 
 void drawFlowSensorTab() {
@@ -522,26 +776,14 @@ void drawFlowSensorTab() {
     M5.Lcd.setCursor(10, 10);
     M5.Lcd.println("Flow Sensors Info");
     
-    // Draw labels for Sensor 1
+    // One row per sensor: rate, volume, status
     M5.Lcd.setTextSize(1);
     M5.Lcd.setCursor(10, 40);
-    M5.Lcd.println("Sensor 1:");
-    M5.Lcd.setCursor(10, 55);
-    M5.Lcd.println("Rate:");
-    M5.Lcd.setCursor(10, 70);
-    M5.Lcd.println("Volume:");
-    M5.Lcd.setCursor(10, 85);
-    M5.Lcd.println("Status:");
-    
-    // Draw labels for Sensor 2
-    M5.Lcd.setCursor(10, 110);
-    M5.Lcd.println("Sensor 2:");
-    M5.Lcd.setCursor(10, 125);
-    M5.Lcd.println("Rate:");
-    M5.Lcd.setCursor(10, 140);
-    M5.Lcd.println("Volume:");
-    M5.Lcd.setCursor(10, 155);
-    M5.Lcd.println("Status:");
+    M5.Lcd.println("Sensor   Rate (L/min)   Volume (L)   Status");
+    for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+        M5.Lcd.setCursor(10, FLOW_TAB_FIRST_ROW + (sensor - 1) * FLOW_TAB_ROW_HEIGHT);
+        M5.Lcd.printf("%d", sensor);
+    }
     
     // Initial update of values
     updateFlowSensorTab();
@@ -549,47 +791,20 @@ void drawFlowSensorTab() {
 
 void updateFlowSensorTab() {
     // Clear the value areas first
-    M5.Lcd.fillRect(100, 40, 220, 130, BLACK);
+    M5.Lcd.fillRect(60, FLOW_TAB_FIRST_ROW, 260, TELEMETRY_MAX_UNITS * FLOW_TAB_ROW_HEIGHT, BLACK);
     
-    M5.Lcd.setTextColor(WHITE);
     M5.Lcd.setTextSize(1);
-    
-    // Update Sensor 1 data
-    M5.Lcd.setCursor(100, 55);
-    M5.Lcd.printf("%.2f L/min", flowData.flowRate);
-    
-    M5.Lcd.setCursor(100, 70);
-    M5.Lcd.printf("%.3f L", flowData.totalVolume);
-    
-    M5.Lcd.setCursor(100, 85);
-    if (flowData.error) {
-        M5.Lcd.setTextColor(RED);
-        M5.Lcd.println("ERROR");
-    } else {
-        M5.Lcd.setTextColor(GREEN);
-        M5.Lcd.println("OK");
-    }
-    
-    // Update Sensor 2 data
-    M5.Lcd.setTextColor(WHITE);
-    M5.Lcd.setCursor(100, 125);
-    M5.Lcd.printf("%.2f L/min", flow2Data.flowRate);
-    
-    M5.Lcd.setCursor(100, 140);
-    M5.Lcd.printf("%.3f L", flow2Data.totalVolume);
-    
-    M5.Lcd.setCursor(100, 155);
-    if (flow2Data.error) {
-        M5.Lcd.setTextColor(RED);
-        M5.Lcd.println("ERROR");
-    } else {
-        M5.Lcd.setTextColor(GREEN);
-        M5.Lcd.println("OK");
+    for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+        const FlowSensorData& flow = flowData[sensor - 1];
+        int y = FLOW_TAB_FIRST_ROW + (sensor - 1) * FLOW_TAB_ROW_HEIGHT;
+        M5.Lcd.setTextColor(WHITE);
+        M5.Lcd.setCursor(64, y);
+        M5.Lcd.printf("%.2f", flow.flowRate);
+        M5.Lcd.setCursor(154, y);
+        M5.Lcd.printf("%.3f", flow.totalVolume);
+        M5.Lcd.setCursor(232, y);
+        M5.Lcd.setTextColor(flow.error ? RED : GREEN);
+        M5.Lcd.println(flow.error ? "ERROR" : "OK");
     }
     M5.Lcd.setTextColor(WHITE);
-    
-    // Debug output
-    Serial.printf("Display updated: S1=%.2f L/min %.3f L %s, S2=%.2f L/min %.3f L %s\n", 
-                  flowData.flowRate, flowData.totalVolume, flowData.error ? "ERROR" : "OK",
-                  flow2Data.flowRate, flow2Data.totalVolume, flow2Data.error ? "ERROR" : "OK");
 }
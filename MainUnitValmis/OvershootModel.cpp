@@ -0,0 +1,100 @@
+#include "OvershootModel.h"
+
+OvershootModel::OvershootModel() {
+    reset();
+}
+
+void OvershootModel::reset() {
+    state.version = OVERSHOOT_STATE_VERSION;
+    state.sessions = 0;
+    state.sumW = 0.0f;
+    state.sumR = 0.0f;
+    state.sumRR = 0.0f;
+    state.sumO = 0.0f;
+    state.sumRO = 0.0f;
+    state.measuredLatencyMs = OVERSHOOT_DEFAULT_LATENCY_MS;
+    beginSession();
+    solve();
+}
+
+void OvershootModel::beginSession() {
+    rate = 0.0f;
+    lastLiters = 0.0f;
+    lastMs = 0;
+    haveFlow = false;
+}
+
+void OvershootModel::observeFlow(float sessionLiters, uint32_t nowMs) {
+    if (haveFlow && nowMs != lastMs) {
+        float sample = (sessionLiters - lastLiters) * 1000.0f / (float)(uint32_t)(nowMs - lastMs);
+        if (sample < 0.0f) sample = 0.0f;
+        rate += OVERSHOOT_RATE_GAIN * (sample - rate);
+    }
+    if (!haveFlow || nowMs != lastMs) {
+        lastLiters = sessionLiters;
+        lastMs = nowMs;
+        haveFlow = true;
+    }
+}
+
+float OvershootModel::predictOvershoot() const {
+    return rate * latencyMs / 1000.0f + dripLiters;
+}
+
+void OvershootModel::noteCutoffLatency(float ms) {
+    if (ms < 0.0f) return;
+    state.measuredLatencyMs += OVERSHOOT_LATENCY_GAIN * (ms - state.measuredLatencyMs);
+    solve();
+}
+
+void OvershootModel::learn(float rateAtStop, float overshootLiters) {
+    if (rateAtStop < 0.0f) rateAtStop = 0.0f;
+    if (overshootLiters < 0.0f) overshootLiters = 0.0f;
+    state.sumW = state.sumW * OVERSHOOT_FORGETTING + 1.0f;
+    state.sumR = state.sumR * OVERSHOOT_FORGETTING + rateAtStop;
+    state.sumRR = state.sumRR * OVERSHOOT_FORGETTING + rateAtStop * rateAtStop;
+    state.sumO = state.sumO * OVERSHOOT_FORGETTING + overshootLiters;
+    state.sumRO = state.sumRO * OVERSHOOT_FORGETTING + rateAtStop * overshootLiters;
+    state.sessions++;
+    solve();
+}
+
+bool OvershootModel::setState(const OvershootState& saved) {
+    if (saved.version != OVERSHOOT_STATE_VERSION || !(saved.sumW >= 0.0f)) {
+        return false;
+    }
+    state = saved;
+    solve();
+    return true;
+}
+
+// Minimise sum w (o - r*T - D)^2 + k*(T - T0)^2 over latency T (seconds)
+// and drip D, where T0 is the measured cutoff latency and k is worth
+// OVERSHOOT_PRIOR_WEIGHT sessions at the typical rate
+void OvershootModel::solve() {
+    float prior = state.measuredLatencyMs / 1000.0f;
+    if (state.sumW <= 0.0f) {
+        latencyMs = state.measuredLatencyMs;
+        dripLiters = 0.0f;
+        return;
+    }
+    float k = OVERSHOOT_PRIOR_WEIGHT * state.sumRR / state.sumW;
+    float varR = state.sumRR - state.sumR * state.sumR / state.sumW;
+    float covRO = state.sumRO - state.sumR * state.sumO / state.sumW;
+    float latency = prior;
+    if (varR + k > 0.0f) {
+        latency = (covRO + k * prior) / (varR + k);
+    }
+    if (latency < 0.0f) latency = 0.0f;
+    float drip = (state.sumO - latency * state.sumR) / state.sumW;
+    if (drip < 0.0f) {
+        // No drip; let the latency explain everything through the origin
+        drip = 0.0f;
+        if (state.sumRR + k > 0.0f) {
+            latency = (state.sumRO + k * prior) / (state.sumRR + k);
+        }
+        if (latency < 0.0f) latency = 0.0f;
+    }
+    latencyMs = latency * 1000.0f;
+    dripLiters = drip;
+}
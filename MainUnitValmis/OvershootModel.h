@@ -0,0 +1,76 @@
+#ifndef OVERSHOOT_MODEL_H
+#define OVERSHOOT_MODEL_H
+
+#include <stdint.h>
+
+#define OVERSHOOT_STATE_VERSION 1
+#define OVERSHOOT_FORGETTING 0.8f       // Weight an older session keeps per newer one
+#define OVERSHOOT_PRIOR_WEIGHT 0.1f     // Pull of the measured cutoff latency, in sessions
+#define OVERSHOOT_RATE_GAIN 0.5f        // Smoothing of the flow rate between reports
+#define OVERSHOOT_LATENCY_GAIN 0.25f    // Smoothing of measured cutoff latencies
+#define OVERSHOOT_DEFAULT_LATENCY_MS 50.0f
+
+// What flows into the cup after the stop decision, for one pump:
+//
+//     overshoot = rate * latency + drip
+//
+// latency covers the report's age, the cutoff path and the relay; drip is
+// what the line and pump deliver once the relay is open. Both are fitted
+// online by exponentially weighted least squares over finished sessions,
+// with the latency pulled towards the cutoff latency measured on this unit
+// so a pump always run at one speed still gets a sensible split.
+//
+// Volumes are litres and rates litres per second. No Arduino dependencies,
+// so it builds on a host as well.
+
+// Persisted form; sums of the weighted regression
+struct OvershootState {
+    uint8_t version;
+    uint32_t sessions;
+    float sumW;
+    float sumR;
+    float sumRR;
+    float sumO;
+    float sumRO;
+    float measuredLatencyMs;
+};
+
+class OvershootModel {
+public:
+    OvershootModel();
+    void reset();
+
+    // Flow while dispensing: the session's volume so far and when it was seen
+    void beginSession();
+    void observeFlow(float sessionLiters, uint32_t nowMs);
+    float getRate() const { return rate; }
+
+    // Litres expected to arrive after a stop issued now
+    float predictOvershoot() const;
+
+    void noteCutoffLatency(float ms);
+    // A session settled: overshootLiters came in after the stop at rateAtStop
+    void learn(float rateAtStop, float overshootLiters);
+
+    bool isTrained() const { return state.sessions > 0; }
+    uint32_t getSessions() const { return state.sessions; }
+    float getLatencyMs() const { return latencyMs; }
+    float getDripLiters() const { return dripLiters; }
+
+    const OvershootState& getState() const { return state; }
+    // Restore saved sums; false (and untouched) if the version doesn't match
+    bool setState(const OvershootState& saved);
+
+private:
+    OvershootState state;
+    float latencyMs;
+    float dripLiters;
+    float rate;
+    float lastLiters;
+    uint32_t lastMs;
+    bool haveFlow;
+
+    void solve();
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "RecipeEngine.h"
+#include <Preferences.h>
+
+RecipeEngine::RecipeEngine(DispensingController* dispensingController)
+    : dispensing(dispensingController), recipeCount(0), lastFillSeconds(0), lastSlowestSeconds(0), lastSumSeconds(0) {
+    mutex = xSemaphoreCreateRecursiveMutex();
+    memset(recipes, 0, sizeof(recipes));
+    memset(&order.recipe, 0, sizeof(order.recipe));
+    order.state = ORDER_NONE;
+    order.startTime = 0;
+    order.finishTime = 0;
+}
+
+void RecipeEngine::begin() {
+    Preferences prefs;
+    if (!prefs.begin(RECIPE_PREFS_NAMESPACE, true)) {
+        return;
+    }
+    size_t length = prefs.getBytesLength("book");
+    if (length > 0 && length % sizeof(Recipe) == 0 && length <= sizeof(recipes)) {
+        prefs.getBytes("book", recipes, length);
+        recipeCount = length / sizeof(Recipe);
+        for (int i = 0; i < recipeCount; i++) {
+            recipes[i].name[RECIPE_NAME_LENGTH - 1] = '\0';
+        }
+        Serial.printf("Recipes: %d loaded\n", recipeCount);
+    }
+    prefs.end();
+}
+
+void RecipeEngine::saveRecipes() {
+    Preferences prefs;
+    if (!prefs.begin(RECIPE_PREFS_NAMESPACE, false)) {
+        Serial.println("Recipes: NVS unavailable");
+        return;
+    }
+    if (recipeCount > 0) {
+        prefs.putBytes("book", recipes, recipeCount * sizeof(Recipe));
+    } else {
+        prefs.remove("book");
+    }
+    prefs.end();
+}
+
+bool RecipeEngine::isValidRecipe(const Recipe& recipe) const {
+    if (recipe.name[0] == '\0' || recipe.componentCount == 0 || recipe.componentCount > RECIPE_MAX_COMPONENTS) {
+        return false;
+    }
+    for (int i = 0; i < recipe.componentCount; i++) {
+        const RecipeComponent& component = recipe.components[i];
+        if (component.pumpId < 1 || component.pumpId > DISPENSING_MAX_PUMPS || component.volume <= 0) {
+            return false;
+        }
+        for (int j = 0; j < i; j++) {
+            if (recipe.components[j].pumpId == component.pumpId) {
+                return false;  // One session per pump; merge the volumes instead
+            }
+        }
+    }
+    return true;
+}
+
+int RecipeEngine::findRecipe(const char* name) const {
+    for (int i = 0; i < recipeCount; i++) {
+        if (strncmp(recipes[i].name, name, RECIPE_NAME_LENGTH) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool RecipeEngine::getRecipe(int index, Recipe& recipe) const {
+    Guard guard(mutex);
+    if (index < 0 || index >= recipeCount) {
+        return false;
+    }
+    recipe = recipes[index];
+    return true;
+}
+
+bool RecipeEngine::saveRecipe(const Recipe& recipe) {
+    if (!isValidRecipe(recipe)) {
+        return false;
+    }
+
+    Guard guard(mutex);
+    int index = findRecipe(recipe.name);
+    if (index < 0) {
+        if (recipeCount >= RECIPE_MAX_COUNT) {
+            return false;
+        }
+        index = recipeCount++;
+    }
+    recipes[index] = recipe;
+    recipes[index].name[RECIPE_NAME_LENGTH - 1] = '\0';
+    saveRecipes();
+    Serial.printf("Recipe '%s' saved: %d components\n", recipes[index].name, recipe.componentCount);
+    return true;
+}
+
+bool RecipeEngine::deleteRecipe(const char* name) {
+    Guard guard(mutex);
+    int index = findRecipe(name);
+    if (index < 0) {
+        return false;
+    }
+    for (int i = index; i < recipeCount - 1; i++) {
+        recipes[i] = recipes[i + 1];
+    }
+    recipeCount--;
+    saveRecipes();
+    return true;
+}
+
+bool RecipeEngine::startOrder(const char* name) {
+    Guard guard(mutex);
+    if (order.state == ORDER_RUNNING) {
+        return false;
+    }
+    int index = findRecipe(name);
+    if (index < 0) {
+        return false;
+    }
+    const Recipe& recipe = recipes[index];
+
+    // Every pump must be free before any of them starts
+    for (int i = 0; i < recipe.componentCount; i++) {
+        int pumpId = recipe.components[i].pumpId;
+        DispensingState state = dispensing->getState(pumpId);
+        if (!dispensing->isValidPumpId(pumpId) || state == DISPENSING || state == PAUSED || state == ERROR_STATE) {
+            Serial.printf("Recipe '%s': pump %d is not available\n", recipe.name, pumpId);
+            return false;
+        }
+    }
+
+    order.recipe = recipe;
+    order.startTime = millis();
+    order.finishTime = 0;
+    order.message = "";
+    order.state = ORDER_RUNNING;
+    for (int i = 0; i < recipe.componentCount; i++) {
+        order.sessionIds[i] = 0;
+        order.componentMs[i] = 0;
+        order.finalVolumes[i] = 0;
+    }
+    for (int i = 0; i < recipe.componentCount; i++) {
+        const RecipeComponent& component = recipe.components[i];
+        if (!dispensing->startDispensing(component.pumpId, component.volume)) {
+            abortOrder("A component failed to start");
+            return false;
+        }
+        order.sessionIds[i] = dispensing->getSessionId(component.pumpId);
+    }
+    Serial.printf("Recipe '%s' started on %d pumps\n", recipe.name, recipe.componentCount);
+    return true;
+}
+
+void RecipeEngine::abortOrder(const char* reason) {
+    Guard guard(mutex);
+    if (order.state != ORDER_RUNNING) {
+        return;
+    }
+    stopComponents();
+    order.state = ORDER_ABORTED;
+    order.finishTime = millis();
+    order.message = reason;
+    Serial.printf("Recipe '%s' aborted: %s\n", order.recipe.name, reason);
+}
+
+// Stop whatever is still pouring for this order; sessions started by
+// someone else since are left alone
+void RecipeEngine::stopComponents() {
+    for (int i = 0; i < order.recipe.componentCount; i++) {
+        int pumpId = order.recipe.components[i].pumpId;
+        if (dispensing->getSessionId(pumpId) == order.sessionIds[i]) {
+            dispensing->stopDispensing(pumpId);
+        }
+    }
+}
+
+bool RecipeEngine::componentFinished(int component) const {
+    return order.componentMs[component] > 0;
+}
+
+void RecipeEngine::service() {
+    Guard guard(mutex);
+    if (order.state != ORDER_RUNNING) {
+        return;
+    }
+
+    unsigned long now = millis();
+    bool allDone = true;
+    for (int i = 0; i < order.recipe.componentCount; i++) {
+        if (componentFinished(i)) {
+            continue;
+        }
+        int pumpId = order.recipe.components[i].pumpId;
+        DispensingState state = dispensing->getState(pumpId);
+        if (dispensing->getSessionId(pumpId) != order.sessionIds[i]) {
+            abortOrder(("Pump " + String(pumpId) + " was restarted").c_str());
+            return;
+        }
+        if (state == ERROR_STATE) {
+            abortOrder(("Pump " + String(pumpId) + ": " + dispensing->getErrorMessage(pumpId)).c_str());
+            return;
+        }
+        if (state == READY) {
+            abortOrder(("Pump " + String(pumpId) + " was stopped").c_str());
+            return;
+        }
+        if (state == COMPLETED) {
+            order.componentMs[i] = max(now - order.startTime, 1UL);
+            order.finalVolumes[i] = dispensing->getCurrentVolume(pumpId);
+        } else {
+            allDone = false;
+        }
+    }
+    if (!allDone) {
+        return;
+    }
+
+    order.state = ORDER_COMPLETED;
+    order.finishTime = now;
+    unsigned long slowest = 0;
+    unsigned long sum = 0;
+    for (int i = 0; i < order.recipe.componentCount; i++) {
+        slowest = max(slowest, order.componentMs[i]);
+        sum += order.componentMs[i];
+    }
+    lastFillSeconds = (order.finishTime - order.startTime) / 1000.0f;
+    lastSlowestSeconds = slowest / 1000.0f;
+    lastSumSeconds = sum / 1000.0f;
+    Serial.printf("Recipe '%s' done in %.1f s (slowest component %.1f s, %.1f s one after another)\n",
+                 order.recipe.name, lastFillSeconds, lastSlowestSeconds, lastSumSeconds);
+}
+
+Recipe RecipeEngine::getOrderRecipe() const {
+    Guard guard(mutex);
+    return order.recipe;
+}
+
+String RecipeEngine::getOrderMessage() const {
+    Guard guard(mutex);
+    return order.message;
+}
+
+float RecipeEngine::getOrderVolume() const {
+    Guard guard(mutex);
+    float poured = 0;
+    for (int i = 0; i < order.recipe.componentCount; i++) {
+        const RecipeComponent& component = order.recipe.components[i];
+        float volume = componentFinished(i) ? order.finalVolumes[i] : dispensing->getCurrentVolume(component.pumpId);
+        poured += min(volume, component.volume);
+    }
+    return poured;
+}
+
+float RecipeEngine::getOrderProgress() const {
+    Guard guard(mutex);
+    if (order.state == ORDER_NONE) return 0.0f;
+    if (order.state == ORDER_COMPLETED) return 1.0f;
+    float total = 0;
+    for (int i = 0; i < order.recipe.componentCount; i++) {
+        total += order.recipe.components[i].volume;
+    }
+    return total > 0 ? getOrderVolume() / total : 0.0f;
+}
+
+unsigned long RecipeEngine::getOrderElapsedMs() const {
+    Guard guard(mutex);
+    if (order.state == ORDER_NONE) return 0;
+    if (order.state == ORDER_RUNNING) return millis() - order.startTime;
+    return order.finishTime - order.startTime;
+}
+
+const char* RecipeEngine::stateName(OrderState state) {
+    switch (state) {
+        case ORDER_NONE: return "none";
+        case ORDER_RUNNING: return "running";
+        case ORDER_COMPLETED: return "completed";
+        case ORDER_ABORTED: return "aborted";
+    }
+    return "unknown";
+}
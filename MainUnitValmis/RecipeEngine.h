@@ -0,0 +1,104 @@
+#ifndef RECIPE_ENGINE_H
+#define RECIPE_ENGINE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "DispensingController.h"
+
+#define RECIPE_MAX_COUNT 16                         // Recipes kept in NVS
+#define RECIPE_MAX_COMPONENTS DISPENSING_MAX_PUMPS  // At most one component per pump
+#define RECIPE_NAME_LENGTH 24                       // Including the terminator
+#define RECIPE_PREFS_NAMESPACE "recipes"
+
+struct RecipeComponent {
+    uint8_t pumpId;
+    float volume;                  // Litres
+};
+
+// A named drink: components are poured at the same time, one per pump
+struct Recipe {
+    char name[RECIPE_NAME_LENGTH];
+    uint8_t componentCount;
+    RecipeComponent components[RECIPE_MAX_COMPONENTS];
+};
+
+enum OrderState {
+    ORDER_NONE,
+    ORDER_RUNNING,
+    ORDER_COMPLETED,
+    ORDER_ABORTED
+};
+
+// Pours recipes through the DispensingController. All of an order's
+// components start together and are tracked as one order, so the fill
+// takes about as long as the slowest component. If any component faults
+// or is stopped, the others are stopped and the order is aborted.
+// One order runs at a time; service() belongs on the control task.
+class RecipeEngine {
+public:
+    RecipeEngine(DispensingController* dispensing);
+    // Load the recipe book from NVS
+    void begin();
+    void service();
+
+    // Recipe book. Getters return copies, as the web server reads them
+    // from its own task while the control task may be changing them.
+    bool saveRecipe(const Recipe& recipe);
+    bool deleteRecipe(const char* name);
+    int getRecipeCount() const { return recipeCount; }
+    bool getRecipe(int index, Recipe& recipe) const;  // False once index is past the end
+    int findRecipe(const char* name) const;
+
+    // Orders
+    bool startOrder(const char* name);
+    void abortOrder(const char* reason);
+    OrderState getOrderState() const { return order.state; }
+    Recipe getOrderRecipe() const;
+    float getOrderProgress() const;                 // Poured share of the total volume, 0..1
+    float getOrderVolume() const;                   // Litres poured so far
+    unsigned long getOrderElapsedMs() const;
+    String getOrderMessage() const;
+    // Last completed order: wall time against the components' own times
+    float getLastFillSeconds() const { return lastFillSeconds; }
+    float getLastSlowestSeconds() const { return lastSlowestSeconds; }
+    float getLastSumSeconds() const { return lastSumSeconds; }
+
+    static const char* stateName(OrderState state);
+
+private:
+    struct Order {
+        OrderState state;
+        Recipe recipe;
+        uint32_t sessionIds[RECIPE_MAX_COMPONENTS];
+        unsigned long componentMs[RECIPE_MAX_COMPONENTS];  // Until that component completed, 0 while running
+        float finalVolumes[RECIPE_MAX_COMPONENTS];
+        unsigned long startTime;
+        unsigned long finishTime;
+        String message;
+    };
+
+    class Guard {
+    public:
+        explicit Guard(SemaphoreHandle_t m) : held(m) { xSemaphoreTakeRecursive(held, portMAX_DELAY); }
+        ~Guard() { xSemaphoreGiveRecursive(held); }
+    private:
+        SemaphoreHandle_t held;
+    };
+
+    DispensingController* dispensing;
+    SemaphoreHandle_t mutex;
+    Recipe recipes[RECIPE_MAX_COUNT];
+    int recipeCount;
+    Order order;
+    float lastFillSeconds;
+    float lastSlowestSeconds;
+    float lastSumSeconds;
+
+    bool isValidRecipe(const Recipe& recipe) const;
+    bool componentFinished(int component) const;
+    void stopComponents();
+    void saveRecipes();
+};
+
+#endif
@@ -1,21 +1,31 @@
 #include "RelayController.h"
 
-RelayController::RelayController(M5UnitPbHub* hub) : pbhub(hub) {}
+// PbHub channel and IO index for each relay output
+static const uint8_t RELAY_OUTPUTS[RELAY_MAX_OUTPUTS][2] = {
+    {RELAY_CHANNEL, RELAY_INDEX1},
+    {RELAY_CHANNEL, RELAY_INDEX2},
+    {3, 0}, {3, 1},
+    {4, 0}, {4, 1},
+    {5, 0}, {5, 1}
+};
 
-void RelayController::setRelay1(bool on) {
-    relay1 = on;
-    pbhub->digitalWrite(RELAY_CHANNEL, RELAY_INDEX1, on ? HIGH : LOW);
+RelayController::RelayController(M5UnitPbHub* hub) : pbhub(hub) {
+    for (int i = 0; i < RELAY_MAX_OUTPUTS; i++) {
+        states[i] = false;
+    }
 }
 
-void RelayController::setRelay2(bool on) {
-    relay2 = on;
-    pbhub->digitalWrite(RELAY_CHANNEL, RELAY_INDEX2, on ? HIGH : LOW);
+void RelayController::setRelay(int index, bool on) {
+    if (index < 0 || index >= RELAY_MAX_OUTPUTS) {
+        return;
+    }
+    states[index] = on;
+    pbhub->digitalWrite(RELAY_OUTPUTS[index][0], RELAY_OUTPUTS[index][1], on ? HIGH : LOW);
 }
 
-bool RelayController::getRelay1() const {
-    return relay1;
+bool RelayController::getRelay(int index) const {
+    if (index < 0 || index >= RELAY_MAX_OUTPUTS) {
+        return false;
+    }
+    return states[index];
 }
-
-bool RelayController::getRelay2() const {
-    return relay2;
-}
\ No newline at end of file
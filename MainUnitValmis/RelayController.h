@@ -6,19 +6,26 @@
 #define RELAY_CHANNEL 1
 #define RELAY_INDEX1 0
 #define RELAY_INDEX2 1
+#define RELAY_MAX_OUTPUTS 8   // PbHub channels 1, 3, 4 and 5; 0 and 2 carry the flashlight and PIR
 
+// Relay outputs on the PbHub, numbered from 0. Relays 0 and 1 are the
+// original pair on RELAY_CHANNEL; further taps continue on the free channels.
 class RelayController {
 public:
     RelayController(M5UnitPbHub* hub);
-    void setRelay1(bool on);
-    void setRelay2(bool on);
-    bool getRelay1() const;
-    bool getRelay2() const;
-    bool relay1 = false;
-    bool relay2 = false;
+    void setRelay(int index, bool on);
+    bool getRelay(int index) const;
+    int getRelayCount() const { return RELAY_MAX_OUTPUTS; }
+
+    // First two taps, as wired on the original unit
+    void setRelay1(bool on) { setRelay(0, on); }
+    void setRelay2(bool on) { setRelay(1, on); }
+    bool getRelay1() const { return getRelay(0); }
+    bool getRelay2() const { return getRelay(1); }
 
 private:
     M5UnitPbHub* pbhub;
+    bool states[RELAY_MAX_OUTPUTS];
 };
 
-#endif
\ No newline at end of file
+#endif
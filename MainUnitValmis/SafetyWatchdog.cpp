@@ -0,0 +1,221 @@
+#include "SafetyWatchdog.h"
+#include <Preferences.h>
+
+SafetyWatchdog::SafetyWatchdog(RelayController* relayController)
+    : relay(relayController), hubLock(nullptr), timer(nullptr), lastHeartbeat(0), forcedWrites(0), lastTripMs(0) {
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    settings.version = WATCHDOG_SETTINGS_VERSION;
+    settings.freshnessMs = WATCHDOG_DEFAULT_FRESHNESS_MS;
+    settings.heartbeatMs = WATCHDOG_DEFAULT_HEARTBEAT_MS;
+    memset(pumps, 0, sizeof(pumps));
+    memset(trips, 0, sizeof(trips));
+    memset(lastSample, 0, sizeof(lastSample));
+    memset(haveSample, 0, sizeof(haveSample));
+    memset(tripCounts, 0, sizeof(tripCounts));
+    memset(pumpTrips, 0, sizeof(pumpTrips));
+}
+
+void SafetyWatchdog::begin(SemaphoreHandle_t hubMutex) {
+    hubLock = hubMutex;
+
+    Preferences prefs;
+    if (prefs.begin(WATCHDOG_PREFS_NAMESPACE, true)) {
+        WatchdogSettings saved;
+        if (prefs.getBytes("settings", &saved, sizeof(saved)) == sizeof(saved) &&
+            saved.version == WATCHDOG_SETTINGS_VERSION) {
+            settings = saved;
+        }
+        prefs.end();
+    }
+
+    portENTER_CRITICAL(&lock);
+    lastHeartbeat = millis();  // The control task starts after this
+    portEXIT_CRITICAL(&lock);
+
+    esp_timer_create_args_t args = {};
+    args.callback = onTimer;
+    args.arg = this;
+    args.name = "pumpWatchdog";
+    if (esp_timer_create(&args, &timer) != ESP_OK ||
+        esp_timer_start_periodic(timer, WATCHDOG_PERIOD_MS * 1000ULL) != ESP_OK) {
+        Serial.println("Safety watchdog: timer could not be started");
+        return;
+    }
+    Serial.printf("Safety watchdog: samples within %lu ms, control task within %lu ms\n",
+                 (unsigned long)settings.freshnessMs, (unsigned long)settings.heartbeatMs);
+}
+
+void SafetyWatchdog::heartbeat() {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&lock);
+    lastHeartbeat = now;
+    portEXIT_CRITICAL(&lock);
+}
+
+void SafetyWatchdog::noteSample(int sensorId) {
+    if (sensorId < 1 || sensorId > TELEMETRY_MAX_UNITS) return;
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&lock);
+    lastSample[sensorId - 1] = now;
+    haveSample[sensorId - 1] = true;
+    portEXIT_CRITICAL(&lock);
+}
+
+void SafetyWatchdog::armPump(int pumpId, uint32_t sessionId, uint8_t sensorId, uint8_t relayIndex) {
+    if (pumpId < 1 || pumpId > DISPENSING_MAX_PUMPS) return;
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&lock);
+    ArmedPump& pump = pumps[pumpId - 1];
+    pump.armed = true;
+    pump.sessionId = sessionId;
+    pump.sensorId = sensorId;
+    pump.relayIndex = relayIndex;
+    pump.armedAt = now;
+    portEXIT_CRITICAL(&lock);
+}
+
+void SafetyWatchdog::disarmPump(int pumpId) {
+    if (pumpId < 1 || pumpId > DISPENSING_MAX_PUMPS) return;
+
+    portENTER_CRITICAL(&lock);
+    pumps[pumpId - 1].armed = false;
+    portEXIT_CRITICAL(&lock);
+}
+
+void SafetyWatchdog::onTimer(void* arg) {
+    static_cast<SafetyWatchdog*>(arg)->poll();
+}
+
+// Decide under the spinlock, switch relays outside it. The hub lock is
+// waited for briefly only: if whoever holds it is stuck, the relay write
+// goes ahead anyway (Wire serialises the bus transfers itself).
+void SafetyWatchdog::poll() {
+    uint32_t now = millis();
+    uint8_t cut[DISPENSING_MAX_PUMPS];
+    int cutCount = 0;
+
+    portENTER_CRITICAL(&lock);
+    uint32_t heartbeatAge = now - lastHeartbeat;
+    bool stalled = heartbeatAge > settings.heartbeatMs;
+    for (int i = 0; i < DISPENSING_MAX_PUMPS; i++) {
+        ArmedPump& pump = pumps[i];
+        if (!pump.armed) {
+            continue;
+        }
+        // Freshness counts from relay-on when the last sample is older
+        int sensor = pump.sensorId - 1;
+        uint32_t newest = pump.armedAt;
+        if (sensor >= 0 && sensor < TELEMETRY_MAX_UNITS && haveSample[sensor] &&
+            (int32_t)(lastSample[sensor] - pump.armedAt) > 0) {
+            newest = lastSample[sensor];
+        }
+        uint32_t sampleAge = now - newest;
+        if (!stalled && sampleAge <= settings.freshnessMs) {
+            continue;
+        }
+
+        WatchdogReason reason = stalled ? WATCHDOG_MISSED_HEARTBEAT : WATCHDOG_STALE_SAMPLES;
+        pump.armed = false;
+        trips[i].pending = true;
+        trips[i].sessionId = pump.sessionId;
+        trips[i].reason = reason;
+        trips[i].ageMs = stalled ? heartbeatAge : sampleAge;
+        tripCounts[reason]++;
+        pumpTrips[i]++;
+        lastTripMs = now;
+        cut[cutCount++] = pump.relayIndex;
+    }
+    portEXIT_CRITICAL(&lock);
+
+    if (cutCount == 0) {
+        return;
+    }
+    bool locked = hubLock && xSemaphoreTake(hubLock, pdMS_TO_TICKS(WATCHDOG_LOCK_WAIT_MS)) == pdTRUE;
+    for (int i = 0; i < cutCount; i++) {
+        relay->setRelay(cut[i], false);
+    }
+    if (locked) {
+        xSemaphoreGive(hubLock);
+    } else {
+        portENTER_CRITICAL(&lock);
+        forcedWrites++;
+        portEXIT_CRITICAL(&lock);
+    }
+}
+
+// The relay is already off; this ends the session properly and reports it.
+// A session started since the trip is left alone.
+void SafetyWatchdog::serviceTrips(DispensingController* dispensing) {
+    for (int pumpId = 1; pumpId <= DISPENSING_MAX_PUMPS; pumpId++) {
+        portENTER_CRITICAL(&lock);
+        Trip trip = trips[pumpId - 1];
+        trips[pumpId - 1].pending = false;
+        portEXIT_CRITICAL(&lock);
+        if (!trip.pending) {
+            continue;
+        }
+
+        Serial.printf("Pump %d: safety watchdog cut the relay, %s for %lu ms\n", pumpId,
+                     reasonName(trip.reason), (unsigned long)trip.ageMs);
+        if (dispensing->getSessionId(pumpId) == trip.sessionId) {
+            dispensing->reportFault(pumpId, FAULT_WATCHDOG);
+        }
+    }
+}
+
+bool SafetyWatchdog::setSettings(uint32_t freshnessMs, uint32_t heartbeatMs) {
+    // Shorter than a couple of ticks would trip on timer jitter alone
+    if (freshnessMs < 2 * WATCHDOG_PERIOD_MS || heartbeatMs < 2 * WATCHDOG_PERIOD_MS ||
+        freshnessMs > WATCHDOG_MAX_BUDGET_MS || heartbeatMs > WATCHDOG_MAX_BUDGET_MS) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&lock);
+    settings.freshnessMs = freshnessMs;
+    settings.heartbeatMs = heartbeatMs;
+    portEXIT_CRITICAL(&lock);
+    saveSettings();
+    Serial.printf("Safety watchdog: samples within %lu ms, control task within %lu ms\n",
+                 (unsigned long)freshnessMs, (unsigned long)heartbeatMs);
+    return true;
+}
+
+void SafetyWatchdog::saveSettings() {
+    Preferences prefs;
+    if (!prefs.begin(WATCHDOG_PREFS_NAMESPACE, false)) {
+        Serial.println("Safety watchdog: NVS unavailable");
+        return;
+    }
+    prefs.putBytes("settings", &settings, sizeof(settings));
+    prefs.end();
+}
+
+uint32_t SafetyWatchdog::getPumpTripCount(int pumpId) const {
+    if (pumpId < 1 || pumpId > DISPENSING_MAX_PUMPS) return 0;
+    return pumpTrips[pumpId - 1];
+}
+
+bool SafetyWatchdog::isArmed(int pumpId) const {
+    if (pumpId < 1 || pumpId > DISPENSING_MAX_PUMPS) return false;
+    return pumps[pumpId - 1].armed;
+}
+
+uint32_t SafetyWatchdog::getSampleAgeMs(int sensorId) const {
+    if (sensorId < 1 || sensorId > TELEMETRY_MAX_UNITS || !haveSample[sensorId - 1]) return 0;
+    return millis() - lastSample[sensorId - 1];
+}
+
+uint32_t SafetyWatchdog::getHeartbeatAgeMs() const {
+    return millis() - lastHeartbeat;
+}
+
+const char* SafetyWatchdog::reasonName(WatchdogReason reason) {
+    switch (reason) {
+        case WATCHDOG_STALE_SAMPLES: return "staleSamples";
+        case WATCHDOG_MISSED_HEARTBEAT: return "missedHeartbeat";
+        case WATCHDOG_REASON_COUNT: break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,111 @@
+#ifndef SAFETY_WATCHDOG_H
+#define SAFETY_WATCHDOG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include "RelayController.h"
+#include "DispensingController.h"
+#include "TelemetryReceiver.h"
+
+#define WATCHDOG_PERIOD_MS 50              // Timer tick
+#define WATCHDOG_DEFAULT_FRESHNESS_MS 2500 // Longer than a flow unit's idle heartbeat
+#define WATCHDOG_DEFAULT_HEARTBEAT_MS 500  // The control task passes every few ms
+#define WATCHDOG_LOCK_WAIT_MS 20           // Then the relay is written without the hub lock
+#define WATCHDOG_MAX_BUDGET_MS 60000       // Longer budgets would leave nothing to watch
+#define WATCHDOG_SETTINGS_VERSION 1
+#define WATCHDOG_PREFS_NAMESPACE "watchdog"
+
+enum WatchdogReason {
+    WATCHDOG_STALE_SAMPLES,        // A running pump's sensor went quiet
+    WATCHDOG_MISSED_HEARTBEAT,     // The control task stopped passing
+    WATCHDOG_REASON_COUNT
+};
+
+struct WatchdogSettings {
+    uint8_t version;
+    uint32_t freshnessMs;          // Newest sample of a running pump's sensor may be this old
+    uint32_t heartbeatMs;          // Control task may go this long without a pass
+};
+
+// Last line of defence for the pump relays. A periodic esp_timer checks,
+// independently of loop() and the control task, that every pump switched
+// on for a session still hears from its flow sensor and that the control
+// task is still running. If not, it switches the relay off itself and
+// leaves the trip for the control task to turn into a FAULT_WATCHDOG
+// session error once it runs again.
+//
+// Pumps are armed and disarmed from the session callback; top-off pulses
+// stay armed in between. State shared with the timer is guarded by a
+// spinlock, and the relay writes happen outside it.
+class SafetyWatchdog {
+public:
+    SafetyWatchdog(RelayController* relay);
+    // Load settings from NVS and start the timer. hubLock orders relay
+    // writes against other PbHub traffic.
+    void begin(SemaphoreHandle_t hubLock);
+
+    // Control task, every pass
+    void heartbeat();
+    // Any report from a flow unit, in order or not
+    void noteSample(int sensorId);
+    // Pump switched on or off for a session
+    void armPump(int pumpId, uint32_t sessionId, uint8_t sensorId, uint8_t relayIndex);
+    void disarmPump(int pumpId);
+    // Hand tripped sessions to the DispensingController; control task
+    void serviceTrips(DispensingController* dispensing);
+
+    // One timer tick, normally from the esp_timer
+    void poll();
+
+    bool setSettings(uint32_t freshnessMs, uint32_t heartbeatMs);
+    const WatchdogSettings& getSettings() const { return settings; }
+
+    uint32_t getTripCount(WatchdogReason reason) const { return tripCounts[reason]; }
+    uint32_t getPumpTripCount(int pumpId) const;
+    uint32_t getForcedWrites() const { return forcedWrites; }
+    uint32_t getLastTripMs() const { return lastTripMs; }
+    bool isArmed(int pumpId) const;
+    uint32_t getSampleAgeMs(int sensorId) const;
+    uint32_t getHeartbeatAgeMs() const;
+
+    static const char* reasonName(WatchdogReason reason);
+
+private:
+    struct ArmedPump {
+        bool armed;
+        uint32_t sessionId;
+        uint8_t sensorId;
+        uint8_t relayIndex;
+        uint32_t armedAt;          // millis()
+    };
+    struct Trip {
+        bool pending;
+        uint32_t sessionId;
+        WatchdogReason reason;
+        uint32_t ageMs;            // Of the newest sample or heartbeat
+    };
+
+    RelayController* relay;
+    SemaphoreHandle_t hubLock;
+    esp_timer_handle_t timer;
+    mutable portMUX_TYPE lock;
+    WatchdogSettings settings;
+
+    ArmedPump pumps[DISPENSING_MAX_PUMPS];
+    Trip trips[DISPENSING_MAX_PUMPS];
+    uint32_t lastSample[TELEMETRY_MAX_UNITS];
+    bool haveSample[TELEMETRY_MAX_UNITS];
+    uint32_t lastHeartbeat;
+
+    uint32_t tripCounts[WATCHDOG_REASON_COUNT];
+    uint32_t pumpTrips[DISPENSING_MAX_PUMPS];
+    uint32_t forcedWrites;
+    uint32_t lastTripMs;
+
+    static void onTimer(void* arg);
+    void saveSettings();
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "SessionMeter.h"
+
+SessionMeter::SessionMeter()
+    : lastRaw(0), offset(0), count(0), countTime(0), haveCount(false), pulsesPerLiter(0.0f),
+      baseline(0), baselineTime(0), baselineAgeMs(0), latched(false), pending(false), baselineLate(false) {
+}
+
+void SessionMeter::update(uint64_t raw, float reportedPulsesPerLiter, uint32_t nowMs) {
+    if (haveCount && raw < lastRaw) {
+        offset += lastRaw;  // Sensor started over from zero
+    }
+    lastRaw = raw;
+    count = raw + offset;
+    countTime = nowMs;
+    haveCount = true;
+    if (reportedPulsesPerLiter > 0.0f) {
+        pulsesPerLiter = reportedPulsesPerLiter;
+    }
+
+    if (latched && pending) {
+        // First count after a blind latch: anything already flowed is lost
+        baseline = count;
+        baselineAgeMs = 0;
+        pending = false;
+        baselineLate = true;
+    }
+}
+
+void SessionMeter::latch(uint32_t nowMs) {
+    latched = true;
+    baselineTime = nowMs;
+    baselineLate = false;
+    if (haveCount) {
+        baseline = count;
+        baselineAgeMs = nowMs - countTime;
+        pending = false;
+    } else {
+        baseline = 0;
+        baselineAgeMs = 0;
+        pending = true;
+    }
+}
+
+void SessionMeter::release() {
+    latched = false;
+    pending = false;
+}
+
+uint64_t SessionMeter::getSessionPulses() const {
+    if (!latched || pending || count < baseline) {
+        return 0;
+    }
+    return count - baseline;
+}
+
+float SessionMeter::pulsesToLiters(uint64_t pulses) const {
+    if (pulsesPerLiter <= 0.0f) {
+        return 0.0f;
+    }
+    return (float)((double)pulses / pulsesPerLiter);
+}
+
+uint64_t SessionMeter::litersToPulses(float liters) const {
+    if (liters <= 0.0f || pulsesPerLiter <= 0.0f) {
+        return 0;
+    }
+    return (uint64_t)((double)liters * pulsesPerLiter + 0.5);
+}
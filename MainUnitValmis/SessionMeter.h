@@ -0,0 +1,63 @@
+#ifndef SESSION_METER_H
+#define SESSION_METER_H
+
+#include <stdint.h>
+
+// Integer pulse accounting for one pump's dispensing sessions.
+//
+// The flow sensor's cumulative pulse count is fed in as it arrives. When
+// the relay switches on, latch() takes the newest known count as the
+// session baseline, with the relay-on time. The pump was off until then, so
+// pulses that arrive later (even in reports sampled before relay-on) all
+// belong to the session. If no count has been seen yet, the first count to
+// arrive becomes the baseline and the latch is marked late.
+//
+// Everything is kept in whole pulses; litres only appear when converting
+// for display or a target. A count that goes backwards (a sensor that
+// resets its own total) is taken as a restart from zero, so the meter
+// itself never runs backwards.
+//
+// No Arduino dependencies, so it builds on a host as well.
+class SessionMeter {
+public:
+    SessionMeter();
+
+    // Feed the sensor's cumulative count and the K-factor it reported
+    void update(uint64_t count, float pulsesPerLiter, uint32_t nowMs);
+    // Relay on: baseline the session on the newest count
+    void latch(uint32_t nowMs);
+    void release();
+
+    bool hasCount() const { return haveCount; }
+    bool isLatched() const { return latched; }
+    bool isBaselineLate() const { return baselineLate; }
+    bool isBaselinePending() const { return latched && pending; }
+
+    uint64_t getCount() const { return count; }
+    uint32_t getCountTime() const { return countTime; }
+    uint64_t getBaseline() const { return baseline; }
+    uint32_t getBaselineTime() const { return baselineTime; }     // Relay-on time
+    uint32_t getBaselineAgeMs() const { return baselineAgeMs; }   // How old the latched count was
+    uint64_t getSessionPulses() const;
+
+    float getPulsesPerLiter() const { return pulsesPerLiter; }
+    float pulsesToLiters(uint64_t pulses) const;
+    uint64_t litersToPulses(float liters) const;
+
+private:
+    uint64_t lastRaw;
+    uint64_t offset;        // Added to raw counts after a restart
+    uint64_t count;
+    uint32_t countTime;
+    bool haveCount;
+    float pulsesPerLiter;
+
+    uint64_t baseline;
+    uint32_t baselineTime;
+    uint32_t baselineAgeMs;
+    bool latched;
+    bool pending;           // Latched before any count was known
+    bool baselineLate;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include <Arduino.h>
+#include "TelemetryReceiver.h"
+
+TelemetryReceiver::TelemetryReceiver(uint16_t port)
+    : port(port), started(false), receivedCount(0), malformedCount(0), replayedCount(0), lastReportTime(0),
+      nextEventSequence(1), sessionEventsSent(0), sessionEventsAcked(0), lastSessionAckMs(0),
+      arrivalMicros(0), reportCallback(nullptr) {
+    sessionLock = portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < TELEMETRY_MAX_UNITS; i++) {
+        units[i].port = 0;
+        units[i].known = false;
+        units[i].unacked = false;
+        units[i].tries = 0;
+        units[i].queuedTime = 0;
+        units[i].lastSent = 0;
+        units[i].hasRequest = false;
+    }
+}
+
+bool TelemetryReceiver::begin() {
+    started = udp.begin(port);
+    if (started) {
+        Serial.printf("UDP telemetry listener started on port %u\n", port);
+    } else {
+        Serial.println("Failed to start UDP telemetry listener");
+    }
+    return started;
+}
+
+void TelemetryReceiver::setReportCallback(void (*callback)(const TelemetryReport&)) {
+    reportCallback = callback;
+}
+
+void TelemetryReceiver::notifySession(uint8_t unitId, uint32_t sessionId, uint8_t event, float targetVolume) {
+    if (unitId < 1 || unitId > TELEMETRY_MAX_UNITS) {
+        return;
+    }
+    UnitLink& unit = units[unitId - 1];
+    portENTER_CRITICAL(&sessionLock);
+    unit.requested.unitId = unitId;
+    unit.requested.sessionId = sessionId;
+    unit.requested.event = event;
+    unit.requested.targetVolume = targetVolume;
+    unit.hasRequest = true;
+    portEXIT_CRITICAL(&sessionLock);
+}
+
+int TelemetryReceiver::poll() {
+    if (!started) {
+        return 0;
+    }
+
+    int handled = 0;
+    for (int i = 0; i < TELEMETRY_MAX_PACKETS_PER_POLL; i++) {
+        if (udp.parsePacket() <= 0) {
+            break;
+        }
+        arrivalMicros = micros();
+        int length = udp.read(packet, sizeof(packet));
+        uint8_t type = length > 0 ? telemetryPacketType(packet, length) : 0;
+        if (type == TELEMETRY_TYPE_BATCH) {
+            handleBatch(length);
+            handled++;
+            continue;
+        }
+        if (type == TELEMETRY_TYPE_ACK) {
+            handleAck(length);
+            continue;
+        }
+        TelemetryReport report;
+        if (length <= 0 || !decodeTelemetryReport(packet, length, report)) {
+            malformedCount++;
+            continue;
+        }
+
+        // Ack first so the sender's RTT doesn't include our processing
+        sendAck(report.unitId, 0, report.sequence);
+        rememberSender(report.unitId);
+        receivedCount++;
+        lastReportTime = millis();
+        if (reportCallback) {
+            reportCallback(report);
+        }
+        handled++;
+    }
+    serviceSessions();
+    return handled;
+}
+
+void TelemetryReceiver::rememberSender(uint8_t unitId) {
+    if (unitId < 1 || unitId > TELEMETRY_MAX_UNITS) {
+        return;
+    }
+    UnitLink& unit = units[unitId - 1];
+    unit.address = udp.remoteIP();
+    unit.port = udp.remotePort();
+    unit.known = true;
+}
+
+void TelemetryReceiver::handleAck(int length) {
+    TelemetryAck ack;
+    if (!decodeTelemetryAck(packet, length, ack) || !(ack.flags & TELEMETRY_ACK_FLAG_SESSION) ||
+        ack.unitId < 1 || ack.unitId > TELEMETRY_MAX_UNITS) {
+        malformedCount++;
+        return;
+    }
+    UnitLink& unit = units[ack.unitId - 1];
+    if (unit.unacked && ack.sequence == unit.session.eventSequence) {
+        unit.unacked = false;
+        sessionEventsAcked++;
+        lastSessionAckMs = millis() - unit.queuedTime;
+    }
+}
+
+// Send newly queued session events and repeat unacked ones
+void TelemetryReceiver::serviceSessions() {
+    for (int i = 0; i < TELEMETRY_MAX_UNITS; i++) {
+        UnitLink& unit = units[i];
+        
+        portENTER_CRITICAL(&sessionLock);
+        if (unit.hasRequest) {
+            unit.session = unit.requested;
+            unit.hasRequest = false;
+            unit.session.eventSequence = nextEventSequence++;
+            unit.unacked = true;
+            unit.tries = 0;
+            unit.queuedTime = millis();
+        }
+        portEXIT_CRITICAL(&sessionLock);
+        
+        if (!unit.unacked || !unit.known) {
+            continue;  // Nothing owed, or the unit hasn't reported yet
+        }
+        if (unit.tries > 0 && millis() - unit.lastSent < TELEMETRY_SESSION_RETRY_MS) {
+            continue;
+        }
+        if (unit.tries >= TELEMETRY_SESSION_MAX_TRIES) {
+            Serial.printf("Session event %lu to flow unit %d never acked\n",
+                          (unsigned long)unit.session.eventSequence, i + 1);
+            unit.unacked = false;
+            continue;
+        }
+        
+        uint8_t message[TELEMETRY_SESSION_SIZE];
+        size_t length = encodeTelemetrySession(unit.session, message, sizeof(message));
+        if (udp.beginPacket(unit.address, unit.port)) {
+            udp.write(message, length);
+            udp.endPacket();
+        }
+        unit.tries++;
+        unit.lastSent = millis();
+        sessionEventsSent++;
+    }
+}
+
+void TelemetryReceiver::handleBatch(int length) {
+    TelemetryBatch batch;
+    if (!decodeTelemetryBatch(packet, length, batch)) {
+        malformedCount++;
+        return;
+    }
+    sendAck(batch.unitId, TELEMETRY_ACK_FLAG_BATCH, batch.batchId);
+    rememberSender(batch.unitId);
+    
+    // A lost ack means the same records come again; the tracker behind the
+    // callback drops them as duplicates
+    for (uint8_t i = 0; i < batch.count; i++) {
+        TelemetryRecord record;
+        getTelemetryBatchRecord(packet, i, record);
+        TelemetryReport report;
+        report.unitId = batch.unitId;
+        report.flags = record.flags | TELEMETRY_FLAG_REPLAYED;
+        report.sequence = record.sequence;
+        report.sensorTimeMs = record.sensorTimeMs;
+        report.totalPulses = record.totalPulses;
+        report.flowRate = record.flowRate;
+        report.totalVolume = 0.0f;  // Not carried; volume comes from lifetimePulses
+        report.pulsesPerLiter = record.pulsesPerLiter;
+        report.bootId = batch.bootId;
+        report.lifetimePulses = record.lifetimePulses;
+        replayedCount++;
+        if (reportCallback) {
+            reportCallback(report);
+        }
+    }
+}
+
+void TelemetryReceiver::sendAck(uint8_t unitId, uint8_t flags, uint32_t sequence) {
+    TelemetryAck ack;
+    ack.unitId = unitId;
+    ack.flags = flags;
+    ack.sequence = sequence;
+    uint8_t reply[TELEMETRY_ACK_SIZE];
+    size_t length = encodeTelemetryAck(ack, reply, sizeof(reply));
+    if (udp.beginPacket(udp.remoteIP(), udp.remotePort())) {
+        udp.write(reply, length);
+        udp.endPacket();
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef TELEMETRY_RECEIVER_H
+#define TELEMETRY_RECEIVER_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "TelemetryPacket.h"
+
+#define TELEMETRY_MAX_PACKETS_PER_POLL 8  // Bound the time spent per loop iteration
+#define TELEMETRY_MAX_UNITS 8             // Flow units addressed by unitId 1..N
+#define TELEMETRY_SESSION_RETRY_MS 100    // Resend an unacked session event this often
+#define TELEMETRY_SESSION_MAX_TRIES 50    // Give up after 5 s; the unit resyncs on its next report
+
+// Non-blocking listener for binary flow telemetry. Every valid report is
+// acked to its sender and handed to the report callback. Replay batches
+// are acked once and each record goes to the same callback, oldest first.
+//
+// It also pushes dispensing session events back to each flow unit, to the
+// address and port its reports come from, repeating them until acked.
+// notifySession() may be called from any task; sending happens in poll().
+class TelemetryReceiver {
+public:
+    TelemetryReceiver(uint16_t port = TELEMETRY_UDP_PORT);
+    bool begin();
+    // Drain pending datagrams; returns the number of reports handled
+    int poll();
+
+    void setReportCallback(void (*callback)(const TelemetryReport&));
+    // Queue a session event for a flow unit; replaces one still unacked
+    void notifySession(uint8_t unitId, uint32_t sessionId, uint8_t event, float targetVolume);
+
+    uint32_t getReceivedCount() const { return receivedCount; }
+    uint32_t getMalformedCount() const { return malformedCount; }
+    uint32_t getReplayedCount() const { return replayedCount; }
+    unsigned long getLastReportTime() const { return lastReportTime; }
+    uint32_t getSessionEventsSent() const { return sessionEventsSent; }
+    uint32_t getSessionEventsAcked() const { return sessionEventsAcked; }
+    unsigned long getLastSessionAckMs() const { return lastSessionAckMs; }  // Event queued -> acked
+    // micros() when the datagram now being dispatched was picked up; for
+    // timing what the report callback does with it
+    uint32_t getArrivalMicros() const { return arrivalMicros; }
+
+private:
+    // Where a flow unit lives and the session event it still owes us an ack for
+    struct UnitLink {
+        IPAddress address;
+        uint16_t port;
+        bool known;
+        TelemetrySession session;
+        bool unacked;
+        uint8_t tries;
+        unsigned long queuedTime;
+        unsigned long lastSent;
+        TelemetrySession requested;  // Written by notifySession()
+        bool hasRequest;
+    };
+
+    WiFiUDP udp;
+    uint16_t port;
+    bool started;
+    uint32_t receivedCount;
+    uint32_t malformedCount;
+    uint32_t replayedCount;
+    unsigned long lastReportTime;
+    UnitLink units[TELEMETRY_MAX_UNITS];
+    portMUX_TYPE sessionLock;
+    uint32_t nextEventSequence;
+    uint32_t sessionEventsSent;
+    uint32_t sessionEventsAcked;
+    unsigned long lastSessionAckMs;
+    uint32_t arrivalMicros;
+    uint8_t packet[TELEMETRY_MAX_PACKET];
+    void (*reportCallback)(const TelemetryReport&);
+
+    void sendAck(uint8_t unitId, uint8_t flags, uint32_t sequence);
+    void handleBatch(int length);
+    void handleAck(int length);
+    void rememberSender(uint8_t unitId);
+    void serviceSessions();
+};
+
+#endif
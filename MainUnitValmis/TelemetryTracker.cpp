@@ -0,0 +1,116 @@
+#include "TelemetryTracker.h"
+
+TelemetryTracker::TelemetryTracker() {
+    reset();
+}
+
+void TelemetryTracker::reset() {
+    started = false;
+    bootId = 0;
+    previousBootId = 0;
+    lastSequence = 0;
+    lastLifetimePulses = 0;
+    lastTotalPulses = 0;
+    pulses = 0;
+    volume = 0.0;
+    pulsesPerLiter = 0.0f;
+    haveTransit = false;
+    lastTransitMs = 0;
+    expected = 0;
+    stats.received = 0;
+    stats.duplicates = 0;
+    stats.late = 0;
+    stats.gaps = 0;
+    stats.lost = 0;
+    stats.reboots = 0;
+    stats.localResets = 0;
+    stats.jitterMs = 0.0f;
+}
+
+TelemetryTracker::Verdict TelemetryTracker::accept(const TelemetryReport& report, uint32_t arrivalMs) {
+    stats.received++;
+
+    if (!started) {
+        // Pulses from before we were listening are not ours to count
+        started = true;
+        expected = 1;
+        adopt(report);
+        updateJitter(report, arrivalMs);
+        return FIRST;
+    }
+
+    if (report.bootId != bootId) {
+        if (report.bootId == previousBootId) {
+            // Straggler from before the reboot; its pulses were lost with it
+            stats.late++;
+            return LATE;
+        }
+        // The counter restarted at zero, so everything it holds is new
+        stats.reboots++;
+        previousBootId = bootId;
+        expected++;
+        addPulses(report.lifetimePulses, report.pulsesPerLiter);
+        haveTransit = false;  // Sensor clock restarted too
+        adopt(report);
+        updateJitter(report, arrivalMs);
+        return REBOOTED;
+    }
+
+    int32_t step = (int32_t)(report.sequence - lastSequence);
+    if (step == 0) {
+        stats.duplicates++;
+        return DUPLICATE;
+    }
+    if (step < 0) {
+        // Its pulses are already included in a newer report's counter
+        stats.late++;
+        if (stats.lost > 0) stats.lost--;
+        return LATE;
+    }
+    if (step > 1) {
+        stats.gaps++;
+        stats.lost += step - 1;
+    }
+    expected += step;
+
+    if (report.totalPulses < lastTotalPulses) {
+        stats.localResets++;
+    }
+    addPulses(report.lifetimePulses - lastLifetimePulses, report.pulsesPerLiter);  // Wrap-safe
+    adopt(report);
+    updateJitter(report, arrivalMs);
+    return ACCEPTED;
+}
+
+float TelemetryTracker::lossRatio() const {
+    if (expected == 0) return 0.0f;
+    return (float)stats.lost / (float)expected;
+}
+
+void TelemetryTracker::adopt(const TelemetryReport& report) {
+    bootId = report.bootId;
+    lastSequence = report.sequence;
+    lastLifetimePulses = report.lifetimePulses;
+    lastTotalPulses = report.totalPulses;
+}
+
+void TelemetryTracker::addPulses(uint32_t delta, float reportedPulsesPerLiter) {
+    pulses += delta;
+    if (reportedPulsesPerLiter > 0.0f) {
+        volume += (double)delta / reportedPulsesPerLiter;
+        pulsesPerLiter = reportedPulsesPerLiter;
+    }
+}
+
+// Interarrival jitter as in RFC 3550: variation of (arrival - send) time,
+// which needs no clock sync between the units
+void TelemetryTracker::updateJitter(const TelemetryReport& report, uint32_t arrivalMs) {
+    int32_t transit = (int32_t)(arrivalMs - report.sensorTimeMs);
+    if (haveTransit) {
+        int32_t difference = transit - lastTransitMs;
+        if (difference < 0) difference = -difference;
+        stats.jitterMs += ((float)difference - stats.jitterMs) / TELEMETRY_JITTER_GAIN;
+    }
+    lastTransitMs = transit;
+    haveTransit = true;
+}
@@ -0,0 +1,75 @@
+#ifndef TELEMETRY_TRACKER_H
+#define TELEMETRY_TRACKER_H
+
+#include <stdint.h>
+#include "TelemetryPacket.h"
+
+#define TELEMETRY_JITTER_GAIN 16.0f  // RFC 3550 interarrival jitter smoothing
+
+// Per flow sensor view of the report stream. Volume is derived from the
+// sensor's lifetime pulse counter rather than its totalVolume, so a lost
+// report costs nothing (the next one carries the pulses), a duplicate or
+// late report is ignored, and a reset on the flow unit's screen does not
+// move the dispensing baseline. A new bootId means the sensor restarted
+// and its counter started over from zero.
+//
+// No Arduino dependencies, so it builds on a host as well.
+class TelemetryTracker {
+public:
+    enum Verdict {
+        ACCEPTED,    // Newest report; state advanced
+        FIRST,       // First report seen from this sensor
+        REBOOTED,    // Sensor restarted; counted from its new boot
+        DUPLICATE,   // Same sequence as the newest report
+        LATE         // Older than the newest report (reordered)
+    };
+
+    struct Stats {
+        uint32_t received;
+        uint32_t duplicates;
+        uint32_t late;          // Arrived after a newer report
+        uint32_t gaps;          // Sequence jumps
+        uint32_t lost;          // Sequences skipped and never seen late
+        uint32_t reboots;
+        uint32_t localResets;   // Volume resets done on the flow unit
+        float jitterMs;
+    };
+
+    TelemetryTracker();
+
+    // Feed one report with its arrival time on this unit
+    Verdict accept(const TelemetryReport& report, uint32_t arrivalMs);
+    void reset();
+
+    bool hasData() const { return started; }
+    // Pulses and litres counted since the first report, across sensor reboots
+    uint64_t getPulses() const { return pulses; }
+    float getVolume() const { return (float)volume; }
+    // K-factor of the newest report that carried one
+    float getPulsesPerLiter() const { return pulsesPerLiter; }
+
+    const Stats& getStats() const { return stats; }
+    // Fraction of expected reports that never arrived
+    float lossRatio() const;
+
+private:
+    bool started;
+    uint32_t bootId;
+    uint32_t previousBootId;
+    uint32_t lastSequence;
+    uint32_t lastLifetimePulses;
+    uint32_t lastTotalPulses;
+    uint64_t pulses;
+    double volume;
+    float pulsesPerLiter;
+    bool haveTransit;
+    int32_t lastTransitMs;
+    uint32_t expected;
+    Stats stats;
+
+    void adopt(const TelemetryReport& report);
+    void addPulses(uint32_t delta, float pulsesPerLiter);
+    void updateJitter(const TelemetryReport& report, uint32_t arrivalMs);
+};
+
+#endif
@@ -16,6 +16,7 @@
 #define BUTTON_MARGIN 20
 #define SETTINGS_BTN_SIZE 40
 #define PROGRESS_BAR_HEIGHT 20
+#define QUEUE_REFRESH_MS 1000
 
 // Wrench icon (16x16 pixels)
 const uint8_t wrenchIcon[] = {
@@ -36,8 +37,9 @@ const uint8_t wrenchIcon[] = {
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 };
 
-TouchController::TouchController(Flashlight* flash, RelayController* relay) 
-    : flashlight(flash), relayController(relay) {
+TouchController::TouchController(Flashlight* flash, RelayController* relay, DispenseScheduler* scheduler,
+                                 DispensingController* dispensing)
+    : flashlight(flash), relayController(relay), dispenseScheduler(scheduler), dispensingController(dispensing) {
     // Calculate button positions for main UI
     int centerX = M5.Lcd.width() / 2;
     int centerY = M5.Lcd.height() / 2;
@@ -83,6 +85,12 @@ void TouchController::update() {
     handleTouch();
 }
 
+void TouchController::updateQueueStatus() {
+    if (!inSettings && millis() - lastQueueDraw >= QUEUE_REFRESH_MS) {
+        drawQueueStatus();
+    }
+}
+
 void TouchController::drawUI(bool pirState) {
     if (inSettings) {
         drawSettingsUI(pirState);
@@ -96,13 +104,13 @@ void TouchController::drawMainUI(bool pirState) {
     
     // Draw relay buttons
     M5.Lcd.fillRect(relay1Btn.x, relay1Btn.y, relay1Btn.w, relay1Btn.h, 
-                   relayController->getRelay1() ? GREEN : RED);
+                   isTapRunning(1) ? GREEN : RED);
     M5.Lcd.setCursor(relay1Btn.x + 20, relay1Btn.y + 25);
     M5.Lcd.setTextSize(2);
     M5.Lcd.print("Jook 1");
     
     M5.Lcd.fillRect(relay2Btn.x, relay2Btn.y, relay2Btn.w, relay2Btn.h, 
-                   relayController->getRelay2() ? GREEN : RED);
+                   isTapRunning(2) ? GREEN : RED);
     M5.Lcd.setCursor(relay2Btn.x + 20, relay2Btn.y + 25);
     M5.Lcd.print("Jook 2");
     
@@ -111,6 +119,73 @@ void TouchController::drawMainUI(bool pirState) {
     M5.Lcd.setCursor(settingsBtn.x + 10, settingsBtn.y + 15);
     M5.Lcd.setTextSize(1);
     M5.Lcd.print("SET");
+    
+    drawQueueStatus();
+}
+
+// Queue depth and wait under each tap button, throughput top left
+void TouchController::drawQueueStatus() {
+    lastQueueDraw = millis();
+    if (!dispenseScheduler) return;
+    
+    int top = relay1Btn.y + relay1Btn.h + 8;
+    M5.Lcd.fillRect(0, top, M5.Lcd.width(), 24, BLACK);
+    M5.Lcd.fillRect(BUTTON_MARGIN, BUTTON_MARGIN, 180, 10, BLACK);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setTextColor(WHITE);
+    M5.Lcd.setCursor(BUTTON_MARGIN, BUTTON_MARGIN);
+    M5.Lcd.printf("%.0f drinks/h, %lu served", dispenseScheduler->getDrinksPerHour(),
+                  (unsigned long)dispenseScheduler->getTotalCompleted());
+    
+    const Rect_t* buttons[] = {&relay1Btn, &relay2Btn};
+    for (int pumpId = 1; pumpId <= 2; pumpId++) {
+        const Rect_t& button = *buttons[pumpId - 1];
+        PumpQueueState state = dispenseScheduler->getState(pumpId);
+        M5.Lcd.setCursor(button.x, top);
+        M5.Lcd.setTextColor(WHITE);
+        M5.Lcd.printf("Queue %d, wait %lus", dispenseScheduler->getQueueDepth(pumpId),
+                      (unsigned long)(dispenseScheduler->getOldestWaitMs(pumpId) / 1000));
+        M5.Lcd.setCursor(button.x, top + 12);
+        if (state == QUEUE_AWAIT_CONFIRM) {
+            M5.Lcd.setTextColor(GREEN);
+            M5.Lcd.print("Tap for next cup");
+        } else if (state == QUEUE_HELD) {
+            M5.Lcd.setTextColor(RED);
+            M5.Lcd.print("Held after error");
+        } else if (state == QUEUE_DWELL) {
+            M5.Lcd.printf("Next cup in %lus", (unsigned long)((dispenseScheduler->getDwellRemainingMs(pumpId) + 999) / 1000));
+        }
+    }
+    M5.Lcd.setTextColor(WHITE);
+}
+
+// A tap on a pump's button while its queue waits for the cup starts the next job
+bool TouchController::confirmQueue(int pumpId) {
+    if (!dispenseScheduler || dispenseScheduler->getQueueDepth(pumpId) == 0) return false;
+    PumpQueueState state = dispenseScheduler->getState(pumpId);
+    if (state != QUEUE_AWAIT_CONFIRM && state != QUEUE_DWELL) return false;
+    return dispenseScheduler->confirm(pumpId);
+}
+
+// Otherwise the tap pours targetVolume, or stops the pour in progress. It
+// goes through the DispensingController, so the pump table picks the relay
+// and the session, the watchdog and the queue all see it.
+void TouchController::toggleTap(int pumpId) {
+    if (!dispensingController || !dispensingController->isValidPumpId(pumpId)) return;
+    
+    if (hubLock) xSemaphoreTake(hubLock, portMAX_DELAY);
+    if (!confirmQueue(pumpId)) {
+        if (isTapRunning(pumpId) || dispensingController->isPaused(pumpId)) {
+            dispensingController->stopDispensing(pumpId);
+        } else if (!dispensingController->startDispensing(pumpId, targetVolume)) {
+            Serial.printf("Pump %d: not started from the touch screen\n", pumpId);
+        }
+    }
+    if (hubLock) xSemaphoreGive(hubLock);
+}
+
+bool TouchController::isTapRunning(int pumpId) const {
+    return dispensingController && dispensingController->isDispensing(pumpId);
 }
 
 void TouchController::drawSettingsUI(bool pirState) {
@@ -165,11 +240,11 @@ void TouchController::handleTouch() {
     } else {
         // Handle main screen touches
         if (isTouched(relay1Btn, touch)) {
-            relayController->setRelay1(!relayController->getRelay1());
+            toggleTap(1);
             drawMainUI(false);
         }
         else if (isTouched(relay2Btn, touch)) {
-            relayController->setRelay2(!relayController->getRelay2());
+            toggleTap(2);
             drawMainUI(false);
         }
         else if (isTouched(settingsBtn, touch)) {
@@ -5,6 +5,10 @@
 #include <WiFi.h>
 #include "Flashlight.h"
 #include "RelayController.h"
+#include "DispenseScheduler.h"
+#include "DispensingController.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
 // Define TouchPoint_t if not already defined by M5Core2
 #ifndef TouchPoint_t
@@ -24,14 +28,22 @@ typedef struct {
 
 class TouchController {
 public:
-    TouchController(Flashlight* flash, RelayController* relay);
+    TouchController(Flashlight* flash, RelayController* relay, DispenseScheduler* scheduler = nullptr,
+                    DispensingController* dispensing = nullptr);
     void init();
     void update();
     void drawUI(bool pirState);
+    // Redraw the queue strip on the main screen, at most once a second
+    void updateQueueStatus();
+    // Held around relay writes from a tap, not around the redraws
+    void setHubLock(SemaphoreHandle_t lock) { hubLock = lock; }
 
 private:
     Flashlight* flashlight;
     RelayController* relayController;
+    DispenseScheduler* dispenseScheduler;
+    DispensingController* dispensingController;  // Taps go through it, never straight to a relay
+    SemaphoreHandle_t hubLock = nullptr;
     
     typedef struct {
         int x;
@@ -50,6 +62,7 @@ private:
     unsigned long pourStartTime = 0;
     float targetVolume = 0.25f;  // Target volume in liters (250ml)
     
+    unsigned long lastQueueDraw = 0;
     unsigned long lastButtonPressTime = 0;
     const unsigned long buttonDebounceDelay = 50;
     
@@ -58,6 +71,10 @@ private:
     void drawMainUI(bool pirState);
     void drawSettingsUI(bool pirState);
     void drawProgressBar();
+    void drawQueueStatus();
+    bool confirmQueue(int pumpId);
+    void toggleTap(int pumpId);
+    bool isTapRunning(int pumpId) const;
     void startPouring();
     void stopPouring();
 };
@@ -47,61 +47,28 @@ body{font-family:Arial;text-align:center;margin:20px;background:#f0f0f0}
 </div>
 <div class="section">
 <h3>Device Control</h3>
-<button class="button" onclick="toggleDevice('relay1')">Jook 1</button>
-<button class="button" onclick="toggleDevice('relay2')">Jook 2</button>
+<span id="relayButtons"></span>
 <button class="button" onclick="toggleDevice('flashlight')">Flashlight</button>
 </div>
 <div class="section">
 <h3>Volume Dispensing System</h3>
 <div style="display:flex;gap:20px;flex-wrap:wrap;justify-content:center">
-<div class="pump-container" style="flex:1;min-width:300px;max-width:400px">
-<h4 class="pump-title">Jook 1</h4>
-<input type="number" id="volume1" class="volume-input" placeholder="Volume (L)" step="0.01" min="0.01" max="10" value="0.5">
-<div style="display:flex;gap:8px;margin:10px 0">
-<button class="button preset" onclick="setVolume(1,0.25)" style="flex:1">250ml</button>
-<button class="button preset" onclick="setVolume(1,0.5)" style="flex:1">500ml</button>
-<button class="button preset" onclick="setVolume(1,1.0)" style="flex:1">1L</button>
-<button class="button preset" onclick="setVolume(1,2.0)" style="flex:1">2L</button>
-</div>
-<div class="progress-container">
-<div id="progress1" class="progress-bar" style="width:0%">
-<span id="progressText1" style="position:absolute;width:100%;text-align:center;line-height:25px;color:white;font-weight:bold;text-shadow:1px 1px 2px rgba(0,0,0,0.5)"></span>
+<div id="pumps" style="display:contents"></div>
 </div>
+<div id="throughput" style="font-size:14px;color:#333;margin-top:15px"></div>
+<div style="text-align:center;margin-top:20px">
+<button class="button stop" onclick="emergencyStop()" style="background:#d32f2f;font-size:16px;padding:12px 24px">EMERGENCY STOP ALL</button>
 </div>
-<div id="status1" class="status-text">Ready: 0.000L / 0.000L</div>
-<div style="display:flex;gap:8px;margin-top:15px">
-<button class="button" onclick="startDispensing(1)" id="start1" style="flex:2">Start Dispensing</button>
-<button class="button stop" onclick="stopDispensing(1)" id="stop1" style="flex:1">Stop</button>
-<button class="button" onclick="pauseDispensing(1)" id="pause1" style="flex:1;background:#FF9800">Pause</button>
-</div>
-<div id="eta1" style="font-size:12px;color:#666;margin-top:8px;text-align:center"></div>
 </div>
-<div class="pump-container" style="flex:1;min-width:300px;max-width:400px">
-<h4 class="pump-title">Jook 2</h4>
-<input type="number" id="volume2" class="volume-input" placeholder="Volume (L)" step="0.01" min="0.01" max="10" value="0.5">
+<div class="section">
+<h3>Recipes</h3>
+<select id="recipe" class="volume-input"></select>
 <div style="display:flex;gap:8px;margin:10px 0">
-<button class="button preset" onclick="setVolume(2,0.25)" style="flex:1">250ml</button>
-<button class="button preset" onclick="setVolume(2,0.5)" style="flex:1">500ml</button>
-<button class="button preset" onclick="setVolume(2,1.0)" style="flex:1">1L</button>
-<button class="button preset" onclick="setVolume(2,2.0)" style="flex:1">2L</button>
-</div>
-<div class="progress-container">
-<div id="progress2" class="progress-bar" style="width:0%">
-<span id="progressText2" style="position:absolute;width:100%;text-align:center;line-height:25px;color:white;font-weight:bold;text-shadow:1px 1px 2px rgba(0,0,0,0.5)"></span>
-</div>
-</div>
-<div id="status2" class="status-text">Ready: 0.000L / 0.000L</div>
-<div style="display:flex;gap:8px;margin-top:15px">
-<button class="button" onclick="startDispensing(2)" id="start2" style="flex:2">Start Dispensing</button>
-<button class="button stop" onclick="stopDispensing(2)" id="stop2" style="flex:1">Stop</button>
-<button class="button" onclick="pauseDispensing(2)" id="pause2" style="flex:1;background:#FF9800">Pause</button>
-</div>
-<div id="eta2" style="font-size:12px;color:#666;margin-top:8px;text-align:center"></div>
-</div>
-</div>
-<div style="text-align:center;margin-top:20px">
-<button class="button stop" onclick="emergencyStop()" style="background:#d32f2f;font-size:16px;padding:12px 24px">EMERGENCY STOP ALL</button>
+<button class="button" onclick="startRecipe()" style="flex:2">Pour Recipe</button>
+<button class="button stop" onclick="abortRecipe()" style="flex:1">Abort</button>
 </div>
+<div class="progress-container"><div id="recipeProgress" class="progress-bar" style="width:0%"></div></div>
+<div id="recipeStatus" class="status-text">No order</div>
 </div>
 <div class="section">
 <h3>PIR Sensor</h3>
@@ -110,24 +77,7 @@ body{font-family:Arial;text-align:center;margin:20px;background:#f0f0f0}
 <div class="section">
 <h3>Flow Sensors</h3>
 <div style="display:flex;gap:20px;flex-wrap:wrap;justify-content:center">
-<div class="pump-container" style="flex:1;min-width:300px;max-width:400px">
-<h4 class="pump-title">Flow Sensor 1</h4>
-<div class="status" id="flowStatus">
-<div>Flow Rate: <span id="flowRate">0.00</span> L/min</div>
-<div>Total Volume: <span id="totalVolume">0.00</span> L</div>
-<div>Pulse Count: <span id="pulseCount">0</span></div>
-</div>
-<button class="button" onclick="resetFlow()">Reset Volume</button>
-</div>
-<div class="pump-container" style="flex:1;min-width:300px;max-width:400px">
-<h4 class="pump-title">Flow Sensor 2</h4>
-<div class="status" id="flow2Status">
-<div>Flow Rate: <span id="flow2Rate">0.00</span> L/min</div>
-<div>Total Volume: <span id="flow2TotalVolume">0.00</span> L</div>
-<div>Pulse Count: <span id="flow2PulseCount">0</span></div>
-</div>
-<button class="button" onclick="resetFlow2()">Reset Volume</button>
-</div>
+<div id="sensors" style="display:contents"></div>
 </div>
 </div>
 </div>
@@ -140,27 +90,120 @@ fetch('/pir').then(r=>r.text()).then(s=>{
 document.getElementById('pirValue').textContent=s;
 document.getElementById('pirStatus').className='status '+(s==='ACTIVE'?'active':'inactive');
 });
-fetch('/flow').then(r=>r.json()).then(d=>{
-document.getElementById('flowRate').textContent=d.flowRate.toFixed(2);
-document.getElementById('totalVolume').textContent=d.totalVolume.toFixed(2);
-document.getElementById('pulseCount').textContent=d.pulseCount||0;
-document.getElementById('flowStatus').className='status '+(d.error?'inactive':'active');
+fetch('/flows').then(r=>r.json()).then(list=>{
+var box=document.getElementById('sensors');
+if(box.children.length!==list.length)box.innerHTML=list.map(d=>sensorPanel(d.sensor)).join('');
+list.forEach(d=>{
+var n=d.sensor;
+document.getElementById('flowRate'+n).textContent=d.flowRate.toFixed(2);
+document.getElementById('totalVolume'+n).textContent=d.totalVolume.toFixed(2);
+document.getElementById('pulseCount'+n).textContent=d.pulseCount||0;
+document.getElementById('flowStatus'+n).className='status '+(d.error?'inactive':'active');
+});
 });
-fetch('/flow2').then(r=>r.json()).then(d=>{
-document.getElementById('flow2Rate').textContent=d.flowRate.toFixed(2);
-document.getElementById('flow2TotalVolume').textContent=d.totalVolume.toFixed(2);
-document.getElementById('flow2PulseCount').textContent=d.pulseCount||0;
-document.getElementById('flow2Status').className='status '+(d.error?'inactive':'active');
+}
+function sensorPanel(n){
+return '<div class="pump-container" style="flex:1;min-width:300px;max-width:400px"><h4 class="pump-title">Flow Sensor '+n+'</h4>'+
+'<div class="status" id="flowStatus'+n+'"><div>Flow Rate: <span id="flowRate'+n+'">0.00</span> L/min</div>'+
+'<div>Total Volume: <span id="totalVolume'+n+'">0.00</span> L</div><div>Pulse Count: <span id="pulseCount'+n+'">0</span></div></div>'+
+'<button class="button" onclick="resetFlow('+n+')">Reset Volume</button></div>';
+}
+function pumpPanel(p){
+var presets=[[0.25,'250ml'],[0.5,'500ml'],[1.0,'1L'],[2.0,'2L']].map(v=>'<button class="button preset" onclick="setVolume('+p+','+v[0]+')" style="flex:1">'+v[1]+'</button>').join('');
+return '<div class="pump-container" style="flex:1;min-width:300px;max-width:400px"><h4 class="pump-title">Jook '+p+'</h4>'+
+'<input type="number" id="volume'+p+'" class="volume-input" placeholder="Volume (L)" step="0.01" min="0.01" max="10" value="0.5">'+
+'<div style="display:flex;gap:8px;margin:10px 0">'+presets+'</div>'+
+'<div class="progress-container"><div id="progress'+p+'" class="progress-bar" style="width:0%">'+
+'<span id="progressText'+p+'" style="position:absolute;width:100%;text-align:center;line-height:25px;color:white;font-weight:bold;text-shadow:1px 1px 2px rgba(0,0,0,0.5)"></span></div></div>'+
+'<div id="status'+p+'" class="status-text">Ready: 0.000L / 0.000L</div>'+
+'<div style="display:flex;gap:8px;margin-top:15px">'+
+'<button class="button" onclick="startDispensing('+p+')" id="start'+p+'" style="flex:2">Start Dispensing</button>'+
+'<button class="button stop" onclick="stopDispensing('+p+')" id="stop'+p+'" style="flex:1">Stop</button>'+
+'<button class="button" onclick="pauseDispensing('+p+')" id="pause'+p+'" style="flex:1;background:#FF9800">Pause</button></div>'+
+'<div style="display:flex;gap:8px;margin-top:8px">'+
+'<button class="button preset" onclick="queueOrder('+p+')" style="flex:2">Add to Queue</button>'+
+'<button class="button preset" onclick="confirmCup('+p+')" id="confirm'+p+'" style="flex:1" disabled>Next Cup</button></div>'+
+'<div id="queue'+p+'" style="font-size:12px;color:#666;margin-top:4px;text-align:center"></div>'+
+'<div id="eta'+p+'" style="font-size:12px;color:#666;margin-top:8px;text-align:center"></div></div>';
+}
+function buildPumps(data){
+var panels='',buttons='';
+for(let p=1;p<=data.pumpCount;p++){
+panels+=pumpPanel(p);
+buttons+='<button class="button" onclick="toggleDevice(\'relay'+data['pump'+p].relay+'\')">Jook '+p+'</button>';
+}
+document.getElementById('pumps').innerHTML=panels;
+document.getElementById('relayButtons').innerHTML=buttons;
+}
+function queueOrder(pump){
+var volume=parseFloat(document.getElementById('volume'+pump).value);
+var formData=new FormData();
+formData.append('pump',pump);
+formData.append('volume',volume);
+fetch('/queue/add',{method:'POST',body:formData}).then(r=>r.ok?r.json():r.text().then(t=>{throw t;})).then(d=>{
+showNotification('Queued '+volume+'L on Jook '+pump,'success');
+updateQueueStatus();
+}).catch(err=>showNotification('Not queued: '+err,'error'));
+}
+function confirmCup(pump){
+var formData=new FormData();
+formData.append('pump',pump);
+fetch('/queue/confirm',{method:'POST',body:formData}).then(()=>updateQueueStatus());
+}
+function updateQueueStatus(){
+fetch('/queue/status').then(r=>r.json()).then(data=>{
+document.getElementById('throughput').textContent='Throughput: '+data.drinksPerHour.toFixed(0)+' drinks/h, '+data.completed+' served';
+for(let pump=1;data['pump'+pump];pump++){
+var q=data['pump'+pump];
+var line=document.getElementById('queue'+pump);
+if(!line)continue;
+var text=q.depth+' waiting';
+if(q.depth>0)text+=', oldest '+formatTime(q.oldestWaitMs/1000);
+if(q.completed>0)text+=', mean wait '+formatTime(q.meanWaitMs/1000);
+if(q.state==='dwell')text+=' - next cup in '+formatTime(q.dwellRemainingMs/1000);
+if(q.state==='awaitConfirm')text+=' - waiting for next cup';
+if(q.state==='held')text+=' - held after an error';
+line.textContent='Queue: '+text;
+document.getElementById('confirm'+pump).disabled=!(q.depth>0&&(q.state==='awaitConfirm'||q.state==='dwell'));
+}
+}).catch(err=>{});
+}
+function loadRecipes(){
+fetch('/recipes').then(r=>r.json()).then(list=>{
+document.getElementById('recipe').innerHTML=list.map(r=>'<option value="'+r.name+'">'+r.name+' ('+
+r.components.map(c=>'Jook '+c.pump+' '+(c.volume*1000).toFixed(0)+'ml').join(', ')+')</option>').join('');
+}).catch(err=>{});
+}
+function startRecipe(){
+var formData=new FormData();
+formData.append('name',document.getElementById('recipe').value);
+fetch('/recipe/start',{method:'POST',body:formData}).then(r=>r.text()).then(result=>{
+if(result==='OK'){playSound('start');}else{showNotification('Not started: '+result,'error');playSound('error');}
+updateRecipeStatus();
 });
 }
+function abortRecipe(){
+fetch('/recipe/abort',{method:'POST'}).then(()=>updateRecipeStatus());
+}
+function updateRecipeStatus(){
+fetch('/recipe/status').then(r=>r.json()).then(d=>{
+var bar=document.getElementById('recipeProgress');
+var status=document.getElementById('recipeStatus');
+if(d.state==='none'){status.textContent='No order';return;}
+bar.style.width=Math.round(d.progress*100)+'%';
+bar.className='progress-bar'+(d.state==='completed'?' completed':d.state==='aborted'?' error':'');
+var text=d.recipe+': '+d.state+', '+d.volume.toFixed(3)+'L in '+formatTime(d.elapsedMs/1000);
+if(d.state==='completed')text+=' (one after another: '+formatTime(d.lastSumSeconds)+')';
+if(d.state==='aborted')text+=' - '+d.message;
+status.textContent=text;
+status.className='status-text '+(d.state==='running'?'dispensing':d.state==='completed'?'completed':'error');
+}).catch(err=>{});
+}
 function toggleDevice(device){
 fetch('/toggle?device='+device).then(r=>r.text()).then(result=>alert(result));
 }
-function resetFlow(){
-fetch('/flow/reset').then(r=>r.text()).then(result=>alert('Success: '+result));
-}
-function resetFlow2(){
-fetch('/flow2/reset').then(r=>r.text()).then(result=>alert('Success: '+result));
+function resetFlow(n){
+fetch((n===1?'/flow':'/flow'+n)+'/reset',{method:'POST'}).then(r=>r.text()).then(result=>alert('Success: '+result));
 }
 function setVolume(pump,volume){
 document.getElementById('volume'+pump).value=volume;
@@ -211,7 +254,8 @@ playSound('error');
 function stopDispensing(pump){
 var formData=new FormData();
 formData.append('pump',pump);
-fetch('/dispense/stop',{method:'POST',body:formData})
+var clear=document.getElementById('stop'+pump).textContent==='Clear Error';
+fetch(clear?'/dispense/clear':'/dispense/stop',{method:'POST',body:formData})
 .then(r=>r.text()).then(result=>{
 document.getElementById('start'+pump).disabled=false;
 updateDispensingStatus();
@@ -242,7 +286,8 @@ return mins+'m '+secs+'s';
 }
 function updateDispensingStatus(){
 fetch('/dispense/status').then(r=>r.json()).then(data=>{
-for(let pump=1;pump<=2;pump++){
+if(document.getElementById('pumps').children.length!==data.pumpCount)buildPumps(data);
+for(let pump=1;pump<=data.pumpCount;pump++){
 var pumpData=data['pump'+pump];
 if(pumpData){
 var progress=Math.round(pumpData.progress*100);
@@ -259,6 +304,7 @@ progressBar.style.width=progress+'%';
 progressText.textContent=progress+'%';
 var statusText='Ready';
 var statusClass='';
+stopBtn.textContent='Stop';
 if(pumpData.isDispensing){
 statusText='Dispensing';
 statusClass='dispensing';
@@ -298,7 +344,8 @@ progressBar.className='progress-bar error';
 startBtn.disabled=false;
 startBtn.textContent='Start Dispensing';
 pauseBtn.disabled=true;
-stopBtn.disabled=true;
+stopBtn.disabled=false;
+stopBtn.textContent='Clear Error';
 }else{
 startBtn.disabled=false;
 startBtn.textContent='Start Dispensing';
@@ -319,44 +366,114 @@ etaDiv.textContent='';
 console.error('Status update failed:',err);
 });
 }
-setInterval(updateStatus,10000);setInterval(updateDispensingStatus,200);updateStatus();updateDispensingStatus();
+setInterval(updateStatus,10000);setInterval(updateDispensingStatus,200);setInterval(updateQueueStatus,1000);setInterval(updateRecipeStatus,500);loadRecipes();updateStatus();updateDispensingStatus();
 </script></body></html>
 )rawliteral";
 
-WebServerManager::WebServerManager(PIRSensor* pir, RelayController* relay, Flashlight* flashlight, DispensingController* dispensing)
-    : server(80), pirSensor(pir), relayController(relay), flashlightController(flashlight), dispensingController(dispensing), wifiMultiPtr(nullptr), flowRate(0), totalVolume(0), flowError(false), pulseCount(0), flow2Rate(0), flow2TotalVolume(0), flow2Error(false), flow2PulseCount(0), flowDataCallback(nullptr), flow2DataCallback(nullptr) {
+WebServerManager::WebServerManager(PIRSensor* pir, RelayController* relay, Flashlight* flashlight, DispensingController* dispensing,
+                                   DispenseScheduler* scheduler, RecipeEngine* recipes)
+    : server(80), telemetryServer(this), pirSensor(pir), relayController(relay), flashlightController(flashlight), dispensingController(dispensing), dispenseScheduler(scheduler), recipeEngine(recipes), safetyWatchdog(nullptr), wifiMultiPtr(nullptr), hubLock(nullptr), sensorDataCallback(nullptr), flowReportCallback(nullptr) {
+    memset(flows, 0, sizeof(flows));
 }
 
-void WebServerManager::updateFlowData(float newFlowRate, float newTotalVolume, bool newError, long newPulseCount) {
-    flowRate = newFlowRate;
-    totalVolume = newTotalVolume;
-    flowError = newError;
-    pulseCount = newPulseCount;
+void WebServerManager::updateSensorData(int sensor, float newFlowRate, float newTotalVolume, bool newError, long newPulseCount) {
+    if (!isValidSensor(sensor)) return;
+    
+    FlowReading& flow = flows[sensor - 1];
+    flow.flowRate = newFlowRate;
+    flow.totalVolume = newTotalVolume;
+    flow.error = newError;
+    flow.pulseCount = newPulseCount;
     
     // Call external callback if set
-    if (flowDataCallback) {
-        flowDataCallback(flowRate, totalVolume, flowError);
+    if (sensorDataCallback) {
+        sensorDataCallback(sensor, newFlowRate, newTotalVolume, newError);
     }
 }
 
-void WebServerManager::setFlowDataCallback(void (*callback)(float, float, bool)) {
-    flowDataCallback = callback;
+void WebServerManager::setSensorDataCallback(void (*callback)(int, float, float, bool)) {
+    sensorDataCallback = callback;
+}
+
+// Sensor 1 keeps the original "/flow" routes, the others are "/flowN"
+static String sensorPath(int sensor) {
+    return sensor == 1 ? String("/flow") : "/flow" + String(sensor);
 }
 
-void WebServerManager::updateFlow2Data(float newFlowRate, float newTotalVolume, bool newError, long newPulseCount) {
-    flow2Rate = newFlowRate;
-    flow2TotalVolume = newTotalVolume;
-    flow2Error = newError;
-    flow2PulseCount = newPulseCount;
+// Millisecond setting stored in 16 bits. Leaves the value alone when the
+// parameter is missing; false when it is given but doesn't fit.
+static bool readMsParam(AsyncWebServerRequest *request, const char* name, uint16_t& value) {
+    if (!request->hasParam(name, true)) {
+        return true;
+    }
+    long ms = request->getParam(name, true)->value().toInt();
+    if (ms < 0 || ms > UINT16_MAX) {
+        return false;
+    }
+    value = (uint16_t)ms;
+    return true;
+}
+
+// Parse a flow unit's JSON report and apply it to the sensor it came in for;
+// a "unit" field in the body names the sensor explicitly
+bool WebServerManager::applyFlowJson(int sensor, const char* json, size_t length) {
+    StaticJsonDocument<384> doc;
+    if (deserializeJson(doc, json, length)) {
+        return false;
+    }
+    int unit = doc["unit"] | sensor;
+    if (!isValidSensor(unit)) {
+        return false;
+    }
     
-    // Call external callback if set
-    if (flow2DataCallback) {
-        flow2DataCallback(flow2Rate, flow2TotalVolume, flow2Error);
+    // Sequenced report from a current flow unit: same path as UDP telemetry
+    if (flowReportCallback && doc.containsKey("bootId")) {
+        TelemetryReport report;
+        report.unitId = unit;
+        report.flags = (doc["error"] | false) ? TELEMETRY_FLAG_ERROR : 0;
+        report.sequence = doc["seq"] | 0UL;
+        report.sensorTimeMs = doc["time"] | 0UL;
+        report.totalPulses = doc["pulseCount"] | 0UL;
+        report.flowRate = doc["flowRate"] | 0.0f;
+        report.totalVolume = doc["totalVolume"] | 0.0f;
+        report.pulsesPerLiter = doc["ppl"] | 0.0f;
+        report.bootId = doc["bootId"] | 0UL;
+        report.lifetimePulses = doc["pulses"] | 0UL;
+        flowReportCallback(report);
+        return true;
     }
+    
+    float newFlowRate = doc["flowRate"] | 0.0f;
+    float newTotalVolume = doc["totalVolume"] | 0.0f;
+    bool newError = doc["error"] | false;
+    long newPulseCount = doc["pulseCount"] | 0;
+    
+    updateSensorData(unit, newFlowRate, newTotalVolume, newError, newPulseCount);
+    return true;
 }
 
-void WebServerManager::setFlow2DataCallback(void (*callback)(float, float, bool)) {
-    flow2DataCallback = callback;
+// Report from the keep-alive telemetry listener; returns the HTTP status
+int WebServerManager::handleFlowReport(const char* path, const char* json, size_t length) {
+    // "/flow/update" for sensor 1, "/flowN/update" for sensor N
+    if (strncmp(path, "/flow", 5) != 0) {
+        return 404;
+    }
+    const char* rest = path + 5;
+    int sensor = 1;
+    if (isdigit((unsigned char)*rest)) {
+        sensor = 0;
+        while (isdigit((unsigned char)*rest)) {
+            sensor = sensor * 10 + (*rest++ - '0');
+        }
+    }
+    if (strcmp(rest, "/update") != 0 || !isValidSensor(sensor)) {
+        return 404;
+    }
+    return applyFlowJson(sensor, json, length) ? 200 : 400;
+}
+
+void WebServerManager::setFlowReportCallback(void (*callback)(const TelemetryReport&)) {
+    flowReportCallback = callback;
 }
 
 void WebServerManager::updatePIRStatus(bool isTriggered) {
@@ -368,6 +485,7 @@ void WebServerManager::updatePIRStatus(bool isTriggered) {
 void WebServerManager::begin() {
     setupRoutes();
     server.begin();
+    telemetryServer.begin();
 }
 
 void WebServerManager::update() {
@@ -407,41 +525,12 @@ bool WebServerManager::connectToNetwork(String ssid, String password) {
     return WiFi.status() == WL_CONNECTED;
 }
 
-void WebServerManager::setupRoutes() {
-    // Serve the main page with chunked response to prevent memory issues
-    server.on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        // Check available memory before serving large HTML
-        size_t freeHeap = ESP.getFreeHeap();
-        if (freeHeap < 15000) { // Less than 15KB free
-            request->send(503, "text/plain", "Service temporarily unavailable - low memory");
-            return;
-        }
-        
-        AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", index_html);
-        response->addHeader("Cache-Control", "no-cache");
-        request->send(response);
-    });
-
-    // PIR sensor status endpoint
-    server.on("/pir", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        request->send(200, "text/plain", pirSensor->isTriggered() ? "ACTIVE" : "INACTIVE");
-    });
-
-    // Flow sensor data endpoint
-    server.on("/flow", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        StaticJsonDocument<250> doc;
-        doc["flowRate"] = flowRate;
-        doc["totalVolume"] = totalVolume;
-        doc["error"] = flowError;
-        doc["pulseCount"] = pulseCount;
-        
-        String response;
-        serializeJson(doc, response);
-        request->send(200, "application/json", response);
-    });
+// Subroutes go in before the base route: "/flow" also matches "/flow/..."
+void WebServerManager::setupSensorRoutes(int sensor) {
+    String base = sensorPath(sensor);
 
-    // Flow sensor update endpoint for receiving data from YF-S402 unit
-    server.on("/flow/update", HTTP_ANY, [this](AsyncWebServerRequest *request) {
+    // Flow sensor update endpoint for receiving data from a YF-S402 unit
+    server.on((base + "/update").c_str(), HTTP_ANY, [this, sensor](AsyncWebServerRequest *request) {
         if (request->method() == HTTP_GET) {
             if (request->hasParam("flowRate") && request->hasParam("totalVolume") && request->hasParam("error")) {
                 float newFlowRate = request->getParam("flowRate")->value().toFloat();
@@ -449,7 +538,7 @@ void WebServerManager::setupRoutes() {
                 bool newError = request->getParam("error")->value() == "true";
                 long newPulseCount = request->hasParam("pulseCount") ? request->getParam("pulseCount")->value().toInt() : 0;
                 
-                updateFlowData(newFlowRate, newTotalVolume, newError, newPulseCount);
+                updateSensorData(sensor, newFlowRate, newTotalVolume, newError, newPulseCount);
                 request->send(200, "text/plain", "OK");
             } else {
                 request->send(400, "text/plain", "Missing parameters");
@@ -459,52 +548,48 @@ void WebServerManager::setupRoutes() {
         } else {
             request->send(405, "text/plain", "Method not allowed");
         }
-    }, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    }, NULL, [this, sensor](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
         // Handle POST body data for JSON flow updates
         if (request->method() != HTTP_POST) return;
         
-        if (index + len == total && total > 0) {
-            char* jsonStr = new char[total + 1];
-            memcpy(jsonStr, data, len);
-            jsonStr[total] = '\0';
-            
-            StaticJsonDocument<512> doc;
-            DeserializationError error = deserializeJson(doc, jsonStr);
-            
-            if (!error) {
-                float newFlowRate = doc["flowRate"] | 0.0f;
-                float newTotalVolume = doc["totalVolume"] | 0.0f;
-                bool newError = doc["error"] | false;
-                long newPulseCount = doc["pulseCount"] | 0;
-                
-                updateFlowData(newFlowRate, newTotalVolume, newError, newPulseCount);
+        // Flow reports are well under one TCP segment, so the body arrives in one piece
+        if (index == 0 && len == total && total > 0) {
+            if (applyFlowJson(sensor, (const char*)data, len)) {
                 request->send(200, "text/plain", "OK");
             } else {
                 request->send(400, "text/plain", "JSON parse error");
             }
-            
-            delete[] jsonStr;
+        } else if (index + len == total) {
+            request->send(413, "text/plain", "Body too large");
         }
     });
 
     // Flow test endpoint for connectivity testing
-    server.on("/flow/test", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    server.on((base + "/test").c_str(), HTTP_GET, [](AsyncWebServerRequest *request) {
         request->send(200, "text/plain", "Flow endpoint is working");
     });
 
-    // Flow sensor dispensing status endpoint - tells flow sensor 1 if pump 1 is dispensing
-    server.on("/flow/dispensing", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    // Dispensing status for the sensor - tells it whether the pump it meters is running
+    server.on((base + "/dispensing").c_str(), HTTP_GET, [this, sensor](AsyncWebServerRequest *request) {
         StaticJsonDocument<200> doc;
         bool isDispensing = false;
         float targetVolume = 0.0f;
+        int activePump = 0;
         
         if (dispensingController) {
-            isDispensing = dispensingController->isDispensing(1);  // Check pump 1 for flow sensor 1
-            targetVolume = dispensingController->getTargetVolume(1);
+            for (int pumpId = 1; pumpId <= dispensingController->getPumpCount(); pumpId++) {
+                if (dispensingController->getPumpConfig(pumpId).sensorId != sensor) continue;
+                if (activePump == 0 || dispensingController->isDispensing(pumpId)) {
+                    activePump = pumpId;
+                    isDispensing = dispensingController->isDispensing(pumpId);
+                    targetVolume = dispensingController->getTargetVolume(pumpId);
+                }
+                if (isDispensing) break;
+            }
         }
         
         doc["isDispensing"] = isDispensing;
-        doc["activePump"] = 1;
+        doc["activePump"] = activePump;
         doc["targetVolume"] = targetVolume;
         
         String response;
@@ -512,132 +597,97 @@ void WebServerManager::setupRoutes() {
         request->send(200, "application/json", response);
     });
 
-    // Toggle device endpoint
-    server.on("/toggle", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        if (!request->hasParam("device")) {
-            request->send(400, "text/plain", "Missing device parameter");
-            return;
-        }
-
-        String device = request->getParam("device")->value();
-        String response = "Unknown device";
-
-        if (device == "flashlight") {
-            bool newState = !flashlightController->state;
-            flashlightController->state = newState;
-            flashlightController->set(newState);
-            response = newState ? "Flashlight ON" : "Flashlight OFF";
-        }
-        else if (device == "relay1") {
-            bool newState = !relayController->getRelay1();
-            relayController->setRelay1(newState);
-            response = newState ? "Jook 1 ON" : "Jook 1 OFF";
-        }
-        else if (device == "relay2") {
-            bool newState = !relayController->getRelay2();
-            relayController->setRelay2(newState);
-            response = newState ? "Jook 2 ON" : "Jook 2 OFF";
-        }
-
-        request->send(200, "text/plain", response);
-    });
-
     // Reset flow volume endpoint
-    server.on("/flow/reset", HTTP_POST, [this](AsyncWebServerRequest *request) {
-        totalVolume = 0;
+    server.on((base + "/reset").c_str(), HTTP_POST, [this, sensor](AsyncWebServerRequest *request) {
+        flows[sensor - 1].totalVolume = 0;
         request->send(200, "text/plain", "OK");
     });
 
-    // FLOW SENSOR 2 ENDPOINTS
-    // Flow sensor 2 data endpoint
-    server.on("/flow2", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    // Flow sensor data endpoint
+    server.on(base.c_str(), HTTP_GET, [this, sensor](AsyncWebServerRequest *request) {
+        const FlowReading& flow = flows[sensor - 1];
         StaticJsonDocument<250> doc;
-        doc["flowRate"] = flow2Rate;
-        doc["totalVolume"] = flow2TotalVolume;
-        doc["error"] = flow2Error;
-        doc["pulseCount"] = flow2PulseCount;
+        doc["flowRate"] = flow.flowRate;
+        doc["totalVolume"] = flow.totalVolume;
+        doc["error"] = flow.error;
+        doc["pulseCount"] = flow.pulseCount;
         
         String response;
         serializeJson(doc, response);
         request->send(200, "application/json", response);
     });
+}
 
-    // Flow sensor 2 update endpoint for receiving data from YF-S402 unit 2
-    server.on("/flow2/update", HTTP_ANY, [this](AsyncWebServerRequest *request) {
-        if (request->method() == HTTP_GET) {
-            if (request->hasParam("flowRate") && request->hasParam("totalVolume") && request->hasParam("error")) {
-                float newFlowRate = request->getParam("flowRate")->value().toFloat();
-                float newTotalVolume = request->getParam("totalVolume")->value().toFloat();
-                bool newError = request->getParam("error")->value() == "true";
-                long newPulseCount = request->hasParam("pulseCount") ? request->getParam("pulseCount")->value().toInt() : 0;
-                
-                updateFlow2Data(newFlowRate, newTotalVolume, newError, newPulseCount);
-                request->send(200, "text/plain", "OK");
-            } else {
-                request->send(400, "text/plain", "Missing parameters");
-            }
-        } else if (request->method() == HTTP_POST) {
-            // POST body will be handled in the body callback below
-        } else {
-            request->send(405, "text/plain", "Method not allowed");
+void WebServerManager::setupRoutes() {
+    // Serve the main page with chunked response to prevent memory issues
+    server.on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        // Check available memory before serving large HTML
+        size_t freeHeap = ESP.getFreeHeap();
+        if (freeHeap < 15000) { // Less than 15KB free
+            request->send(503, "text/plain", "Service temporarily unavailable - low memory");
+            return;
         }
-    }, NULL, [this](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-        // Handle POST body data for JSON flow2 updates
-        if (request->method() != HTTP_POST) return;
         
-        if (index + len == total && total > 0) {
-            char* jsonStr = new char[total + 1];
-            memcpy(jsonStr, data, len);
-            jsonStr[total] = '\0';
-            
-            StaticJsonDocument<512> doc;
-            DeserializationError error = deserializeJson(doc, jsonStr);
-            
-            if (!error) {
-                float newFlowRate = doc["flowRate"] | 0.0f;
-                float newTotalVolume = doc["totalVolume"] | 0.0f;
-                bool newError = doc["error"] | false;
-                long newPulseCount = doc["pulseCount"] | 0;
-                
-                updateFlow2Data(newFlowRate, newTotalVolume, newError, newPulseCount);
-                request->send(200, "text/plain", "OK");
-            } else {
-                request->send(400, "text/plain", "JSON parse error");
-            }
-            
-            delete[] jsonStr;
-        }
+        AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", index_html);
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
     });
 
-    // Flow 2 test endpoint for connectivity testing
-    server.on("/flow2/test", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        request->send(200, "text/plain", "Flow endpoint is working");
+    // PIR sensor status endpoint
+    server.on("/pir", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        request->send(200, "text/plain", pirSensor->isTriggered() ? "ACTIVE" : "INACTIVE");
     });
 
-    // Flow sensor 2 dispensing status endpoint - tells flow sensor 2 if pump 2 is dispensing
-    server.on("/flow2/dispensing", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        StaticJsonDocument<200> doc;
-        bool isDispensing = false;
-        float targetVolume = 0.0f;
-        
-        if (dispensingController) {
-            isDispensing = dispensingController->isDispensing(2);  // Check pump 2 for flow sensor 2
-            targetVolume = dispensingController->getTargetVolume(2);
+    // Per-sensor endpoints: /flow/... for sensor 1, /flowN/... for the rest
+    for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+        setupSensorRoutes(sensor);
+    }
+
+    // Every flow sensor at once
+    server.on("/flows", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        StaticJsonDocument<JSON_ARRAY_SIZE(TELEMETRY_MAX_UNITS) + TELEMETRY_MAX_UNITS * JSON_OBJECT_SIZE(5)> doc;
+        for (int sensor = 1; sensor <= TELEMETRY_MAX_UNITS; sensor++) {
+            const FlowReading& flow = flows[sensor - 1];
+            JsonObject entry = doc.createNestedObject();
+            entry["sensor"] = sensor;
+            entry["flowRate"] = flow.flowRate;
+            entry["totalVolume"] = flow.totalVolume;
+            entry["error"] = flow.error;
+            entry["pulseCount"] = flow.pulseCount;
         }
         
-        doc["isDispensing"] = isDispensing;
-        doc["activePump"] = 2;
-        doc["targetVolume"] = targetVolume;
-        
         String response;
         serializeJson(doc, response);
         request->send(200, "application/json", response);
     });
 
-    // Reset flow2 volume endpoint
-    server.on("/flow2/reset", HTTP_POST, [this](AsyncWebServerRequest *request) {
-        flow2TotalVolume = 0;
-        request->send(200, "text/plain", "OK");
+    // Toggle device endpoint: "flashlight" or "relayN" for relay output N-1
+    server.on("/toggle", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!request->hasParam("device")) {
+            request->send(400, "text/plain", "Missing device parameter");
+            return;
+        }
+
+        String device = request->getParam("device")->value();
+        String response = "Unknown device";
+
+        HubGuard guard(hubLock);  // Flashlight and relays are both on the PbHub
+        if (device == "flashlight") {
+            bool newState = !flashlightController->state;
+            flashlightController->state = newState;
+            flashlightController->set(newState);
+            response = newState ? "Flashlight ON" : "Flashlight OFF";
+        }
+        else if (device.startsWith("relay")) {
+            int number = device.substring(5).toInt();
+            if (number >= 1 && number <= relayController->getRelayCount()) {
+                bool newState = !relayController->getRelay(number - 1);
+                relayController->setRelay(number - 1, newState);
+                response = "Jook " + String(number) + (newState ? " ON" : " OFF");
+            }
+        }
+
+        request->send(200, "text/plain", response);
     });
 
     // NEW DISPENSING ENDPOINTS - Added for volume-controlled dispensing
@@ -652,10 +702,15 @@ void WebServerManager::setupRoutes() {
             int pumpId = request->getParam("pump", true)->value().toInt();
             float targetVolume = request->getParam("volume", true)->value().toFloat();
 
-            if (dispensingController->startDispensing(pumpId, targetVolume)) {
+            bool started;
+            {
+                HubGuard guard(hubLock);
+                started = dispensingController->startDispensing(pumpId, targetVolume);
+            }
+            if (started) {
                 request->send(200, "text/plain", "OK");
             } else {
-                request->send(400, "text/plain", "Failed to start dispensing");
+                request->send(400, "text/plain", "Failed to start dispensing: the pump is busy, paused, or has a fault to clear");
             }
         });
 
@@ -667,7 +722,24 @@ void WebServerManager::setupRoutes() {
             }
 
             int pumpId = request->getParam("pump", true)->value().toInt();
-            dispensingController->stopDispensing(pumpId);
+            {
+                HubGuard guard(hubLock);
+                dispensingController->stopDispensing(pumpId);
+            }
+            request->send(200, "text/plain", "OK");
+        });
+
+        // Acknowledge a fault; queued jobs then wait for a confirm
+        server.on("/dispense/clear", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            {
+                HubGuard guard(hubLock);
+                dispensingController->clearError(request->getParam("pump", true)->value().toInt());
+            }
             request->send(200, "text/plain", "OK");
         });
 
@@ -679,28 +751,220 @@ void WebServerManager::setupRoutes() {
             }
 
             int pumpId = request->getParam("pump", true)->value().toInt();
-            if (dispensingController->isDispensing(pumpId)) {
-                dispensingController->pauseDispensing(pumpId);
-            } else if (dispensingController->isPaused(pumpId)) {
-                dispensingController->resumeDispensing(pumpId);
+            {
+                HubGuard guard(hubLock);
+                if (dispensingController->isDispensing(pumpId)) {
+                    dispensingController->pauseDispensing(pumpId);
+                } else if (dispensingController->isPaused(pumpId)) {
+                    dispensingController->resumeDispensing(pumpId);
+                }
             }
             request->send(200, "text/plain", "OK");
         });
 
         // Emergency stop endpoint
         server.on("/dispense/emergency", HTTP_POST, [this](AsyncWebServerRequest *request) {
-            dispensingController->emergencyStopAll();
+            {
+                HubGuard guard(hubLock);
+                dispensingController->emergencyStopAll();
+            }
             request->send(200, "text/plain", "Emergency stop activated");
         });
 
+        // Forget a pump's learned overshoot, e.g. after changing its tubing
+        server.on("/dispense/overshoot/reset", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            if (!dispensingController->isValidPumpId(pumpId)) {
+                request->send(400, "text/plain", "Invalid pump");
+                return;
+            }
+            dispensingController->resetOvershootModel(pumpId);
+            request->send(200, "text/plain", "OK");
+        });
+
+        // Pump table: how many taps are in use, and each one's sensor and relay
+        server.on("/dispense/pumps", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("count", true)) {
+                request->send(400, "text/plain", "Missing count parameter");
+                return;
+            }
+
+            if (dispensingController->setPumpCount(request->getParam("count", true)->value().toInt())) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Invalid count, a dropped pump is busy, or an added one has no relay of its own");
+            }
+        });
+
+        server.on("/dispense/pump", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true) || !request->hasParam("sensor", true) ||
+                !request->hasParam("relay", true)) {
+                request->send(400, "text/plain", "Missing pump, sensor or relay parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            int sensor = request->getParam("sensor", true)->value().toInt();
+            int relayNumber = request->getParam("relay", true)->value().toInt();  // 1-based, as in /toggle
+            if (!isValidSensor(sensor) || relayNumber < 1 || relayNumber > relayController->getRelayCount() ||
+                !dispensingController->configurePump(pumpId, sensor, relayNumber - 1)) {
+                request->send(400, "text/plain", "Invalid pump mapping, the pump is busy, or the relay belongs to another pump");
+                return;
+            }
+            request->send(200, "text/plain", "OK");
+        });
+
+        // Fill profiles: set one slot, or go back to filling continuously
+        server.on("/dispense/profile", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true) || !request->hasParam("slot", true) ||
+                !request->hasParam("bulkFraction", true)) {
+                request->send(400, "text/plain", "Missing pump, slot or bulkFraction parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            int slot = request->getParam("slot", true)->value().toInt();
+            FillProfile profile;
+            profile.minTarget = request->hasParam("minVolume", true) ? request->getParam("minVolume", true)->value().toFloat() : 0.0f;
+            profile.bulkFraction = request->getParam("bulkFraction", true)->value().toFloat();
+            profile.pulseOnMs = 0;
+            profile.pulseOffMs = 0;
+            if (!readMsParam(request, "pulseOnMs", profile.pulseOnMs) ||
+                !readMsParam(request, "pulseOffMs", profile.pulseOffMs)) {
+                request->send(400, "text/plain", "pulseOnMs and pulseOffMs must be 0-65535");
+                return;
+            }
+
+            if (dispensingController->setFillProfile(pumpId, slot, profile)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Invalid fill profile");
+            }
+        });
+
+        server.on("/dispense/profile/clear", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            dispensingController->clearFillProfiles(request->getParam("pump", true)->value().toInt());
+            request->send(200, "text/plain", "OK");
+        });
+
+        // Fill profiles with their fill time and final error
+        server.on("/dispense/profiles", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            int pumpCount = dispensingController->getPumpCount();
+            DynamicJsonDocument doc(JSON_OBJECT_SIZE(DISPENSING_MAX_PUMPS) +
+                                    pumpCount * (JSON_ARRAY_SIZE(FILL_MAX_PROFILES) + FILL_MAX_PROFILES * JSON_OBJECT_SIZE(9) + 16));
+
+            for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+                JsonArray profiles = doc.createNestedArray("pump" + String(pumpId));
+                for (int slot = 0; slot < dispensingController->getFillProfileCount(pumpId); slot++) {
+                    const FillProfile& profile = dispensingController->getFillProfile(pumpId, slot);
+                    const FillProfileStats& stats = dispensingController->getFillStats(pumpId, slot);
+                    JsonObject entry = profiles.createNestedObject();
+                    entry["minVolume"] = profile.minTarget;
+                    entry["bulkFraction"] = profile.bulkFraction;
+                    entry["pulseOnMs"] = profile.pulseOnMs;
+                    entry["pulseOffMs"] = profile.pulseOffMs;
+                    entry["fills"] = stats.fills;
+                    entry["lastFillSeconds"] = stats.lastFillSeconds;
+                    entry["meanFillSeconds"] = stats.meanFillSeconds;
+                    entry["lastError"] = stats.lastError;
+                    entry["meanAbsError"] = stats.meanAbsError;
+                }
+            }
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+
+        // Fault limits per pump: latencies in ms, rates in L/min. Parameters
+        // left out keep their current value.
+        server.on("/dispense/faults", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            if (!dispensingController->isValidPumpId(pumpId)) {
+                request->send(400, "text/plain", "Invalid pump");
+                return;
+            }
+            FaultLimits limits = dispensingController->getFaultLimits(pumpId);
+            if (!readMsParam(request, "dryRunMs", limits.dryRunMs) ||
+                !readMsParam(request, "confirmMs", limits.confirmMs) ||
+                !readMsParam(request, "rateWindowMs", limits.rateWindowMs) ||
+                !readMsParam(request, "offGraceMs", limits.offGraceMs) ||
+                !readMsParam(request, "leakWindowMs", limits.leakWindowMs)) {
+                request->send(400, "text/plain", "Latencies must be 0-65535 ms");
+                return;
+            }
+            if (request->hasParam("minRate", true)) limits.minRateLpm = request->getParam("minRate", true)->value().toFloat();
+            if (request->hasParam("maxRate", true)) limits.maxRateLpm = request->getParam("maxRate", true)->value().toFloat();
+            if (request->hasParam("stallFraction", true)) limits.stallFraction = request->getParam("stallFraction", true)->value().toFloat();
+            if (request->hasParam("leakVolume", true)) limits.leakLiters = request->getParam("leakVolume", true)->value().toFloat();
+
+            if (dispensingController->setFaultLimits(pumpId, limits)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Invalid fault limits");
+            }
+        });
+
+        // Fault limits, live rates and how often each fault has fired
+        server.on("/dispense/faults", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            int pumpCount = dispensingController->getPumpCount();
+            DynamicJsonDocument doc(JSON_OBJECT_SIZE(DISPENSING_MAX_PUMPS) +
+                                    pumpCount * (2 * JSON_OBJECT_SIZE(FAULT_CODE_COUNT + 11) + 64));
+
+            for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+                JsonObject pump = doc.createNestedObject("pump" + String(pumpId));
+                const FaultLimits& limits = dispensingController->getFaultLimits(pumpId);
+                const FaultDetector& detector = dispensingController->getFaultDetector(pumpId);
+                pump["dryRunMs"] = limits.dryRunMs;
+                pump["confirmMs"] = limits.confirmMs;
+                pump["rateWindowMs"] = limits.rateWindowMs;
+                pump["minRate"] = limits.minRateLpm;
+                pump["maxRate"] = limits.maxRateLpm;
+                pump["stallFraction"] = limits.stallFraction;
+                pump["offGraceMs"] = limits.offGraceMs;
+                pump["leakWindowMs"] = limits.leakWindowMs;
+                pump["leakVolume"] = limits.leakLiters;
+                pump["rate"] = detector.getRateLpm();
+                pump["peakRate"] = detector.getPeakRateLpm();
+                JsonObject counts = pump.createNestedObject("counts");
+                for (int code = FAULT_TIMEOUT; code < FAULT_CODE_COUNT; code++) {
+                    counts[FaultDetector::codeName((FaultCode)code)] = dispensingController->getFaultCount(pumpId, (FaultCode)code);
+                }
+            }
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+
         // Dispensing status endpoint
         server.on("/dispense/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
-            StaticJsonDocument<512> doc;
+            int pumpCount = dispensingController->getPumpCount();
+            DynamicJsonDocument doc(JSON_OBJECT_SIZE(DISPENSING_MAX_PUMPS + 1) + pumpCount * 448);
+            doc["pumpCount"] = pumpCount;
             
-            for (int pumpId = 1; pumpId <= 2; pumpId++) {
+            for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
                 String pumpKey = "pump" + String(pumpId);
                 JsonObject pump = doc.createNestedObject(pumpKey);
                 
+                const PumpConfig& config = dispensingController->getPumpConfig(pumpId);
+                pump["sensor"] = config.sensorId;
+                pump["relay"] = config.relayIndex + 1;  // As in /toggle?device=relayN
                 pump["state"] = (int)dispensingController->getState(pumpId);
                 pump["isDispensing"] = dispensingController->isDispensing(pumpId);
                 pump["isPaused"] = dispensingController->isPaused(pumpId);
@@ -710,8 +974,15 @@ void WebServerManager::setupRoutes() {
                 pump["progress"] = dispensingController->getProgress(pumpId);
                 pump["elapsedTime"] = dispensingController->getElapsedTime(pumpId);
                 pump["estimatedTimeRemaining"] = dispensingController->getEstimatedTimeRemaining(pumpId);
+                const OvershootModel& overshoot = dispensingController->getOvershootModel(pumpId);
+                pump["overshootLatencyMs"] = overshoot.getLatencyMs();
+                pump["overshootDrip"] = overshoot.getDripLiters();
+                pump["overshootSessions"] = overshoot.getSessions();
                 pump["hasError"] = dispensingController->hasError(pumpId);
                 if (dispensingController->hasError(pumpId)) {
+                    FaultCode fault = dispensingController->getFaultCode(pumpId);
+                    pump["errorCode"] = (int)fault;
+                    pump["errorName"] = FaultDetector::codeName(fault);
                     pump["errorMessage"] = dispensingController->getErrorMessage(pumpId);
                 }
             }
@@ -722,6 +993,286 @@ void WebServerManager::setupRoutes() {
         });
     }
 
+    // Job queues: orders wait per pump and run back to back
+    if (dispensingController && dispenseScheduler) {
+        server.on("/queue/add", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true) || !request->hasParam("volume", true)) {
+                request->send(400, "text/plain", "Missing pump or volume parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            float volume = request->getParam("volume", true)->value().toFloat();
+            uint32_t jobId = dispenseScheduler->enqueue(pumpId, volume);
+            if (jobId == 0) {
+                request->send(400, "text/plain", "Invalid order, or the queue is full");
+                return;
+            }
+            request->send(200, "application/json", "{\"job\":" + String(jobId) + "}");
+        });
+
+        server.on("/queue/cancel", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true) || !request->hasParam("job", true)) {
+                request->send(400, "text/plain", "Missing pump or job parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            uint32_t jobId = request->getParam("job", true)->value().toInt();
+            if (dispenseScheduler->cancel(pumpId, jobId)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(404, "text/plain", "No such job waiting");
+            }
+        });
+
+        server.on("/queue/clear", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            dispenseScheduler->clear(request->getParam("pump", true)->value().toInt());
+            request->send(200, "text/plain", "OK");
+        });
+
+        // Cup changed: start the pump's next job
+        server.on("/queue/confirm", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true)) {
+                request->send(400, "text/plain", "Missing pump parameter");
+                return;
+            }
+
+            bool confirmed;
+            {
+                HubGuard guard(hubLock);
+                confirmed = dispenseScheduler->confirm(request->getParam("pump", true)->value().toInt());
+            }
+            if (confirmed) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(409, "text/plain", "Nothing waiting for a confirm");
+            }
+        });
+
+        server.on("/queue/options", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("pump", true) || !request->hasParam("dwellMs", true)) {
+                request->send(400, "text/plain", "Missing pump or dwellMs parameter");
+                return;
+            }
+
+            int pumpId = request->getParam("pump", true)->value().toInt();
+            uint32_t dwellMs = request->getParam("dwellMs", true)->value().toInt();
+            bool requireConfirm = request->hasParam("confirm", true) && request->getParam("confirm", true)->value() == "true";
+            if (dispenseScheduler->setOptions(pumpId, dwellMs, requireConfirm)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Invalid pump");
+            }
+        });
+
+        // Queue depth, waits and throughput
+        server.on("/queue/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            int pumpCount = dispensingController->getPumpCount();
+            DynamicJsonDocument doc(JSON_OBJECT_SIZE(DISPENSING_MAX_PUMPS + 3) +
+                                    pumpCount * (JSON_OBJECT_SIZE(14) + JSON_ARRAY_SIZE(SCHEDULER_QUEUE_DEPTH) +
+                                                 SCHEDULER_QUEUE_DEPTH * JSON_OBJECT_SIZE(3) + 16));
+            doc["drinksPerHour"] = dispenseScheduler->getDrinksPerHour();
+            doc["completed"] = dispenseScheduler->getTotalCompleted();
+
+            for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+                JsonObject pump = doc.createNestedObject("pump" + String(pumpId));
+                const PumpQueueStats& stats = dispenseScheduler->getStats(pumpId);
+                const PumpQueueOptions& options = dispenseScheduler->getOptions(pumpId);
+                pump["state"] = DispenseScheduler::stateName(dispenseScheduler->getState(pumpId));
+                pump["depth"] = dispenseScheduler->getQueueDepth(pumpId);
+                pump["runningJob"] = dispenseScheduler->getRunningJobId(pumpId);
+                pump["oldestWaitMs"] = dispenseScheduler->getOldestWaitMs(pumpId);
+                pump["dwellRemainingMs"] = dispenseScheduler->getDwellRemainingMs(pumpId);
+                pump["meanWaitMs"] = stats.meanWaitMs;
+                pump["maxWaitMs"] = stats.maxWaitMs;
+                pump["completed"] = stats.completed;
+                pump["failed"] = stats.failed;
+                pump["rejected"] = stats.rejected;
+                pump["dwellMs"] = options.dwellMs;
+                pump["confirm"] = options.requireConfirm;
+                JsonArray jobs = pump.createNestedArray("jobs");
+                for (int position = 0; position < dispenseScheduler->getQueueDepth(pumpId); position++) {
+                    const DispenseJob& job = dispenseScheduler->getJob(pumpId, position);
+                    JsonObject entry = jobs.createNestedObject();
+                    entry["job"] = job.jobId;
+                    entry["volume"] = job.volume;
+                }
+            }
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+    }
+
+    // Recipes: named multi-pump drinks poured as one order
+    if (dispensingController && recipeEngine) {
+        server.on("/recipes", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            DynamicJsonDocument doc(JSON_ARRAY_SIZE(RECIPE_MAX_COUNT) +
+                                    recipeEngine->getRecipeCount() * (JSON_OBJECT_SIZE(2) + RECIPE_NAME_LENGTH +
+                                    JSON_ARRAY_SIZE(RECIPE_MAX_COMPONENTS) + RECIPE_MAX_COMPONENTS * JSON_OBJECT_SIZE(2)));
+            Recipe recipe;
+            for (int i = 0; recipeEngine->getRecipe(i, recipe); i++) {
+                JsonObject entry = doc.createNestedObject();
+                entry["name"] = recipe.name;  // char*, so copied before the next recipe overwrites it
+                JsonArray components = entry.createNestedArray("components");
+                for (int c = 0; c < recipe.componentCount; c++) {
+                    JsonObject component = components.createNestedObject();
+                    component["pump"] = recipe.components[c].pumpId;
+                    component["volume"] = recipe.components[c].volume;
+                }
+            }
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+
+        // components is "pump:litres,pump:litres", e.g. "1:0.05,2:0.15"
+        server.on("/recipe/save", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("name", true) || !request->hasParam("components", true)) {
+                request->send(400, "text/plain", "Missing name or components parameter");
+                return;
+            }
+
+            Recipe recipe;
+            memset(&recipe, 0, sizeof(recipe));
+            strncpy(recipe.name, request->getParam("name", true)->value().c_str(), RECIPE_NAME_LENGTH - 1);
+            String list = request->getParam("components", true)->value();
+            int start = 0;
+            while (start < (int)list.length() && recipe.componentCount < RECIPE_MAX_COMPONENTS) {
+                int end = list.indexOf(',', start);
+                if (end < 0) end = list.length();
+                String item = list.substring(start, end);
+                int colon = item.indexOf(':');
+                if (colon < 0) {
+                    request->send(400, "text/plain", "Components are pump:litres");
+                    return;
+                }
+                RecipeComponent& component = recipe.components[recipe.componentCount++];
+                component.pumpId = item.substring(0, colon).toInt();
+                component.volume = item.substring(colon + 1).toFloat();
+                start = end + 1;
+            }
+
+            if (recipeEngine->saveRecipe(recipe)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Invalid recipe, or the recipe book is full");
+            }
+        });
+
+        server.on("/recipe/delete", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("name", true)) {
+                request->send(400, "text/plain", "Missing name parameter");
+                return;
+            }
+
+            if (recipeEngine->deleteRecipe(request->getParam("name", true)->value().c_str())) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(404, "text/plain", "No such recipe");
+            }
+        });
+
+        server.on("/recipe/start", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            if (!request->hasParam("name", true)) {
+                request->send(400, "text/plain", "Missing name parameter");
+                return;
+            }
+
+            bool started;
+            {
+                HubGuard guard(hubLock);
+                started = recipeEngine->startOrder(request->getParam("name", true)->value().c_str());
+            }
+            if (started) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(409, "text/plain", "Unknown recipe, an order is running, or a pump is busy");
+            }
+        });
+
+        server.on("/recipe/abort", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            {
+                HubGuard guard(hubLock);
+                recipeEngine->abortOrder("Aborted from the web page");
+            }
+            request->send(200, "text/plain", "OK");
+        });
+
+        // The current (or last) order as a whole
+        server.on("/recipe/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            StaticJsonDocument<384> doc;
+            doc["state"] = RecipeEngine::stateName(recipeEngine->getOrderState());
+            if (recipeEngine->getOrderState() != ORDER_NONE) {
+                Recipe recipe = recipeEngine->getOrderRecipe();
+                doc["recipe"] = recipe.name;  // char*, so the document keeps a copy
+                doc["progress"] = recipeEngine->getOrderProgress();
+                doc["volume"] = recipeEngine->getOrderVolume();
+                doc["elapsedMs"] = recipeEngine->getOrderElapsedMs();
+                doc["message"] = recipeEngine->getOrderMessage();
+            }
+            doc["lastFillSeconds"] = recipeEngine->getLastFillSeconds();
+            doc["lastSlowestSeconds"] = recipeEngine->getLastSlowestSeconds();
+            doc["lastSumSeconds"] = recipeEngine->getLastSumSeconds();
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+    }
+
+    // Safety watchdog: its budgets, trip counters and what it is watching
+    if (safetyWatchdog && dispensingController) {
+        server.on("/watchdog/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
+            int pumpCount = dispensingController->getPumpCount();
+            DynamicJsonDocument doc(JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(WATCHDOG_REASON_COUNT) +
+                                    JSON_ARRAY_SIZE(DISPENSING_MAX_PUMPS) + pumpCount * JSON_OBJECT_SIZE(4));
+            const WatchdogSettings& settings = safetyWatchdog->getSettings();
+            doc["freshnessMs"] = settings.freshnessMs;
+            doc["heartbeatMs"] = settings.heartbeatMs;
+            doc["heartbeatAgeMs"] = safetyWatchdog->getHeartbeatAgeMs();
+            doc["forcedWrites"] = safetyWatchdog->getForcedWrites();
+            doc["lastTripMs"] = safetyWatchdog->getLastTripMs();
+            JsonObject trips = doc.createNestedObject("trips");
+            for (int reason = 0; reason < WATCHDOG_REASON_COUNT; reason++) {
+                trips[SafetyWatchdog::reasonName((WatchdogReason)reason)] = safetyWatchdog->getTripCount((WatchdogReason)reason);
+            }
+            JsonArray pumps = doc.createNestedArray("pumps");
+            for (int pumpId = 1; pumpId <= pumpCount; pumpId++) {
+                JsonObject pump = pumps.createNestedObject();
+                pump["pump"] = pumpId;
+                pump["armed"] = safetyWatchdog->isArmed(pumpId);
+                pump["trips"] = safetyWatchdog->getPumpTripCount(pumpId);
+                pump["sampleAgeMs"] = safetyWatchdog->getSampleAgeMs(dispensingController->getPumpConfig(pumpId).sensorId);
+            }
+
+            String response;
+            serializeJson(doc, response);
+            request->send(200, "application/json", response);
+        });
+
+        server.on("/watchdog/settings", HTTP_POST, [this](AsyncWebServerRequest *request) {
+            const WatchdogSettings& current = safetyWatchdog->getSettings();
+            uint32_t freshnessMs = request->hasParam("freshnessMs", true) ?
+                request->getParam("freshnessMs", true)->value().toInt() : current.freshnessMs;
+            uint32_t heartbeatMs = request->hasParam("heartbeatMs", true) ?
+                request->getParam("heartbeatMs", true)->value().toInt() : current.heartbeatMs;
+            if (safetyWatchdog->setSettings(freshnessMs, heartbeatMs)) {
+                request->send(200, "text/plain", "OK");
+            } else {
+                request->send(400, "text/plain", "Budgets must be between two watchdog periods and a minute");
+            }
+        });
+    }
+
     // Simple WiFi settings page
     server.on("/wifi", HTTP_GET, [this](AsyncWebServerRequest *request) {
         String html = "<!DOCTYPE HTML><html><head><title>WiFi Settings</title>";
@@ -6,14 +6,31 @@
 #include <ArduinoJson.h>
 #include <WiFi.h>
 #include <WiFiMulti.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "PIRSensor.h"
 #include "RelayController.h"
 #include "Flashlight.h"
 #include "DispensingController.h"
+#include "DispenseScheduler.h"
+#include "RecipeEngine.h"
+#include "SafetyWatchdog.h"
+#include "FlowTelemetryServer.h"
+#include "TelemetryPacket.h"
+#include "TelemetryReceiver.h"
+
+// Latest reading from one flow sensor
+struct FlowReading {
+    float flowRate;
+    float totalVolume;
+    bool error;
+    long pulseCount;
+};
 
 class WebServerManager {
 public:
-    WebServerManager(PIRSensor* pir, RelayController* relay, Flashlight* flashlight, DispensingController* dispensing = nullptr);
+    WebServerManager(PIRSensor* pir, RelayController* relay, Flashlight* flashlight, DispensingController* dispensing = nullptr,
+                     DispenseScheduler* scheduler = nullptr, RecipeEngine* recipes = nullptr);
     void begin();
     void update();
     
@@ -21,50 +38,60 @@ public:
     void setWiFiMulti(WiFiMulti* wifiMulti);
     bool connectToNetwork(String ssid, String password);
     
-    // Data update functions
-    void updateFlowData(float flowRate, float totalVolume, bool error, long pulseCount = 0);
-    void updateFlow2Data(float flowRate, float totalVolume, bool error, long pulseCount = 0);
+    // Before begin(), for its status and settings routes
+    void setSafetyWatchdog(SafetyWatchdog* watchdog) { safetyWatchdog = watchdog; }
+    // Before begin(); routes that switch relays hold it, as the control task does
+    void setHubLock(SemaphoreHandle_t lock) { hubLock = lock; }
+    
+    // Data update functions; sensors are numbered 1..TELEMETRY_MAX_UNITS
+    void updateSensorData(int sensor, float flowRate, float totalVolume, bool error, long pulseCount = 0);
     void updatePIRStatus(bool isTriggered);
     
     // Callback for flow data updates from external source
-    void setFlowDataCallback(void (*callback)(float, float, bool));
-    void setFlow2DataCallback(void (*callback)(float, float, bool));
+    void setSensorDataCallback(void (*callback)(int, float, float, bool));
+    // Reports that carry bootId/seq/pulses go here instead, like UDP telemetry
+    void setFlowReportCallback(void (*callback)(const TelemetryReport&));
     
-    // Get current flow data
-    float getFlowRate() const { return flowRate; }
-    float getTotalVolume() const { return totalVolume; }
-    bool getFlowError() const { return flowError; }
+    // Flow report from the keep-alive telemetry listener; returns the HTTP status
+    int handleFlowReport(const char* path, const char* json, size_t length);
+    const FlowTelemetryServer& getTelemetryServer() const { return telemetryServer; }
     
-    // Get current flow2 data
-    float getFlow2Rate() const { return flow2Rate; }
-    float getFlow2TotalVolume() const { return flow2TotalVolume; }
-    bool getFlow2Error() const { return flow2Error; }
+    // Get current flow data
+    const FlowReading& getFlowReading(int sensor) const { return flows[sensor - 1]; }
+    static bool isValidSensor(int sensor) { return sensor >= 1 && sensor <= TELEMETRY_MAX_UNITS; }
 
 private:
     AsyncWebServer server;
+    FlowTelemetryServer telemetryServer;  // Keep-alive listener for flow reports
     PIRSensor* pirSensor;
     RelayController* relayController;
     Flashlight* flashlightController;
     DispensingController* dispensingController;
+    DispenseScheduler* dispenseScheduler;
+    RecipeEngine* recipeEngine;
+    SafetyWatchdog* safetyWatchdog;
     WiFiMulti* wifiMultiPtr;
+    SemaphoreHandle_t hubLock;  // Shared PbHub; handlers run on the async_tcp task
     
-    // Flow sensor data (received from FlowSensorUnit)
-    float flowRate;
-    float totalVolume;
-    bool flowError;
-    long pulseCount;
-    
-    // Flow sensor 2 data (received from FlowSensorUnit2)
-    float flow2Rate;
-    float flow2TotalVolume;
-    bool flow2Error;
-    long flow2PulseCount;
+    // Flow sensor data (received from the flow units), indexed by sensor - 1
+    FlowReading flows[TELEMETRY_MAX_UNITS];
     
     // Callback for external flow data updates
-    void (*flowDataCallback)(float, float, bool);
-    void (*flow2DataCallback)(float, float, bool);
+    void (*sensorDataCallback)(int, float, float, bool);
+    void (*flowReportCallback)(const TelemetryReport&);
+    
+    // Holds the hub lock for one handler, if one was set
+    class HubGuard {
+    public:
+        explicit HubGuard(SemaphoreHandle_t lock) : held(lock) { if (held) xSemaphoreTake(held, portMAX_DELAY); }
+        ~HubGuard() { if (held) xSemaphoreGive(held); }
+    private:
+        SemaphoreHandle_t held;
+    };
     
     void setupRoutes();
+    void setupSensorRoutes(int sensor);
+    bool applyFlowJson(int sensor, const char* json, size_t length);
     void handleRoot(AsyncWebServerRequest *request);
     void handlePIRStatus(AsyncWebServerRequest *request);
     void handleFlowData(AsyncWebServerRequest *request);
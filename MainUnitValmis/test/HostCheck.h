@@ -0,0 +1,27 @@
+#ifndef HOSTCHECK_H
+#define HOSTCHECK_H
+
+#include <stdio.h>
+
+// Minimal check macro for the host tests; unlike assert() it stays on in
+// release builds. main() returns checkResult().
+static int checkFailures = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            checkFailures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+static inline int checkResult() {
+    if (checkFailures > 0) {
+        printf("%d check(s) failed\n", checkFailures);
+        return 1;
+    }
+    printf("ok\n");
+    return 0;
+}
+
+#endif
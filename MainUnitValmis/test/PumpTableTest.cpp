@@ -0,0 +1,193 @@
+// The pump table with all eight taps in use: every slot starts out
+// initialised, each tap owns its relay, and eight simulated pumps with
+// different flow rates and reversed relay wiring fill at once, each
+// stopping on its own target and learning its own overshoot.
+#include <Arduino.h>
+#include <Preferences.h>
+#include <math.h>
+#include <new>
+#include <string.h>
+#include <vector>
+#include "DispensingController.h"
+#include "HostCheck.h"
+
+#define K 450.0f           // Pulses per litre
+#define PUMPS 8
+#define REPORT_EVERY_MS 50
+#define REPORT_DELAY_MS 30
+#define FLOW_DELAY_MS 20   // Relay on to liquid at the sensor
+#define DRIP_MS 300        // Flow after relay off
+#define DRIP_LITERS 0.002
+
+static M5UnitPbHub hub;
+static RelayController relay(&hub);
+
+// Relays in reverse order: pump 1 on the last relay, pump 8 on the first
+static int relayOf(int pumpId) { return PUMPS - pumpId; }
+
+// Slots past the default pump count are set up too, not left as found
+static void testSlotsInitialised() {
+    Preferences::clearAll();
+    static unsigned char storage[sizeof(DispensingController)];
+    memset(storage, 0xA5, sizeof(storage));
+    DispensingController* dispensing = new (storage) DispensingController(&relay);
+    CHECK(dispensing->setPumpCount(PUMPS));
+    for (int pumpId = 1; pumpId <= PUMPS; pumpId++) {
+        CHECK(dispensing->getState(pumpId) == READY);
+        CHECK(dispensing->getTargetVolume(pumpId) == 0.0f);
+        CHECK(dispensing->getSessionId(pumpId) == 0);
+        CHECK(dispensing->getFaultCode(pumpId) == FAULT_NONE);
+    }
+    dispensing->~DispensingController();
+}
+
+// Two pumps in use never share a relay
+static void testRelayOwnership() {
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    dispensing.begin();
+    CHECK(dispensing.getPumpCount() == 2);
+    CHECK(!dispensing.configurePump(1, 1, 1));        // Pump 2's relay
+    CHECK(!dispensing.configurePump(1, 1, PUMPS));    // No such relay
+    CHECK(dispensing.configurePump(1, 1, 1 + 1));
+    CHECK(dispensing.configurePump(2, 2, 0));         // Free again now
+    CHECK(dispensing.configurePump(2, 2, 0));         // Its own relay
+
+    // A slot out of use can't join the table on a relay taken since
+    CHECK(!dispensing.configurePump(3, 3, 0));
+    CHECK(dispensing.configurePump(3, 3, 5));
+    CHECK(dispensing.configurePump(1, 1, 5));
+    CHECK(!dispensing.setPumpCount(3));
+    CHECK(dispensing.getPumpCount() == 2);
+    CHECK(dispensing.configurePump(3, 3, 1));
+    CHECK(dispensing.setPumpCount(3));
+}
+
+// Emergency stop latches every pump but only counts against the ones it stopped
+static void testEmergencyStop() {
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    dispensing.begin();
+    CHECK(dispensing.startDispensing(1, 1.0f));
+    CHECK(relay.getRelay(dispensing.getPumpConfig(1).relayIndex));
+    dispensing.emergencyStopAll();
+    CHECK(!relay.getRelay(dispensing.getPumpConfig(1).relayIndex));
+    for (int pumpId = 1; pumpId <= 2; pumpId++) {
+        CHECK(dispensing.getState(pumpId) == ERROR_STATE);
+        CHECK(dispensing.getFaultCode(pumpId) == FAULT_EMERGENCY_STOP);
+    }
+    CHECK(dispensing.getFaultCount(1, FAULT_EMERGENCY_STOP) == 1);
+    CHECK(dispensing.getFaultCount(2, FAULT_EMERGENCY_STOP) == 0);
+    dispensing.clearError(1);
+    dispensing.clearError(2);
+}
+
+// Litres delivered by one pump, with a lag after relay-on and a drip after relay-off
+struct Plant {
+    double litersPerMs;
+    double delivered;
+    unsigned long onSince;
+    unsigned long offSince;
+    bool wasOn;
+    uint64_t basePulses;
+};
+
+struct PendingReport {
+    unsigned long dueMs;
+    int sensorId;
+    uint64_t pulses;
+};
+
+static void testEightPumps() {
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    dispensing.begin();
+
+    // Relays are only free to reverse while the other pumps are out of use
+    CHECK(dispensing.setPumpCount(1));
+    for (int pumpId = 1; pumpId <= PUMPS; pumpId++) {
+        CHECK(dispensing.configurePump(pumpId, pumpId, relayOf(pumpId)));
+    }
+    CHECK(dispensing.setPumpCount(PUMPS));
+    CHECK(!dispensing.setPumpCount(PUMPS + 1));
+
+    Plant plants[PUMPS];
+    for (int i = 0; i < PUMPS; i++) {
+        memset(&plants[i], 0, sizeof(plants[i]));
+        plants[i].litersPerMs = (0.02 + 0.008 * i) / 1000.0;  // 1.2..4.6 L/min, under the rate limit
+        plants[i].basePulses = 500 * i;
+    }
+
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < PUMPS; i++) {
+            plants[i].delivered = 0.0;
+            plants[i].offSince = 0;
+            CHECK(dispensing.startDispensing(i + 1, 0.2f + 0.05f * i));
+        }
+
+        std::vector<PendingReport> reports;
+        for (int tick = 0; tick < 40000; tick++) {
+            hostMillis++;
+            for (int i = 0; i < PUMPS; i++) {
+                Plant& plant = plants[i];
+                bool on = relay.getRelay(relayOf(i + 1));
+                if (on && !plant.wasOn) plant.onSince = hostMillis;
+                if (!on && plant.wasOn) plant.offSince = hostMillis;
+                plant.wasOn = on;
+                if (on && hostMillis - plant.onSince >= FLOW_DELAY_MS) {
+                    plant.delivered += plant.litersPerMs;
+                }
+                if (!on && plant.offSince && hostMillis - plant.offSince < DRIP_MS) {
+                    plant.delivered += DRIP_LITERS / DRIP_MS;
+                }
+                if ((hostMillis + i * 7) % REPORT_EVERY_MS == 0) {
+                    PendingReport report = {hostMillis + REPORT_DELAY_MS, i + 1,
+                                            plant.basePulses + (uint64_t)(plant.delivered * K)};
+                    reports.push_back(report);
+                }
+            }
+            while (!reports.empty() && reports.front().dueMs <= hostMillis) {
+                dispensing.updateSensorPulses(reports.front().sensorId, reports.front().pulses, K);
+                reports.erase(reports.begin());
+            }
+            dispensing.service();
+        }
+
+        for (int i = 0; i < PUMPS; i++) {
+            Plant& plant = plants[i];
+            CHECK(dispensing.isCompleted(i + 1));
+            CHECK(!relay.getRelay(relayOf(i + 1)));
+            double error = plant.delivered - (0.2 + 0.05 * i);
+            if (round >= 3) {
+                // Trained by now: within a few millilitres, drip included
+                CHECK(fabs(error) < 0.006);
+            }
+            plant.basePulses += (uint64_t)(plant.delivered * K);
+        }
+    }
+
+    // The table and each pump's model survive a restart
+    DispensingController restarted(&relay);
+    restarted.begin();
+    CHECK(restarted.getPumpCount() == PUMPS);
+    for (int pumpId = 1; pumpId <= PUMPS; pumpId++) {
+        CHECK(restarted.getPumpConfig(pumpId).relayIndex == relayOf(pumpId));
+        CHECK(restarted.getOvershootModel(pumpId).isTrained());
+    }
+
+    // A busy pump can't be dropped from the table
+    CHECK(dispensing.startDispensing(PUMPS, 1.0f));
+    CHECK(!dispensing.setPumpCount(2));
+    dispensing.stopDispensing(PUMPS);
+    CHECK(dispensing.setPumpCount(2));
+    CHECK(!dispensing.isValidPumpId(3));
+}
+
+int main() {
+    Serial.quiet = true;
+    testSlotsInitialised();
+    testRelayOwnership();
+    testEmergencyStop();
+    testEightPumps();
+    return checkResult();
+}
@@ -0,0 +1,185 @@
+// Link loss against the safety watchdog: two pumps run on a simulated
+// millis() with flow reports every 50 ms, and the watchdog's timer tick is
+// called where the esp_timer would. Covers a sensor that goes quiet, a
+// control task that stops passing while something holds the hub lock,
+// and a session started after a trip but before the trip was serviced.
+#include <Arduino.h>
+#include <Preferences.h>
+#include "SafetyWatchdog.h"
+#include "HostCheck.h"
+
+#define K 450.0f                 // Pulses per litre
+#define LITERS_PER_MS 0.00005    // 3 L/min
+#define REPORT_MS 50
+
+static M5UnitPbHub hub;
+static RelayController relay(&hub);
+static DispensingController* dispensing;
+static SafetyWatchdog* watchdog;
+static SemaphoreHandle_t hubLock;
+
+static double delivered[2];
+static bool linkUp;              // Flow reports reach the main unit
+static bool controlRunning;      // The control task passes
+
+// As the sketch's session callback does
+static void handleSessionChange(int pumpId, uint32_t sessionId, bool pumpOn, float targetVolume) {
+    (void)targetVolume;
+    const PumpConfig& pump = dispensing->getPumpConfig(pumpId);
+    if (pumpOn) {
+        watchdog->armPump(pumpId, sessionId, pump.sensorId, pump.relayIndex);
+    } else {
+        watchdog->disarmPump(pumpId);
+    }
+}
+
+static void run(unsigned long ms) {
+    for (unsigned long i = 0; i < ms; i++) {
+        hostMillis++;
+        for (int pump = 0; pump < 2; pump++) {
+            if (relay.getRelay(pump)) delivered[pump] += LITERS_PER_MS;
+        }
+        if (linkUp && hostMillis % REPORT_MS == 0) {
+            for (int sensor = 1; sensor <= 2; sensor++) {
+                watchdog->noteSample(sensor);
+                if (controlRunning) {
+                    dispensing->updateSensorPulses(sensor, (uint64_t)(delivered[sensor - 1] * K), K);
+                }
+            }
+        }
+        if (controlRunning) {
+            watchdog->heartbeat();
+            watchdog->serviceTrips(dispensing);
+            dispensing->service();
+        }
+        if (hostMillis % WATCHDOG_PERIOD_MS == 0) {
+            watchdog->poll();
+        }
+    }
+}
+
+// Runs until the relay goes off; returns how long that took
+static unsigned long runUntilRelayOff(int relayIndex, unsigned long limitMs) {
+    unsigned long start = hostMillis;
+    while (relay.getRelay(relayIndex) && hostMillis - start < limitMs) {
+        run(1);
+    }
+    return hostMillis - start;
+}
+
+static void setUp() {
+    Preferences::clearAll();
+    static DispensingController dispensingController(&relay);
+    static SafetyWatchdog safetyWatchdog(&relay);
+    dispensing = &dispensingController;
+    watchdog = &safetyWatchdog;
+    hubLock = xSemaphoreCreateMutex();
+    linkUp = true;
+    controlRunning = true;
+
+    dispensing->begin();
+    dispensing->setSessionCallback(handleSessionChange);
+    watchdog->begin(hubLock);
+    run(1000);
+}
+
+// Reports keep coming: the session runs to its target untouched
+static void testHealthyLink() {
+    CHECK(dispensing->startDispensing(1, 0.3f));
+    CHECK(watchdog->isArmed(1));
+    run(10000);
+    CHECK(dispensing->getState(1) == COMPLETED);
+    CHECK(!watchdog->isArmed(1));
+    CHECK(watchdog->getTripCount(WATCHDOG_STALE_SAMPLES) == 0);
+    CHECK(watchdog->getTripCount(WATCHDOG_MISSED_HEARTBEAT) == 0);
+}
+
+// The sensor goes quiet mid-dispense: cut within the freshness budget
+static void testStaleSensor() {
+    CHECK(dispensing->startDispensing(1, 2.0f));
+    run(1000);
+    linkUp = false;
+    unsigned long cutAfter = runUntilRelayOff(0, 10000);
+    CHECK(!relay.getRelay(0));
+    CHECK(cutAfter <= WATCHDOG_DEFAULT_FRESHNESS_MS + WATCHDOG_PERIOD_MS);
+    CHECK(watchdog->getTripCount(WATCHDOG_STALE_SAMPLES) == 1);
+    CHECK(watchdog->getForcedWrites() == 0);
+    CHECK(hubLock->held == 0);
+
+    // The control task turns the trip into a fault on the next pass
+    run(1);
+    CHECK(dispensing->getState(1) == ERROR_STATE);
+    CHECK(dispensing->getFaultCode(1) == FAULT_WATCHDOG);
+    CHECK(!dispensing->startDispensing(1, 2.0f));
+    dispensing->clearError(1);
+    linkUp = true;
+    run(1000);
+}
+
+// The control task stops with the hub lock held: the watchdog writes the
+// relay anyway and counts the forced write
+static void testMissedHeartbeat() {
+    CHECK(dispensing->startDispensing(2, 2.0f));
+    run(1000);
+    controlRunning = false;
+    hubLock->stuck = true;
+    unsigned long cutAfter = runUntilRelayOff(1, 10000);
+    CHECK(!relay.getRelay(1));
+    CHECK(cutAfter <= WATCHDOG_DEFAULT_HEARTBEAT_MS + WATCHDOG_PERIOD_MS);
+    CHECK(watchdog->getTripCount(WATCHDOG_MISSED_HEARTBEAT) == 1);
+    CHECK(watchdog->getPumpTripCount(2) == 1);
+    CHECK(watchdog->getForcedWrites() == 1);
+
+    hubLock->stuck = false;
+    controlRunning = true;
+    run(1);
+    CHECK(dispensing->getFaultCode(2) == FAULT_WATCHDOG);
+    dispensing->clearError(2);
+    run(1000);
+}
+
+// A trip still waiting for the control task belongs to its own session;
+// one started since then keeps running
+static void testNewSessionAfterTrip() {
+    CHECK(dispensing->startDispensing(1, 2.0f));
+    uint32_t tripped = dispensing->getSessionId(1);
+    run(1000);
+    controlRunning = false;
+    runUntilRelayOff(0, 10000);
+    CHECK(watchdog->getTripCount(WATCHDOG_MISSED_HEARTBEAT) == 2);
+
+    // Stopped and restarted from the web page before the control task runs
+    dispensing->stopDispensing(1);
+    CHECK(dispensing->startDispensing(1, 0.3f));
+    CHECK(dispensing->getSessionId(1) != tripped);
+    controlRunning = true;
+    run(1);
+    CHECK(dispensing->getState(1) == DISPENSING);
+    CHECK(dispensing->getFaultCode(1) == FAULT_NONE);
+    CHECK(relay.getRelay(0));
+    CHECK(watchdog->isArmed(1));
+    run(10000);
+    CHECK(dispensing->getState(1) == COMPLETED);
+}
+
+// Budgets are bounded and survive a restart
+static void testSettings() {
+    CHECK(watchdog->setSettings(1000, 300));
+    CHECK(!watchdog->setSettings(WATCHDOG_PERIOD_MS, 300));
+    CHECK(!watchdog->setSettings(1000, WATCHDOG_MAX_BUDGET_MS + 1));
+    SafetyWatchdog restarted(&relay);
+    restarted.begin(hubLock);
+    CHECK(restarted.getSettings().freshnessMs == 1000);
+    CHECK(restarted.getSettings().heartbeatMs == 300);
+}
+
+int main() {
+    Serial.quiet = true;
+    setUp();
+    testHealthyLink();
+    testStaleSensor();
+    testMissedHeartbeat();
+    testNewSessionAfterTrip();
+    testSettings();
+    return checkResult();
+}
@@ -0,0 +1,145 @@
+// Session baselining against the sensor's cumulative pulse count, with the
+// start races it has to survive: a report just before relay-on, the first
+// report only after it, a report sampled before relay-on that arrives
+// after, and a sensor that restarts its count mid-session. Each case runs
+// on a bare SessionMeter and through DispensingController.
+#include <Arduino.h>
+#include <Preferences.h>
+#include "SessionMeter.h"
+#include "DispensingController.h"
+#include "HostCheck.h"
+
+#define K 450.0f   // Pulses per litre
+
+static M5UnitPbHub hub;
+static RelayController relay(&hub);
+
+static void testReportBeforeLatch() {
+    SessionMeter meter;
+    meter.update(1000, K, 100);
+    meter.latch(350);
+    CHECK(!meter.isBaselinePending());
+    CHECK(meter.getBaseline() == 1000);
+    CHECK(meter.getBaselineAgeMs() == 250);
+    meter.update(1450, K, 400);
+    CHECK(meter.getSessionPulses() == 450);
+    CHECK(meter.pulsesToLiters(450) == 1.0f);
+
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    hostMillis = 100;
+    dispensing.updateSensorPulses(1, 1000, K);
+    hostMillis = 350;
+    CHECK(dispensing.startDispensing(1, 2.0f));
+    CHECK(relay.getRelay(0));
+    CHECK(dispensing.getMeter(1).getBaseline() == 1000);
+    hostMillis = 400;
+    dispensing.updateSensorPulses(1, 1450, K);
+    CHECK(dispensing.getSessionPulses(1) == 450);
+    CHECK(dispensing.getCurrentVolume(1) == 1.0f);
+}
+
+static void testReportAfterLatch() {
+    SessionMeter meter;
+    meter.latch(10);
+    CHECK(meter.isBaselinePending());
+    CHECK(meter.getSessionPulses() == 0);
+    meter.update(5000, K, 60);
+    CHECK(!meter.isBaselinePending());
+    CHECK(meter.isBaselineLate());
+    CHECK(meter.getBaseline() == 5000);
+    meter.update(5100, K, 90);
+    CHECK(meter.getSessionPulses() == 100);
+
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    hostMillis = 10;
+    CHECK(dispensing.startDispensing(1, 2.0f));
+    CHECK(dispensing.getMeter(1).isBaselinePending());
+    hostMillis = 60;
+    dispensing.updateSensorPulses(1, 5000, K);
+    CHECK(dispensing.getMeter(1).isBaselineLate());
+    CHECK(dispensing.getSessionPulses(1) == 0);
+    hostMillis = 90;
+    dispensing.updateSensorPulses(1, 5450, K);
+    CHECK(dispensing.getCurrentVolume(1) == 1.0f);
+}
+
+// Sampled before relay-on, delivered after: same count as the baseline,
+// so nothing is counted twice or lost
+static void testInFlightReport() {
+    SessionMeter meter;
+    meter.update(200, K, 0);
+    meter.latch(50);
+    meter.update(200, K, 60);
+    CHECK(meter.getSessionPulses() == 0);
+    meter.update(210, K, 70);
+    CHECK(meter.getSessionPulses() == 10);
+}
+
+// A total of zero at the start is a real baseline, not "unknown"
+static void testZeroAtStart() {
+    SessionMeter meter;
+    meter.update(0, K, 0);
+    meter.latch(5);
+    CHECK(!meter.isBaselinePending());
+    CHECK(!meter.isBaselineLate());
+    CHECK(meter.getBaseline() == 0);
+    meter.update(30, K, 20);
+    CHECK(meter.getSessionPulses() == 30);
+}
+
+// A sensor whose count starts over keeps the session counting forward
+static void testCounterRestart() {
+    SessionMeter meter;
+    meter.update(900, K, 0);
+    meter.latch(1);
+    meter.update(1000, K, 2);
+    meter.update(20, K, 3);
+    CHECK(meter.getSessionPulses() == 120);
+    meter.update(50, K, 4);
+    CHECK(meter.getSessionPulses() == 150);
+
+    Preferences::clearAll();
+    DispensingController dispensing(&relay);
+    hostMillis = 0;
+    dispensing.updateSensorPulses(1, 900, K);
+    CHECK(dispensing.startDispensing(1, 2.0f));
+    hostMillis = 50;
+    dispensing.updateSensorPulses(1, 1125, K);
+    hostMillis = 100;
+    dispensing.updateSensorPulses(1, 0, K);
+    hostMillis = 150;
+    dispensing.updateSensorPulses(1, 225, K);
+    CHECK(dispensing.getSessionPulses(1) == 450);
+    CHECK(dispensing.getCurrentVolume(1) == 1.0f);
+    CHECK(dispensing.getState(1) == DISPENSING);
+}
+
+// Release ends metering; the next session takes a new baseline
+static void testRelease() {
+    SessionMeter meter;
+    meter.update(10, K, 0);
+    meter.latch(1);
+    meter.update(60, K, 2);
+    meter.release();
+    CHECK(meter.getSessionPulses() == 0);
+    meter.latch(3);
+    meter.update(70, K, 4);
+    CHECK(meter.getSessionPulses() == 10);
+
+    SessionMeter targets;
+    targets.update(0, K, 0);
+    CHECK(targets.litersToPulses(2.5f) == 1125);
+    CHECK(targets.litersToPulses(0) == 0);
+}
+
+int main() {
+    testReportBeforeLatch();
+    testReportAfterLatch();
+    testInFlightReport();
+    testZeroAtStart();
+    testCounterRestart();
+    testRelease();
+    return checkResult();
+}
@@ -0,0 +1,167 @@
+// Replays flow report streams through TelemetryTracker: lossy, reordered,
+// duplicated and rebooting ones, each report taken through the wire
+// encoding first. The volume derived from lifetime pulses must come out
+// exact, and the loss counters must match what the channel did.
+#include "TelemetryTracker.h"
+#include "HostCheck.h"
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define PULSES_PER_LITER 450.0f
+#define REPORT_MS 50
+
+static TelemetryReport makeReport(uint32_t bootId, uint32_t sequence, uint32_t lifetimePulses, uint32_t totalPulses) {
+    TelemetryReport report;
+    memset(&report, 0, sizeof(report));
+    report.unitId = 1;
+    report.bootId = bootId;
+    report.sequence = sequence;
+    report.lifetimePulses = lifetimePulses;
+    report.totalPulses = totalPulses;
+    report.pulsesPerLiter = PULSES_PER_LITER;
+    report.sensorTimeMs = sequence * REPORT_MS;
+    return report;
+}
+
+// Through the wire format, like the receiver gets it
+static TelemetryTracker::Verdict deliver(TelemetryTracker& tracker, const TelemetryReport& report, uint32_t arrivalMs) {
+    uint8_t buffer[TELEMETRY_REPORT_SIZE];
+    size_t length = encodeTelemetryReport(report, buffer, sizeof(buffer));
+    TelemetryReport decoded;
+    CHECK(length == TELEMETRY_REPORT_SIZE);
+    CHECK(decodeTelemetryReport(buffer, length, decoded));
+    CHECK(!decodeTelemetryReport(buffer, length - 1, decoded));
+    return tracker.accept(decoded, arrivalMs);
+}
+
+// A short stream whose counters can be worked out by hand: 45 pulses per
+// report, sequence 6 lost, 3 and 9 overtaken, 2 and 8 sent twice
+static void testHandWorkedStream() {
+    static const uint32_t arrivals[] = {0, 1, 2, 2, 4, 3, 5, 7, 8, 8, 10, 9, 11};
+    static const TelemetryTracker::Verdict verdicts[] = {
+        TelemetryTracker::FIRST,    TelemetryTracker::ACCEPTED, TelemetryTracker::ACCEPTED,
+        TelemetryTracker::DUPLICATE, TelemetryTracker::ACCEPTED, TelemetryTracker::LATE,
+        TelemetryTracker::ACCEPTED, TelemetryTracker::ACCEPTED, TelemetryTracker::ACCEPTED,
+        TelemetryTracker::DUPLICATE, TelemetryTracker::ACCEPTED, TelemetryTracker::LATE,
+        TelemetryTracker::ACCEPTED};
+    const int count = sizeof(arrivals) / sizeof(arrivals[0]);
+
+    TelemetryTracker tracker;
+    for (int i = 0; i < count; i++) {
+        uint32_t sequence = arrivals[i];
+        CHECK(deliver(tracker, makeReport(7, sequence, sequence * 45, sequence * 45), i * REPORT_MS + 5) == verdicts[i]);
+    }
+
+    const TelemetryTracker::Stats& stats = tracker.getStats();
+    CHECK(tracker.getPulses() == 11 * 45);
+    CHECK(fabs(tracker.getVolume() - 11 * 45 / PULSES_PER_LITER) < 1e-4);
+    CHECK(stats.received == 13);
+    CHECK(stats.duplicates == 2);
+    CHECK(stats.late == 2);
+    CHECK(stats.gaps == 3);
+    CHECK(stats.lost == 1);
+    CHECK(fabs(tracker.lossRatio() - 1.0f / 12) < 1e-4);
+}
+
+// A sensor that reboots mid-stream, with a straggler from the old boot
+// arriving after the first report of the new one
+static void testReboot() {
+    TelemetryTracker tracker;
+    deliver(tracker, makeReport(7, 0, 1000, 0), 0);
+    deliver(tracker, makeReport(7, 1, 1090, 90), 50);
+    CHECK(deliver(tracker, makeReport(9, 0, 30, 30), 100) == TelemetryTracker::REBOOTED);
+    CHECK(tracker.getPulses() == 90 + 30);
+    CHECK(deliver(tracker, makeReport(7, 2, 1200, 200), 110) == TelemetryTracker::LATE);
+    CHECK(tracker.getPulses() == 90 + 30);  // Its pulses died with the old boot
+    CHECK(deliver(tracker, makeReport(9, 1, 75, 75), 150) == TelemetryTracker::ACCEPTED);
+    CHECK(tracker.getPulses() == 90 + 75);
+    CHECK(tracker.getStats().reboots == 1);
+    CHECK(tracker.getStats().late == 1);
+}
+
+// Volume reset on the flow unit's screen, and both counters wrapping
+static void testResetAndWrap() {
+    TelemetryTracker tracker;
+    deliver(tracker, makeReport(3, 0xFFFFFFFFu, 0xFFFFFF00u, 500), 0);
+    CHECK(deliver(tracker, makeReport(3, 0, 0x100, 0), 50) == TelemetryTracker::ACCEPTED);
+    CHECK(tracker.getPulses() == 0x200);
+    CHECK(tracker.getStats().localResets == 1);
+    CHECK(tracker.getStats().gaps == 0);
+}
+
+// Constant transit time is no jitter; transit that keeps changing is
+static void testJitter() {
+    TelemetryTracker steady;
+    TelemetryTracker shaky;
+    for (uint32_t sequence = 0; sequence < 50; sequence++) {
+        deliver(steady, makeReport(1, sequence, sequence, sequence), sequence * REPORT_MS + 20);
+        deliver(shaky, makeReport(1, sequence, sequence, sequence), sequence * REPORT_MS + (sequence % 2 ? 40 : 0));
+    }
+    CHECK(steady.getStats().jitterMs == 0.0f);
+    CHECK(shaky.getStats().jitterMs > 20.0f);
+}
+
+// A long stream over a channel that drops 10 %, duplicates 5 % and delays
+// every report by up to 120 ms, so neighbours overtake each other
+static void testLossyChannel() {
+    struct InFlight {
+        uint32_t arrivalMs;
+        TelemetryReport report;
+        bool operator<(const InFlight& other) const { return arrivalMs < other.arrivalMs; }
+    };
+
+    std::mt19937 random(14);
+    std::uniform_int_distribution<int> pulses(0, 60);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> delay(0, 120);
+
+    const uint32_t reports = 5000;
+    std::vector<uint32_t> lifetime(reports);
+    std::vector<InFlight> channel;
+    uint32_t counter = 0xFFF00000u;  // Wraps during the run
+    for (uint32_t sequence = 0; sequence < reports; sequence++) {
+        counter += pulses(random);
+        lifetime[sequence] = counter;
+        TelemetryReport report = makeReport(5, sequence, counter, counter);
+        if (sequence > 0 && percent(random) < 10) {
+            continue;
+        }
+        int copies = percent(random) < 5 ? 2 : 1;
+        for (int copy = 0; copy < copies; copy++) {
+            InFlight sent = {sequence * REPORT_MS + (sequence == 0 ? 0 : 1 + delay(random)), report};
+            channel.push_back(sent);
+        }
+    }
+    std::stable_sort(channel.begin(), channel.end());
+
+    TelemetryTracker tracker;
+    uint32_t newest = 0;
+    uint32_t accepted = 0;
+    for (size_t i = 0; i < channel.size(); i++) {
+        TelemetryTracker::Verdict verdict = deliver(tracker, channel[i].report, channel[i].arrivalMs);
+        if (verdict == TelemetryTracker::ACCEPTED || verdict == TelemetryTracker::FIRST) accepted++;
+        newest = std::max(newest, channel[i].report.sequence);
+    }
+
+    const TelemetryTracker::Stats& stats = tracker.getStats();
+    uint64_t expectedPulses = (uint32_t)(lifetime[newest] - lifetime[0]);
+    printf("lossy channel: %u reports, %u received, %u duplicates, %u late, %u lost, jitter %.1f ms\n",
+           reports, stats.received, stats.duplicates, stats.late, stats.lost, stats.jitterMs);
+    CHECK(tracker.getPulses() == expectedPulses);
+    CHECK(fabs(tracker.getVolume() - expectedPulses / PULSES_PER_LITER) < 1e-3 * expectedPulses / PULSES_PER_LITER);
+    CHECK(accepted + stats.duplicates + stats.late == stats.received);
+    CHECK(stats.late > 0);
+    CHECK(stats.duplicates > 0);
+    CHECK(stats.lost > 0 && tracker.lossRatio() < 0.2f);
+}
+
+int main() {
+    testHandWorkedStream();
+    testReboot();
+    testResetAndWrap();
+    testJitter();
+    testLossyChannel();
+    return checkResult();
+}
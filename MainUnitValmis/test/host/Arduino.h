@@ -0,0 +1,45 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the Arduino core to build the main unit's controllers on
+// a PC. Time only moves when a test sets hostMillis.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+extern unsigned long hostMillis;
+
+inline unsigned long millis() { return hostMillis; }
+inline unsigned long micros() { return hostMillis * 1000UL; }
+
+class String : public std::string {
+public:
+    String(const char* text = "") : std::string(text) {}
+    String(const std::string& text) : std::string(text) {}
+    String(int value) : std::string(std::to_string(value)) {}
+};
+
+class HostSerial {
+public:
+    template <typename... Args>
+    void printf(const char* format, Args... args) {
+        if (!quiet) ::printf(format, args...);
+    }
+    void println(const char* text) {
+        if (!quiet) puts(text);
+    }
+    void println(const String& text) { println(text.c_str()); }
+
+    bool quiet = false;
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,58 @@
+// State behind the host stand-ins for the Arduino core, FreeRTOS and
+// esp_timer
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+unsigned long hostMillis = 0;
+HostSerial Serial;
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t semaphore = new HostSemaphore();
+    semaphore->held = 0;
+    semaphore->stuck = false;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    if (semaphore->held > 0 || semaphore->stuck) {
+        (void)ticks;
+        return pdFALSE;  // Another "task" has it; a real take would time out
+    }
+    semaphore->held++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore->held == 0) return pdFALSE;
+    semaphore->held--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    (void)ticks;
+    semaphore->held++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return xSemaphoreGive(semaphore);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    HostTimer* timer = new HostTimer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->periodUs = 0;
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    timer->periodUs = periodUs;
+    return ESP_OK;
+}
@@ -0,0 +1,24 @@
+#ifndef HOST_M5UNITPBHUB_H
+#define HOST_M5UNITPBHUB_H
+
+#include <stdint.h>
+
+#ifndef HIGH
+#define HIGH 1
+#define LOW 0
+#endif
+
+// Counts writes instead of driving the hub
+class M5UnitPbHub {
+public:
+    void digitalWrite(uint8_t channel, uint8_t index, uint8_t value) {
+        (void)channel;
+        (void)index;
+        (void)value;
+        writes++;
+    }
+
+    unsigned long writes = 0;
+};
+
+#endif
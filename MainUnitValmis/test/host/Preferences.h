@@ -0,0 +1,57 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+// NVS stand-in: one process-wide key/value store, so a second controller
+// built in the same test sees what the first one saved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly) {
+        (void)readOnly;
+        space = name;
+        return true;
+    }
+    void end() {}
+
+    size_t getBytesLength(const char* key) {
+        std::map<std::string, std::vector<uint8_t> >::iterator entry = store().find(space + "/" + key);
+        return entry == store().end() ? 0 : entry->second.size();
+    }
+    size_t getBytes(const char* key, void* buffer, size_t length) {
+        std::map<std::string, std::vector<uint8_t> >::iterator entry = store().find(space + "/" + key);
+        if (entry == store().end()) return 0;
+        size_t copied = length < entry->second.size() ? length : entry->second.size();
+        memcpy(buffer, entry->second.data(), copied);
+        return copied;
+    }
+    size_t putBytes(const char* key, const void* buffer, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        store()[space + "/" + key] = std::vector<uint8_t>(bytes, bytes + length);
+        return length;
+    }
+    uint8_t getUChar(const char* key, uint8_t fallback = 0) {
+        uint8_t value = fallback;
+        return getBytes(key, &value, 1) == 1 ? value : fallback;
+    }
+    size_t putUChar(const char* key, uint8_t value) { return putBytes(key, &value, 1); }
+    bool remove(const char* key) { return store().erase(space + "/" + key) > 0; }
+
+    static void clearAll() { store().clear(); }
+
+private:
+    std::string space;
+
+    static std::map<std::string, std::vector<uint8_t> >& store() {
+        static std::map<std::string, std::vector<uint8_t> > values;
+        return values;
+    }
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+// Declarations only: TelemetryReceiver.h is included for its constants,
+// its implementation is not part of the host build.
+
+#include <Arduino.h>
+
+class IPAddress {
+public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { (void)a; (void)b; (void)c; (void)d; }
+};
+
+class WiFiUDP {};
+
+#endif
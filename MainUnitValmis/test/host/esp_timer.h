@@ -0,0 +1,30 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+// The timer never fires by itself; tests call the owner's tick function
+// where the esp_timer task would run the callback.
+
+#include <stdint.h>
+
+typedef struct HostTimer* esp_timer_handle_t;
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef struct {
+    void (*callback)(void* arg);
+    void* arg;
+    int dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct HostTimer {
+    void (*callback)(void* arg);
+    void* arg;
+    uint64_t periodUs;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs);
+
+#endif
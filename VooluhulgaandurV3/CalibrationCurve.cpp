@@ -0,0 +1,97 @@
+#include "CalibrationCurve.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Preferences.h>
+#endif
+
+CalibrationCurve::CalibrationCurve() : activeLut(&DEFAULT_CALIBRATION_LUT) {
+    pointCount = CAL_DEFAULT_POINTS;
+    for (int i = 0; i < CAL_DEFAULT_POINTS; i++) {
+        points[i] = DEFAULT_CALIBRATION_POINTS[i];
+    }
+}
+
+CalibrationPoint CalibrationCurve::getPoint(int index) const {
+    if (index < 0 || index >= pointCount) {
+        CalibrationPoint none = {0.0f, 0.0f};
+        return none;
+    }
+    return points[index];
+}
+
+bool CalibrationCurve::setPointPulsesPerLiter(int index, float pulsesPerLiter) {
+    if (index < 0 || index >= pointCount) return false;
+    if (pulsesPerLiter < CAL_K_MIN || pulsesPerLiter > CAL_K_MAX) return false;
+
+    points[index].pulsesPerLiter = pulsesPerLiter;
+    rebuild();
+    return true;
+}
+
+void CalibrationCurve::resetToDefaults() {
+    pointCount = CAL_DEFAULT_POINTS;
+    for (int i = 0; i < CAL_DEFAULT_POINTS; i++) {
+        points[i] = DEFAULT_CALIBRATION_POINTS[i];
+    }
+    activeLut.store(&DEFAULT_CALIBRATION_LUT, std::memory_order_release);
+}
+
+void CalibrationCurve::rebuild() {
+    const CalibrationLut* active = activeLut.load(std::memory_order_relaxed);
+    CalibrationLut* spare = active == &builtLuts[0] ? &builtLuts[1] : &builtLuts[0];
+    for (int i = 0; i < CAL_LUT_SIZE; i++) {
+        spare->pulsesPerLiter[i] = calibration_detail::evalCurve(
+            points, pointCount, i * calibration_detail::lutStepHz());
+    }
+    activeLut.store(spare, std::memory_order_release);
+}
+
+#ifdef ARDUINO
+
+bool CalibrationCurve::load() {
+    Preferences prefs;
+    prefs.begin("flowcal", true);
+    int count = prefs.getInt("count", 0);
+    CalibrationPoint stored[CAL_DEFAULT_POINTS];
+    size_t bytes = 0;
+    if (count > 0 && count <= CAL_DEFAULT_POINTS) {
+        bytes = prefs.getBytes("points", stored, sizeof(CalibrationPoint) * count);
+    }
+    prefs.end();
+
+    if (bytes != sizeof(CalibrationPoint) * count || count == 0) {
+        Serial.println("No stored calibration curve, using defaults");
+        return false;
+    }
+
+    // Reject anything out of order or out of range rather than half-apply it
+    for (int i = 0; i < count; i++) {
+        if (stored[i].pulsesPerLiter < CAL_K_MIN || stored[i].pulsesPerLiter > CAL_K_MAX) return false;
+        if (i > 0 && stored[i].frequencyHz <= stored[i - 1].frequencyHz) return false;
+    }
+
+    pointCount = count;
+    for (int i = 0; i < count; i++) {
+        points[i] = stored[i];
+    }
+    rebuild();
+    Serial.printf("Loaded %d calibration points from NVS\n", count);
+    return true;
+}
+
+bool CalibrationCurve::save() const {
+    Preferences prefs;
+    prefs.begin("flowcal", false);
+    prefs.putInt("count", pointCount);
+    size_t written = prefs.putBytes("points", points, sizeof(CalibrationPoint) * pointCount);
+    prefs.end();
+    return written == sizeof(CalibrationPoint) * pointCount;
+}
+
+#else
+
+bool CalibrationCurve::load() { return false; }
+bool CalibrationCurve::save() const { return false; }
+
+#endif
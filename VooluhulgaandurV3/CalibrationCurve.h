@@ -0,0 +1,121 @@
+#ifndef CALIBRATIONCURVE_H
+#define CALIBRATIONCURVE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// YF-S402 calibration: f = 73×Q gives 4380 pulses/liter nominally, but the
+// real K-factor drifts with flow rate. The curve is a handful of editable
+// (frequency, pulses/liter) points, linearly interpolated and clamped at the
+// ends. For the hot path it is sampled into a fixed lookup table, so one
+// evaluation is an index and a lerp.
+//
+// Points are edited from the UI task while the acquisition task evaluates
+// the curve. An edit builds a spare table and then publishes it with one
+// atomic pointer store, so a reader always sees a whole table, old or new.
+
+#define BASE_FLOW_SENSOR_PULSES_PER_LITER 4380  // Base calibration: f = 73×Q
+#define CAL_DEFAULT_POINTS 5      // Also the most points a stored curve may have
+#define CAL_LUT_SIZE 256
+#define CAL_LUT_MAX_HZ 1000.0f   // ~13.7 L/min, well above the tap's range
+#define CAL_K_MIN 3000.0f        // Sanity limits for edited points
+#define CAL_K_MAX 6000.0f
+
+struct CalibrationPoint {
+    float frequencyHz;
+    float pulsesPerLiter;
+};
+
+namespace calibration_detail {
+
+// Interpolate a sorted point list at hz. Written as a single-expression
+// recursion so it is a valid C++11 constexpr and can build the default LUT
+// at compile time; the same function rebuilds the LUT after an edit.
+constexpr float evalSegment(const CalibrationPoint* pts, int count, float hz, int i) {
+    return (i >= count - 1) ? pts[count - 1].pulsesPerLiter
+         : (hz <= pts[i + 1].frequencyHz)
+             ? pts[i].pulsesPerLiter + (pts[i + 1].pulsesPerLiter - pts[i].pulsesPerLiter) *
+                   (hz - pts[i].frequencyHz) / (pts[i + 1].frequencyHz - pts[i].frequencyHz)
+             : evalSegment(pts, count, hz, i + 1);
+}
+
+constexpr float evalCurve(const CalibrationPoint* pts, int count, float hz) {
+    return (count <= 0) ? (float)BASE_FLOW_SENSOR_PULSES_PER_LITER
+         : (hz <= pts[0].frequencyHz) ? pts[0].pulsesPerLiter
+         : evalSegment(pts, count, hz, 0);
+}
+
+constexpr float lutStepHz() { return CAL_LUT_MAX_HZ / (CAL_LUT_SIZE - 1); }
+
+template <int... Is> struct IndexList {};
+template <int N, int... Is> struct MakeIndexList : MakeIndexList<N - 1, N - 1, Is...> {};
+template <int... Is> struct MakeIndexList<0, Is...> { typedef IndexList<Is...> type; };
+
+}  // namespace calibration_detail
+
+struct CalibrationLut {
+    float pulsesPerLiter[CAL_LUT_SIZE];
+};
+
+// Factory curve: flat at the nominal K-factor at 0.5, 1, 2, 4 and 8 L/min
+constexpr CalibrationPoint DEFAULT_CALIBRATION_POINTS[CAL_DEFAULT_POINTS] = {
+    {36.5f, (float)BASE_FLOW_SENSOR_PULSES_PER_LITER},
+    {73.0f, (float)BASE_FLOW_SENSOR_PULSES_PER_LITER},
+    {146.0f, (float)BASE_FLOW_SENSOR_PULSES_PER_LITER},
+    {292.0f, (float)BASE_FLOW_SENSOR_PULSES_PER_LITER},
+    {584.0f, (float)BASE_FLOW_SENSOR_PULSES_PER_LITER},
+};
+
+template <int... Is>
+constexpr CalibrationLut buildDefaultLut(calibration_detail::IndexList<Is...>) {
+    return CalibrationLut{{calibration_detail::evalCurve(
+        DEFAULT_CALIBRATION_POINTS, CAL_DEFAULT_POINTS, Is * calibration_detail::lutStepHz())...}};
+}
+
+constexpr CalibrationLut DEFAULT_CALIBRATION_LUT =
+    buildDefaultLut(calibration_detail::MakeIndexList<CAL_LUT_SIZE>::type());
+
+class CalibrationCurve {
+public:
+    CalibrationCurve();
+
+    // Hot path: pulses per liter at the given pulse frequency
+    float pulsesPerLiter(float frequencyHz) const {
+        const CalibrationLut& lut = *activeLut.load(std::memory_order_acquire);
+        float position = frequencyHz / calibration_detail::lutStepHz();
+        if (position <= 0.0f) {
+            return lut.pulsesPerLiter[0];
+        }
+        if (position >= CAL_LUT_SIZE - 1) {
+            return lut.pulsesPerLiter[CAL_LUT_SIZE - 1];
+        }
+        int index = (int)position;
+        float fraction = position - index;
+        return lut.pulsesPerLiter[index] +
+               (lut.pulsesPerLiter[index + 1] - lut.pulsesPerLiter[index]) * fraction;
+    }
+
+    // Point editing, UI task only; the lookup table is rebuilt on every change
+    int getPointCount() const { return pointCount; }
+    CalibrationPoint getPoint(int index) const;
+    bool setPointPulsesPerLiter(int index, float pulsesPerLiter);
+    void resetToDefaults();
+
+    // NVS persistence (Preferences namespace "flowcal")
+    bool load();
+    bool save() const;
+
+private:
+    CalibrationPoint points[CAL_DEFAULT_POINTS];
+    int pointCount;
+    // The table readers use: the compile-time default or one of the two
+    // built ones. An edit writes whichever built table isn't active. That
+    // table was last read at least one whole edit ago, far longer than
+    // one evaluation takes.
+    CalibrationLut builtLuts[2];
+    std::atomic<const CalibrationLut*> activeLut;
+
+    void rebuild();
+};
+
+#endif
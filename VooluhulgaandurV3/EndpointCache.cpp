@@ -0,0 +1,81 @@
+#include "EndpointCache.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Preferences.h>
+#endif
+
+EndpointCache::EndpointCache() : valid(false) {
+    memset(&endpoint, 0, sizeof(endpoint));
+}
+
+#ifdef ARDUINO
+
+bool EndpointCache::load() {
+    Preferences prefs;
+    prefs.begin("endpoint", true);
+    uint8_t version = prefs.getUChar("version", 0);
+    MainUnitEndpoint stored;
+    size_t bytes = 0;
+    if (version == ENDPOINT_CACHE_VERSION) {
+        bytes = prefs.getBytes("data", &stored, sizeof(stored));
+    }
+    prefs.end();
+
+    if (bytes != sizeof(stored) || (stored.address[0] | stored.address[1] | stored.address[2] | stored.address[3]) == 0) {
+        Serial.println("No cached main unit endpoint");
+        valid = false;
+        return false;
+    }
+    stored.ssid[sizeof(stored.ssid) - 1] = '\0';
+    endpoint = stored;
+    valid = true;
+    Serial.printf("Cached main unit endpoint: %u.%u.%u.%u on '%s' channel %u\n",
+                  endpoint.address[0], endpoint.address[1], endpoint.address[2], endpoint.address[3],
+                  endpoint.ssid, endpoint.channel);
+    return true;
+}
+
+bool EndpointCache::update(const MainUnitEndpoint& fresh) {
+    if (valid && memcmp(&fresh, &endpoint, sizeof(fresh)) == 0) {
+        return false;
+    }
+    endpoint = fresh;
+    valid = true;
+
+    Preferences prefs;
+    prefs.begin("endpoint", false);
+    prefs.putUChar("version", ENDPOINT_CACHE_VERSION);
+    prefs.putBytes("data", &endpoint, sizeof(endpoint));
+    prefs.end();
+    Serial.println("Main unit endpoint saved to NVS");
+    return true;
+}
+
+void EndpointCache::clear() {
+    valid = false;
+    memset(&endpoint, 0, sizeof(endpoint));
+    Preferences prefs;
+    prefs.begin("endpoint", false);
+    prefs.clear();
+    prefs.end();
+}
+
+#else
+
+bool EndpointCache::load() { return false; }
+
+bool EndpointCache::update(const MainUnitEndpoint& fresh) {
+    bool changed = !valid || memcmp(&fresh, &endpoint, sizeof(fresh)) != 0;
+    endpoint = fresh;
+    valid = true;
+    return changed;
+}
+
+void EndpointCache::clear() {
+    valid = false;
+    memset(&endpoint, 0, sizeof(endpoint));
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ENDPOINTCACHE_H
+#define ENDPOINTCACHE_H
+
+#include <stdint.h>
+
+#define ENDPOINT_CACHE_VERSION 2
+
+// Last main unit endpoint that actually accepted telemetry, and the WiFi
+// network it was reached on. Stored as one blob so a half-written record
+// can't be mistaken for a valid one.
+struct MainUnitEndpoint {
+    uint8_t address[4];
+    uint16_t telemetryPort;
+    uint16_t keepAlivePort;
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    // Our own DHCP lease on that network, reused as a static address on
+    // reconnect so the join doesn't wait for DHCP
+    uint8_t localAddress[4];
+    uint8_t gateway[4];
+    uint8_t subnet[4];
+};
+
+// NVS persistence (Preferences namespace "endpoint"). Writes only happen
+// when the endpoint changes, so steady operation doesn't wear the flash.
+class EndpointCache {
+public:
+    EndpointCache();
+
+    bool load();
+    // Store a verified endpoint; returns true if anything had to be written
+    bool update(const MainUnitEndpoint& endpoint);
+    void clear();
+
+    bool isValid() const { return valid; }
+    const MainUnitEndpoint& get() const { return endpoint; }
+
+private:
+    MainUnitEndpoint endpoint;
+    bool valid;
+};
+
+#endif
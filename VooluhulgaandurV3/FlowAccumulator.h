@@ -0,0 +1,67 @@
+#ifndef FLOWACCUMULATOR_H
+#define FLOWACCUMULATOR_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Lossless pulse accumulator shared between the pulse producer (ISR or
+// hardware poll) and any number of consumers.
+//
+// The producer only ever moves a free-running 32-bit counter forward; nobody
+// writes it back to zero. Each consumer keeps its own Cursor and takes
+// deltas against its private baseline, so a consumer resetting "its" count
+// can never erase pulses another consumer (or the ISR) has not seen yet.
+// Cursors extend the raw counter to 64 bits: the only requirement is that a
+// cursor is advanced at least once per 2^32 pulses (~13 days at 50 L/min).
+class FlowAccumulator {
+public:
+    FlowAccumulator() : rawCount(0) {}
+
+    // Producer side. There is exactly one producer, so a relaxed load+store
+    // is a correct increment and compiles to plain loads/stores that are
+    // safe to inline into an IRAM interrupt handler.
+    __attribute__((always_inline)) inline void increment(uint32_t pulses = 1) {
+        rawCount.store(rawCount.load(std::memory_order_relaxed) + pulses,
+                       std::memory_order_release);
+    }
+
+    // Producer side for hardware counters: publish an absolute count.
+    __attribute__((always_inline)) inline void publish(uint32_t count) {
+        rawCount.store(count, std::memory_order_release);
+    }
+
+    // Raw snapshot, wraps at 2^32
+    uint32_t raw() const { return rawCount.load(std::memory_order_acquire); }
+
+    class Cursor {
+    public:
+        Cursor() : lastRaw(0), pulses(0) {}
+
+        // Start counting from the accumulator's current value
+        void rebase(const FlowAccumulator& acc) {
+            lastRaw = acc.raw();
+            pulses = 0;
+        }
+
+        // Pulses since the previous take(); advances the baseline
+        uint32_t take(const FlowAccumulator& acc) {
+            uint32_t now = acc.raw();
+            uint32_t delta = now - lastRaw;  // Wrap-safe unsigned delta
+            lastRaw = now;
+            pulses += delta;
+            return delta;
+        }
+
+        // Pulses seen by this cursor since its last rebase()
+        uint64_t total() const { return pulses; }
+
+    private:
+        uint32_t lastRaw;
+        uint64_t pulses;
+    };
+
+private:
+    std::atomic<uint32_t> rawCount;
+};
+
+#endif
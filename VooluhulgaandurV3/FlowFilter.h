@@ -0,0 +1,197 @@
+#ifndef FLOWFILTER_H
+#define FLOWFILTER_H
+
+#include <stdint.h>
+
+// Flow rate filters. Every filter has the same interface:
+//
+//   float update(float sample, float dtSeconds);  // returns the filtered value
+//   float value() const;
+//   void reset();
+//
+// so the flow unit can switch filters at compile time with FLOW_FILTER and
+// host code can run several side by side on the same recorded trace.
+
+#define FLOW_FILTER_BOXCAR 0       // Original 5-sample moving average
+#define FLOW_FILTER_EMA 1          // First-order low pass, time-constant based
+#define FLOW_FILTER_MEDIAN_EMA 2   // Median-of-3 spike rejection, then EMA
+#define FLOW_FILTER_ALPHA_BETA 3   // Rate + slope tracker, least lag on ramps
+
+#ifndef FLOW_FILTER
+#define FLOW_FILTER FLOW_FILTER_EMA
+#endif
+
+#define FLOW_FILTER_EMA_TAU 0.15f      // seconds
+#define FLOW_FILTER_ALPHA 0.5f
+#define FLOW_FILTER_BETA 0.1f
+
+// Moving average over the last N samples. Group delay is (N-1)/2 samples.
+template <int N>
+class BoxcarFilter {
+public:
+    BoxcarFilter() { reset(); }
+
+    float update(float sample, float dtSeconds) {
+        (void)dtSeconds;
+        sum += sample - history[index];
+        history[index] = sample;
+        index = (index + 1) % N;
+        if (count < N) count++;
+        output = sum / N;
+        return output;
+    }
+
+    float value() const { return output; }
+
+    void reset() {
+        for (int i = 0; i < N; i++) history[i] = 0.0f;
+        index = 0;
+        count = 0;
+        sum = 0.0f;
+        output = 0.0f;
+    }
+
+private:
+    float history[N];
+    int index;
+    int count;
+    float sum;
+    float output;
+};
+
+// Exponential moving average. Uses the actual sample spacing, so the time
+// constant holds even when updates are irregular.
+class EmaFilter {
+public:
+    EmaFilter(float tauSeconds = FLOW_FILTER_EMA_TAU) : tau(tauSeconds) { reset(); }
+
+    float update(float sample, float dtSeconds) {
+        if (!primed) {
+            output = sample;
+            primed = true;
+            return output;
+        }
+        float alpha = dtSeconds / (tau + dtSeconds);
+        output += alpha * (sample - output);
+        return output;
+    }
+
+    float value() const { return output; }
+    void reset() { output = 0.0f; primed = false; }
+    void setTimeConstant(float tauSeconds) { tau = tauSeconds; }
+
+private:
+    float tau;
+    float output;
+    bool primed;
+};
+
+// Median of the last N samples. Rejects single-sample spikes (air bubbles,
+// bounce on the sensor line) without smearing a real step.
+template <int N>
+class MedianFilter {
+    static_assert(N % 2 == 1, "MedianFilter needs an odd window");
+
+public:
+    MedianFilter() { reset(); }
+
+    float update(float sample, float dtSeconds) {
+        (void)dtSeconds;
+        history[index] = sample;
+        index = (index + 1) % N;
+        if (count < N) count++;
+
+        // Insertion sort of a copy; N is tiny
+        float sorted[N];
+        for (int i = 0; i < count; i++) {
+            float v = history[i];
+            int j = i - 1;
+            while (j >= 0 && sorted[j] > v) {
+                sorted[j + 1] = sorted[j];
+                j--;
+            }
+            sorted[j + 1] = v;
+        }
+        output = sorted[count / 2];
+        return output;
+    }
+
+    float value() const { return output; }
+
+    void reset() {
+        for (int i = 0; i < N; i++) history[i] = 0.0f;
+        index = 0;
+        count = 0;
+        output = 0.0f;
+    }
+
+private:
+    float history[N];
+    int index;
+    int count;
+    float output;
+};
+
+// Alpha-beta tracker: estimates rate and its slope, so a ramping flow is
+// followed without the constant lag of a pure low pass.
+class AlphaBetaFilter {
+public:
+    AlphaBetaFilter(float alphaGain = FLOW_FILTER_ALPHA, float betaGain = FLOW_FILTER_BETA)
+        : alpha(alphaGain), beta(betaGain) { reset(); }
+
+    float update(float sample, float dtSeconds) {
+        if (!primed) {
+            rate = sample;
+            slope = 0.0f;
+            primed = true;
+            return rate;
+        }
+        if (dtSeconds <= 0.0f) {
+            return rate;
+        }
+        float predicted = rate + slope * dtSeconds;
+        float residual = sample - predicted;
+        rate = predicted + alpha * residual;
+        slope += (beta / dtSeconds) * residual;
+        if (rate < 0.0f) {
+            rate = 0.0f;
+        }
+        return rate;
+    }
+
+    float value() const { return rate; }
+    void reset() { rate = 0.0f; slope = 0.0f; primed = false; }
+
+private:
+    float alpha;
+    float beta;
+    float rate;
+    float slope;
+    bool primed;
+};
+
+// Two filters in series
+template <typename First, typename Second>
+class FilterChain {
+public:
+    float update(float sample, float dtSeconds) {
+        return second.update(first.update(sample, dtSeconds), dtSeconds);
+    }
+    float value() const { return second.value(); }
+    void reset() { first.reset(); second.reset(); }
+
+    First first;
+    Second second;
+};
+
+#if FLOW_FILTER == FLOW_FILTER_BOXCAR
+typedef BoxcarFilter<5> ActiveFlowFilter;
+#elif FLOW_FILTER == FLOW_FILTER_EMA
+typedef EmaFilter ActiveFlowFilter;
+#elif FLOW_FILTER == FLOW_FILTER_ALPHA_BETA
+typedef AlphaBetaFilter ActiveFlowFilter;
+#else
+typedef FilterChain<MedianFilter<3>, EmaFilter> ActiveFlowFilter;
+#endif
+
+#endif
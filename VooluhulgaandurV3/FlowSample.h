@@ -0,0 +1,25 @@
+#ifndef FLOWSAMPLE_H
+#define FLOWSAMPLE_H
+
+#include <stdint.h>
+
+// One flow calculation, published by the acquisition task
+struct FlowSample {
+    uint32_t timestampMs;    // millis() when the sample was computed
+    uint64_t totalPulses;    // Pulses since the last volume reset
+    uint32_t lifetimePulses; // Pulses since boot, never reset (wraps)
+    float flowRate;          // L/min, filtered
+    float totalVolume;       // L since the last volume reset
+    float pulseFrequency;    // Hz
+    float pulsesPerLiter;    // K-factor used for this sample
+    bool error;              // No pulses for 5 seconds
+};
+
+// Identifies one report on the wire: the flow unit's boot and a counter
+// that goes up by one per report within that boot
+struct ReportId {
+    uint32_t bootId;
+    uint32_t sequence;
+};
+
+#endif
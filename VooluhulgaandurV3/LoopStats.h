@@ -0,0 +1,87 @@
+#ifndef LOOPSTATS_H
+#define LOOPSTATS_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Loop period statistics for one task. The owning task calls tick() once per
+// iteration; any other task may read a snapshot() and ask for a new
+// measurement window with restart(), which the owner applies on its next tick.
+class LoopStats {
+public:
+    struct Snapshot {
+        uint32_t iterations;     // Periods measured in this window
+        uint32_t minPeriodUs;
+        uint32_t maxPeriodUs;
+        uint32_t meanPeriodUs;
+        uint32_t outOfTolerance; // Periods further than tolerance from target
+        uint32_t targetPeriodUs; // 0 if the loop has no fixed cadence
+    };
+
+    LoopStats(uint32_t targetPeriodUs = 0, uint32_t toleranceUs = 1000)
+        : target(targetPeriodUs), tolerance(toleranceUs), restartRequested(false) {
+        clear();
+        lastTickUs = 0;
+        started = false;
+    }
+
+    void tick(uint32_t nowUs) {
+        if (restartRequested.exchange(false)) {
+            clear();
+        }
+        if (started) {
+            uint32_t period = nowUs - lastTickUs;
+            if (period < minPeriod) minPeriod = period;
+            if (period > maxPeriod) maxPeriod = period;
+            sumPeriod += period;
+            if (target > 0) {
+                uint32_t error = period > target ? period - target : target - period;
+                if (error > tolerance) outOfTolerance++;
+            }
+            iterations++;
+            meanPeriod = (uint32_t)(sumPeriod / iterations);
+        }
+        lastTickUs = nowUs;
+        started = true;
+    }
+
+    Snapshot snapshot() const {
+        Snapshot s;
+        s.iterations = iterations;
+        s.minPeriodUs = iterations ? minPeriod : 0;
+        s.maxPeriodUs = maxPeriod;
+        s.meanPeriodUs = meanPeriod;
+        s.outOfTolerance = outOfTolerance;
+        s.targetPeriodUs = target;
+        return s;
+    }
+
+    void restart() { restartRequested.store(true); }
+
+private:
+    const uint32_t target;
+    const uint32_t tolerance;
+    std::atomic<bool> restartRequested;
+
+    // Written only by the owning task; readers may see a slightly torn
+    // snapshot, which is fine for diagnostics.
+    volatile uint32_t iterations;
+    volatile uint32_t minPeriod;
+    volatile uint32_t maxPeriod;
+    volatile uint32_t meanPeriod;
+    volatile uint32_t outOfTolerance;
+    uint64_t sumPeriod;
+    uint32_t lastTickUs;
+    bool started;
+
+    void clear() {
+        iterations = 0;
+        minPeriod = 0xFFFFFFFF;
+        maxPeriod = 0;
+        meanPeriod = 0;
+        outOfTolerance = 0;
+        sumPeriod = 0;
+    }
+};
+
+#endif
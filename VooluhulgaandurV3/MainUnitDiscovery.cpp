@@ -0,0 +1,341 @@
+#include "MainUnitDiscovery.h"
+#include <lwip/sockets.h>
+#include <esp_idf_version.h>
+
+// Addresses worth a probe when nothing answers the broadcast
+static const uint8_t KNOWN_ADDRESSES[][4] = {
+    {192, 168, 4, 1},     // Main unit's own access point
+    {192, 168, 1, 100},
+    {192, 168, 0, 100},
+    {192, 168, 1, 1},
+    {10, 0, 0, 1},
+};
+static const uint8_t SCAN_HOSTS[] = {1, 2, 100, 101, 188, 200, 254};
+
+static const char PROBE_REQUEST[] = "GET /flow/test HTTP/1.0\r\n\r\n";
+static const char PROBE_MARKER[] = "Flow endpoint is working";
+static const char RESPONSE_PREFIX[] = "JOOGIMASIN_RESPONSE:";
+
+MainUnitDiscovery::MainUnitDiscovery(const char* hostname, const char* discoveryMessage)
+    : hostname(hostname), discoveryMessage(discoveryMessage), state(IDLE), result((uint32_t)0),
+      resultMethod(""), startTime(0), lastDuration(0), udpOpen(false), mdnsSearch(nullptr),
+      beaconAddress((uint32_t)0), lastBeaconTime(0), beaconCount(0), candidateCount(0), nextCandidate(0) {
+    memset(&beacon, 0, sizeof(beacon));
+    for (int i = 0; i < DISCOVERY_MAX_PROBES; i++) {
+        probes[i].socket = -1;
+    }
+}
+
+MainUnitDiscovery::~MainUnitDiscovery() {
+    stopAll();
+    if (udpOpen) {
+        udp.stop();
+    }
+}
+
+bool MainUnitDiscovery::begin() {
+    if (!udpOpen) {
+        udpOpen = udp.begin(DISCOVERY_UDP_PORT);
+        if (!udpOpen) {
+            Serial.println("Discovery socket failed to start");
+        }
+    }
+    return udpOpen;
+}
+
+void MainUnitDiscovery::start(const IPAddress& preferred) {
+    stopAll();
+    state = RUNNING;
+    startTime = millis();
+    candidateCount = 0;
+    nextCandidate = 0;
+    Serial.println("=== DISCOVERING MAIN UNIT (background) ===");
+
+#ifdef MANUAL_MAIN_UNIT_IP
+    IPAddress manual;
+    if (manual.fromString(MANUAL_MAIN_UNIT_IP)) {
+        addCandidate(manual);
+        return;  // Only the configured address
+    }
+#endif
+
+    sendBroadcast();
+    addCandidate(preferred);  // Probed first
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    mdnsSearch = mdns_query_async_new(hostname, NULL, NULL, MDNS_TYPE_A, DISCOVERY_MDNS_TIMEOUT, 1, NULL);
+#else
+    mdnsSearch = mdns_query_async_new(hostname, NULL, NULL, MDNS_TYPE_A, DISCOVERY_MDNS_TIMEOUT, 1);
+#endif
+
+    // The gateway is the main unit whenever we are on its access point
+    addCandidate(WiFi.gatewayIP());
+    for (size_t i = 0; i < sizeof(KNOWN_ADDRESSES) / sizeof(KNOWN_ADDRESSES[0]); i++) {
+        addCandidate(IPAddress(KNOWN_ADDRESSES[i][0], KNOWN_ADDRESSES[i][1],
+                               KNOWN_ADDRESSES[i][2], KNOWN_ADDRESSES[i][3]));
+    }
+    IPAddress local = WiFi.localIP();
+    for (size_t i = 0; i < sizeof(SCAN_HOSTS); i++) {
+        addCandidate(IPAddress(local[0], local[1], local[2], SCAN_HOSTS[i]));
+    }
+}
+
+void MainUnitDiscovery::addCandidate(const IPAddress& address) {
+    if ((uint32_t)address == 0 || address == WiFi.localIP() || candidateCount >= DISCOVERY_MAX_CANDIDATES) {
+        return;
+    }
+    for (int i = 0; i < candidateCount; i++) {
+        if (candidates[i] == address) return;
+    }
+    candidates[candidateCount++] = address;
+}
+
+void MainUnitDiscovery::cancel() {
+    stopAll();
+    state = IDLE;
+}
+
+void MainUnitDiscovery::poll() {
+    pollSocket();
+    if (state != RUNNING) {
+        return;
+    }
+    pollMdns();
+    if (state == RUNNING) pollProbes();
+
+    if (state == RUNNING && millis() - startTime > DISCOVERY_TIMEOUT) {
+        stopAll();
+        state = FAILED;
+        lastDuration = millis() - startTime;
+        Serial.printf("Main unit discovery failed after %lu ms\n", lastDuration);
+    }
+}
+
+void MainUnitDiscovery::finish(const IPAddress& address, const char* method) {
+    stopAll();
+    result = address;
+    resultMethod = method;
+    state = FOUND;
+    lastDuration = millis() - startTime;
+    Serial.printf("*** Found main unit via %s at %s in %lu ms ***\n", method,
+                  address.toString().c_str(), lastDuration);
+}
+
+void MainUnitDiscovery::stopAll() {
+    for (int i = 0; i < DISCOVERY_MAX_PROBES; i++) {
+        closeProbe(probes[i]);
+    }
+    if (mdnsSearch) {
+        mdns_query_async_delete(mdnsSearch);
+        mdnsSearch = nullptr;
+    }
+}
+
+void MainUnitDiscovery::sendBroadcast() {
+    if (!begin()) {
+        return;
+    }
+
+    // Broadcast address: IP | ~subnetMask
+    IPAddress localIP = WiFi.localIP();
+    IPAddress subnetMask = WiFi.subnetMask();
+    IPAddress broadcastAddr;
+    for (int i = 0; i < 4; i++) {
+        broadcastAddr[i] = localIP[i] | (~subnetMask[i]);
+    }
+
+    udp.beginPacket(broadcastAddr, DISCOVERY_REQUEST_PORT);
+    udp.print(discoveryMessage);
+    udp.endPacket();
+}
+
+bool MainUnitDiscovery::hasFreshBeacon() const {
+    return beaconCount > 0 && millis() - lastBeaconTime < DISCOVERY_BEACON_MAX_AGE;
+}
+
+// Beacons and broadcast answers share the socket; read whatever is queued
+void MainUnitDiscovery::pollSocket() {
+    if (!udpOpen) {
+        return;
+    }
+    for (int i = 0; i < 4 && udp.parsePacket() > 0; i++) {
+        uint8_t packet[64];
+        int len = udp.read(packet, sizeof(packet) - 1);
+        if (len <= 0) {
+            continue;
+        }
+
+        TelemetryBeacon received;
+        if (decodeTelemetryBeacon(packet, len, received)) {
+            handleBeacon(received);
+            continue;
+        }
+
+        // Text answer to our FLOW_SENSOR_DISCOVERY broadcast
+        packet[len] = '\0';
+        const char* response = (const char*)packet;
+        size_t prefixLength = sizeof(RESPONSE_PREFIX) - 1;
+        IPAddress found;
+        if (state == RUNNING && strncmp(response, RESPONSE_PREFIX, prefixLength) == 0 &&
+            found.fromString(response + prefixLength)) {
+            finish(found, "broadcast");
+        }
+    }
+}
+
+void MainUnitDiscovery::handleBeacon(const TelemetryBeacon& received) {
+    // Prefer whichever advertised address is on our own subnet; otherwise
+    // the beacon's source address is what reached us
+    IPAddress local = WiFi.localIP();
+    IPAddress mask = WiFi.subnetMask();
+    IPAddress ap(received.apAddress[0], received.apAddress[1], received.apAddress[2], received.apAddress[3]);
+    IPAddress sta(received.staAddress[0], received.staAddress[1], received.staAddress[2], received.staAddress[3]);
+    IPAddress address = udp.remoteIP();
+    if ((uint32_t)sta != 0 && ((uint32_t)sta & (uint32_t)mask) == ((uint32_t)local & (uint32_t)mask)) {
+        address = sta;
+    } else if ((uint32_t)ap != 0 && ((uint32_t)ap & (uint32_t)mask) == ((uint32_t)local & (uint32_t)mask)) {
+        address = ap;
+    }
+
+    if (beaconCount == 0) {
+        Serial.printf("First main unit beacon: %s (API %u, telemetry port %u)\n",
+                      address.toString().c_str(), received.apiVersion, received.telemetryPort);
+    }
+    beacon = received;
+    beaconAddress = address;
+    lastBeaconTime = millis();
+    beaconCount++;
+
+    if (state == RUNNING) {
+        finish(address, "beacon");
+    }
+}
+
+void MainUnitDiscovery::pollMdns() {
+    if (!mdnsSearch) {
+        return;
+    }
+    mdns_result_t* results = nullptr;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    uint8_t resultCount = 0;
+    bool done = mdns_query_async_get_results(mdnsSearch, 0, &results, &resultCount);
+#else
+    bool done = mdns_query_async_get_results(mdnsSearch, 0, &results);
+#endif
+    if (!done) {
+        return;
+    }
+
+    // mDNS only gives a name lookup; the address still has to pass a probe,
+    // so put it at the front of the queue
+    for (mdns_result_t* r = results; r; r = r->next) {
+        for (mdns_ip_addr_t* a = r->addr; a; a = a->next) {
+            if (a->addr.type == IPADDR_TYPE_V4) {
+                IPAddress address(a->addr.u_addr.ip4.addr);
+                if (nextCandidate > 0) {
+                    candidates[--nextCandidate] = address;  // Reuse a slot already probed
+                } else {
+                    addCandidate(address);
+                }
+                Serial.println("mDNS resolved main unit to " + address.toString());
+                break;
+            }
+        }
+    }
+    if (results) {
+        mdns_query_results_free(results);
+    }
+    mdns_query_async_delete(mdnsSearch);
+    mdnsSearch = nullptr;
+}
+
+void MainUnitDiscovery::pollProbes() {
+    for (int i = 0; i < DISCOVERY_MAX_PROBES && state == RUNNING; i++) {
+        Probe& probe = probes[i];
+        if (probe.socket < 0) {
+            while (nextCandidate < candidateCount) {
+                if (startProbe(probe, candidates[nextCandidate++])) break;
+            }
+        }
+        if (probe.socket >= 0) {
+            advanceProbe(probe);
+        }
+    }
+}
+
+bool MainUnitDiscovery::startProbe(Probe& probe, const IPAddress& address) {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        return false;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = (uint32_t)address;
+    server.sin_port = htons(80);
+    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) < 0 && errno != EINPROGRESS) {
+        close(sock);
+        return false;
+    }
+
+    probe.socket = sock;
+    probe.address = address;
+    probe.started = millis();
+    probe.requestSent = false;
+    probe.responseLength = 0;
+    return true;
+}
+
+void MainUnitDiscovery::advanceProbe(Probe& probe) {
+    if (millis() - probe.started > DISCOVERY_PROBE_TIMEOUT) {
+        closeProbe(probe);
+        return;
+    }
+
+    if (!probe.requestSent) {
+        // Connected once the socket turns writable without a pending error
+        fd_set writeSet;
+        FD_ZERO(&writeSet);
+        FD_SET(probe.socket, &writeSet);
+        struct timeval noWait = {0, 0};
+        if (select(probe.socket + 1, NULL, &writeSet, NULL, &noWait) <= 0) {
+            return;
+        }
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(probe.socket, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0 || send(probe.socket, PROBE_REQUEST, sizeof(PROBE_REQUEST) - 1, 0) < 0) {
+            closeProbe(probe);
+            return;
+        }
+        probe.requestSent = true;
+    }
+
+    // Keep only the tail of the response; the marker is in a short body
+    char chunk[64];
+    int received = recv(probe.socket, chunk, sizeof(chunk), 0);
+    if (received == 0 || (received < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) {
+        closeProbe(probe);
+        return;
+    }
+    for (int i = 0; i < received; i++) {
+        if (probe.responseLength == sizeof(probe.response) - 1) {
+            memmove(probe.response, probe.response + 1, probe.responseLength - 1);
+            probe.responseLength--;
+        }
+        probe.response[probe.responseLength++] = chunk[i];
+    }
+    probe.response[probe.responseLength] = '\0';
+    if (strstr(probe.response, PROBE_MARKER)) {
+        finish(probe.address, "probe");
+    }
+}
+
+void MainUnitDiscovery::closeProbe(Probe& probe) {
+    if (probe.socket >= 0) {
+        close(probe.socket);
+        probe.socket = -1;
+    }
+}
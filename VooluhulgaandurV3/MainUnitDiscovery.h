@@ -0,0 +1,98 @@
+#ifndef MAINUNITDISCOVERY_H
+#define MAINUNITDISCOVERY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <mdns.h>
+#include "TelemetryPacket.h"
+
+#define DISCOVERY_UDP_PORT TELEMETRY_BEACON_PORT  // Our side; answers and beacons arrive here
+#define DISCOVERY_REQUEST_PORT 12346     // Main unit's discovery listener
+#define DISCOVERY_TIMEOUT 8000           // ms for one complete discovery round
+#define DISCOVERY_PROBE_TIMEOUT 1500     // ms per HTTP probe
+#define DISCOVERY_MAX_PROBES 4           // Probes in flight at once
+#define DISCOVERY_MAX_CANDIDATES 16
+#define DISCOVERY_MDNS_TIMEOUT 3000      // ms
+#define DISCOVERY_BEACON_MAX_AGE 3500    // ms; beacons come every second
+
+// Finds the main unit without blocking the caller. The main unit broadcasts a
+// beacon every second; poll() caches the latest one, so normally the address
+// is known without asking. start() is the active fallback: it sends the UDP
+// broadcast and an mDNS query and queues HTTP probes to likely addresses;
+// every poll() advances all of them by a few milliseconds at most, using
+// non-blocking sockets. The first method to get an answer wins.
+class MainUnitDiscovery {
+public:
+    enum State { IDLE, RUNNING, FOUND, FAILED };
+
+    MainUnitDiscovery(const char* hostname, const char* discoveryMessage);
+    ~MainUnitDiscovery();
+
+    // Open the beacon/answer socket; call once WiFi is up
+    bool begin();
+    // preferred (e.g. the cached endpoint) is probed before anything else
+    void start(const IPAddress& preferred = IPAddress());
+    // Queue an extra address to probe; call after start()
+    void addCandidate(const IPAddress& address);
+    void poll();
+    void cancel();
+
+    State getState() const { return state; }
+    bool isRunning() const { return state == RUNNING; }
+    IPAddress getResult() const { return result; }
+    const char* getResultMethod() const { return resultMethod; }
+    unsigned long getLastDuration() const { return lastDuration; }
+
+    // Passive beacon cache
+    bool hasFreshBeacon() const;
+    IPAddress getBeaconAddress() const { return beaconAddress; }
+    const TelemetryBeacon& getBeacon() const { return beacon; }
+    unsigned long getBeaconAge() const { return millis() - lastBeaconTime; }
+    uint32_t getBeaconCount() const { return beaconCount; }
+
+private:
+    struct Probe {
+        int socket;           // -1 when the slot is free
+        IPAddress address;
+        unsigned long started;
+        bool requestSent;
+        char response[64];
+        size_t responseLength;
+    };
+
+    const char* hostname;
+    const char* discoveryMessage;
+    State state;
+    IPAddress result;
+    const char* resultMethod;
+    unsigned long startTime;
+    unsigned long lastDuration;
+
+    WiFiUDP udp;
+    bool udpOpen;
+    mdns_search_once_t* mdnsSearch;
+
+    TelemetryBeacon beacon;
+    IPAddress beaconAddress;
+    unsigned long lastBeaconTime;
+    uint32_t beaconCount;
+
+    IPAddress candidates[DISCOVERY_MAX_CANDIDATES];
+    int candidateCount;
+    int nextCandidate;
+    Probe probes[DISCOVERY_MAX_PROBES];
+
+    void sendBroadcast();
+    void pollSocket();
+    void handleBeacon(const TelemetryBeacon& received);
+    void pollMdns();
+    void pollProbes();
+    bool startProbe(Probe& probe, const IPAddress& address);
+    void advanceProbe(Probe& probe);
+    void closeProbe(Probe& probe);
+    void finish(const IPAddress& address, const char* method);
+    void stopAll();
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "PulsePeriodMeter.h"
+
+PulsePeriodMeter::PulsePeriodMeter() {
+    reset();
+}
+
+void PulsePeriodMeter::reset() {
+    for (int i = 0; i < PERIOD_WINDOW_EDGES; i++) {
+        edges[i] = 0;
+    }
+    newest = 0;
+    stored = 0;
+    edgesSeen = 0;
+}
+
+void PulsePeriodMeter::consume(EdgeRing& ring) {
+    uint32_t timestampUs;
+    while (ring.pop(timestampUs)) {
+        addEdge(timestampUs);
+    }
+}
+
+void PulsePeriodMeter::addEdge(uint32_t timestampUs) {
+    newest = (newest + 1) % PERIOD_WINDOW_EDGES;
+    edges[newest] = timestampUs;
+    if (stored < PERIOD_WINDOW_EDGES) {
+        stored++;
+    }
+    edgesSeen++;
+}
+
+float PulsePeriodMeter::frequencyHz(uint32_t nowUs) const {
+    if (stored == 0) {
+        return 0.0f;
+    }
+
+    uint32_t newestUs = edges[newest];
+    uint32_t sinceLastUs = nowUs - newestUs;
+    if (sinceLastUs > PERIOD_TIMEOUT_US || stored < 2) {
+        return 0.0f;
+    }
+
+    // Walk back from the newest edge while the span stays inside the window.
+    // Always keep at least one full period.
+    int periods = 0;
+    uint32_t spanUs = 0;
+    for (int back = 1; back < stored; back++) {
+        int index = (newest + PERIOD_WINDOW_EDGES - back) % PERIOD_WINDOW_EDGES;
+        uint32_t candidateSpan = newestUs - edges[index];
+        if (periods > 0 && candidateSpan > PERIOD_MAX_SPAN_US) {
+            break;
+        }
+        periods = back;
+        spanUs = candidateSpan;
+    }
+
+    if (spanUs == 0 || spanUs > PERIOD_TIMEOUT_US) {
+        return 0.0f;
+    }
+
+    float frequency = periods * 1000000.0f / spanUs;
+
+    // If the next edge is already overdue the flow is slowing down; the
+    // current period is at least as long as the time since the last edge.
+    if (sinceLastUs > spanUs / periods) {
+        float upperBound = 1000000.0f / sinceLastUs;
+        if (upperBound < frequency) {
+            frequency = upperBound;
+        }
+    }
+
+    return frequency;
+}
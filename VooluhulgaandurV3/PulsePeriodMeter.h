@@ -0,0 +1,40 @@
+#ifndef PULSEPERIODMETER_H
+#define PULSEPERIODMETER_H
+
+#include <stdint.h>
+#include "SpscRing.h"
+
+#define EDGE_RING_CAPACITY 1024  // ~280 ms of edges at the sensor's 50 L/min ceiling
+#define PERIOD_WINDOW_EDGES 8    // Average over the last 8 edges (7 periods)
+#define PERIOD_MAX_SPAN_US 250000UL   // ...but never over more than 250 ms
+#define PERIOD_TIMEOUT_US 1000000UL   // No edge for 1 s means no flow
+
+// Edge timestamps in microseconds, pushed by the pulse interrupt
+typedef SpscRing<uint32_t, EDGE_RING_CAPACITY> EdgeRing;
+
+// Measures pulse frequency from inter-pulse periods instead of counting
+// pulses in a fixed window. The reading follows the most recent edges, so it
+// reacts within a few pulses and keeps full resolution at low flow.
+class PulsePeriodMeter {
+public:
+    PulsePeriodMeter();
+
+    // Drain all pending edges from the ring
+    void consume(EdgeRing& ring);
+    // Feed a single edge (used by consume() and by tests)
+    void addEdge(uint32_t timestampUs);
+
+    // Pulse frequency in Hz at time nowUs
+    float frequencyHz(uint32_t nowUs) const;
+
+    void reset();
+    uint32_t edgeCount() const { return edgesSeen; }
+
+private:
+    uint32_t edges[PERIOD_WINDOW_EDGES];
+    uint8_t newest;       // Index of the most recent edge
+    uint8_t stored;       // Valid entries in edges[]
+    uint32_t edgesSeen;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "PulseSource.h"
+
+#ifdef ARDUINO
+
+FlowAccumulator* IsrPulseSource::isrCounter = nullptr;
+EdgeRing* IsrPulseSource::isrEdges = nullptr;
+
+IsrPulseSource::IsrPulseSource(int pin) : sensorPin(pin) {}
+
+void IRAM_ATTR IsrPulseSource::pulseCounter() {
+    isrCounter->increment();
+    isrEdges->push((uint32_t)esp_timer_get_time());
+    // Note: Don't use Serial.print in interrupt handlers as it can cause issues
+}
+
+bool IsrPulseSource::begin() {
+    isrCounter = &counter;
+    isrEdges = &edgeRing;
+    pinMode(sensorPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(sensorPin), pulseCounter, FALLING);
+    Serial.printf("Pulse source: GPIO interrupt on pin %d\n", sensorPin);
+    return true;
+}
+
+PcntPulseSource::PcntPulseSource(int pin, pcnt_unit_t unit)
+    : sensorPin(pin), pcntUnit(unit), overflowCount(0), lastCount(0) {}
+
+void IRAM_ATTR PcntPulseSource::overflowHandler(void* arg) {
+    PcntPulseSource* self = static_cast<PcntPulseSource*>(arg);
+    self->overflowCount += PCNT_HIGH_LIMIT;
+}
+
+bool PcntPulseSource::begin() {
+    pinMode(sensorPin, INPUT_PULLUP);
+
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = sensorPin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = pcntUnit;
+    config.pos_mode = PCNT_COUNT_DIS;   // Count falling edges, same as the ISR path
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = PCNT_HIGH_LIMIT;
+    config.counter_l_lim = 0;
+
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        Serial.println("PCNT unit config failed");
+        return false;
+    }
+
+    pcnt_set_filter_value(pcntUnit, PCNT_FILTER_CYCLES);
+    pcnt_filter_enable(pcntUnit);
+
+    pcnt_event_enable(pcntUnit, PCNT_EVT_H_LIM);
+    pcnt_counter_pause(pcntUnit);
+    pcnt_counter_clear(pcntUnit);
+    overflowCount = 0;
+    lastCount = 0;
+
+    // The ISR service may already be installed by another unit
+    esp_err_t err = pcnt_isr_service_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        Serial.println("PCNT ISR service install failed");
+        return false;
+    }
+    err = pcnt_isr_handler_add(pcntUnit, overflowHandler, this);
+    if (err != ESP_OK) {
+        // Without the wrap interrupt every 32000 pulses would be lost
+        Serial.printf("PCNT ISR handler add failed: %d\n", (int)err);
+        return false;
+    }
+    pcnt_counter_resume(pcntUnit);
+
+    Serial.printf("Pulse source: PCNT unit %d on pin %d\n", (int)pcntUnit, sensorPin);
+    return true;
+}
+
+void PcntPulseSource::poll() {
+    uint32_t high;
+    int16_t low = 0;
+
+    // Re-read if the wrap interrupt fired while we were sampling
+    do {
+        high = overflowCount;
+        pcnt_get_counter_value(pcntUnit, &low);
+    } while (high != overflowCount);
+
+    uint32_t count = high + (uint16_t)low;
+
+    // The counter resets to 0 at the limit slightly before the wrap interrupt
+    // runs. Never report a value smaller than the previous one; the next read
+    // picks up the folded-in pulses.
+    if ((int32_t)(count - lastCount) < 0) {
+        count = lastCount;
+    }
+    lastCount = count;
+    counter.publish(count);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef PULSESOURCE_H
+#define PULSESOURCE_H
+
+#include <stdint.h>
+#include "FlowAccumulator.h"
+#include "PulsePeriodMeter.h"
+
+// Pulse counting backends (select with PULSE_SOURCE_BACKEND)
+#define PULSE_SOURCE_ISR 0        // GPIO interrupt per falling edge (original path)
+#define PULSE_SOURCE_PCNT 1       // ESP32 PCNT peripheral, counts in hardware
+#define PULSE_SOURCE_SIMULATED 2  // Software-fed counter for host tests
+
+#ifndef PULSE_SOURCE_BACKEND
+#ifdef ARDUINO
+#define PULSE_SOURCE_BACKEND PULSE_SOURCE_PCNT
+#else
+#define PULSE_SOURCE_BACKEND PULSE_SOURCE_SIMULATED
+#endif
+#endif
+
+// Common interface for everything that counts flow sensor pulses.
+// Every backend feeds a FlowAccumulator; consumers read it through their
+// own FlowAccumulator::Cursor.
+class PulseSource {
+public:
+    virtual ~PulseSource() {}
+    virtual bool begin() = 0;
+    // Hardware backends move their count into the accumulator here. Interrupt
+    // driven backends update it directly and need no polling.
+    virtual void poll() {}
+    // Edge timestamps for period-based rate measurement, or nullptr when the
+    // backend cannot see individual edges (PCNT)
+    virtual EdgeRing* edges() { return nullptr; }
+    virtual const char* name() const = 0;
+
+    const FlowAccumulator& accumulator() const { return counter; }
+
+protected:
+    FlowAccumulator counter;
+};
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "driver/pcnt.h"
+
+// Original path: one interrupt per pulse. Kept as a fallback for boards or
+// pins where the PCNT peripheral is not available. Since it sees every edge
+// it also timestamps them for the period meter.
+class IsrPulseSource : public PulseSource {
+public:
+    IsrPulseSource(int pin);
+    bool begin() override;
+    EdgeRing* edges() override { return &edgeRing; }
+    const char* name() const override { return "ISR"; }
+
+private:
+    const int sensorPin;
+    EdgeRing edgeRing;
+    static FlowAccumulator* isrCounter;
+    static EdgeRing* isrEdges;
+
+    static void IRAM_ATTR pulseCounter();
+};
+
+// Hardware counter. The 16-bit PCNT counter wraps at PCNT_HIGH_LIMIT and
+// raises one interrupt per wrap, so at 50 L/min the CPU sees roughly one
+// interrupt every 9 seconds instead of ~3600 per second.
+#define PCNT_HIGH_LIMIT 32000
+#define PCNT_FILTER_CYCLES 1000  // Ignore glitches shorter than 12.5 us (80 MHz APB)
+
+class PcntPulseSource : public PulseSource {
+public:
+    PcntPulseSource(int pin, pcnt_unit_t unit = PCNT_UNIT_0);
+    bool begin() override;
+    void poll() override;
+    const char* name() const override { return "PCNT"; }
+
+private:
+    const int sensorPin;
+    const pcnt_unit_t pcntUnit;
+    volatile uint32_t overflowCount;  // Pulses folded in by the wrap interrupt
+    uint32_t lastCount;
+
+    static void IRAM_ATTR overflowHandler(void* arg);
+};
+#endif
+
+// Simulated backend: pulses are injected by the test harness.
+class SimulatedPulseSource : public PulseSource {
+public:
+    SimulatedPulseSource(int pin = -1) { (void)pin; }
+    bool begin() override { return true; }
+    EdgeRing* edges() override { return &edgeRing; }
+    const char* name() const override { return "SIM"; }
+
+    // Called from the test's "ISR" thread
+    void inject(uint32_t pulses = 1) { counter.increment(pulses); }
+    void injectEdge(uint32_t timestampUs) {
+        counter.increment();
+        edgeRing.push(timestampUs);
+    }
+
+private:
+    EdgeRing edgeRing;
+};
+
+#if PULSE_SOURCE_BACKEND == PULSE_SOURCE_PCNT
+typedef PcntPulseSource ActivePulseSource;
+#elif PULSE_SOURCE_BACKEND == PULSE_SOURCE_ISR
+typedef IsrPulseSource ActivePulseSource;
+#else
+typedef SimulatedPulseSource ActivePulseSource;
+#endif
+
+#endif
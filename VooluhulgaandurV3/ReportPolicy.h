@@ -0,0 +1,111 @@
+#ifndef REPORTPOLICY_H
+#define REPORTPOLICY_H
+
+#include <stdint.h>
+
+// Report timing for the flow unit. While this unit's pump is dispensing,
+// reports go out at the active rate; otherwise a slow heartbeat is enough.
+// A rate change larger than the deadband is sent right away in either mode,
+// limited only by the minimum spacing.
+
+#ifndef REPORT_IDLE_INTERVAL_MS
+#define REPORT_IDLE_INTERVAL_MS 2000   // Heartbeat while idle (0.5 Hz)
+#endif
+#ifndef REPORT_ACTIVE_INTERVAL_MS
+#define REPORT_ACTIVE_INTERVAL_MS 50   // While dispensing (20 Hz)
+#endif
+#ifndef REPORT_DEADBAND_LPM
+#define REPORT_DEADBAND_LPM 0.1f       // Rate change that triggers an immediate report
+#endif
+#define REPORT_MIN_SPACING_MS 20       // Never more than 50 reports per second
+#define REPORT_RATE_WINDOW_MS 5000     // Window for the achieved rate
+
+class ReportPolicy {
+public:
+    enum Reason {
+        REPORT_NONE = 0,
+        REPORT_HEARTBEAT,
+        REPORT_ACTIVE,
+        REPORT_DEADBAND,
+        REPORT_FORCED,
+        REPORT_REASON_COUNT
+    };
+
+    ReportPolicy(uint32_t idleIntervalMs = REPORT_IDLE_INTERVAL_MS,
+                 uint32_t activeIntervalMs = REPORT_ACTIVE_INTERVAL_MS,
+                 float deadbandLpm = REPORT_DEADBAND_LPM)
+        : idleInterval(idleIntervalMs), activeInterval(activeIntervalMs), deadband(deadbandLpm),
+          sessionActive(false), forced(true), haveSent(false), lastSendMs(0), lastRate(0.0f),
+          lastError(false), windowStartMs(0), windowCount(0), achievedMilliHz(0) {
+        for (int i = 0; i < REPORT_REASON_COUNT; i++) reasonCounts[i] = 0;
+    }
+
+    void setIdleInterval(uint32_t ms) { idleInterval = ms; }
+    void setActiveInterval(uint32_t ms) { activeInterval = ms; }
+    void setDeadband(float lpm) { deadband = lpm; }
+    uint32_t getIdleInterval() const { return idleInterval; }
+    uint32_t getActiveInterval() const { return activeInterval; }
+
+    void setSessionActive(bool active) {
+        if (active != sessionActive) forced = true;  // Report the transition at once
+        sessionActive = active;
+    }
+    bool isSessionActive() const { return sessionActive; }
+    uint32_t currentInterval() const { return sessionActive ? activeInterval : idleInterval; }
+
+    // Send the next report regardless of timing (e.g. after a volume reset)
+    void requestImmediate() { forced = true; }
+
+    Reason evaluate(uint32_t nowMs, float flowRate, bool error) const {
+        if (!haveSent) return REPORT_FORCED;
+        uint32_t sinceLast = nowMs - lastSendMs;
+        if (sinceLast < REPORT_MIN_SPACING_MS) return REPORT_NONE;
+        if (forced || error != lastError) return REPORT_FORCED;
+        float change = flowRate - lastRate;
+        if (change > deadband || change < -deadband) return REPORT_DEADBAND;
+        if (sinceLast >= currentInterval()) return sessionActive ? REPORT_ACTIVE : REPORT_HEARTBEAT;
+        return REPORT_NONE;
+    }
+
+    void markSent(uint32_t nowMs, float flowRate, bool error, Reason reason) {
+        haveSent = true;
+        forced = false;
+        lastSendMs = nowMs;
+        lastRate = flowRate;
+        lastError = error;
+        if (reason > REPORT_NONE && reason < REPORT_REASON_COUNT) reasonCounts[reason]++;
+
+        windowCount++;
+        uint32_t windowLength = nowMs - windowStartMs;
+        if (windowLength >= REPORT_RATE_WINDOW_MS) {
+            achievedMilliHz = (uint32_t)((uint64_t)windowCount * 1000000ULL / windowLength);
+            windowStartMs = nowMs;
+            windowCount = 0;
+        }
+    }
+
+    // Reports per second over the last completed window
+    float achievedRateHz() const { return achievedMilliHz / 1000.0f; }
+    uint32_t getReasonCount(Reason reason) const { return reasonCounts[reason]; }
+    void resetCounts() {
+        for (int i = 0; i < REPORT_REASON_COUNT; i++) reasonCounts[i] = 0;
+    }
+
+private:
+    uint32_t idleInterval;
+    uint32_t activeInterval;
+    float deadband;
+    bool sessionActive;
+    bool forced;
+    bool haveSent;
+    uint32_t lastSendMs;
+    float lastRate;
+    bool lastError;
+
+    uint32_t windowStartMs;
+    uint32_t windowCount;
+    uint32_t achievedMilliHz;
+    uint32_t reasonCounts[REPORT_REASON_COUNT];
+};
+
+#endif
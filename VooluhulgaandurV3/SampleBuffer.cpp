@@ -0,0 +1,170 @@
+#include "SampleBuffer.h"
+
+#if SAMPLE_BUFFER_HAS_SPILL
+#include <Arduino.h>
+#include <SPIFFS.h>
+#endif
+
+// Ring modulus; never zero even when the flash ring is compiled out
+#define SPILL_SLOTS (SAMPLE_BUFFER_SPILL_RECORDS > 0 ? SAMPLE_BUFFER_SPILL_RECORDS : 1)
+
+SampleBuffer::SampleBuffer()
+    : ramHead(0), ramCount(0), ramLimit(SAMPLE_BUFFER_RAM_RECORDS), spillHead(0), spillCount(0),
+      spillReady(false), dropPolicy(DROP_OLDEST) {
+    resetStats();
+}
+
+bool SampleBuffer::begin() {
+#if SAMPLE_BUFFER_HAS_SPILL
+    if (!SPIFFS.begin(true)) {
+        Serial.println("Sample spill: SPIFFS unavailable, buffering in RAM only");
+        return false;
+    }
+    // Fixed-size file so every slot can be rewritten in place
+    spillFile = SPIFFS.open(SAMPLE_BUFFER_SPILL_PATH, "w+");
+    if (!spillFile) {
+        Serial.println("Sample spill: cannot open " SAMPLE_BUFFER_SPILL_PATH);
+        return false;
+    }
+    uint8_t empty[TELEMETRY_RECORD_SIZE] = {0};
+    for (size_t i = 0; i < SAMPLE_BUFFER_SPILL_RECORDS; i++) {
+        if (spillFile.write(empty, sizeof(empty)) != sizeof(empty)) {
+            Serial.println("Sample spill: not enough flash, buffering in RAM only");
+            spillFile.close();
+            return false;
+        }
+    }
+    spillFile.flush();
+    spillReady = true;
+    Serial.printf("Sample spill: %u records in flash\n", (unsigned)SAMPLE_BUFFER_SPILL_RECORDS);
+#endif
+    return true;
+}
+
+void SampleBuffer::setLimit(size_t maxRamRecords) {
+    if (maxRamRecords == 0) maxRamRecords = 1;
+    if (maxRamRecords > SAMPLE_BUFFER_RAM_RECORDS) maxRamRecords = SAMPLE_BUFFER_RAM_RECORDS;
+    ramLimit = maxRamRecords;
+    while (ramCount > ramLimit) {
+        if (!spillOldest()) {
+            ramHead = (ramHead + 1) % SAMPLE_BUFFER_RAM_RECORDS;
+            ramCount--;
+            stats.dropped++;
+        }
+    }
+}
+
+void SampleBuffer::resetStats() {
+    stats.buffered = 0;
+    stats.dropped = 0;
+    stats.replayed = 0;
+    stats.spilled = 0;
+}
+
+bool SampleBuffer::push(const TelemetryRecord& record) {
+    if (ramCount >= ramLimit && !spillOldest()) {
+        if (dropPolicy == DROP_NEWEST) {
+            stats.dropped++;
+            return false;
+        }
+        ramHead = (ramHead + 1) % SAMPLE_BUFFER_RAM_RECORDS;
+        ramCount--;
+        stats.dropped++;
+    }
+    ram[(ramHead + ramCount) % SAMPLE_BUFFER_RAM_RECORDS] = record;
+    ramCount++;
+    stats.buffered++;
+    return true;
+}
+
+size_t SampleBuffer::peek(TelemetryRecord* out, size_t max) {
+    size_t copied = 0;
+    for (size_t i = 0; i < spillCount && copied < max; i++) {
+        if (!readSpill((spillHead + i) % SPILL_SLOTS, out[copied])) {
+            return copied;
+        }
+        copied++;
+    }
+    for (size_t i = 0; i < ramCount && copied < max; i++) {
+        out[copied++] = ram[(ramHead + i) % SAMPLE_BUFFER_RAM_RECORDS];
+    }
+    return copied;
+}
+
+// Sequences only grow within a boot, and the buffer starts empty on every
+// boot, so everything up to lastSequence sits at the head
+void SampleBuffer::discardThrough(uint32_t lastSequence) {
+    TelemetryRecord record;
+    while (spillCount > 0) {
+        if (!readSpill(spillHead, record) || (int32_t)(record.sequence - lastSequence) > 0) {
+            return;  // Spilled records are older than RAM; nothing there is due either
+        }
+        spillHead = (spillHead + 1) % SPILL_SLOTS;
+        spillCount--;
+        stats.replayed++;
+    }
+    while (ramCount > 0 && (int32_t)(ram[ramHead].sequence - lastSequence) <= 0) {
+        ramHead = (ramHead + 1) % SAMPLE_BUFFER_RAM_RECORDS;
+        ramCount--;
+        stats.replayed++;
+    }
+}
+
+void SampleBuffer::clear() {
+    ramHead = 0;
+    ramCount = 0;
+    spillHead = 0;
+    spillCount = 0;
+}
+
+// Move the oldest RAM record to the flash ring; false if there is no
+// flash ring or the policy says the flash ring keeps what it has
+bool SampleBuffer::spillOldest() {
+    if (!spillReady || ramCount == 0) {
+        return false;
+    }
+    if (spillCount >= SPILL_SLOTS) {
+        if (dropPolicy == DROP_NEWEST) {
+            return false;
+        }
+        spillHead = (spillHead + 1) % SPILL_SLOTS;
+        spillCount--;
+        stats.dropped++;
+    }
+    if (!writeSpill((spillHead + spillCount) % SPILL_SLOTS, ram[ramHead])) {
+        return false;
+    }
+    spillCount++;
+    stats.spilled++;
+    ramHead = (ramHead + 1) % SAMPLE_BUFFER_RAM_RECORDS;
+    ramCount--;
+    return true;
+}
+
+#if SAMPLE_BUFFER_HAS_SPILL
+
+bool SampleBuffer::writeSpill(size_t slot, const TelemetryRecord& record) {
+    uint8_t encoded[TELEMETRY_RECORD_SIZE];
+    encodeTelemetryRecord(record, encoded);
+    if (!spillFile.seek(slot * TELEMETRY_RECORD_SIZE)) {
+        return false;
+    }
+    return spillFile.write(encoded, sizeof(encoded)) == sizeof(encoded);
+}
+
+bool SampleBuffer::readSpill(size_t slot, TelemetryRecord& record) {
+    uint8_t encoded[TELEMETRY_RECORD_SIZE];
+    if (!spillFile.seek(slot * TELEMETRY_RECORD_SIZE) ||
+        spillFile.read(encoded, sizeof(encoded)) != sizeof(encoded)) {
+        return false;
+    }
+    decodeTelemetryRecord(encoded, record);
+    return true;
+}
+
+#else
+
+bool SampleBuffer::writeSpill(size_t, const TelemetryRecord&) { return false; }
+bool SampleBuffer::readSpill(size_t, TelemetryRecord&) { return false; }
+
+#endif
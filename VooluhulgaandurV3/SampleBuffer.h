@@ -0,0 +1,88 @@
+#ifndef SAMPLEBUFFER_H
+#define SAMPLEBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TelemetryPacket.h"
+
+// Store-and-forward buffer for reports the main unit never got. Records
+// stay until a replayed batch is acked, oldest first.
+//
+// The RAM ring is sized at compile time; setLimit() can lower it at run
+// time. With SAMPLE_BUFFER_SPILL_RECORDS > 0 the oldest RAM records move
+// to a fixed-size ring file on SPIFFS instead of being dropped, so a long
+// outage keeps its timing at the cost of flash writes.
+#ifndef SAMPLE_BUFFER_RAM_RECORDS
+#define SAMPLE_BUFFER_RAM_RECORDS 256       // ~7 KB; 12.8 s at 20 Hz, 8.5 min of heartbeats
+#endif
+#ifndef SAMPLE_BUFFER_SPILL_RECORDS
+#define SAMPLE_BUFFER_SPILL_RECORDS 0       // Flash ring capacity, 0 = RAM only
+#endif
+#define SAMPLE_BUFFER_SPILL_PATH "/samples.bin"
+
+#if defined(ARDUINO) && SAMPLE_BUFFER_SPILL_RECORDS > 0
+#include <FS.h>
+#define SAMPLE_BUFFER_HAS_SPILL 1
+#else
+#define SAMPLE_BUFFER_HAS_SPILL 0
+#endif
+
+class SampleBuffer {
+public:
+    enum DropPolicy {
+        DROP_OLDEST,   // Keep the most recent outage history
+        DROP_NEWEST    // Keep the start of the outage
+    };
+
+    struct Stats {
+        uint32_t buffered;   // Records accepted
+        uint32_t dropped;    // Records lost to the size limit
+        uint32_t replayed;   // Records acked by the main unit
+        uint32_t spilled;    // Records moved to flash
+    };
+
+    SampleBuffer();
+    // Opens (and empties) the spill file when flash spill is enabled
+    bool begin();
+
+    void setLimit(size_t maxRamRecords);
+    void setDropPolicy(DropPolicy policy) { dropPolicy = policy; }
+
+    // Returns false if the limit forced this record to be dropped
+    bool push(const TelemetryRecord& record);
+    // Copy up to max of the oldest records without removing them
+    size_t peek(TelemetryRecord* out, size_t max);
+    // Remove the oldest records, up to and including lastSequence, once
+    // the main unit has them. By sequence rather than by count: records
+    // dropped while a batch was in flight must not take unsent ones along.
+    void discardThrough(uint32_t lastSequence);
+    void clear();
+
+    size_t size() const { return ramCount + spillCount; }
+    bool isEmpty() const { return size() == 0; }
+    size_t getLimit() const { return ramLimit; }
+
+    const Stats& getStats() const { return stats; }
+    void resetStats();
+
+private:
+    TelemetryRecord ram[SAMPLE_BUFFER_RAM_RECORDS];
+    size_t ramHead;
+    size_t ramCount;
+    size_t ramLimit;
+    // Spill ring in flash; always older than everything in RAM
+    size_t spillHead;
+    size_t spillCount;
+    bool spillReady;
+    DropPolicy dropPolicy;
+    Stats stats;
+#if SAMPLE_BUFFER_HAS_SPILL
+    fs::File spillFile;
+#endif
+
+    bool spillOldest();
+    bool writeSpill(size_t slot, const TelemetryRecord& record);
+    bool readSpill(size_t slot, TelemetryRecord& record);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer ring buffer.
+// The producer may be an interrupt handler: push() never blocks and, when the
+// ring is full, drops the new element and counts an overrun instead.
+// Capacity must be a power of two.
+template <typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), overruns(0) {}
+
+    // Producer side
+    __attribute__((always_inline)) inline bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+            overruns.store(overruns.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+            return false;
+        }
+        buffer[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = buffer[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+    bool empty() const { return size() == 0; }
+    uint32_t capacity() const { return Capacity; }
+
+    // Items dropped because the consumer fell behind
+    uint32_t overrunCount() const { return overruns.load(std::memory_order_relaxed); }
+
+private:
+    T buffer[Capacity];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> overruns;
+};
+
+#endif
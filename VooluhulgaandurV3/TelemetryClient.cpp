@@ -0,0 +1,185 @@
+#include "TelemetryClient.h"
+
+TelemetryClient::TelemetryClient(const char* path, uint16_t port)
+    : serverAddress((uint32_t)0), path(path), port(port) {
+    resetStats();
+}
+
+void TelemetryClient::setServer(const IPAddress& address, uint16_t serverPort) {
+    if (address != serverAddress || serverPort != port) {
+        disconnect();
+        serverAddress = address;
+        port = serverPort;
+    }
+}
+
+void TelemetryClient::disconnect() {
+    if (client.connected()) {
+        client.stop();
+    }
+}
+
+void TelemetryClient::resetStats() {
+    stats.requests = 0;
+    stats.failures = 0;
+    stats.reconnects = 0;
+    stats.lastRttUs = 0;
+    stats.minRttUs = 0;
+    stats.maxRttUs = 0;
+    stats.meanRttUs = 0;
+    rttSumUs = 0;
+}
+
+bool TelemetryClient::ensureConnected() {
+    if (client.connected()) {
+        return true;
+    }
+    if ((uint32_t)serverAddress == 0) {
+        return false;
+    }
+
+    client.stop();  // Release a socket the server already closed
+    if (!client.connect(serverAddress, port, TELEMETRY_CONNECT_TIMEOUT)) {
+        return false;
+    }
+    client.setNoDelay(true);  // Each report is one small segment; don't let Nagle hold it
+    stats.reconnects++;
+    Serial.printf("Telemetry connection opened to %s:%u\n", serverAddress.toString().c_str(), port);
+    return true;
+}
+
+bool TelemetryClient::post(const FlowSample& sample, const ReportId& id) {
+    if (!ensureConnected()) {
+        stats.failures++;
+        return false;
+    }
+
+    int bodyLength = snprintf(body, sizeof(body),
+                              "{\"flowRate\":%.3f,\"totalVolume\":%.4f,\"error\":%s,\"pulseCount\":%lu,"
+                              "\"bootId\":%lu,\"seq\":%lu,\"pulses\":%lu,\"ppl\":%.3f,\"time\":%lu}",
+                              sample.flowRate, sample.totalVolume, sample.error ? "true" : "false",
+                              (unsigned long)sample.totalPulses, (unsigned long)id.bootId,
+                              (unsigned long)id.sequence, (unsigned long)sample.lifetimePulses,
+                              sample.pulsesPerLiter, (unsigned long)sample.timestampMs);
+    int requestLength = snprintf(request, sizeof(request),
+                                 "POST %s HTTP/1.1\r\n"
+                                 "Host: %u.%u.%u.%u\r\n"
+                                 "Content-Type: application/json\r\n"
+                                 "Content-Length: %d\r\n"
+                                 "Connection: keep-alive\r\n"
+                                 "\r\n"
+                                 "%s",
+                                 path, serverAddress[0], serverAddress[1], serverAddress[2], serverAddress[3],
+                                 bodyLength, body);
+    if (bodyLength <= 0 || bodyLength >= (int)sizeof(body) || requestLength <= 0 ||
+        requestLength >= (int)sizeof(request)) {
+        stats.failures++;
+        return false;
+    }
+
+    uint32_t started = micros();
+    if (client.write((const uint8_t*)request, requestLength) != (size_t)requestLength) {
+        // Half-open connection (server rebooted); try once more on a new socket
+        client.stop();
+        if (!ensureConnected() ||
+            client.write((const uint8_t*)request, requestLength) != (size_t)requestLength) {
+            client.stop();
+            stats.failures++;
+            return false;
+        }
+        started = micros();
+    }
+
+    if (!readResponse(millis() + TELEMETRY_RESPONSE_TIMEOUT)) {
+        client.stop();
+        stats.failures++;
+        return false;
+    }
+
+    recordRtt(micros() - started);
+    stats.requests++;
+    return true;
+}
+
+// Read one CRLF-terminated line into the line buffer. Overlong lines are
+// truncated; only the status line and a few headers are ever looked at.
+bool TelemetryClient::readLine(unsigned long deadline) {
+    size_t length = 0;
+    while ((long)(deadline - millis()) > 0) {
+        int c = client.read();
+        if (c < 0) {
+            if (!client.connected()) {
+                return false;
+            }
+            delay(1);
+            continue;
+        }
+        if (c == '\n') {
+            if (length > 0 && line[length - 1] == '\r') {
+                length--;
+            }
+            line[length] = '\0';
+            return true;
+        }
+        if (length < sizeof(line) - 1) {
+            line[length++] = (char)c;
+        }
+    }
+    return false;
+}
+
+bool TelemetryClient::readResponse(unsigned long deadline) {
+    if (!readLine(deadline)) {
+        return false;
+    }
+    // "HTTP/1.1 200 OK"
+    const char* space = strchr(line, ' ');
+    int statusCode = space ? atoi(space + 1) : 0;
+
+    long contentLength = 0;
+    bool serverCloses = strncmp(line, "HTTP/1.0", 8) == 0;
+    for (;;) {
+        if (!readLine(deadline)) {
+            return false;
+        }
+        if (line[0] == '\0') {
+            break;  // End of headers
+        }
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = atol(line + 15);
+        } else if (strncasecmp(line, "Connection:", 11) == 0) {
+            serverCloses = strcasestr(line + 11, "close") != nullptr;
+        }
+    }
+
+    // Discard the body so the next response starts clean
+    while (contentLength > 0 && (long)(deadline - millis()) > 0) {
+        if (client.read() >= 0) {
+            contentLength--;
+        } else if (!client.connected()) {
+            return false;
+        } else {
+            delay(1);
+        }
+    }
+    if (contentLength > 0) {
+        return false;
+    }
+
+    if (serverCloses) {
+        client.stop();
+    }
+    if (statusCode != 200) {
+        Serial.printf("Telemetry HTTP error: %d\n", statusCode);
+        return false;
+    }
+    return true;
+}
+
+void TelemetryClient::recordRtt(uint32_t rttUs) {
+    stats.lastRttUs = rttUs;
+    if (stats.requests == 0 || rttUs < stats.minRttUs) stats.minRttUs = rttUs;
+    if (rttUs > stats.maxRttUs) stats.maxRttUs = rttUs;
+    rttSumUs += rttUs;
+    stats.meanRttUs = (uint32_t)(rttSumUs / (stats.requests + 1));
+}
@@ -0,0 +1,58 @@
+#ifndef TELEMETRYCLIENT_H
+#define TELEMETRYCLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "FlowSample.h"
+
+#define TELEMETRY_HTTP_PORT 8080        // Main unit's keep-alive flow listener
+#define TELEMETRY_RESPONSE_TIMEOUT 300  // ms to wait for the main unit's reply
+#define TELEMETRY_CONNECT_TIMEOUT 1000  // ms for a fresh TCP connection
+
+// Round-trip statistics for telemetry requests
+struct TelemetryStats {
+    uint32_t requests;     // Successful request/response pairs
+    uint32_t failures;     // Requests without a valid 200 reply
+    uint32_t reconnects;   // TCP connections opened
+    uint32_t lastRttUs;
+    uint32_t minRttUs;
+    uint32_t maxRttUs;
+    uint32_t meanRttUs;
+};
+
+// Posts flow samples to the main unit over one persistent HTTP/1.1
+// connection. The connection is reopened on the next report whenever the
+// server closes it or a request fails. Requests are formatted into fixed
+// buffers, so a report costs no heap allocation once connected.
+class TelemetryClient {
+public:
+    TelemetryClient(const char* path, uint16_t port = TELEMETRY_HTTP_PORT);
+
+    // Change the target; drops the current connection if it differs
+    void setServer(const IPAddress& address, uint16_t serverPort = TELEMETRY_HTTP_PORT);
+    bool post(const FlowSample& sample, const ReportId& id);
+    void disconnect();
+
+    bool isConnected() { return client.connected(); }
+    const TelemetryStats& getStats() const { return stats; }
+    void resetStats();
+
+private:
+    WiFiClient client;
+    IPAddress serverAddress;
+    const char* path;
+    uint16_t port;
+    TelemetryStats stats;
+    uint64_t rttSumUs;
+
+    char body[192];
+    char request[448];
+    char line[128];
+
+    bool ensureConnected();
+    bool readLine(unsigned long deadline);
+    bool readResponse(unsigned long deadline);
+    void recordRtt(uint32_t rttUs);
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef TELEMETRYPACKET_H
+#define TELEMETRYPACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Binary flow telemetry between flow units and the main unit, one UDP
+// datagram per message. Every field has a fixed offset and is little endian,
+// so both ends (and host tools) encode and decode without padding or
+// alignment surprises. Keep this file identical in the flow unit and main
+// unit sketches.
+//
+// Report, 40 bytes:
+//    0  u16  magic           TELEMETRY_MAGIC
+//    2  u8   version         TELEMETRY_VERSION
+//    3  u8   type            TELEMETRY_TYPE_REPORT
+//    4  u8   unitId          Flow sensor 1..TELEMETRY_MAX_UNITS (main unit TelemetryReceiver.h)
+//    5  u8   flags           TELEMETRY_FLAG_*
+//    6  u16  reserved        0
+//    8  u32  sequence        +1 per report within one boot, wraps
+//   12  u32  sensorTimeMs    millis() on the flow unit when sampled
+//   16  u32  totalPulses     Pulses since the last volume reset
+//   20  f32  flowRate        L/min
+//   24  f32  totalVolume     L since the last volume reset
+//   28  f32  pulsesPerLiter  K-factor used for the sample
+//   32  u32  bootId          Random per flow unit boot, never 0
+//   36  u32  lifetimePulses  Pulses since boot, never reset, wraps
+//
+// The receiver derives volume from lifetimePulses deltas, so lost reports
+// cost no volume, and uses bootId/sequence to tell loss, duplicates,
+// reordering and sensor reboots apart (see TelemetryTracker on the main
+// unit).
+//
+// Ack, 12 bytes: magic, version, type = TELEMETRY_TYPE_ACK, unitId,
+// flags (TELEMETRY_ACK_FLAG_*), 2 reserved bytes, then the acknowledged
+// sequence (or batch ID) at offset 8.
+//
+// Batch, 20 bytes + 24 per record: samples buffered on the flow unit while
+// the main unit was unreachable, replayed oldest first once acks flow again.
+//    0  8-byte header, type TELEMETRY_TYPE_BATCH
+//    8  u32  batchId         Acked with TELEMETRY_ACK_FLAG_BATCH
+//   12  u32  bootId
+//   16  u8   count           1..TELEMETRY_BATCH_MAX_RECORDS
+//   17  u8[3] reserved
+//   20  records, each:
+//        0  u32  sequence
+//        4  u32  sensorTimeMs
+//        8  u32  lifetimePulses
+//       12  u32  totalPulses
+//       16  f32  flowRate
+//       20  u16  pulsesPerLiter x10
+//       22  u8   flags
+//       23  u8   reserved
+//
+// Session event, 24 bytes, main unit -> flow unit (to the port its reports
+// come from), repeated until the flow unit acks it with
+// TELEMETRY_ACK_FLAG_SESSION:
+//    0  8-byte header, type TELEMETRY_TYPE_SESSION, unitId = target sensor
+//    8  u32  eventSequence   Per main unit boot, acked back
+//   12  u32  sessionId       Changes with every dispense
+//   16  u8   event           TELEMETRY_SESSION_*
+//   17  u8[3] reserved
+//   20  f32  targetVolume    L
+//
+// Beacon, 24 bytes, broadcast by the main unit to TELEMETRY_BEACON_PORT:
+//    0  8-byte header, type TELEMETRY_TYPE_BEACON, unitId 0
+//    8  u8[4] apAddress      Soft-AP address, 0.0.0.0 if the AP is off
+//   12  u8[4] staAddress     Station address, 0.0.0.0 if not connected
+//   16  u16  telemetryPort   UDP telemetry
+//   18  u16  keepAlivePort   HTTP keep-alive flow listener
+//   20  u16  httpPort        Web interface and legacy /flow routes
+//   22  u16  apiVersion      TELEMETRY_API_VERSION
+
+#define TELEMETRY_UDP_PORT 12347
+#define TELEMETRY_MAGIC 0x464A   // "JF"
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_TYPE_REPORT 1
+#define TELEMETRY_TYPE_ACK 2
+#define TELEMETRY_TYPE_BEACON 3
+#define TELEMETRY_TYPE_BATCH 4
+#define TELEMETRY_TYPE_SESSION 5
+#define TELEMETRY_REPORT_SIZE 40
+#define TELEMETRY_ACK_SIZE 12
+#define TELEMETRY_BEACON_SIZE 24
+#define TELEMETRY_BATCH_HEADER_SIZE 20
+#define TELEMETRY_RECORD_SIZE 24
+#define TELEMETRY_BATCH_MAX_RECORDS 20
+#define TELEMETRY_SESSION_SIZE 24
+#define TELEMETRY_BEACON_PORT 12345     // Flow units listen for beacons here
+#define TELEMETRY_API_VERSION 1
+#define TELEMETRY_MAX_PACKET (TELEMETRY_BATCH_HEADER_SIZE + TELEMETRY_BATCH_MAX_RECORDS * TELEMETRY_RECORD_SIZE)
+
+#define TELEMETRY_FLAG_ERROR 0x01  // No pulses for 5 seconds
+#define TELEMETRY_FLAG_REPLAYED 0x02  // Came out of a replay batch, not live
+#define TELEMETRY_ACK_FLAG_BATCH 0x01  // Ack is for a batch ID, not a report sequence
+#define TELEMETRY_ACK_FLAG_SESSION 0x02  // Ack is for a session event sequence
+
+#define TELEMETRY_SESSION_START 1   // Pump switched on for a new session
+#define TELEMETRY_SESSION_STOP 2    // Session finished, stopped or failed
+
+struct TelemetryReport {
+    uint8_t unitId;
+    uint8_t flags;
+    uint32_t sequence;
+    uint32_t sensorTimeMs;
+    uint32_t totalPulses;
+    float flowRate;
+    float totalVolume;
+    float pulsesPerLiter;
+    uint32_t bootId;
+    uint32_t lifetimePulses;
+};
+
+struct TelemetryAck {
+    uint8_t unitId;
+    uint8_t flags;
+    uint32_t sequence;
+};
+
+// One buffered sample inside a batch
+struct TelemetryRecord {
+    uint32_t sequence;
+    uint32_t sensorTimeMs;
+    uint32_t lifetimePulses;
+    uint32_t totalPulses;
+    float flowRate;
+    float pulsesPerLiter;
+    uint8_t flags;
+};
+
+struct TelemetrySession {
+    uint8_t unitId;
+    uint32_t eventSequence;
+    uint32_t sessionId;
+    uint8_t event;
+    float targetVolume;
+};
+
+struct TelemetryBatch {
+    uint8_t unitId;
+    uint32_t batchId;
+    uint32_t bootId;
+    uint8_t count;
+};
+
+struct TelemetryBeacon {
+    uint8_t apAddress[4];
+    uint8_t staAddress[4];
+    uint16_t telemetryPort;
+    uint16_t keepAlivePort;
+    uint16_t httpPort;
+    uint16_t apiVersion;
+};
+
+namespace telemetry_wire {
+
+inline void put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+inline void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+inline void putFloat(uint8_t* p, float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    put32(p, v);
+}
+
+inline uint16_t get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline float getFloat(const uint8_t* p) {
+    uint32_t v = get32(p);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+inline void putHeader(uint8_t* p, uint8_t type, uint8_t unitId, uint8_t flags) {
+    put16(p, TELEMETRY_MAGIC);
+    p[2] = TELEMETRY_VERSION;
+    p[3] = type;
+    p[4] = unitId;
+    p[5] = flags;
+    put16(p + 6, 0);
+}
+
+}  // namespace telemetry_wire
+
+// Message type of a received datagram, or 0 if it is not telemetry
+inline uint8_t telemetryPacketType(const uint8_t* buffer, size_t length) {
+    if (length < 4 || telemetry_wire::get16(buffer) != TELEMETRY_MAGIC || buffer[2] != TELEMETRY_VERSION) {
+        return 0;
+    }
+    return buffer[3];
+}
+
+// Encoders return the datagram length, or 0 if the buffer is too small
+inline size_t encodeTelemetryReport(const TelemetryReport& report, uint8_t* buffer, size_t capacity) {
+    if (capacity < TELEMETRY_REPORT_SIZE) return 0;
+    telemetry_wire::putHeader(buffer, TELEMETRY_TYPE_REPORT, report.unitId, report.flags);
+    telemetry_wire::put32(buffer + 8, report.sequence);
+    telemetry_wire::put32(buffer + 12, report.sensorTimeMs);
+    telemetry_wire::put32(buffer + 16, report.totalPulses);
+    telemetry_wire::putFloat(buffer + 20, report.flowRate);
+    telemetry_wire::putFloat(buffer + 24, report.totalVolume);
+    telemetry_wire::putFloat(buffer + 28, report.pulsesPerLiter);
+    telemetry_wire::put32(buffer + 32, report.bootId);
+    telemetry_wire::put32(buffer + 36, report.lifetimePulses);
+    return TELEMETRY_REPORT_SIZE;
+}
+
+inline bool decodeTelemetryReport(const uint8_t* buffer, size_t length, TelemetryReport& report) {
+    if (length < TELEMETRY_REPORT_SIZE || telemetryPacketType(buffer, length) != TELEMETRY_TYPE_REPORT) {
+        return false;
+    }
+    report.unitId = buffer[4];
+    report.flags = buffer[5];
+    report.sequence = telemetry_wire::get32(buffer + 8);
+    report.sensorTimeMs = telemetry_wire::get32(buffer + 12);
+    report.totalPulses = telemetry_wire::get32(buffer + 16);
+    report.flowRate = telemetry_wire::getFloat(buffer + 20);
+    report.totalVolume = telemetry_wire::getFloat(buffer + 24);
+    report.pulsesPerLiter = telemetry_wire::getFloat(buffer + 28);
+    report.bootId = telemetry_wire::get32(buffer + 32);
+    report.lifetimePulses = telemetry_wire::get32(buffer + 36);
+    return true;
+}
+
+inline size_t encodeTelemetryAck(const TelemetryAck& ack, uint8_t* buffer, size_t capacity) {
+    if (capacity < TELEMETRY_ACK_SIZE) return 0;
+    telemetry_wire::putHeader(buffer, TELEMETRY_TYPE_ACK, ack.unitId, ack.flags);
+    telemetry_wire::put32(buffer + 8, ack.sequence);
+    return TELEMETRY_ACK_SIZE;
+}
+
+inline bool decodeTelemetryAck(const uint8_t* buffer, size_t length, TelemetryAck& ack) {
+    if (length < TELEMETRY_ACK_SIZE || telemetryPacketType(buffer, length) != TELEMETRY_TYPE_ACK) {
+        return false;
+    }
+    ack.unitId = buffer[4];
+    ack.flags = buffer[5];
+    ack.sequence = telemetry_wire::get32(buffer + 8);
+    return true;
+}
+
+inline size_t encodeTelemetryBeacon(const TelemetryBeacon& beacon, uint8_t* buffer, size_t capacity) {
+    if (capacity < TELEMETRY_BEACON_SIZE) return 0;
+    telemetry_wire::putHeader(buffer, TELEMETRY_TYPE_BEACON, 0, 0);
+    memcpy(buffer + 8, beacon.apAddress, 4);
+    memcpy(buffer + 12, beacon.staAddress, 4);
+    telemetry_wire::put16(buffer + 16, beacon.telemetryPort);
+    telemetry_wire::put16(buffer + 18, beacon.keepAlivePort);
+    telemetry_wire::put16(buffer + 20, beacon.httpPort);
+    telemetry_wire::put16(buffer + 22, beacon.apiVersion);
+    return TELEMETRY_BEACON_SIZE;
+}
+
+inline bool decodeTelemetryBeacon(const uint8_t* buffer, size_t length, TelemetryBeacon& beacon) {
+    if (length < TELEMETRY_BEACON_SIZE || telemetryPacketType(buffer, length) != TELEMETRY_TYPE_BEACON) {
+        return false;
+    }
+    memcpy(beacon.apAddress, buffer + 8, 4);
+    memcpy(beacon.staAddress, buffer + 12, 4);
+    beacon.telemetryPort = telemetry_wire::get16(buffer + 16);
+    beacon.keepAlivePort = telemetry_wire::get16(buffer + 18);
+    beacon.httpPort = telemetry_wire::get16(buffer + 20);
+    beacon.apiVersion = telemetry_wire::get16(buffer + 22);
+    return true;
+}
+
+inline void encodeTelemetryRecord(const TelemetryRecord& record, uint8_t* p) {
+    float scaledK = record.pulsesPerLiter * 10.0f + 0.5f;
+    if (scaledK < 0.0f) scaledK = 0.0f;
+    if (scaledK > 65535.0f) scaledK = 65535.0f;
+    telemetry_wire::put32(p, record.sequence);
+    telemetry_wire::put32(p + 4, record.sensorTimeMs);
+    telemetry_wire::put32(p + 8, record.lifetimePulses);
+    telemetry_wire::put32(p + 12, record.totalPulses);
+    telemetry_wire::putFloat(p + 16, record.flowRate);
+    telemetry_wire::put16(p + 20, (uint16_t)scaledK);
+    p[22] = record.flags;
+    p[23] = 0;
+}
+
+inline void decodeTelemetryRecord(const uint8_t* p, TelemetryRecord& record) {
+    record.sequence = telemetry_wire::get32(p);
+    record.sensorTimeMs = telemetry_wire::get32(p + 4);
+    record.lifetimePulses = telemetry_wire::get32(p + 8);
+    record.totalPulses = telemetry_wire::get32(p + 12);
+    record.flowRate = telemetry_wire::getFloat(p + 16);
+    record.pulsesPerLiter = telemetry_wire::get16(p + 20) / 10.0f;
+    record.flags = p[22];
+}
+
+inline size_t encodeTelemetryBatch(const TelemetryBatch& batch, const TelemetryRecord* records,
+                                   uint8_t* buffer, size_t capacity) {
+    size_t length = TELEMETRY_BATCH_HEADER_SIZE + (size_t)batch.count * TELEMETRY_RECORD_SIZE;
+    if (batch.count == 0 || batch.count > TELEMETRY_BATCH_MAX_RECORDS || capacity < length) return 0;
+    telemetry_wire::putHeader(buffer, TELEMETRY_TYPE_BATCH, batch.unitId, 0);
+    telemetry_wire::put32(buffer + 8, batch.batchId);
+    telemetry_wire::put32(buffer + 12, batch.bootId);
+    buffer[16] = batch.count;
+    buffer[17] = buffer[18] = buffer[19] = 0;
+    for (uint8_t i = 0; i < batch.count; i++) {
+        encodeTelemetryRecord(records[i], buffer + TELEMETRY_BATCH_HEADER_SIZE + i * TELEMETRY_RECORD_SIZE);
+    }
+    return length;
+}
+
+// Validates the header and length; records are then read one at a time
+inline bool decodeTelemetryBatch(const uint8_t* buffer, size_t length, TelemetryBatch& batch) {
+    if (length < TELEMETRY_BATCH_HEADER_SIZE || telemetryPacketType(buffer, length) != TELEMETRY_TYPE_BATCH) {
+        return false;
+    }
+    batch.unitId = buffer[4];
+    batch.batchId = telemetry_wire::get32(buffer + 8);
+    batch.bootId = telemetry_wire::get32(buffer + 12);
+    batch.count = buffer[16];
+    return batch.count > 0 && batch.count <= TELEMETRY_BATCH_MAX_RECORDS &&
+           length >= TELEMETRY_BATCH_HEADER_SIZE + (size_t)batch.count * TELEMETRY_RECORD_SIZE;
+}
+
+inline void getTelemetryBatchRecord(const uint8_t* buffer, uint8_t index, TelemetryRecord& record) {
+    decodeTelemetryRecord(buffer + TELEMETRY_BATCH_HEADER_SIZE + index * TELEMETRY_RECORD_SIZE, record);
+}
+
+inline size_t encodeTelemetrySession(const TelemetrySession& session, uint8_t* buffer, size_t capacity) {
+    if (capacity < TELEMETRY_SESSION_SIZE) return 0;
+    telemetry_wire::putHeader(buffer, TELEMETRY_TYPE_SESSION, session.unitId, 0);
+    telemetry_wire::put32(buffer + 8, session.eventSequence);
+    telemetry_wire::put32(buffer + 12, session.sessionId);
+    buffer[16] = session.event;
+    buffer[17] = buffer[18] = buffer[19] = 0;
+    telemetry_wire::putFloat(buffer + 20, session.targetVolume);
+    return TELEMETRY_SESSION_SIZE;
+}
+
+inline bool decodeTelemetrySession(const uint8_t* buffer, size_t length, TelemetrySession& session) {
+    if (length < TELEMETRY_SESSION_SIZE || telemetryPacketType(buffer, length) != TELEMETRY_TYPE_SESSION) {
+        return false;
+    }
+    session.unitId = buffer[4];
+    session.eventSequence = telemetry_wire::get32(buffer + 8);
+    session.sessionId = telemetry_wire::get32(buffer + 12);
+    session.event = buffer[16];
+    session.targetVolume = telemetry_wire::getFloat(buffer + 20);
+    return true;
+}
+
+#endif
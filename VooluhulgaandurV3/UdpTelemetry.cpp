@@ -0,0 +1,167 @@
+#include "UdpTelemetry.h"
+
+UdpTelemetry::UdpTelemetry(uint8_t unitId, uint16_t port)
+    : serverAddress((uint32_t)0), serverPort(port), unitId(unitId), port(port), lastAckTime(0),
+      lastBatchAck(0), batchAcked(false), newestReportAck(0), reportAckBits(0), haveSession(false), sessionPending(false), started(false) {
+    resetStats();
+    for (int i = 0; i < UDP_TELEMETRY_RTT_SLOTS; i++) {
+        sendTimesUs[i] = 0;
+        sendSequences[i] = 0xFFFFFFFF;
+    }
+}
+
+bool UdpTelemetry::begin() {
+    // Bound to the telemetry port so acks come back to a fixed place
+    started = udp.begin(port);
+    if (!started) {
+        Serial.println("Failed to open UDP telemetry socket");
+    }
+    return started;
+}
+
+void UdpTelemetry::resetStats() {
+    stats.sent = 0;
+    stats.acked = 0;
+    stats.lastRttUs = 0;
+    stats.maxRttUs = 0;
+    stats.batches = 0;
+}
+
+bool UdpTelemetry::send(const FlowSample& sample, const ReportId& id) {
+    if (!started || (uint32_t)serverAddress == 0) {
+        return false;
+    }
+
+    TelemetryReport report;
+    report.unitId = unitId;
+    report.flags = sample.error ? TELEMETRY_FLAG_ERROR : 0;
+    report.sequence = id.sequence;
+    report.sensorTimeMs = sample.timestampMs;
+    report.totalPulses = (uint32_t)sample.totalPulses;
+    report.flowRate = sample.flowRate;
+    report.totalVolume = sample.totalVolume;
+    report.pulsesPerLiter = sample.pulsesPerLiter;
+    report.bootId = id.bootId;
+    report.lifetimePulses = sample.lifetimePulses;
+
+    size_t length = encodeTelemetryReport(report, packet, sizeof(packet));
+    if (!udp.beginPacket(serverAddress, serverPort)) {
+        return false;
+    }
+    udp.write(packet, length);
+    if (!udp.endPacket()) {
+        return false;
+    }
+
+    int slot = id.sequence % UDP_TELEMETRY_RTT_SLOTS;
+    sendTimesUs[slot] = micros();
+    sendSequences[slot] = id.sequence;
+    stats.sent++;
+    return true;
+}
+
+bool UdpTelemetry::sendBatch(const TelemetryBatch& batch, const TelemetryRecord* records) {
+    if (!started || (uint32_t)serverAddress == 0) {
+        return false;
+    }
+    size_t length = encodeTelemetryBatch(batch, records, packet, sizeof(packet));
+    if (length == 0 || !udp.beginPacket(serverAddress, serverPort)) {
+        return false;
+    }
+    udp.write(packet, length);
+    if (!udp.endPacket()) {
+        return false;
+    }
+    stats.batches++;
+    return true;
+}
+
+void UdpTelemetry::poll() {
+    if (!started) {
+        return;
+    }
+    while (udp.parsePacket() > 0) {
+        int length = udp.read(packet, sizeof(packet));
+        if (length > 0 && telemetryPacketType(packet, length) == TELEMETRY_TYPE_SESSION) {
+            handleSession(length);
+            continue;
+        }
+        TelemetryAck ack;
+        if (length <= 0 || !decodeTelemetryAck(packet, length, ack) || ack.unitId != unitId) {
+            continue;
+        }
+
+        lastAckTime = millis();
+        if (ack.flags & TELEMETRY_ACK_FLAG_BATCH) {
+            lastBatchAck = ack.sequence;
+            batchAcked = true;
+            continue;
+        }
+        stats.acked++;
+        noteReportAck(ack.sequence);
+        int slot = ack.sequence % UDP_TELEMETRY_RTT_SLOTS;
+        if (sendSequences[slot] == ack.sequence) {
+            uint32_t rtt = micros() - sendTimesUs[slot];
+            stats.lastRttUs = rtt;
+            if (rtt > stats.maxRttUs) stats.maxRttUs = rtt;
+            sendSequences[slot] = 0xFFFFFFFF;  // Ignore duplicate acks
+        }
+    }
+}
+
+void UdpTelemetry::noteReportAck(uint32_t sequence) {
+    int32_t ahead = (int32_t)(sequence - newestReportAck);
+    if (reportAckBits == 0 || ahead > 0) {
+        reportAckBits = (reportAckBits == 0 || ahead >= UDP_TELEMETRY_ACK_WINDOW) ? 0 : reportAckBits << ahead;
+        reportAckBits |= 1;
+        newestReportAck = sequence;
+    } else if (-ahead < UDP_TELEMETRY_ACK_WINDOW) {
+        reportAckBits |= 1ULL << -ahead;  // Acks can arrive out of order
+    }
+}
+
+bool UdpTelemetry::isReportAcked(uint32_t sequence) const {
+    int32_t behind = (int32_t)(newestReportAck - sequence);
+    return reportAckBits != 0 && behind >= 0 && behind < UDP_TELEMETRY_ACK_WINDOW &&
+           ((reportAckBits >> behind) & 1) != 0;
+}
+
+bool UdpTelemetry::isHealthy() const {
+    return lastAckTime != 0 && millis() - lastAckTime < UDP_TELEMETRY_ACK_TIMEOUT;
+}
+
+void UdpTelemetry::handleSession(int length) {
+    TelemetrySession event;
+    if (!decodeTelemetrySession(packet, length, event) || event.unitId != unitId) {
+        return;
+    }
+
+    // Ack every copy; the main unit repeats until one of these gets through
+    TelemetryAck ack;
+    ack.unitId = unitId;
+    ack.flags = TELEMETRY_ACK_FLAG_SESSION;
+    ack.sequence = event.eventSequence;
+    uint8_t reply[TELEMETRY_ACK_SIZE];
+    size_t replyLength = encodeTelemetryAck(ack, reply, sizeof(reply));
+    if (udp.beginPacket(udp.remoteIP(), udp.remotePort())) {
+        udp.write(reply, replyLength);
+        udp.endPacket();
+    }
+
+    if (haveSession && event.eventSequence == lastSession.eventSequence &&
+        event.sessionId == lastSession.sessionId && event.event == lastSession.event) {
+        return;  // Repeat of an event we already have
+    }
+    lastSession = event;
+    haveSession = true;
+    sessionPending = true;
+}
+
+bool UdpTelemetry::takeSessionEvent(TelemetrySession& event) {
+    if (!sessionPending) {
+        return false;
+    }
+    event = lastSession;
+    sessionPending = false;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef UDPTELEMETRY_H
+#define UDPTELEMETRY_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "FlowSample.h"
+#include "TelemetryPacket.h"
+
+#define UDP_TELEMETRY_ACK_TIMEOUT 2000  // ms without an ack before HTTP takes over
+#define UDP_TELEMETRY_RTT_SLOTS 8       // Send times kept for matching acks
+#define UDP_TELEMETRY_ACK_WINDOW 64     // Report acks remembered, back from the newest (3.2 s at 20 Hz)
+
+// Sends flow samples to the main unit as binary telemetry datagrams and
+// tracks the main unit's acks. The link counts as healthy while acks keep
+// arriving; the caller falls back to HTTP otherwise. Session events pushed
+// by the main unit arrive on the same socket and are acked here.
+class UdpTelemetry {
+public:
+    struct Stats {
+        uint32_t sent;
+        uint32_t acked;
+        uint32_t lastRttUs;
+        uint32_t maxRttUs;
+        uint32_t batches;   // Replay batches sent
+    };
+
+    UdpTelemetry(uint8_t unitId, uint16_t port = TELEMETRY_UDP_PORT);
+    bool begin();
+
+    void setServer(const IPAddress& address, uint16_t remotePort = TELEMETRY_UDP_PORT) {
+        serverAddress = address;
+        serverPort = remotePort;
+    }
+    bool send(const FlowSample& sample, const ReportId& id);
+    // Replay of buffered samples; the main unit acks the batch ID
+    bool sendBatch(const TelemetryBatch& batch, const TelemetryRecord* records);
+    bool isBatchAcked(uint32_t batchId) const { return batchAcked && lastBatchAck == batchId; }
+    // Whether the main unit acked this report; only recent ones are remembered
+    bool isReportAcked(uint32_t sequence) const;
+    // Newest session event not yet taken; repeats of one event are delivered once
+    bool takeSessionEvent(TelemetrySession& event);
+    // Drain acks; call often so RTT measurements stay accurate
+    void poll();
+    bool isHealthy() const;
+
+    const Stats& getStats() const { return stats; }
+    void resetStats();
+
+private:
+    WiFiUDP udp;
+    IPAddress serverAddress;
+    uint16_t serverPort;
+    uint8_t unitId;
+    uint16_t port;  // Local port acks come back to
+    unsigned long lastAckTime;
+    uint32_t lastBatchAck;
+    bool batchAcked;
+    uint32_t newestReportAck;
+    uint64_t reportAckBits;     // Bit n: newestReportAck - n was acked
+    TelemetrySession lastSession;
+    bool haveSession;
+    bool sessionPending;
+    bool started;
+    Stats stats;
+    uint32_t sendTimesUs[UDP_TELEMETRY_RTT_SLOTS];
+    uint32_t sendSequences[UDP_TELEMETRY_RTT_SLOTS];
+    uint8_t packet[TELEMETRY_MAX_PACKET];
+
+    void handleSession(int length);
+    void noteReportAck(uint32_t sequence);
+};
+
+#endif
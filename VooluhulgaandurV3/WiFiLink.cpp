@@ -0,0 +1,169 @@
+#include "WiFiLink.h"
+
+const uint32_t ReconnectHistogram::bounds[WIFI_LINK_HISTOGRAM_BUCKETS - 1] = {
+    250, 500, 1000, 2000, 5000, 10000, 30000
+};
+
+void ReconnectHistogram::clear() {
+    for (int i = 0; i < WIFI_LINK_HISTOGRAM_BUCKETS; i++) counts[i] = 0;
+    lastMs = 0;
+    maxMs = 0;
+}
+
+void ReconnectHistogram::record(uint32_t ms) {
+    int bucket = 0;
+    while (bucket < WIFI_LINK_HISTOGRAM_BUCKETS - 1 && ms >= bounds[bucket]) {
+        bucket++;
+    }
+    counts[bucket]++;
+    lastMs = ms;
+    if (ms > maxMs) maxMs = ms;
+}
+
+WiFiLink::WiFiLink()
+    : profileCount(0), currentProfile(-1), state(IDLE), attemptStarted(0), outageStarted(0),
+      waitStarted(0), disconnectCount(0), connectedCallback(nullptr), gotIpEvent(false),
+      disconnectedEvent(false), earlyDisconnect(false) {
+    histogram.clear();
+}
+
+// The list may be rebuilt while connected (a newly cached endpoint moves to
+// the front). The current index is then found again by addProfile() from
+// the network the station is actually on, so a later link loss retries it.
+void WiFiLink::clearProfiles() {
+    profileCount = 0;
+    if (state == CONNECTED) {
+        currentProfile = -1;
+    }
+}
+
+bool WiFiLink::addProfile(const WiFiProfile& profile) {
+    if (profileCount >= WIFI_LINK_MAX_PROFILES) {
+        return false;
+    }
+    if (state == CONNECTED && currentProfile < 0 && isCurrentNetwork(profile)) {
+        currentProfile = profileCount;
+    }
+    profiles[profileCount++] = profile;
+    return true;
+}
+
+bool WiFiLink::isCurrentNetwork(const WiFiProfile& profile) const {
+    if (WiFi.SSID() != profile.ssid) {
+        return false;
+    }
+    uint8_t* bssid = WiFi.BSSID();
+    return !profile.hasBssid || (bssid && memcmp(bssid, profile.bssid, sizeof(profile.bssid)) == 0);
+}
+
+void WiFiLink::setConnectedCallback(void (*callback)(const WiFiProfile&, uint32_t)) {
+    connectedCallback = callback;
+}
+
+void WiFiLink::begin() {
+    WiFi.persistent(false);       // Profiles live in our own cache, not the SDK's flash
+    WiFi.setAutoReconnect(false); // We pick the next network ourselves
+    WiFi.mode(WIFI_STA);
+
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+        gotIpEvent = true;
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t info) {
+        disconnectedEvent = true;
+    }, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+
+    outageStarted = millis();
+    startAttempt(0);
+}
+
+unsigned long WiFiLink::attemptTimeout() const {
+    const WiFiProfile& profile = profiles[currentProfile];
+    return (profile.channel > 0 && profile.hasBssid) ? WIFI_LINK_CACHED_TIMEOUT : WIFI_LINK_SCAN_TIMEOUT;
+}
+
+void WiFiLink::startAttempt(int index) {
+    if (index >= profileCount) {
+        // Everything failed; pause so we don't hammer the radio
+        state = WAITING;
+        waitStarted = millis();
+        currentProfile = -1;
+        return;
+    }
+
+    currentProfile = index;
+    const WiFiProfile& profile = profiles[index];
+    Serial.printf("WiFi: trying '%s'%s%s\n", profile.ssid,
+                  profile.hasBssid ? " (cached channel/BSSID)" : "",
+                  (uint32_t)profile.localIP != 0 ? " (static IP)" : "");
+
+    if ((uint32_t)profile.localIP != 0) {
+        WiFi.config(profile.localIP, profile.gateway, profile.subnet);
+    } else {
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    }
+    gotIpEvent = false;
+    disconnectedEvent = false;
+    earlyDisconnect = false;
+    WiFi.begin(profile.ssid, profile.password, profile.channel,
+               profile.hasBssid ? profile.bssid : nullptr);
+    state = CONNECTING;
+    attemptStarted = millis();
+}
+
+void WiFiLink::poll() {
+    switch (state) {
+        case IDLE:
+            break;
+
+        case CONNECTING:
+            if (gotIpEvent.exchange(false) || WiFi.status() == WL_CONNECTED) {
+                state = CONNECTED;
+                uint32_t reconnectMs = millis() - outageStarted;
+                histogram.record(reconnectMs);
+                Serial.printf("WiFi: connected to '%s' in %lu ms, IP %s\n", profiles[currentProfile].ssid,
+                              (unsigned long)reconnectMs, WiFi.localIP().toString().c_str());
+                if (connectedCallback) {
+                    connectedCallback(profiles[currentProfile], reconnectMs);
+                }
+            } else {
+                unsigned long elapsed = millis() - attemptStarted;
+                bool rejected = false;
+                if (disconnectedEvent.exchange(false)) {
+                    if (elapsed > WIFI_LINK_STALE_EVENT_MS) {
+                        rejected = true;
+                    } else {
+                        // Usually the previous attempt's teardown, but it may be
+                        // a quick rejection of this one: re-check after the window
+                        earlyDisconnect = true;
+                    }
+                } else if (earlyDisconnect && elapsed > WIFI_LINK_STALE_EVENT_MS) {
+                    earlyDisconnect = false;
+                    wl_status_t status = WiFi.status();
+                    rejected = status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL ||
+                               status == WL_CONNECTION_LOST;
+                }
+                if (rejected || elapsed > attemptTimeout()) {
+                    // Without auto-reconnect a rejected join stays down, so move on
+                    WiFi.disconnect();
+                    startAttempt(currentProfile + 1);
+                }
+            }
+            break;
+
+        case CONNECTED:
+            if (disconnectedEvent.exchange(false) && WiFi.status() != WL_CONNECTED) {
+                disconnectCount++;
+                outageStarted = millis();
+                Serial.println("WiFi: link lost, reconnecting in the background");
+                // The network we just had is the best bet
+                startAttempt(currentProfile >= 0 ? currentProfile : 0);
+            }
+            break;
+
+        case WAITING:
+            if (millis() - waitStarted > WIFI_LINK_RETRY_PAUSE) {
+                startAttempt(0);
+            }
+            break;
+    }
+}
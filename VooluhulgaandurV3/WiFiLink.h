@@ -0,0 +1,88 @@
+#ifndef WIFILINK_H
+#define WIFILINK_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <atomic>
+
+#define WIFI_LINK_MAX_PROFILES 4
+#define WIFI_LINK_CACHED_TIMEOUT 3000    // ms; channel and BSSID known, no scan
+#define WIFI_LINK_SCAN_TIMEOUT 10000     // ms for a network that needs a scan
+#define WIFI_LINK_RETRY_PAUSE 2000       // ms after every profile has failed
+#define WIFI_LINK_STALE_EVENT_MS 500     // Disconnects this soon after begin() belong to the previous attempt
+#define WIFI_LINK_HISTOGRAM_BUCKETS 8
+
+// One network to try. bssid/channel skip the scan when set; a static
+// address skips DHCP.
+struct WiFiProfile {
+    const char* ssid;
+    const char* password;
+    int32_t channel;        // 0 = scan
+    uint8_t bssid[6];
+    bool hasBssid;
+    IPAddress localIP;      // 0.0.0.0 = DHCP
+    IPAddress gateway;
+    IPAddress subnet;
+};
+
+// Reconnect duration histogram, bucket upper bounds in ms
+struct ReconnectHistogram {
+    static const uint32_t bounds[WIFI_LINK_HISTOGRAM_BUCKETS - 1];
+    uint32_t counts[WIFI_LINK_HISTOGRAM_BUCKETS];
+    uint32_t lastMs;
+    uint32_t maxMs;
+
+    void clear();
+    void record(uint32_t ms);
+};
+
+// Keeps the station connected without ever blocking the caller. WiFi
+// events only set flags; poll() walks the profile list, giving each one a
+// bounded time before moving on, and starts over after a short pause.
+class WiFiLink {
+public:
+    enum State { IDLE, CONNECTING, CONNECTED, WAITING };
+
+    WiFiLink();
+
+    // Profiles are tried in the order added; the first is usually the cache
+    void clearProfiles();
+    bool addProfile(const WiFiProfile& profile);
+    void begin();
+    void poll();
+
+    bool isConnected() const { return state == CONNECTED; }
+    State getState() const { return state; }
+    // Profile that produced the current connection, or -1
+    int getConnectedProfile() const { return state == CONNECTED ? currentProfile : -1; }
+    const WiFiProfile& getProfile(int index) const { return profiles[index]; }
+
+    // Called from poll() once an address is assigned
+    void setConnectedCallback(void (*callback)(const WiFiProfile& profile, uint32_t reconnectMs));
+
+    const ReconnectHistogram& getHistogram() const { return histogram; }
+    uint32_t getDisconnectCount() const { return disconnectCount; }
+
+private:
+    WiFiProfile profiles[WIFI_LINK_MAX_PROFILES];
+    int profileCount;
+    int currentProfile;
+    State state;
+    unsigned long attemptStarted;
+    unsigned long outageStarted;
+    unsigned long waitStarted;
+    uint32_t disconnectCount;
+    ReconnectHistogram histogram;
+    void (*connectedCallback)(const WiFiProfile&, uint32_t);
+
+    // Set from the WiFi event task
+    std::atomic<bool> gotIpEvent;
+    std::atomic<bool> disconnectedEvent;
+    bool earlyDisconnect;  // Seen inside WIFI_LINK_STALE_EVENT_MS, not yet re-checked
+
+    void startAttempt(int index);
+    unsigned long attemptTimeout() const;
+    bool isCurrentNetwork(const WiFiProfile& profile) const;
+};
+
+#endif
@@ -1,25 +1,76 @@
 #include <M5Core2.h>
 #include <WiFi.h>
-#include <WiFiMulti.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <ESPmDNS.h>
 #include <WiFiUdp.h>
+#include "PulseSource.h"
+#include "FlowFilter.h"
+#include "CalibrationCurve.h"
+#include "FlowSample.h"
+#include "SpscRing.h"
+#include "LoopStats.h"
+#include "TelemetryClient.h"
+#include "UdpTelemetry.h"
+#include "ReportPolicy.h"
+#include "MainUnitDiscovery.h"
+#include "EndpointCache.h"
+#include "WiFiLink.h"
+#include "SampleBuffer.h"
 
 // Flow sensor pin
 #define FLOW_SENSOR_PIN 32  // Port A on M5Stack Core 2
+#define FLOW_UNIT_ID 1      // Sensor number in telemetry packets, 1..8
+
+// Unit 1 keeps the original names; unit N uses "/flowN", "flowsensorN", ...
+#if FLOW_UNIT_ID == 1
+#define FLOW_UNIT_SUFFIX ""
+#else
+#define FLOW_UNIT_STR(x) #x
+#define FLOW_UNIT_XSTR(x) FLOW_UNIT_STR(x)
+#define FLOW_UNIT_SUFFIX FLOW_UNIT_XSTR(FLOW_UNIT_ID)
+#endif
+#define FLOW_UNIT_PATH "/flow" FLOW_UNIT_SUFFIX
+#define FLOW_UNIT_HOSTNAME "flowsensor" FLOW_UNIT_SUFFIX
+#define FLOW_UNIT_DISCOVERY "FLOW_SENSOR" FLOW_UNIT_SUFFIX "_DISCOVERY"
 
 // Flow sensor specifications
-// YF-S402 calibration: f = 73×Q formula gives f = 4380 pulses/liter
-#define BASE_FLOW_SENSOR_PULSES_PER_LITER 4380  // Base calibration: f = 73×Q
-#define FLOW_SENSOR_UPDATE_INTERVAL 200   // Update every 200ms (5 times per second)
+// YF-S402 calibration: flow-rate dependent K-factor curve, see CalibrationCurve.h
+#define FLOW_SENSOR_UPDATE_INTERVAL 200   // Update every 200ms (5 times per second) when idle
+#define HTTP_REPORT_MIN_INTERVAL 500       // HTTP fallback is too slow for the dispensing rate
+#define HTTP_ONESHOT_CONNECT_TIMEOUT 300   // ms; the one-shot fallback runs on the display's task
+#define HTTP_ONESHOT_RESPONSE_TIMEOUT 300  // ms
+#define HTTP_ONESHOT_BACKOFF 10000         // ms without one-shot attempts after one fails
+#define FLOW_DEBUG_OUTPUT 0  // Per-update serial dump; UART writes would stretch the acquisition period
+
+// Task layout: acquisition owns the pulse source and all flow math on core 1,
+// network and UI run on core 0 and only see published samples.
+#define ACQ_TASK_PERIOD_MS 10
+#define ACQ_TASK_CORE 1
+#define ACQ_TASK_PRIORITY 10
+#define ACQ_TASK_STACK 4096
+#define NET_TASK_CORE 0
+#define NET_TASK_PRIORITY 1
+#define NET_TASK_STACK 8192
+#define TASK_STATS_INTERVAL 10000  // Log loop statistics every 10 seconds
 
-// Calibration coefficient (adjustable via slider)
-float calibrationCoeff = 1.0f;  // Range: 0.80 to 1.20 (±20%)
+// Store-and-forward while the main unit is unreachable (RAM capacity and
+// flash spill are set in SampleBuffer.h)
+#define SAMPLE_BUFFER_LIMIT 256                       // Records kept in RAM
+#define SAMPLE_BUFFER_POLICY SampleBuffer::DROP_OLDEST
+#define SAMPLE_REPLAY_BATCH 16           // Records per replay datagram (max TELEMETRY_BATCH_MAX_RECORDS)
+#define SAMPLE_REPLAY_INTERVAL 100       // ms between replay batches, leaves room for live reports
+#define SAMPLE_REPLAY_ACK_TIMEOUT 500    // ms before an unacked batch is sent again
+#define SAMPLE_REPLAY_MIN_AGE 1000       // ms a live report waits for its own ack before it is replayed
+
+// Calibration curve (editable on the calibration tab, stored in NVS)
+CalibrationCurve calibration;
+float currentPulseFrequency = 0.0f;   // Hz, updated with every flow calculation
+float currentPulsesPerLiter = BASE_FLOW_SENSOR_PULSES_PER_LITER;
 
 // Helper function to get current calibration value
 float getCurrentPulsesPerLiter() {
-    return BASE_FLOW_SENSOR_PULSES_PER_LITER * calibrationCoeff;
+    return currentPulsesPerLiter;
 }
 
 // Helper function to get ml per pulse
@@ -28,395 +79,334 @@ float getMlPerPulse() {
 }
 
 // WiFi settings
-WiFiMulti wifiMulti;
+// Rejoin the cached network with the last lease as a static IP, skipping
+// DHCP. Off by default: after a main unit reboot the soft-AP may have handed
+// that address to another flow unit or a phone. Only turn it on where every
+// unit has a reserved address.
+#ifndef WIFI_REUSE_CACHED_ADDRESS
+#define WIFI_REUSE_CACHED_ADDRESS 0
+#endif
+WiFiLink wifiLink;
+bool mdnsStarted = false;
 
 // Main unit discovery
 const char* mainUnitHostname = "joogimasin";  // Main unit's mDNS hostname
 String mainUnitIP = "";  // Will be discovered automatically
 
-unsigned long lastDiscoveryTime = 0;
-const unsigned long DISCOVERY_INTERVAL = 30000;  // Try to discover every 30 seconds
+MainUnitDiscovery discovery(mainUnitHostname, FLOW_UNIT_DISCOVERY);
+bool rediscoveryRequested = false;     // Reporting failed; look again in the background
+unsigned long lastDiscoveryTime = 0;   // Last successful discovery
+unsigned long lastDiscoveryAttempt = 0;
+const unsigned long DISCOVERY_INTERVAL = 30000;  // Re-check an unhealthy link every 30 seconds
+const unsigned long DISCOVERY_RETRY_INTERVAL = 5000;  // Pause between failed rounds
+uint16_t mainUnitTelemetryPort = TELEMETRY_UDP_PORT;   // Updated from the main unit's beacon
+uint16_t mainUnitKeepAlivePort = TELEMETRY_HTTP_PORT;
+const char* mainUnitSource = "";  // How the current address was found
+
+// Last verified endpoint, tried before any discovery
+EndpointCache endpointCache;
+String verifiedIP = "";                 // mainUnitIP as of the last cache update
+unsigned long firstTelemetryTime = 0;   // ms after boot when the main unit first took a report
+const char* firstTelemetrySource = "";
+
+// Networks the flow unit knows the password for
+struct KnownNetwork {
+    const char* ssid;
+    const char* password;
+};
+const KnownNetwork knownNetworks[] = {
+    {"Joogimasin-AP", "joogimasin123"},
+    {"Illuminaty", "S330nm1nuk0du!"},
+};
 int connectionFailureCount = 0;
 const int MAX_FAILURE_COUNT = 3;  // Only rediscover after 3 consecutive failures
 
+// Flow reports go out as binary UDP telemetry. While the main unit does not
+// ack them, they go over a persistent connection to its keep-alive listener,
+// and main units without that get the one-shot HTTPClient path.
+UdpTelemetry udpTelemetry(FLOW_UNIT_ID);
+TelemetryClient telemetry(FLOW_UNIT_PATH "/update");
+unsigned long keepAliveRetryTime = 0;  // Skip the keep-alive path until then
+unsigned long lastHttpReportTime = 0;
+unsigned long httpOneShotRetryTime = 0;  // Skip the one-shot fallback until then
+uint32_t bootId = 0;           // Random per boot so the main unit can spot restarts
+uint32_t reportSequence = 0;   // One per report, whichever transport carries it
+
+// Reports the main unit hasn't acked yet, replayed once UDP acks flow again
+SampleBuffer sampleBuffer;
+uint32_t replayBatchId = 0;
+uint32_t replayLastSequence = 0; // Newest record in the batch awaiting an ack
+bool replayInFlight = false;
+unsigned long replaySentTime = 0;
+
+// When to report: fast while this unit's pump dispenses, heartbeat otherwise
+ReportPolicy reportPolicy;
+bool sampleIsFresh = false;  // latestSample not reported yet
+
 // Flow sensor variables
-volatile long pulseCount = 0;          // Pulse count for current interval (gets reset)
-volatile long totalPulseCount = 0;     // Total cumulative pulse count (never reset)
+ActivePulseSource pulseSource(FLOW_SENSOR_PIN);  // Backend chosen by PULSE_SOURCE_BACKEND
+FlowAccumulator::Cursor intervalCursor;  // Baseline for the flow rate window
+FlowAccumulator::Cursor totalCursor;     // Baseline for the displayed/reported total
+FlowAccumulator::Cursor lifetimeCursor;  // Pulses since boot; never rebased
+uint32_t lastSeenCount = 0;            // Raw count at the last pulse check
+uint32_t pulseCount = 0;               // Pulses counted in the last interval
+uint64_t totalPulseCount = 0;          // Pulses since the last volume reset
+PulsePeriodMeter periodMeter;          // Rate from inter-pulse periods (edge-capable backends)
 float flowRate = 0.0f;                 // Flow rate in L/min
 float totalVolume = 0.0f;              // Total volume in L
 bool flowError = false;
 unsigned long lastUpdateTime = 0;
 unsigned long lastPulseTime = 0;
 
-// Flow rate smoothing variables
-float flowRateHistory[5] = {0, 0, 0, 0, 0};  // Store last 5 readings for smoothing
-int flowRateIndex = 0;
+// Flow rate smoothing (filter chosen at compile time with FLOW_FILTER)
+ActiveFlowFilter flowFilter;
 float smoothedFlowRate = 0.0f;
 
+// Acquisition -> network/UI hand-off
+SpscRing<FlowSample, 16> sampleQueue;      // Lock-free, acquisition task is the only producer
+FlowSample latestSample = {};              // Network/UI task's copy of the newest sample
+std::atomic<bool> volumeResetRequested(false);   // Set by UI, applied by acquisition
+std::atomic<uint32_t> flowUpdateInterval(FLOW_SENSOR_UPDATE_INTERVAL);  // ms, follows the report rate
+std::atomic<uint32_t> flowRateCaps(0);          // Counted by acquisition, logged by the network task
+LoopStats acquisitionStats(ACQ_TASK_PERIOD_MS * 1000UL, 1000);  // Target period, ±1 ms
+LoopStats networkStats;
+
 // Display management
 static int currentTab = 0;  // 0: Flow Data, 1: Network Info, 2: Calibration
 static unsigned long lastDisplayUpdate = 0;
 
-// Calibration slider variables
-bool sliderActive = false;
-int sliderX = 50;    // Slider position X
-int sliderY = 140;   // Slider position Y
-int sliderWidth = 220;  // Slider width
-int sliderHeight = 20;  // Slider height
-int sliderKnobX = sliderX + sliderWidth / 2;  // Current knob position
+// Calibration editor variables
+int selectedCalPoint = 0;
+const int calTableY = 45;      // First row of the point table
+const int calRowHeight = 18;
+const int calButtonY = 165;    // -, +, Save buttons
+const int calButtonHeight = 30;
+const float CAL_STEP = 1.005f;  // One touch changes K by 0.5%
 
-// Dispensing tracking variables for auto-reset
+// Dispensing session, as pushed by the main unit
 bool wasDispensing = false;
 float lastTargetVolume = 0.0f;
-unsigned long lastDispensingCheck = 0;
-const unsigned long DISPENSING_CHECK_INTERVAL = 2000; // Check every 2 seconds
+uint32_t activeSessionId = 0;
 
-// Interrupt service routine for flow sensor
-void IRAM_ATTR pulseCounter() {
-    pulseCount++;           // For interval calculations
-    totalPulseCount++;      // For total cumulative count
-    lastPulseTime = millis();
-    // Note: Don't use Serial.print in interrupt handlers as it can cause issues
+// Pull the latest count from the backend and note when pulses last arrived.
+// The counters themselves are only ever read through cursors. Edge
+// timestamps are drained on every call so the ring never fills up between
+// rate updates.
+void samplePulseSource(unsigned long currentTime) {
+    pulseSource.poll();
+    EdgeRing* edgeRing = pulseSource.edges();
+    if (edgeRing) {
+        periodMeter.consume(*edgeRing);
+    }
+    uint32_t count = pulseSource.accumulator().raw();
+    if (count != lastSeenCount) {
+        lastSeenCount = count;
+        lastPulseTime = currentTime;
+    }
 }
 
-String findMainUnitByBroadcast() {
-    WiFiUDP udp;
-    
-    // Start UDP on port 12345
-    if (!udp.begin(12345)) {
-        Serial.println("UDP broadcast discovery failed to start");
-        return "";
-    }
-    
-    Serial.println("Sending broadcast discovery packets...");
-    
-    // Calculate broadcast address for current subnet
-    IPAddress localIP = WiFi.localIP();
-    IPAddress subnetMask = WiFi.subnetMask();
-    IPAddress broadcastAddr;
-    
-    // Calculate broadcast address: IP | (~subnetMask)
-    for (int i = 0; i < 4; i++) {
-        broadcastAddr[i] = localIP[i] | (~subnetMask[i]);
-    }
-    
-    Serial.println("Broadcast address: " + broadcastAddr.toString());
-    
-    // Send discovery packet
-    String discoveryMsg = "FLOW_SENSOR_DISCOVERY";
-    udp.beginPacket(broadcastAddr, 12346); // Send to port 12346
-    udp.print(discoveryMsg);
-    udp.endPacket();
-    
-    // Wait for response
-    unsigned long startTime = millis();
-    while (millis() - startTime < 3000) { // Wait up to 3 seconds
-        int packetSize = udp.parsePacket();
-        if (packetSize) {
-            char responseBuffer[64];
-            int len = udp.read(responseBuffer, sizeof(responseBuffer) - 1);
-            responseBuffer[len] = '\0';
-            
-            String response = String(responseBuffer);
-            if (response.startsWith("JOOGIMASIN_RESPONSE:")) {
-                String foundIP = response.substring(20); // Extract IP after "JOOGIMASIN_RESPONSE:"
-                Serial.println("Received response from: " + udp.remoteIP().toString());
-                Serial.println("Main unit reports IP: " + foundIP);
-                udp.stop();
-                return foundIP;
-            }
+// Start the displayed/reported total from zero without touching the counter
+void rebaseTotalPulses() {
+    totalCursor.rebase(pulseSource.accumulator());
+    totalPulseCount = 0;
+}
+
+const char* passwordForNetwork(const char* ssid) {
+    for (size_t i = 0; i < sizeof(knownNetworks) / sizeof(knownNetworks[0]); i++) {
+        if (strcmp(knownNetworks[i].ssid, ssid) == 0) {
+            return knownNetworks[i].password;
         }
-        delay(50);
     }
-    
-    udp.stop();
-    Serial.println("No broadcast response received");
-    return "";
+    return nullptr;
 }
 
-bool discoverMainUnit() {
-    Serial.println("=== DISCOVERING MAIN UNIT ===");
-    Serial.println("Flow sensor IP: " + WiFi.localIP().toString());
-    
-#ifdef MANUAL_MAIN_UNIT_IP
-    // Use manual IP if defined
-    Serial.println("Using MANUAL IP configuration: " + String(MANUAL_MAIN_UNIT_IP));
-    mainUnitIP = MANUAL_MAIN_UNIT_IP;
-    
-    HTTPClient http;
-    http.begin("http://" + mainUnitIP + "/flow/test");
-    http.setTimeout(3000);
-    
-    int httpCode = http.GET();
-    if (httpCode == HTTP_CODE_OK) {
-        String response = http.getString();
-        Serial.println("Manual IP connection successful: " + response);
-        http.end();
-        return true;
-    } else {
-        Serial.printf("Manual IP connection failed with code: %d\n", httpCode);
-        http.end();
-        return false;
-    }
+// Networks in the order the link manager tries them: the one the cached
+// endpoint was reached on (channel and BSSID given up front, so no scan),
+// then every known network with a full scan
+void buildWiFiProfiles() {
+    wifiLink.clearProfiles();
+    
+    if (endpointCache.isValid()) {
+        const MainUnitEndpoint& cached = endpointCache.get();
+        const char* password = passwordForNetwork(cached.ssid);
+        if (password) {
+            WiFiProfile profile;
+            memset(&profile, 0, sizeof(profile));
+            profile.ssid = cached.ssid;
+            profile.password = password;
+            profile.channel = cached.channel;
+            memcpy(profile.bssid, cached.bssid, sizeof(profile.bssid));
+            profile.hasBssid = true;
+            profile.localIP = IPAddress((uint32_t)0);
+#if WIFI_REUSE_CACHED_ADDRESS
+            if (cached.localAddress[0] != 0) {
+                profile.localIP = IPAddress(cached.localAddress[0], cached.localAddress[1],
+                                            cached.localAddress[2], cached.localAddress[3]);
+                profile.gateway = IPAddress(cached.gateway[0], cached.gateway[1], cached.gateway[2], cached.gateway[3]);
+                profile.subnet = IPAddress(cached.subnet[0], cached.subnet[1], cached.subnet[2], cached.subnet[3]);
+            }
 #endif
-
-    // Try UDP broadcast discovery first (works across different networks)
-    Serial.println("Trying UDP broadcast discovery...");
-    String broadcastIP = findMainUnitByBroadcast();
-    if (broadcastIP.length() > 0) {
-        mainUnitIP = broadcastIP;
-        Serial.println("*** Found main unit via broadcast at: " + mainUnitIP + " ***");
-        return true;
-    }
-    
-    Serial.println("Looking for hostname: " + String(mainUnitHostname) + ".local");
-    
-    // Multiple attempts at mDNS resolution
-    IPAddress serverIP;
-    bool mdnsFound = false;
-    
-    for (int attempt = 1; attempt <= 3; attempt++) {
-        Serial.printf("mDNS attempt %d/3...\n", attempt);
-        serverIP = MDNS.queryHost(mainUnitHostname);
-        
-        if (serverIP.toString() != "0.0.0.0") {
-            mdnsFound = true;
-            break;
+            wifiLink.addProfile(profile);
         }
-        delay(1000); // Wait 1 second between attempts
     }
     
-    if (mdnsFound) {
-        mainUnitIP = serverIP.toString();
-        Serial.println("Found main unit via mDNS at: " + mainUnitIP);
-        
-        // Test connectivity to the main unit
-        HTTPClient http;
-        http.begin("http://" + mainUnitIP + "/flow/test");
-        http.setTimeout(3000);
-        
-        int httpCode = http.GET();
-        if (httpCode == HTTP_CODE_OK) {
-            String response = http.getString();
-            Serial.println("mDNS connection test successful: " + response);
-            http.end();
-            return true;
-        } else {
-            Serial.printf("mDNS connection test failed with code: %d\n", httpCode);
-            http.end();
-            // Don't return false yet, try other methods
-        }
-    } else {
-        Serial.println("Main unit not found via mDNS, trying fallback methods...");
-        
-        // Try known IP addresses first (faster than scanning)
-        String knownIPs[] = {
-            "192.168.88.188",  // Your known IP
-            "192.168.1.100", 
-            "192.168.0.100",
-            "192.168.4.1",     // Common ESP32 AP mode IP
-            "192.168.1.1",     // Common router IP
-            "10.0.0.1"         // Another common router IP
-        };
-        
-        Serial.println("Trying known IP addresses...");
-        for (int i = 0; i < 6; i++) {
-            Serial.printf("Testing known IP %d/6: %s\n", i+1, knownIPs[i].c_str());
-            
-            HTTPClient http;
-            http.begin("http://" + knownIPs[i] + "/flow/test");
-            http.setTimeout(2000);
-            
-            int httpCode = http.GET();
-            if (httpCode == HTTP_CODE_OK) {
-                String response = http.getString();
-                if (response.indexOf("Flow endpoint is working") >= 0) {
-                    Serial.println("*** Found main unit at known IP: " + knownIPs[i] + " ***");
-                    mainUnitIP = knownIPs[i];
-                    http.end();
-                    return true;
-                }
-            }
-            http.end();
-            delay(200); // Small delay between attempts
-        }
-        
-        // Try subnet scan as last resort (only common IPs to save time)
-        Serial.println("Trying subnet scan (limited range)...");
-        String baseIP = WiFi.localIP().toString();
-        int lastDot = baseIP.lastIndexOf('.');
-        if (lastDot > 0) {
-            String subnet = baseIP.substring(0, lastDot + 1);
-            Serial.println("Scanning subnet: " + subnet + "x");
-            
-            // Only scan common IP ranges to save time
-            int scanIPs[] = {1, 2, 100, 101, 188, 200, 254};
-            for (int i = 0; i < 7; i++) {
-                String testIP = subnet + String(scanIPs[i]);
-                if (testIP != WiFi.localIP().toString()) {
-                    Serial.println("Scanning: " + testIP);
-                    
-                    HTTPClient http;
-                    http.begin("http://" + testIP + "/flow/test");
-                    http.setTimeout(1500);
-                    
-                    int httpCode = http.GET();
-                    if (httpCode == HTTP_CODE_OK) {
-                        String response = http.getString();
-                        if (response.indexOf("Flow endpoint is working") >= 0) {
-                            Serial.println("*** Found main unit at: " + testIP + " ***");
-                            mainUnitIP = testIP;
-                            http.end();
-                            return true;
-                        }
-                    }
-                    http.end();
-                    delay(300);
-                }
-            }
-        }
-        
-        return false;
+    for (size_t i = 0; i < sizeof(knownNetworks) / sizeof(knownNetworks[0]); i++) {
+        WiFiProfile profile;
+        memset(&profile, 0, sizeof(profile));
+        profile.ssid = knownNetworks[i].ssid;
+        profile.password = knownNetworks[i].password;
+        profile.localIP = IPAddress((uint32_t)0);
+        wifiLink.addProfile(profile);
     }
 }
 
-void connectWiFi() {
-    Serial.println("=== SIMPLE FLOW SENSOR WIFI CONNECTION ===");
-    
-    // Priority 1: Try to connect to main unit's Access Point
-    Serial.println("Connecting to main unit Access Point...");
-    
-    WiFi.begin("Joogimasin-AP", "joogimasin123");
-    
-    // Wait for connection (up to 15 seconds)
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
+// Called by the link manager once the station has an address
+void onWiFiConnected(const WiFiProfile& profile, uint32_t reconnectMs) {
+    if (strcmp(profile.ssid, "Joogimasin-AP") == 0) {
+        // The main unit's own access point is always 192.168.4.1
+        mainUnitIP = "192.168.4.1";
+        mainUnitSource = "access point";
+    } else if (endpointCache.isValid() && strcmp(profile.ssid, endpointCache.get().ssid) == 0) {
+        // Last verified main unit; beacon and discovery cover the rest
+        const MainUnitEndpoint& cached = endpointCache.get();
+        mainUnitIP = IPAddress(cached.address[0], cached.address[1], cached.address[2], cached.address[3]).toString();
+        mainUnitTelemetryPort = cached.telemetryPort;
+        mainUnitKeepAlivePort = cached.keepAlivePort;
+        mainUnitSource = "cache";
+    }
+    if (mainUnitIP.length() > 0) {
+        Serial.println("Main unit IP: " + mainUnitIP + " (" + mainUnitSource + ")");
     }
     
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n*** CONNECTED TO MAIN UNIT ACCESS POINT ***");
-        Serial.println("SSID: " + WiFi.SSID());
-        Serial.println("IP Address: " + WiFi.localIP().toString());
-        
-        // Set main unit IP (always 192.168.4.1 for Access Point)
-        mainUnitIP = "192.168.4.1";
-        Serial.println("Main unit IP: " + mainUnitIP);
-        
-        // Initialize mDNS
-        if (!MDNS.begin("flowsensor")) {
+    // A new network may hand out a different address; drop stale sockets
+    telemetry.disconnect();
+    
+    if (!mdnsStarted) {
+        if (!MDNS.begin(FLOW_UNIT_HOSTNAME)) {
             Serial.println("Error setting up mDNS responder!");
         } else {
-            Serial.println("mDNS responder started as 'flowsensor.local'");
-        }
-        
-        Serial.println("Connection successful - ready to send data!");
-        
-    } else {
-        Serial.println("\n*** CONNECTION FAILED ***");
-        Serial.println("Make sure:");
-        Serial.println("1. Main unit is powered on");
-        Serial.println("2. Main unit is running Access Point mode");
-        Serial.println("3. You're within WiFi range");
-        
-        // Optional: Try one fallback network if needed
-        Serial.println("Trying fallback network...");
-        WiFi.begin("Illuminaty", "S330nm1nuk0du!");
-        
-        attempts = 0;
-        while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-            delay(500);
-            Serial.print(".");
-            attempts++;
-        }
-        
-        if (WiFi.status() == WL_CONNECTED) {
-            Serial.println("\nConnected to fallback network");
-            Serial.println("SSID: " + WiFi.SSID());
-            Serial.println("IP Address: " + WiFi.localIP().toString());
-            
-            // Initialize mDNS
-            if (!MDNS.begin("flowsensor")) {
-                Serial.println("Error setting up mDNS responder!");
-            } else {
-                Serial.println("mDNS responder started as 'flowsensor.local'");
-            }
-            
-            // Try known main unit IP
-            mainUnitIP = "192.168.88.188";
-            Serial.println("Will try to find main unit at: " + mainUnitIP);
-        } else {
-            Serial.println("All connection attempts failed!");
+            Serial.println("mDNS responder started as '" FLOW_UNIT_HOSTNAME ".local'");
+            mdnsStarted = true;
         }
     }
 }
 
-float calculateSmoothedFlowRate(float newReading) {
-    // Add new reading to history
-    flowRateHistory[flowRateIndex] = newReading;
-    flowRateIndex = (flowRateIndex + 1) % 5;
+// The main unit took a report: remember how we got there
+void noteTelemetryDelivered() {
+    if (firstTelemetryTime == 0) {
+        firstTelemetryTime = millis();
+        firstTelemetrySource = mainUnitSource;
+        Serial.printf("Time to first telemetry: %lu ms (main unit from %s)\n",
+                      firstTelemetryTime, firstTelemetrySource);
+    }
+    if (mainUnitIP == verifiedIP) {
+        return;
+    }
     
-    // Calculate average of last 5 readings
-    float sum = 0;
-    for (int i = 0; i < 5; i++) {
-        sum += flowRateHistory[i];
+    IPAddress address;
+    if (!address.fromString(mainUnitIP)) {
+        return;
+    }
+    MainUnitEndpoint endpoint;
+    memset(&endpoint, 0, sizeof(endpoint));
+    for (int i = 0; i < 4; i++) {
+        endpoint.address[i] = address[i];
+    }
+    endpoint.telemetryPort = mainUnitTelemetryPort;
+    endpoint.keepAlivePort = mainUnitKeepAlivePort;
+    strncpy(endpoint.ssid, WiFi.SSID().c_str(), sizeof(endpoint.ssid) - 1);
+    uint8_t* bssid = WiFi.BSSID();
+    if (bssid) {
+        memcpy(endpoint.bssid, bssid, sizeof(endpoint.bssid));
     }
-    return sum / 5.0f;
+    endpoint.channel = WiFi.channel();
+    IPAddress localAddress = WiFi.localIP();
+    IPAddress gateway = WiFi.gatewayIP();
+    IPAddress subnet = WiFi.subnetMask();
+    for (int i = 0; i < 4; i++) {
+        endpoint.localAddress[i] = localAddress[i];
+        endpoint.gateway[i] = gateway[i];
+        endpoint.subnet[i] = subnet[i];
+    }
+    if (endpointCache.update(endpoint)) {
+        buildWiFiProfiles();  // Next reconnect goes straight to this network
+    }
+    verifiedIP = mainUnitIP;
 }
 
-void updateFlowSensor() {
+// Returns true when a new flow calculation was made
+bool updateFlowSensor() {
     unsigned long currentTime = millis();
+    samplePulseSource(currentTime);
     
     // Check for flow sensor error (no pulses for 5 seconds)
     if (currentTime - lastPulseTime > 5000) {
         flowError = true;
-        // Clear flow rate history when no flow detected
-        for (int i = 0; i < 5; i++) {
-            flowRateHistory[i] = 0;
-        }
+        // Clear filter state when no flow detected
+        flowFilter.reset();
         smoothedFlowRate = 0;
     } else {
         flowError = false;
     }
     
     // Calculate flow rate and volume
-    if (currentTime - lastUpdateTime >= FLOW_SENSOR_UPDATE_INTERVAL) {
+    if (currentTime - lastUpdateTime >= flowUpdateInterval.load(std::memory_order_relaxed)) {
         float actualTimeInterval = (currentTime - lastUpdateTime) / 1000.0f; // Convert to seconds
         
+        // Take this interval's pulses against our own baselines
+        pulseCount = intervalCursor.take(pulseSource.accumulator());
+        totalCursor.take(pulseSource.accumulator());
+        lifetimeCursor.take(pulseSource.accumulator());
+        totalPulseCount = totalCursor.total();
+        
         // Debug output
-        if (pulseCount > 0) {
+        if (FLOW_DEBUG_OUTPUT && pulseCount > 0) {
             Serial.printf("=== FLOW DETECTED ===\n");
-            Serial.printf("Pulse count: %ld\n", pulseCount);
+            Serial.printf("Pulse count: %lu\n", (unsigned long)pulseCount);
             Serial.printf("Time interval: %.3f seconds\n", actualTimeInterval);
-            Serial.printf("Calibration: %d pulses/liter\n", getCurrentPulsesPerLiter());
+        }
+        
+        // Pulse frequency selects the K-factor from the calibration curve
+        if (pulseSource.edges()) {
+            currentPulseFrequency = periodMeter.frequencyHz((uint32_t)micros());
+        } else {
+            currentPulseFrequency = actualTimeInterval > 0 ? pulseCount / actualTimeInterval : 0.0f;
+        }
+        currentPulsesPerLiter = calibration.pulsesPerLiter(currentPulseFrequency);
+        if (FLOW_DEBUG_OUTPUT && pulseCount > 0) {
+            Serial.printf("Calibration: %.0f pulses/liter at %.1f Hz\n", currentPulsesPerLiter, currentPulseFrequency);
         }
         
         // Calculate instantaneous flow rate in L/min
         float instantaneousFlowRate = 0.0f;
-        if (pulseCount > 0 && actualTimeInterval > 0) {
+        if (pulseSource.edges()) {
+            // Period-based: reflects the most recent pulses, not the window
+            instantaneousFlowRate = currentPulseFrequency * 60.0f / getCurrentPulsesPerLiter();
+            if (instantaneousFlowRate > 50.0f) {
+                instantaneousFlowRate = 50.0f;
+                flowRateCaps.fetch_add(1, std::memory_order_relaxed);
+            }
+        } else if (pulseCount > 0 && actualTimeInterval > 0) {
             // Improved calculation with minimum time threshold
-            if (actualTimeInterval >= 0.1f) { // Only calculate if we have at least 100ms of data
+            if (actualTimeInterval >= 0.025f) { // Only calculate if we have at least 25ms of data
                 instantaneousFlowRate = (pulseCount * 60.0f) / (getCurrentPulsesPerLiter() * actualTimeInterval);
                 
                 // Apply reasonable limits to prevent unrealistic readings
                 if (instantaneousFlowRate > 50.0f) { // Cap at 50 L/min (very high but possible)
                     instantaneousFlowRate = 50.0f;
-                    Serial.println("WARNING: Flow rate capped at 50 L/min");
+                    flowRateCaps.fetch_add(1, std::memory_order_relaxed);
                 }
             } else {
                 // For very short intervals, use a conservative estimate
-                instantaneousFlowRate = (pulseCount * 60.0f) / (getCurrentPulsesPerLiter() * 0.2f); // Assume 200ms minimum
+                instantaneousFlowRate = (pulseCount * 60.0f) / (getCurrentPulsesPerLiter() * 0.025f); // Assume 25ms minimum
                 if (instantaneousFlowRate > 10.0f) { // More conservative cap for short intervals
                     instantaneousFlowRate = 10.0f;
                 }
-                Serial.printf("Short interval detected, using conservative estimate\n");
             }
         }
         
         // Apply smoothing to reduce erratic readings
-        smoothedFlowRate = calculateSmoothedFlowRate(instantaneousFlowRate);
+        smoothedFlowRate = flowFilter.update(instantaneousFlowRate, actualTimeInterval);
         flowRate = smoothedFlowRate;
         
         // Calculate volume in liters: pulses / pulses_per_liter
@@ -424,209 +414,419 @@ void updateFlowSensor() {
         totalVolume += volumeIncrement;
         
         // Debug output
-        if (pulseCount > 0) {
+        if (FLOW_DEBUG_OUTPUT && pulseCount > 0) {
             Serial.printf("Instantaneous flow rate: %.2f L/min\n", instantaneousFlowRate);
             Serial.printf("Smoothed flow rate: %.2f L/min\n", smoothedFlowRate);
             Serial.printf("Volume increment: %.4f L\n", volumeIncrement);
             Serial.printf("Total volume: %.3f L\n", totalVolume);
             Serial.printf("Error status: %s\n", flowError ? "true" : "false");
+            if (pulseSource.edges()) {
+                Serial.printf("Edge ring overruns: %lu\n", (unsigned long)pulseSource.edges()->overrunCount());
+            }
             Serial.println("=== FLOW UPDATE COMPLETE ===");
         }
         
-        // Reset pulse count
-        pulseCount = 0;
         lastUpdateTime = currentTime;
+        return true;
     }
+    return false;
 }
 
-void sendDataToMainUnit() {
-    if (WiFi.status() != WL_CONNECTED) {
-        Serial.println("WiFi disconnected, reconnecting...");
-        connectWiFi();
+// Apply requests the UI task made against acquisition-owned state
+void applyAcquisitionRequests() {
+    if (volumeResetRequested.exchange(false)) {
+        totalVolume = 0.0f;
+        rebaseTotalPulses();
+    }
+}
+
+void publishSample() {
+    FlowSample sample;
+    sample.timestampMs = millis();
+    sample.totalPulses = totalPulseCount;
+    sample.lifetimePulses = (uint32_t)lifetimeCursor.total();
+    sample.flowRate = flowRate;
+    sample.totalVolume = totalVolume;
+    sample.pulseFrequency = currentPulseFrequency;
+    sample.pulsesPerLiter = currentPulsesPerLiter;
+    sample.error = flowError;
+    sampleQueue.push(sample);  // Drops (and counts) if the network task stalls
+}
+
+// High priority, fixed cadence. Never touches WiFi, HTTP or the display.
+void acquisitionTask(void* parameter) {
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(ACQ_TASK_PERIOD_MS));
+        acquisitionStats.tick((uint32_t)esp_timer_get_time());
+        
+        applyAcquisitionRequests();
+        if (updateFlowSensor()) {
+            publishSample();
+        }
+    }
+}
+
+// Keep the newest published sample for reporting and display
+void drainSamples() {
+    FlowSample sample;
+    while (sampleQueue.pop(sample)) {
+        latestSample = sample;
+        sampleIsFresh = true;
+    }
+}
+
+void logTaskStats() {
+    static unsigned long lastStatsLog = 0;
+    if (millis() - lastStatsLog < TASK_STATS_INTERVAL) {
         return;
     }
+    lastStatsLog = millis();
+    
+    LoopStats::Snapshot acq = acquisitionStats.snapshot();
+    LoopStats::Snapshot net = networkStats.snapshot();
+    Serial.printf("Acquisition: %lu loops, period %lu/%lu/%lu us (min/mean/max), %lu outside +-1ms, %lu samples dropped\n",
+                  (unsigned long)acq.iterations, (unsigned long)acq.minPeriodUs, (unsigned long)acq.meanPeriodUs,
+                  (unsigned long)acq.maxPeriodUs, (unsigned long)acq.outOfTolerance,
+                  (unsigned long)sampleQueue.overrunCount());
+    uint32_t caps = flowRateCaps.exchange(0, std::memory_order_relaxed);
+    if (caps > 0) {
+        Serial.printf("WARNING: Flow rate capped at 50 L/min %lu times\n", (unsigned long)caps);
+    }
+    Serial.printf("Network/UI: %lu loops, period %lu/%lu/%lu us (min/mean/max)\n",
+                  (unsigned long)net.iterations, (unsigned long)net.minPeriodUs, (unsigned long)net.meanPeriodUs,
+                  (unsigned long)net.maxPeriodUs);
+    const TelemetryStats& link = telemetry.getStats();
+    Serial.printf("Telemetry: %lu ok, %lu failed, %lu connects, RTT %lu/%lu/%lu us (min/mean/max)\n",
+                  (unsigned long)link.requests, (unsigned long)link.failures, (unsigned long)link.reconnects,
+                  (unsigned long)link.minRttUs, (unsigned long)link.meanRttUs, (unsigned long)link.maxRttUs);
+    const UdpTelemetry::Stats& udpLink = udpTelemetry.getStats();
+    Serial.printf("UDP telemetry: %lu sent, %lu acked, RTT %lu us (max %lu us)\n",
+                  (unsigned long)udpLink.sent, (unsigned long)udpLink.acked,
+                  (unsigned long)udpLink.lastRttUs, (unsigned long)udpLink.maxRttUs);
+    Serial.printf("Reports: %.1f/s (%s, interval %lu ms), %lu heartbeat, %lu active, %lu deadband, %lu forced\n",
+                  reportPolicy.achievedRateHz(), reportPolicy.isSessionActive() ? "dispensing" : "idle",
+                  (unsigned long)reportPolicy.currentInterval(),
+                  (unsigned long)reportPolicy.getReasonCount(ReportPolicy::REPORT_HEARTBEAT),
+                  (unsigned long)reportPolicy.getReasonCount(ReportPolicy::REPORT_ACTIVE),
+                  (unsigned long)reportPolicy.getReasonCount(ReportPolicy::REPORT_DEADBAND),
+                  (unsigned long)reportPolicy.getReasonCount(ReportPolicy::REPORT_FORCED));
+    const ReconnectHistogram& reconnects = wifiLink.getHistogram();
+    Serial.printf("WiFi reconnects (<250/<500/<1k/<2k/<5k/<10k/<30k/more ms): %lu/%lu/%lu/%lu/%lu/%lu/%lu/%lu, last %lu ms, max %lu ms, %lu drops\n",
+                  (unsigned long)reconnects.counts[0], (unsigned long)reconnects.counts[1],
+                  (unsigned long)reconnects.counts[2], (unsigned long)reconnects.counts[3],
+                  (unsigned long)reconnects.counts[4], (unsigned long)reconnects.counts[5],
+                  (unsigned long)reconnects.counts[6], (unsigned long)reconnects.counts[7],
+                  (unsigned long)reconnects.lastMs, (unsigned long)reconnects.maxMs,
+                  (unsigned long)wifiLink.getDisconnectCount());
+    const SampleBuffer::Stats& buffered = sampleBuffer.getStats();
+    Serial.printf("Sample buffer: %u queued, %lu buffered, %lu dropped, %lu acked, %lu spilled to flash\n",
+                  (unsigned)sampleBuffer.size(), (unsigned long)buffered.buffered,
+                  (unsigned long)buffered.dropped, (unsigned long)buffered.replayed,
+                  (unsigned long)buffered.spilled);
+    acquisitionStats.restart();
+    networkStats.restart();
+    reportPolicy.resetCounts();
+    telemetry.resetStats();
+    udpTelemetry.resetStats();
+    sampleBuffer.resetStats();
+}
 
-    // Check if we need to discover main unit IP
-    if (mainUnitIP.length() == 0 || (millis() - lastDiscoveryTime > DISCOVERY_INTERVAL)) {
-        Serial.println("Attempting to discover main unit...");
-        if (discoverMainUnit()) {
+// Advance background discovery and adopt its result
+void pollDiscovery() {
+    discovery.poll();
+    if (discovery.getState() == MainUnitDiscovery::FOUND) {
+        String found = discovery.getResult().toString();
+        if (found != mainUnitIP) {
+            Serial.println("Main unit address changed: " + mainUnitIP + " -> " + found);
+        }
+        mainUnitIP = found;
+        mainUnitSource = discovery.getResultMethod();
+        lastDiscoveryTime = millis();
+        connectionFailureCount = 0;
+        discovery.cancel();
+    } else if (discovery.getState() == MainUnitDiscovery::FAILED) {
+        discovery.cancel();
+    }
+    
+    // Beacons: take the announced endpoint when we have no address or the
+    // current one has stopped acking
+    if (!discovery.isRunning() && discovery.hasFreshBeacon()) {
+        const TelemetryBeacon& beacon = discovery.getBeacon();
+        mainUnitTelemetryPort = beacon.telemetryPort;
+        mainUnitKeepAlivePort = beacon.keepAlivePort;
+        String announced = discovery.getBeaconAddress().toString();
+        if (announced != mainUnitIP && (mainUnitIP.length() == 0 || !udpTelemetry.isHealthy())) {
+            Serial.println("Main unit beacon: using " + announced);
+            mainUnitIP = announced;
+            mainUnitSource = "beacon";
             lastDiscoveryTime = millis();
+            connectionFailureCount = 0;
+        }
+    }
+}
+
+// Keep a report until the main unit has it, for replay otherwise
+void bufferReport(const ReportId& id) {
+    TelemetryRecord record;
+    record.sequence = id.sequence;
+    record.sensorTimeMs = latestSample.timestampMs;
+    record.lifetimePulses = latestSample.lifetimePulses;
+    record.totalPulses = (uint32_t)latestSample.totalPulses;
+    record.flowRate = latestSample.flowRate;
+    record.pulsesPerLiter = latestSample.pulsesPerLiter;
+    record.flags = latestSample.error ? TELEMETRY_FLAG_ERROR : 0;
+    sampleBuffer.push(record);
+}
+
+// Release reports from the front of the buffer as their live acks come in.
+// One still unacked there holds the rest back; replay sends them all again.
+void releaseAckedReports() {
+    TelemetryRecord oldest;
+    while (sampleBuffer.peek(&oldest, 1) == 1 && udpTelemetry.isReportAcked(oldest.sequence)) {
+        sampleBuffer.discardThrough(oldest.sequence);
+    }
+}
+
+// Send buffered reports oldest first, one batch in flight at a time
+void replayBufferedSamples() {
+    if (replayInFlight) {
+        if (udpTelemetry.isBatchAcked(replayBatchId)) {
+            sampleBuffer.discardThrough(replayLastSequence);
+            replayInFlight = false;
+        } else if (millis() - replaySentTime < SAMPLE_REPLAY_ACK_TIMEOUT) {
+            return;
         } else {
-            Serial.println("Cannot find main unit, skipping data send");
+            replayInFlight = false;  // Lost; resend under a new batch ID
+        }
+    }
+    if (sampleBuffer.isEmpty() || !udpTelemetry.isHealthy() ||
+        millis() - replaySentTime < SAMPLE_REPLAY_INTERVAL) {
+        return;
+    }
+    
+    TelemetryRecord records[SAMPLE_REPLAY_BATCH];
+    size_t count = sampleBuffer.peek(records, SAMPLE_REPLAY_BATCH);
+    while (count > 0 && millis() - records[count - 1].sensorTimeMs < SAMPLE_REPLAY_MIN_AGE) {
+        count--;  // Sent live moments ago; its own ack may still come
+    }
+    if (count == 0) {
+        return;
+    }
+    TelemetryBatch batch;
+    batch.unitId = FLOW_UNIT_ID;
+    batch.batchId = ++replayBatchId;
+    batch.bootId = bootId;
+    batch.count = (uint8_t)count;
+    replaySentTime = millis();
+    if (udpTelemetry.sendBatch(batch, records)) {
+        replayLastSequence = records[count - 1].sequence;
+        replayInFlight = true;
+    }
+}
+
+void sendDataToMainUnit() {
+    // Every transport carries the same id, so a report that arrives twice
+    // is recognised as a duplicate
+    ReportId id = {bootId, reportSequence++};
+    
+    if (!wifiLink.isConnected()) {
+        bufferReport(id);
+        return;  // The link manager reconnects in the background
+    }
+
+    // Discovery runs in the background; reports keep going to the last
+    // known address until it finds something
+    bool linkStale = !udpTelemetry.isHealthy() && millis() - lastDiscoveryTime > DISCOVERY_INTERVAL;
+    if (!discovery.isRunning() && !discovery.hasFreshBeacon() &&
+        (mainUnitIP.length() == 0 || rediscoveryRequested || linkStale) &&
+        (lastDiscoveryAttempt == 0 || millis() - lastDiscoveryAttempt > DISCOVERY_RETRY_INTERVAL)) {
+        IPAddress cachedAddress;
+        if (endpointCache.isValid()) {
+            const MainUnitEndpoint& cached = endpointCache.get();
+            cachedAddress = IPAddress(cached.address[0], cached.address[1], cached.address[2], cached.address[3]);
+        }
+        discovery.start(cachedAddress);
+        lastDiscoveryAttempt = millis();
+        rediscoveryRequested = false;
+    }
+    IPAddress mainUnitAddress;
+    if (mainUnitIP.length() == 0 || !mainUnitAddress.fromString(mainUnitIP)) {
+        bufferReport(id);
+        return;  // Nothing to report to yet
+    }
+    
+    udpTelemetry.setServer(mainUnitAddress, mainUnitTelemetryPort);
+    udpTelemetry.send(latestSample, id);
+    if (udpTelemetry.isHealthy()) {
+        // Kept until its ack arrives: the link may have gone down just now
+        bufferReport(id);
+        connectionFailureCount = 0;
+        noteTelemetryDelivered();
+        return;
+    }
+    
+    if (millis() - lastHttpReportTime < HTTP_REPORT_MIN_INTERVAL) {
+        bufferReport(id);  // Not sent anywhere that confirms it
+        return;
+    }
+    lastHttpReportTime = millis();
+    
+    // No recent acks: the main unit may not speak UDP telemetry, use HTTP
+    if ((long)(millis() - keepAliveRetryTime) >= 0) {
+        telemetry.setServer(mainUnitAddress, mainUnitKeepAlivePort);
+        if (telemetry.post(latestSample, id)) {
+            connectionFailureCount = 0;
+            noteTelemetryDelivered();
             return;
         }
     }
 
+    // Keep-alive listener unreachable: one-shot request on port 80, backed
+    // off after a failure so a main unit that is down doesn't stall the display
+    bool attempt = (long)(millis() - httpOneShotRetryTime) >= 0;
+    if (attempt && sendDataViaHttpClient(id)) {
+        noteTelemetryDelivered();
+        // Main unit answers but has no keep-alive listener; don't pay a
+        // connect timeout on every report
+        keepAliveRetryTime = millis() + DISCOVERY_INTERVAL;
+    } else {
+        if (attempt) {
+            httpOneShotRetryTime = millis() + HTTP_ONESHOT_BACKOFF;
+        }
+        bufferReport(id);
+    }
+}
+
+// One-shot JSON POST, for main units without the keep-alive telemetry
+// listener. Runs on the network/UI task, so the timeouts are short; GET is
+// only tried when the main unit answered but refused the POST.
+bool sendDataViaHttpClient(const ReportId& id) {
     HTTPClient http;
-    String url = "http://" + mainUnitIP + "/flow/update";
-    
-    // Try POST method first (JSON)
-    Serial.println("Trying POST method with JSON data...");
+    String url = "http://" + mainUnitIP + FLOW_UNIT_PATH "/update";
     
     // Create JSON document
     StaticJsonDocument<250> doc;
-    doc["flowRate"] = flowRate;
-    doc["totalVolume"] = totalVolume;
-    doc["error"] = flowError;
-    doc["pulseCount"] = totalPulseCount;
+    doc["unit"] = FLOW_UNIT_ID;
+    doc["flowRate"] = latestSample.flowRate;
+    doc["totalVolume"] = latestSample.totalVolume;
+    doc["error"] = latestSample.error;
+    doc["pulseCount"] = (uint32_t)latestSample.totalPulses;
+    doc["bootId"] = id.bootId;
+    doc["seq"] = id.sequence;
+    doc["pulses"] = latestSample.lifetimePulses;
+    doc["ppl"] = latestSample.pulsesPerLiter;
+    doc["time"] = latestSample.timestampMs;
     
     String jsonData;
     serializeJson(doc, jsonData);
     
-    Serial.println("Sending data to: " + url);
-    Serial.println("JSON data: " + jsonData);
+    if (FLOW_DEBUG_OUTPUT) {
+        Serial.println("Sending data to: " + url);
+        Serial.println("JSON data: " + jsonData);
+    }
     
     // Send data to main unit via POST
     http.begin(url);
     http.addHeader("Content-Type", "application/json");
-    http.setTimeout(5000); // 5 second timeout
+    http.setConnectTimeout(HTTP_ONESHOT_CONNECT_TIMEOUT);
+    http.setTimeout(HTTP_ONESHOT_RESPONSE_TIMEOUT);
     
     int httpCode = http.POST(jsonData);
     
-    if (httpCode > 0) {
-        if (httpCode == HTTP_CODE_OK) {
-            String response = http.getString();
+    if (httpCode == HTTP_CODE_OK) {
+        if (FLOW_DEBUG_OUTPUT) {
             Serial.println("POST data sent successfully to " + mainUnitIP);
-            Serial.println("Response: " + response);
-            connectionFailureCount = 0;  // Reset failure counter on success
-            http.end();
-            return; // Success, exit function
-        } else {
-            Serial.printf("POST HTTP error: %d\n", httpCode);
-            String response = http.getString();
-            Serial.println("POST Error response: " + response);
+            Serial.println("Response: " + http.getString());
         }
-    } else {
-        Serial.printf("POST HTTP request failed: %s\n", http.errorToString(httpCode).c_str());
+        connectionFailureCount = 0;  // Reset failure counter on success
+        http.end();
+        return true; // Success, exit function
     }
-    
     http.end();
     
-    // If POST failed, try GET method as fallback
-    Serial.println("POST failed, trying GET method as fallback...");
-    
-    String getUrl = url + "?flowRate=" + String(flowRate, 2) + 
-                   "&totalVolume=" + String(totalVolume, 3) + 
-                   "&error=" + (flowError ? "true" : "false") +
-                   "&pulseCount=" + String(totalPulseCount);
-    
-    Serial.println("GET URL: " + getUrl);
-    
-    http.begin(getUrl);
-    http.setTimeout(5000);
-    
-    httpCode = http.GET();
-    
     if (httpCode > 0) {
+        // Reachable, but an older main unit may only take GET
+        Serial.printf("POST HTTP error: %d, trying GET\n", httpCode);
+        String getUrl = url + "?flowRate=" + String(latestSample.flowRate, 2) + 
+                       "&totalVolume=" + String(latestSample.totalVolume, 3) + 
+                       "&error=" + (latestSample.error ? "true" : "false") +
+                       "&pulseCount=" + String((uint32_t)latestSample.totalPulses);
+        if (FLOW_DEBUG_OUTPUT) {
+            Serial.println("GET URL: " + getUrl);
+        }
+        
+        http.begin(getUrl);
+        http.setConnectTimeout(HTTP_ONESHOT_CONNECT_TIMEOUT);
+        http.setTimeout(HTTP_ONESHOT_RESPONSE_TIMEOUT);
+        httpCode = http.GET();
+        http.end();
         if (httpCode == HTTP_CODE_OK) {
-            String response = http.getString();
-            Serial.println("GET data sent successfully to " + mainUnitIP);
-            Serial.println("Response: " + response);
             connectionFailureCount = 0;  // Reset failure counter on success
-        } else {
-            Serial.printf("GET HTTP error: %d\n", httpCode);
-            String response = http.getString();
-            Serial.println("GET Error response: " + response);
-            connectionFailureCount++;
-            
-            // Only clear IP after multiple failures or specific error codes
-            if (connectionFailureCount >= MAX_FAILURE_COUNT || httpCode == -1 || httpCode == 404) {
-                Serial.printf("Too many failures (%d) or server unreachable, will rediscover main unit\n", connectionFailureCount);
-                mainUnitIP = "";  // Force rediscovery
-                connectionFailureCount = 0;  // Reset counter
-            } else {
-                Serial.printf("Failure %d/%d, keeping current IP for next attempt\n", connectionFailureCount, MAX_FAILURE_COUNT);
-            }
+            return true;
         }
+    }
+    
+    if (httpCode > 0) {
+        Serial.printf("GET HTTP error: %d\n", httpCode);
     } else {
-        Serial.printf("GET HTTP request failed: %s\n", http.errorToString(httpCode).c_str());
-        connectionFailureCount++;
-        
-        if (connectionFailureCount >= MAX_FAILURE_COUNT) {
-            Serial.printf("Too many connection failures (%d), will rediscover main unit\n", connectionFailureCount);
-            mainUnitIP = "";  // Force rediscovery
-            connectionFailureCount = 0;  // Reset counter
-        } else {
-            Serial.printf("Connection failure %d/%d, keeping current IP for next attempt\n", connectionFailureCount, MAX_FAILURE_COUNT);
-        }
+        Serial.printf("HTTP request failed: %s\n", HTTPClient::errorToString(httpCode).c_str());
     }
+    connectionFailureCount++;
     
-    http.end();
+    // Only clear IP after multiple failures or specific error codes
+    if (connectionFailureCount >= MAX_FAILURE_COUNT || httpCode == 404) {
+        Serial.printf("Too many failures (%d) or server unreachable, will rediscover main unit\n", connectionFailureCount);
+        rediscoveryRequested = true;  // Keep the old address until discovery finds one
+        connectionFailureCount = 0;  // Reset counter
+    } else {
+        Serial.printf("Failure %d/%d, keeping current IP for next attempt\n", connectionFailureCount, MAX_FAILURE_COUNT);
+    }
+    return false;
 }
 
-void checkDispensingStatus() {
-    // Only check every 2 seconds to avoid excessive requests
-    if (millis() - lastDispensingCheck < DISPENSING_CHECK_INTERVAL) {
+// Switch reporting (and the flow calculation feeding it) between the
+// dispensing and idle rates
+void applySessionState(bool dispensing) {
+    reportPolicy.setSessionActive(dispensing);
+    uint32_t interval = FLOW_SENSOR_UPDATE_INTERVAL;
+    if (dispensing && reportPolicy.getActiveInterval() < interval) {
+        interval = reportPolicy.getActiveInterval();
+    }
+    flowUpdateInterval.store(interval, std::memory_order_relaxed);
+}
+
+// Session events pushed by the main unit the moment a pump starts or
+// stops. The counters keep running: the main unit baselines sessions on
+// the lifetime pulse count, so there is nothing to reset here.
+void handleSessionEvents() {
+    TelemetrySession event;
+    if (!udpTelemetry.takeSessionEvent(event)) {
         return;
     }
-    lastDispensingCheck = millis();
     
-    if (WiFi.status() != WL_CONNECTED || mainUnitIP.length() == 0) {
-        return; // Can't check if not connected
+    bool isDispensing = event.event == TELEMETRY_SESSION_START;
+    Serial.printf("Session %lu %s, target %.3f L\n", (unsigned long)event.sessionId,
+                  isDispensing ? "started" : "ended", event.targetVolume);
+    applySessionState(isDispensing);
+    if (isDispensing) {
+        reportPolicy.requestImmediate();  // Give the main unit a fresh count right away
     }
-    
-    HTTPClient http;
-    String url = "http://" + mainUnitIP + "/flow/dispensing";
-    
-    http.begin(url);
-    http.setTimeout(3000);
-    
-    int httpCode = http.GET();
-    if (httpCode == HTTP_CODE_OK) {
-        String response = http.getString();
-        
-        // Parse JSON response
-        StaticJsonDocument<200> doc;
-        DeserializationError error = deserializeJson(doc, response);
-        
-        if (!error) {
-            bool isDispensing = doc["isDispensing"] | false;
-            float targetVolume = doc["targetVolume"] | 0.0f;
-            
-            // Check if a new dispensing session started
-            if (isDispensing && !wasDispensing) {
-                // New dispensing started - reset pulse count
-                Serial.println("=== NEW DISPENSING DETECTED - AUTO-RESETTING PULSE COUNT ===");
-                Serial.printf("Target volume: %.3f L\n", targetVolume);
-                totalPulseCount = 0;
-                pulseCount = 0;
-                
-                // Show notification on display
-                M5.Lcd.fillScreen(BLACK);
-                M5.Lcd.setTextColor(YELLOW);
-                M5.Lcd.setTextSize(2);
-                M5.Lcd.setCursor(30, 80);
-                M5.Lcd.println("DISPENSING");
-                M5.Lcd.setCursor(50, 110);
-                M5.Lcd.println("STARTED");
-                M5.Lcd.setCursor(20, 140);
-                M5.Lcd.printf("%.2fL Target", targetVolume);
-                M5.Lcd.setTextColor(GREEN);
-                M5.Lcd.setCursor(10, 170);
-                M5.Lcd.println("Pulse Count Reset");
-                delay(1500); // Show message for 1.5 seconds
-            }
-            
-            // Update tracking variables
-            wasDispensing = isDispensing;
-            lastTargetVolume = targetVolume;
-        }
-    }
-    
-    http.end();
+    activeSessionId = event.sessionId;
+    wasDispensing = isDispensing;
+    lastTargetVolume = event.targetVolume;
+    lastDisplayUpdate = 0;  // Show the new state on the next pass
 }
 
 void resetVolumeCounter() {
     // Reset local volume counter and pulse count
-    totalVolume = 0.0f;
-    totalPulseCount = 0;
-    pulseCount = 0;
+    volumeResetRequested = true;  // Applied by the acquisition task
     Serial.println("=== VOLUME AND PULSE COUNT RESET LOCALLY ===");
     
     // Also send reset command to main unit if connected
     if (WiFi.status() == WL_CONNECTED && mainUnitIP.length() > 0) {
         HTTPClient http;
-        String resetUrl = "http://" + mainUnitIP + "/flow/reset";
+        String resetUrl = "http://" + mainUnitIP + FLOW_UNIT_PATH "/reset";
         
         Serial.println("Sending volume reset command to main unit...");
         Serial.println("Reset URL: " + resetUrl);
@@ -691,32 +891,43 @@ void drawFlowDataTab() {
     // Display flow rate (smoothed)
     M5.Lcd.setCursor(10, 50);
     M5.Lcd.print("Flow: ");
-    M5.Lcd.print(flowRate, 2);
+    M5.Lcd.print(latestSample.flowRate, 2);
     M5.Lcd.println(" L/min");
     
     // Display total volume
     M5.Lcd.setCursor(10, 80);
     M5.Lcd.print("Total: ");
-    M5.Lcd.print(totalVolume, 3);
+    M5.Lcd.print(latestSample.totalVolume, 3);
     M5.Lcd.println(" L");
     
     // Display pulse count for debugging
     M5.Lcd.setCursor(10, 110);
     M5.Lcd.print("Pulses: ");
-    M5.Lcd.println(totalPulseCount);
+    M5.Lcd.printf("%llu\n", (unsigned long long)latestSample.totalPulses);
     
     // Display calibration value (fixed)
     M5.Lcd.setCursor(10, 130);
     M5.Lcd.print("Calibration: ");
     M5.Lcd.setTextColor(CYAN);
-    M5.Lcd.printf("%d", getCurrentPulsesPerLiter());
+    M5.Lcd.printf("%.0f", latestSample.pulsesPerLiter);
     
     // Display sensor status
     M5.Lcd.setTextColor(WHITE);
     M5.Lcd.setCursor(10, 150);
     M5.Lcd.print("Sensor: ");
-    M5.Lcd.setTextColor(flowError ? RED : GREEN);
-    M5.Lcd.println(flowError ? "ERROR" : "OK");
+    M5.Lcd.setTextColor(latestSample.error ? RED : GREEN);
+    M5.Lcd.println(latestSample.error ? "ERROR" : "OK");
+    
+    // Session pushed by the main unit
+    if (wasDispensing) {
+        M5.Lcd.setTextColor(YELLOW);
+        M5.Lcd.setCursor(180, 150);
+        M5.Lcd.print("DISPENSING");
+        M5.Lcd.setTextSize(1);
+        M5.Lcd.setCursor(180, 170);
+        M5.Lcd.printf("#%lu target %.2f L", (unsigned long)activeSessionId, lastTargetVolume);
+        M5.Lcd.setTextSize(2);
+    }
     
     // Display main unit connection status (simplified)
     M5.Lcd.setTextColor(WHITE);
@@ -730,6 +941,14 @@ void drawFlowDataTab() {
         M5.Lcd.println("Searching...");
     }
     
+    // Acquisition loop timing
+    LoopStats::Snapshot acq = acquisitionStats.snapshot();
+    M5.Lcd.setTextColor(LIGHTGREY);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setCursor(10, 200);
+    M5.Lcd.printf("Acq: %lu-%lu us, %lu late", (unsigned long)acq.minPeriodUs,
+                  (unsigned long)acq.maxPeriodUs, (unsigned long)acq.outOfTolerance);
+    
     // Display button instructions at bottom
     M5.Lcd.setTextColor(YELLOW);
     M5.Lcd.setTextSize(1);
@@ -772,6 +991,11 @@ void drawNetworkInfoTab() {
         M5.Lcd.println("Mode: Network Discovery");
     }
     
+    M5.Lcd.setTextColor(WHITE);
+    M5.Lcd.setCursor(180, 100);
+    M5.Lcd.printf("Rejoin: %lu ms (%lu)", (unsigned long)wifiLink.getHistogram().lastMs,
+                  (unsigned long)wifiLink.getDisconnectCount());
+    
     // IP addresses
     M5.Lcd.setTextColor(WHITE);
     M5.Lcd.setCursor(10, 120);
@@ -779,6 +1003,31 @@ void drawNetworkInfoTab() {
     M5.Lcd.setCursor(10, 140);
     M5.Lcd.println(WiFi.localIP().toString());
     
+    // Telemetry link
+    M5.Lcd.setCursor(180, 120);
+    if (udpTelemetry.isHealthy()) {
+        M5.Lcd.println("Link: UDP");
+        M5.Lcd.setCursor(180, 140);
+        M5.Lcd.printf("RTT: %.1f ms", udpTelemetry.getStats().lastRttUs / 1000.0f);
+    } else {
+        M5.Lcd.println(telemetry.isConnected() ? "Link: keep-alive" : "Link: one-shot");
+        M5.Lcd.setCursor(180, 140);
+        M5.Lcd.printf("RTT: %.1f ms", telemetry.getStats().lastRttUs / 1000.0f);
+    }
+    
+    M5.Lcd.setCursor(180, 160);
+    M5.Lcd.printf("Reports: %.1f/s", reportPolicy.achievedRateHz());
+    
+    M5.Lcd.setCursor(180, 180);
+    if (firstTelemetryTime > 0) {
+        M5.Lcd.printf("1st data: %lu ms", firstTelemetryTime);
+    } else {
+        M5.Lcd.println("1st data: waiting");
+    }
+    
+    M5.Lcd.setCursor(180, 200);
+    M5.Lcd.printf("Buffered: %u", (unsigned)sampleBuffer.size());
+    
     M5.Lcd.setCursor(10, 160);
     M5.Lcd.println("Main Unit IP:");
     M5.Lcd.setCursor(10, 180);
@@ -815,28 +1064,13 @@ void drawNetworkInfoTab() {
     M5.Lcd.println("A:Reset  B:Next Tab  C:Next Tab");
 }
 
-void drawSlider() {
-    // Draw slider track
-    M5.Lcd.fillRect(sliderX, sliderY, sliderWidth, sliderHeight, DARKGREY);
-    M5.Lcd.drawRect(sliderX, sliderY, sliderWidth, sliderHeight, WHITE);
-    
-    // Calculate knob position based on coefficient (0.80 to 1.20 range)
-    float sliderPos = (calibrationCoeff - 0.80f) / 0.40f;  // Normalize to 0-1
-    sliderKnobX = sliderX + (int)(sliderPos * (sliderWidth - 20));
-    
-    // Draw slider knob
-    M5.Lcd.fillRect(sliderKnobX, sliderY - 5, 20, sliderHeight + 10, BLUE);
-    M5.Lcd.drawRect(sliderKnobX, sliderY - 5, 20, sliderHeight + 10, WHITE);
-    
-    // Draw scale marks
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setTextColor(YELLOW);
-    M5.Lcd.setCursor(sliderX, sliderY + 25);
-    M5.Lcd.print("0.80");
-    M5.Lcd.setCursor(sliderX + sliderWidth/2 - 10, sliderY + 25);
-    M5.Lcd.print("1.00");
-    M5.Lcd.setCursor(sliderX + sliderWidth - 25, sliderY + 25);
-    M5.Lcd.print("1.20");
+void drawCalibrationButton(int x, const char* label, uint16_t color) {
+    M5.Lcd.fillRect(x, calButtonY, 90, calButtonHeight, color);
+    M5.Lcd.drawRect(x, calButtonY, 90, calButtonHeight, WHITE);
+    M5.Lcd.setTextColor(WHITE);
+    M5.Lcd.setTextSize(2);
+    M5.Lcd.setCursor(x + 45 - strlen(label) * 6, calButtonY + 8);
+    M5.Lcd.print(label);
 }
 
 void drawCalibrationTab() {
@@ -848,68 +1082,86 @@ void drawCalibrationTab() {
     M5.Lcd.setCursor(10, 10);
     M5.Lcd.println("Calibration [3/3]");
     
-    // Display current coefficient
-    M5.Lcd.setCursor(10, 50);
-    M5.Lcd.print("Coefficient: ");
-    M5.Lcd.setTextColor(CYAN);
-    M5.Lcd.printf("%.3f", calibrationCoeff);
-    
-    // Display pulses per liter
-    M5.Lcd.setTextColor(WHITE);
-    M5.Lcd.setCursor(10, 80);
-    M5.Lcd.print("Pulses/L: ");
-    M5.Lcd.setTextColor(CYAN);
-    M5.Lcd.printf("%.0f", getCurrentPulsesPerLiter());
+    // Point table: one row per curve point, selected row highlighted
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setTextColor(YELLOW);
+    M5.Lcd.setCursor(10, calTableY - 12);
+    M5.Lcd.print(" #   Hz      L/min   Pulses/L   mL/Pulse");
+    for (int i = 0; i < calibration.getPointCount(); i++) {
+        CalibrationPoint point = calibration.getPoint(i);
+        int rowY = calTableY + i * calRowHeight;
+        if (i == selectedCalPoint) {
+            M5.Lcd.fillRect(5, rowY - 4, 310, calRowHeight, DARKGREY);
+        }
+        M5.Lcd.setTextColor(i == selectedCalPoint ? WHITE : CYAN);
+        M5.Lcd.setCursor(10, rowY);
+        M5.Lcd.printf(" %d  %6.1f  %6.2f   %7.0f    %.4f", i + 1, point.frequencyHz,
+                      point.frequencyHz * 60.0f / point.pulsesPerLiter,
+                      point.pulsesPerLiter, 1000.0f / point.pulsesPerLiter);
+    }
     
-    // Display ml per pulse
+    // Live K-factor
     M5.Lcd.setTextColor(WHITE);
-    M5.Lcd.setCursor(10, 110);
-    M5.Lcd.print("mL/Pulse: ");
-    M5.Lcd.setTextColor(CYAN);
-    M5.Lcd.printf("%.4f", getMlPerPulse());
+    M5.Lcd.setCursor(10, calButtonY - 14);
+    M5.Lcd.printf("Now: %.1f Hz -> %.0f pulses/L (%.4f mL/pulse)",
+                  latestSample.pulseFrequency, latestSample.pulsesPerLiter,
+                  latestSample.pulsesPerLiter > 0.0f ? 1000.0f / latestSample.pulsesPerLiter : 0.0f);
     
-    // Draw calibration slider
-    drawSlider();
-    
-    // Display instructions
-    M5.Lcd.setTextColor(YELLOW);
-    M5.Lcd.setTextSize(1);
-    M5.Lcd.setCursor(10, 180);
-    M5.Lcd.println("Touch slider to adjust calibration");
-    M5.Lcd.setCursor(10, 195);
-    M5.Lcd.println("Lower = Less volume per pulse");
-    M5.Lcd.setCursor(10, 210);
-    M5.Lcd.println("Higher = More volume per pulse");
+    drawCalibrationButton(10, "-", BLUE);
+    drawCalibrationButton(115, "+", BLUE);
+    drawCalibrationButton(220, "Save", DARKGREEN);
     
     // Display button instructions at bottom
     M5.Lcd.setTextColor(YELLOW);
+    M5.Lcd.setTextSize(1);
+    M5.Lcd.setCursor(10, 205);
+    M5.Lcd.println("Touch a row, then -/+ to adjust by 0.5%");
     M5.Lcd.setCursor(10, 225);
     M5.Lcd.println("A:Reset  B:Next Tab  C:Next Tab");
 }
 
-void handleSliderTouch() {
+void handleCalibrationTouch() {
     TouchPoint_t pos = M5.Touch.getPressPoint();
     
-    if (pos.x != -1 && pos.y != -1) {  // Valid touch
-        // Check if touch is within slider area
-        if (pos.x >= sliderX && pos.x <= sliderX + sliderWidth &&
-            pos.y >= sliderY - 10 && pos.y <= sliderY + sliderHeight + 10) {
-            
-            // Calculate new coefficient based on touch position
-            float touchPos = (float)(pos.x - sliderX) / (float)sliderWidth;
-            touchPos = constrain(touchPos, 0.0f, 1.0f);  // Clamp to 0-1
-            
-            // Convert to coefficient range (0.80 to 1.20)
-            calibrationCoeff = 0.80f + (touchPos * 0.40f);
-            calibrationCoeff = constrain(calibrationCoeff, 0.80f, 1.20f);
-            
-            Serial.printf("Slider touched: pos=%.2f, coeff=%.3f, pulses/L=%.0f, mL/pulse=%.4f\n", 
-                         touchPos, calibrationCoeff, getCurrentPulsesPerLiter(), getMlPerPulse());
-            
-            // Force immediate display update
-            lastDisplayUpdate = 0;
-        }
+    if (pos.x == -1 || pos.y == -1) {
+        return;
     }
+    
+    // Touch-and-hold would repeat every loop; allow one edit per 200ms
+    static unsigned long lastEdit = 0;
+    if (millis() - lastEdit < 200) {
+        return;
+    }
+    lastEdit = millis();
+    
+    // Row selection
+    int row = (pos.y - calTableY + 4) / calRowHeight;
+    if (pos.y >= calTableY - 4 && row >= 0 && row < calibration.getPointCount()) {
+        selectedCalPoint = row;
+        lastDisplayUpdate = 0;
+        return;
+    }
+    
+    if (pos.y < calButtonY || pos.y > calButtonY + calButtonHeight) {
+        return;
+    }
+    
+    CalibrationPoint point = calibration.getPoint(selectedCalPoint);
+    if (pos.x >= 10 && pos.x < 100) {
+        calibration.setPointPulsesPerLiter(selectedCalPoint, point.pulsesPerLiter / CAL_STEP);
+    } else if (pos.x >= 115 && pos.x < 205) {
+        calibration.setPointPulsesPerLiter(selectedCalPoint, point.pulsesPerLiter * CAL_STEP);
+    } else if (pos.x >= 220 && pos.x < 310) {
+        bool saved = calibration.save();
+        Serial.printf("Calibration curve %s\n", saved ? "saved to NVS" : "save FAILED");
+    }
+    
+    point = calibration.getPoint(selectedCalPoint);
+    Serial.printf("Calibration point %d: %.1f Hz -> %.0f pulses/L\n",
+                  selectedCalPoint + 1, point.frequencyHz, point.pulsesPerLiter);
+    
+    // Force immediate display update
+    lastDisplayUpdate = 0;
 }
 
 void updateDisplay() {
@@ -933,12 +1185,30 @@ void setup() {
     Serial.begin(115200);
     Serial.println("Flow Sensor Unit initializing...");
     
-    // Initialize flow sensor
-    pinMode(FLOW_SENSOR_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(FLOW_SENSOR_PIN), pulseCounter, FALLING);
+    // Load the calibration curve before the first flow calculation
+    calibration.load();
+    endpointCache.load();
     
-    // Connect to WiFi
-    connectWiFi();
+    // Initialize flow sensor
+    if (!pulseSource.begin()) {
+        Serial.println("Pulse source init failed!");
+    }
+    intervalCursor.rebase(pulseSource.accumulator());
+    lifetimeCursor.rebase(pulseSource.accumulator());
+    rebaseTotalPulses();
+    do {
+        bootId = esp_random();
+    } while (bootId == 0);
+    
+    // Start joining WiFi; the network task finishes the connection
+    buildWiFiProfiles();
+    wifiLink.setConnectedCallback(onWiFiConnected);
+    wifiLink.begin();
+    udpTelemetry.begin();
+    discovery.begin();
+    sampleBuffer.begin();
+    sampleBuffer.setLimit(SAMPLE_BUFFER_LIMIT);
+    sampleBuffer.setDropPolicy(SAMPLE_BUFFER_POLICY);
     
     // Initialize display
     M5.Lcd.fillScreen(BLACK);
@@ -951,9 +1221,16 @@ void setup() {
     
     lastUpdateTime = millis();
     lastPulseTime = millis();
+    latestSample.pulsesPerLiter = getCurrentPulsesPerLiter();
+    
+    // Acquisition gets core 1 to itself; WiFi and the LCD live on core 0
+    xTaskCreatePinnedToCore(acquisitionTask, "flowAcq", ACQ_TASK_STACK, NULL,
+                            ACQ_TASK_PRIORITY, NULL, ACQ_TASK_CORE);
+    xTaskCreatePinnedToCore(networkTask, "flowNet", NET_TASK_STACK, NULL,
+                            NET_TASK_PRIORITY, NULL, NET_TASK_CORE);
 }
 
-void loop() {
+void networkIteration() {
     M5.update();
     
     // Check for button presses
@@ -980,24 +1257,48 @@ void loop() {
         updateDisplay();
     }
     
-    // Handle touch input for calibration slider
+    // Handle touch input for calibration editor
     if (currentTab == 2) {  // Only handle touch on calibration tab
-        handleSliderTouch();
+        handleCalibrationTouch();
     }
     
-    // Check dispensing status for auto-reset
-    checkDispensingStatus();
+    // Keep WiFi up without blocking
+    wifiLink.poll();
     
-    // Update flow sensor readings
-    updateFlowSensor();
+    // Collect telemetry acks and session events, advance discovery
+    udpTelemetry.poll();
+    releaseAckedReports();
+    handleSessionEvents();
+    pollDiscovery();
+    replayBufferedSamples();
     
-    // Send data to main unit every 500ms (twice per second)
-    static unsigned long lastSendTime = 0;
-    if (millis() - lastSendTime >= 500) {
+    // Send data to main unit as the report policy decides
+    ReportPolicy::Reason reason = reportPolicy.evaluate(millis(), latestSample.flowRate, latestSample.error);
+    if (reason == ReportPolicy::REPORT_ACTIVE && !sampleIsFresh) {
+        reason = ReportPolicy::REPORT_NONE;  // Nothing new to say yet
+    }
+    if (reason != ReportPolicy::REPORT_NONE) {
         sendDataToMainUnit();
-        lastSendTime = millis();
+        reportPolicy.markSent(millis(), latestSample.flowRate, latestSample.error, reason);
+        sampleIsFresh = false;
     }
     
     // Update display
     updateDisplay();
 }
+
+// Network and UI work: buttons, touch, HTTP and the display
+void networkTask(void* parameter) {
+    for (;;) {
+        networkStats.tick((uint32_t)esp_timer_get_time());
+        drainSamples();
+        networkIteration();
+        logTaskStats();
+        vTaskDelay(1);  // Let the idle task on this core run
+    }
+}
+
+void loop() {
+    // All work happens in the pinned tasks
+    vTaskDelete(NULL);
+}
@@ -0,0 +1,216 @@
+// Benchmark of the flow filter variants on pulse traces. Each trace is
+// run through the PulsePeriodMeter the way the flow unit does it, sampled
+// at the idle (200 ms) and the dispensing (50 ms) report interval, and fed
+// to every filter side by side.
+//
+// For each filter it reports:
+// - lag: the shift that best lines the output up with a centred,
+//   non-causal reference rate
+// - noise: the RMS error left at that shift
+// - step: 10-90 % rise time after the synthetic trace's first step
+//
+//   FlowFilterBench              synthetic traces (jitter, bubbles, steps)
+//   FlowFilterBench edges.txt    a recorded trace: one edge time in us per line
+//
+// Without a file it also checks that at the 200 ms interval the original
+// 5-sample boxcar ran at, the selected filter lags less than the boxcar,
+// so a bad FLOW_FILTER choice fails the test run.
+#include "FlowFilter.h"
+#include "PulsePeriodMeter.h"
+#include "HostCheck.h"
+#include <math.h>
+#include <random>
+#include <vector>
+
+#define PULSES_PER_LITER 4380.0f     // BASE_FLOW_SENSOR_PULSES_PER_LITER
+#define REFERENCE_HALF_MS 250        // Reference averages edges over +-250 ms
+#define MAX_LAG_MS 1000
+
+typedef std::vector<uint32_t> Trace;
+
+struct Segment {
+    uint32_t untilMs;
+    float litersPerMinute;
+};
+
+// Edges for a piecewise constant flow with period jitter and, if asked,
+// air bubbles: a burst of spurious edges a few hundred microseconds apart
+static Trace synthesize(const Segment* segments, int count, float jitter, int bubblesPerSecond, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<float> noise(0.0f, jitter);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    Trace edges;
+    double nowUs = 0;
+    for (int i = 0; i < count; i++) {
+        double endUs = segments[i].untilMs * 1000.0;
+        float hz = segments[i].litersPerMinute * PULSES_PER_LITER / 60.0f;
+        if (hz <= 0.0f) {
+            nowUs = endUs;
+            continue;
+        }
+        while (nowUs < endUs) {
+            nowUs += 1e6 / hz * (1.0f + noise(random));
+            edges.push_back((uint32_t)nowUs);
+            if (bubblesPerSecond > 0 && uniform(random) < bubblesPerSecond / hz) {
+                for (int b = 1; b <= 3; b++) {
+                    edges.push_back((uint32_t)nowUs + b * 300);
+                }
+            }
+        }
+    }
+    return edges;
+}
+
+static bool load(const char* path, Trace& edges) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    unsigned long us;
+    while (fscanf(file, "%lu", &us) == 1) {
+        edges.push_back((uint32_t)us);
+    }
+    fclose(file);
+    return !edges.empty();
+}
+
+// Unfiltered period-meter rate every sampleMs, as the flow unit sees it
+static std::vector<float> meterRates(const Trace& edges, int sampleMs) {
+    std::vector<float> rates;
+    PulsePeriodMeter meter;
+    size_t next = 0;
+    uint32_t endUs = edges.back() + 1000000;
+    for (uint32_t nowUs = sampleMs * 1000; nowUs < endUs; nowUs += sampleMs * 1000) {
+        while (next < edges.size() && edges[next] <= nowUs) {
+            meter.addEdge(edges[next++]);
+        }
+        rates.push_back(meter.frequencyHz(nowUs) * 60.0f / PULSES_PER_LITER);
+    }
+    return rates;
+}
+
+// Edges counted in a window centred on each sample; it sees the future, so
+// it is a fair "true rate" to measure causal filters against
+static std::vector<float> referenceRates(const Trace& edges, size_t samples, int sampleMs) {
+    std::vector<float> rates(samples);
+    size_t low = 0;
+    size_t high = 0;
+    for (size_t i = 0; i < samples; i++) {
+        double centreUs = (i + 1) * sampleMs * 1000.0;
+        while (low < edges.size() && edges[low] < centreUs - REFERENCE_HALF_MS * 1000.0) low++;
+        while (high < edges.size() && edges[high] < centreUs + REFERENCE_HALF_MS * 1000.0) high++;
+        rates[i] = (high - low) / (2 * REFERENCE_HALF_MS / 1000.0f) * 60.0f / PULSES_PER_LITER;
+    }
+    return rates;
+}
+
+struct Result {
+    int lagMs;
+    float noise;    // L/min RMS
+    int riseMs;     // -1 when there is no step to measure
+};
+
+template <typename Filter>
+static Result measure(const std::vector<float>& input, const std::vector<float>& reference, int sampleMs,
+                      int stepSample, float stepFrom, float stepTo) {
+    Filter filter;
+    std::vector<float> output(input.size());
+    for (size_t i = 0; i < input.size(); i++) {
+        output[i] = filter.update(input[i], sampleMs / 1000.0f);
+    }
+
+    Result result = {0, INFINITY, -1};
+    int maxShift = MAX_LAG_MS / sampleMs;
+    for (int shift = 0; shift <= maxShift; shift++) {
+        double sum = 0;
+        size_t n = 0;
+        for (size_t i = shift; i < output.size(); i++) {
+            double error = output[i] - reference[i - shift];
+            sum += error * error;
+            n++;
+        }
+        float rms = n > 0 ? sqrt(sum / n) : INFINITY;
+        if (rms < result.noise) {
+            result.noise = rms;
+            result.lagMs = shift * sampleMs;
+        }
+    }
+
+    if (stepSample >= 0) {
+        float low = stepFrom + 0.1f * (stepTo - stepFrom);
+        float high = stepFrom + 0.9f * (stepTo - stepFrom);
+        int lowAt = -1;
+        for (size_t i = stepSample; i < output.size(); i++) {
+            if (lowAt < 0 && output[i] >= low) lowAt = i;
+            if (output[i] >= high) {
+                result.riseMs = ((int)i - lowAt) * sampleMs;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static void print(const char* name, const Result& result) {
+    printf("  %-16s lag %4d ms  noise %.3f L/min", name, result.lagMs, result.noise);
+    if (result.riseMs >= 0) {
+        printf("  step %4d ms", result.riseMs);
+    }
+    printf("\n");
+}
+
+// Runs every filter; returns the lags of the boxcar and the active filter.
+// stepMs < 0: no step to time.
+static void runAll(const char* title, const Trace& edges, int sampleMs, int stepMs, float stepFrom, float stepTo,
+                   int& boxcarLag, int& activeLag) {
+    std::vector<float> input = meterRates(edges, sampleMs);
+    std::vector<float> reference = referenceRates(edges, input.size(), sampleMs);
+    int step = stepMs < 0 ? -1 : stepMs / sampleMs - 1;
+    printf("%s, %d ms samples (%u edges)\n", title, sampleMs, (unsigned)edges.size());
+
+    Result boxcar = measure<BoxcarFilter<5> >(input, reference, sampleMs, step, stepFrom, stepTo);
+    Result active = measure<ActiveFlowFilter>(input, reference, sampleMs, step, stepFrom, stepTo);
+    print("unfiltered", measure<BoxcarFilter<1> >(input, reference, sampleMs, step, stepFrom, stepTo));
+    print("boxcar(5)", boxcar);
+    print("ema", measure<EmaFilter>(input, reference, sampleMs, step, stepFrom, stepTo));
+    print("median3+ema",
+          measure<FilterChain<MedianFilter<3>, EmaFilter> >(input, reference, sampleMs, step, stepFrom, stepTo));
+    print("alpha-beta", measure<AlphaBetaFilter>(input, reference, sampleMs, step, stepFrom, stepTo));
+    print("active", active);
+    boxcarLag = boxcar.lagMs;
+    activeLag = active.lagMs;
+}
+
+int main(int argc, char** argv) {
+    int boxcarLag;
+    int activeLag;
+
+    if (argc > 1) {
+        Trace edges;
+        if (!load(argv[1], edges)) {
+            printf("Cannot read a trace from %s\n", argv[1]);
+            return 1;
+        }
+        runAll(argv[1], edges, 200, -1, 0, 0, boxcarLag, activeLag);
+        runAll(argv[1], edges, 50, -1, 0, 0, boxcarLag, activeLag);
+        return 0;
+    }
+
+    // A pour: idle, open to 2 L/min at 1 s, throttle to 0.5 L/min, close
+    const Segment pour[] = {{1000, 0.0f}, {4000, 2.0f}, {7000, 0.5f}, {8000, 0.0f}};
+    const Trace clean = synthesize(pour, 4, 0.02f, 0, 1);
+    const Trace jittery = synthesize(pour, 4, 0.15f, 0, 2);
+    const Trace bubbles = synthesize(pour, 4, 0.05f, 4, 3);
+
+    static const int intervals[] = {200, 50};
+    for (int i = 0; i < 2; i++) {
+        int sampleMs = intervals[i];
+        runAll("clean pour", clean, sampleMs, 1000, 0.0f, 2.0f, boxcarLag, activeLag);
+        if (sampleMs == 200) CHECK(activeLag < boxcarLag);
+        runAll("jittery pour", jittery, sampleMs, 1000, 0.0f, 2.0f, boxcarLag, activeLag);
+        if (sampleMs == 200) CHECK(activeLag < boxcarLag);
+        runAll("pour with bubbles", bubbles, sampleMs, 1000, 0.0f, 2.0f, boxcarLag, activeLag);
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,57 @@
+// SampleBuffer replay bookkeeping: an acked batch removes exactly the
+// records it carried, even when the drop policy moved the head meanwhile.
+#include "SampleBuffer.h"
+#include "HostCheck.h"
+
+static TelemetryRecord makeRecord(uint32_t sequence) {
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.sequence = sequence;
+    return record;
+}
+
+// Records 0 and 1 go out in a batch; before the ack, three more arrive and
+// DROP_OLDEST pushes 0..2 out. The ack must not take 3 with it.
+static void testDropDuringFlight() {
+    SampleBuffer buffer;
+    buffer.setLimit(4);
+    for (uint32_t sequence = 0; sequence < 4; sequence++) {
+        buffer.push(makeRecord(sequence));
+    }
+    TelemetryRecord batch[2];
+    size_t count = buffer.peek(batch, 2);
+    CHECK(count == 2);
+
+    for (uint32_t sequence = 4; sequence < 7; sequence++) {
+        buffer.push(makeRecord(sequence));
+    }
+    CHECK(buffer.getStats().dropped == 3);
+
+    buffer.discardThrough(batch[count - 1].sequence);
+    TelemetryRecord oldest;
+    CHECK(buffer.size() == 4);
+    CHECK(buffer.peek(&oldest, 1) == 1 && oldest.sequence == 3);
+    CHECK(buffer.getStats().replayed == 0);
+
+    buffer.discardThrough(4);
+    CHECK(buffer.size() == 2);
+    CHECK(buffer.peek(&oldest, 1) == 1 && oldest.sequence == 5);
+    CHECK(buffer.getStats().replayed == 2);
+}
+
+static void testSequenceWrap() {
+    SampleBuffer buffer;
+    buffer.push(makeRecord(0xFFFFFFFEu));
+    buffer.push(makeRecord(0xFFFFFFFFu));
+    buffer.push(makeRecord(0));
+    buffer.discardThrough(0xFFFFFFFFu);
+    TelemetryRecord oldest;
+    CHECK(buffer.size() == 1);
+    CHECK(buffer.peek(&oldest, 1) == 1 && oldest.sequence == 0);
+}
+
+int main() {
+    testDropDuringFlight();
+    testSequenceWrap();
+    return checkResult();
+}
@@ -0,0 +1,115 @@
+// SpscRing, the edge ring between the pulse interrupt and the acquisition
+// task: order across index wraparound, drop-and-count when full, a producer
+// thread racing the consumer, and PulsePeriodMeter::consume draining it.
+#include <math.h>
+#include <thread>
+#include "SpscRing.h"
+#include "PulsePeriodMeter.h"
+#include "HostCheck.h"
+
+// Many times round a small ring: every item comes out once, in order
+static void testWraparound() {
+    SpscRing<uint32_t, 4> ring;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    for (int round = 0; round < 100; round++) {
+        int batch = 1 + round % 4;
+        for (int i = 0; i < batch; i++) {
+            CHECK(ring.push(next++));
+        }
+        CHECK(ring.size() == (uint32_t)batch);
+        uint32_t item;
+        while (ring.pop(item)) {
+            CHECK(item == expected);
+            expected++;
+        }
+        CHECK(ring.empty());
+    }
+    CHECK(expected == next);
+    CHECK(ring.overrunCount() == 0);
+}
+
+// A full ring keeps what it has and counts each item it turned away
+static void testOverrun() {
+    SpscRing<uint32_t, 4> ring;
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(ring.push(i));
+    }
+    CHECK(!ring.push(4));
+    CHECK(!ring.push(5));
+    CHECK(ring.overrunCount() == 2);
+    CHECK(ring.size() == 4);
+
+    uint32_t item;
+    CHECK(ring.pop(item) && item == 0);
+    CHECK(ring.push(6));
+    const uint32_t remaining[] = {1, 2, 3, 6};
+    for (uint32_t want : remaining) {
+        CHECK(ring.pop(item) && item == want);
+    }
+    CHECK(!ring.pop(item));
+    CHECK(ring.overrunCount() == 2);
+}
+
+// Producer on its own thread, as the interrupt is, retrying when full:
+// nothing is lost, reordered or duplicated
+static void testConcurrent() {
+    static SpscRing<uint32_t, 64> ring;
+    const uint32_t items = 200000;
+    std::thread producer([]() {
+        for (uint32_t i = 1; i <= items; ) {
+            if (ring.push(i)) {
+                i++;
+            } else {
+                std::this_thread::yield();  // Single-core hosts need the consumer to run
+            }
+        }
+    });
+    uint32_t expected = 1;
+    bool inOrder = true;
+    while (expected <= items) {
+        uint32_t item;
+        if (ring.pop(item)) {
+            inOrder = inOrder && item == expected;
+            expected++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(inOrder);
+    CHECK(ring.empty());
+}
+
+// The meter takes every pending edge, oldest first, and leaves the ring empty
+static void testConsume() {
+    static EdgeRing ring;
+    PulsePeriodMeter meter;
+    uint32_t now = 0xFFFFF000u;  // Timestamps wrap on the way
+    for (int i = 0; i < 100; i++) {
+        now += 2000;  // 500 Hz
+        CHECK(ring.push(now));
+    }
+    meter.consume(ring);
+    CHECK(ring.empty());
+    CHECK(meter.edgeCount() == 100);
+    CHECK(fabs(meter.frequencyHz(now) - 500.0f) < 0.5f);
+
+    // More than the ring holds: the excess is counted, the rest still measured
+    for (uint32_t i = 0; i < EDGE_RING_CAPACITY + 10; i++) {
+        now += 1000;  // 1 kHz
+        ring.push(now);
+    }
+    CHECK(ring.overrunCount() == 10);
+    meter.consume(ring);
+    CHECK(ring.empty());
+    CHECK(meter.edgeCount() == 100 + EDGE_RING_CAPACITY);
+}
+
+int main() {
+    testWraparound();
+    testOverrun();
+    testConcurrent();
+    testConsume();
+    return checkResult();
+}